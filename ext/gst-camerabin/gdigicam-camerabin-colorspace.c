@@ -0,0 +1,681 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * YUV to RGB conversion of the preview buffers.
+ *
+ * Every supported format is converted row by row: the luma and the
+ * horizontally subsampled chroma of a row are made contiguous (which
+ * is free for I420) and then handed to a row kernel, so there is a
+ * single kernel per instruction set. All the kernels use the same
+ * BT.601 6-bit fixed point arithmetic, so they give identical results.
+ */
+
+#include <string.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-colorspace.h"
+#include "gdigicam-camerabin-scratch.h"
+#include "gdigicam-debug.h"
+
+#if defined(__GNUC__) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9))) && \
+    (defined(__i386__) || defined(__x86_64__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+
+/*****************************************/
+/* Utiliy macros */
+/*****************************************/
+
+/* BT.601, video range, 6 bits of fraction */
+#define COEF_Y   75
+#define COEF_RV 102
+#define COEF_GU  25
+#define COEF_GV  52
+#define COEF_BU 129
+
+#define CLAMP_BYTE(x) ((guchar) CLAMP ((x), 0, 255))
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+typedef void (*RowFunc) (const guchar *y,
+                         const guchar *u,
+                         const guchar *v,
+                         guchar *dst,
+                         gint width,
+                         gboolean has_alpha);
+
+
+/*****************************************/
+/* Private variables */
+/*****************************************/
+
+static GOnce simd_once = G_ONCE_INIT;
+static volatile guint simd_forced = ~0U;
+/* The split rows, as long as the image */
+static GStaticPrivate scratch_key = G_STATIC_PRIVATE_INIT;
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static gpointer _detect_simd (gpointer data);
+static RowFunc _get_row_func (void);
+static void _row_c (const guchar *y,
+                    const guchar *u,
+                    const guchar *v,
+                    guchar *dst,
+                    gint width,
+                    gboolean has_alpha);
+#ifdef HAVE_X86_KERNELS
+static void _row_sse2 (const guchar *y,
+                       const guchar *u,
+                       const guchar *v,
+                       guchar *dst,
+                       gint width,
+                       gboolean has_alpha);
+static void _row_avx2 (const guchar *y,
+                       const guchar *u,
+                       const guchar *v,
+                       guchar *dst,
+                       gint width,
+                       gboolean has_alpha);
+#endif
+#ifdef HAVE_NEON_KERNELS
+static void _row_neon (const guchar *y,
+                       const guchar *u,
+                       const guchar *v,
+                       guchar *dst,
+                       gint width,
+                       gboolean has_alpha);
+#endif
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_colorspace_supported:
+ * @format: A #GstVideoFormat.
+ *
+ * Checks whether buffers in @format can be converted by
+ * _g_digicam_camerabin_colorspace_convert().
+ *
+ * Returns: #TRUE if @format is supported, #FALSE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_colorspace_supported (GstVideoFormat format)
+{
+    switch (format) {
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_UYVY:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+
+/**
+ * _g_digicam_camerabin_colorspace_convert:
+ * @format: The #GstVideoFormat of @src.
+ * @src: The source image, laid out as GStreamer does for @format.
+ * @width: Width of the image.
+ * @height: Height of the image.
+ * @dst: Destination RGB or RGBA pixels.
+ * @dst_stride: Row stride of @dst.
+ * @has_alpha: Whether @dst has an alpha channel, which is set
+ * opaque.
+ *
+ * Converts a YUV image to RGB using the fastest kernel available in
+ * the running CPU.
+ *
+ * Returns: #FALSE if @format is not supported, #TRUE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_colorspace_convert (GstVideoFormat format,
+                                         const guchar  *src,
+                                         gint           width,
+                                         gint           height,
+                                         guchar        *dst,
+                                         gint           dst_stride,
+                                         gboolean       has_alpha)
+{
+    RowFunc row_func = NULL;
+    const guchar *src_y = NULL;
+    const guchar *src_u = NULL;
+    const guchar *src_v = NULL;
+    guchar *scratch = NULL;
+    guchar *row_y = NULL;
+    guchar *row_u = NULL;
+    guchar *row_v = NULL;
+    gint stride_y, stride_u, stride_v;
+    gint offset_u, offset_v;
+    gint chroma_w;
+    gint i, j;
+
+    g_return_val_if_fail (NULL != src, FALSE);
+    g_return_val_if_fail (NULL != dst, FALSE);
+    g_return_val_if_fail ((0 < width) && (0 < height), FALSE);
+
+    if (!_g_digicam_camerabin_colorspace_supported (format)) {
+        return FALSE;
+    }
+
+    row_func = _get_row_func ();
+    chroma_w = (width + 1) / 2;
+
+    stride_y = gst_video_format_get_row_stride (format, 0, width);
+    stride_u = gst_video_format_get_row_stride (format, 1, width);
+    stride_v = gst_video_format_get_row_stride (format, 2, width);
+    offset_u = gst_video_format_get_component_offset (format, 1, width, height);
+    offset_v = gst_video_format_get_component_offset (format, 2, width, height);
+
+    /* Packed and semi planar rows need to be split first */
+    if (GST_VIDEO_FORMAT_I420 != format) {
+        scratch = _g_digicam_camerabin_scratch_get (&scratch_key,
+                                                    GST_ROUND_UP_16 (width) +
+                                                    2 * GST_ROUND_UP_16 (chroma_w));
+        row_y = scratch;
+        row_u = row_y + GST_ROUND_UP_16 (width);
+        row_v = row_u + GST_ROUND_UP_16 (chroma_w);
+    }
+
+    for (i = 0; i < height; i++) {
+        switch (format) {
+        case GST_VIDEO_FORMAT_I420:
+            src_y = src + i * stride_y;
+            src_u = src + offset_u + (i / 2) * stride_u;
+            src_v = src + offset_v + (i / 2) * stride_v;
+            break;
+        case GST_VIDEO_FORMAT_NV12:
+            src_y = src + i * stride_y;
+            src_u = src + offset_u + (i / 2) * stride_u;
+            for (j = 0; j < chroma_w; j++) {
+                row_u[j] = src_u[2 * j];
+                row_v[j] = src_u[2 * j + 1];
+            }
+            src_u = row_u;
+            src_v = row_v;
+            break;
+        default:
+            /* UYVY */
+            src_y = src + i * stride_y;
+            for (j = 0; j < width / 2; j++) {
+                row_u[j] = src_y[4 * j];
+                row_y[2 * j] = src_y[4 * j + 1];
+                row_v[j] = src_y[4 * j + 2];
+                row_y[2 * j + 1] = src_y[4 * j + 3];
+            }
+            if (width & 1) {
+                row_u[j] = src_y[4 * j];
+                row_y[2 * j] = src_y[4 * j + 1];
+                row_v[j] = src_y[4 * j + 2];
+            }
+            src_y = row_y;
+            src_u = row_u;
+            src_v = row_v;
+            break;
+        }
+
+        row_func (src_y, src_u, src_v, dst + i * dst_stride, width, has_alpha);
+    }
+
+    return TRUE;
+}
+
+
+/**
+ * _g_digicam_camerabin_colorspace_get_simd:
+ *
+ * Gets the instruction set extensions the conversion kernels are
+ * using.
+ *
+ * Returns: A #GDigicamCamerabinSimd mask.
+ **/
+guint
+_g_digicam_camerabin_colorspace_get_simd (void)
+{
+    guint simd;
+
+    simd = GPOINTER_TO_UINT (g_once (&simd_once, _detect_simd, NULL));
+
+    return simd & simd_forced;
+}
+
+
+/**
+ * _g_digicam_camerabin_colorspace_set_simd:
+ * @simd: A #GDigicamCamerabinSimd mask.
+ *
+ * Restricts the instruction set extensions the conversion kernels
+ * can use to the ones in @simd and supported by the running CPU. It
+ * is meant for testing and benchmarking.
+ **/
+void
+_g_digicam_camerabin_colorspace_set_simd (guint simd)
+{
+    simd_forced = simd;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static gpointer
+_detect_simd (gpointer data)
+{
+    guint simd = G_DIGICAM_CAMERABIN_SIMD_NONE;
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("sse2")) {
+        simd |= G_DIGICAM_CAMERABIN_SIMD_SSE2;
+    }
+    if (__builtin_cpu_supports ("avx2")) {
+        simd |= G_DIGICAM_CAMERABIN_SIMD_AVX2;
+    }
+#endif
+
+#ifdef HAVE_NEON_KERNELS
+    /* The whole library is built for NEON already */
+    simd |= G_DIGICAM_CAMERABIN_SIMD_NEON;
+#endif
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: colorspace kernels available: "
+                     "0x%x", simd);
+
+    return GUINT_TO_POINTER (simd);
+}
+
+
+static RowFunc
+_get_row_func (void)
+{
+    guint simd;
+
+    simd = _g_digicam_camerabin_colorspace_get_simd ();
+
+#ifdef HAVE_X86_KERNELS
+    if (simd & G_DIGICAM_CAMERABIN_SIMD_AVX2) {
+        return _row_avx2;
+    }
+    if (simd & G_DIGICAM_CAMERABIN_SIMD_SSE2) {
+        return _row_sse2;
+    }
+#endif
+
+#ifdef HAVE_NEON_KERNELS
+    if (simd & G_DIGICAM_CAMERABIN_SIMD_NEON) {
+        return _row_neon;
+    }
+#endif
+
+    return _row_c;
+}
+
+
+static void
+_row_c (const guchar *y,
+        const guchar *u,
+        const guchar *v,
+        guchar *dst,
+        gint width,
+        gboolean has_alpha)
+{
+    gint bpp;
+    gint luma, cu, cv;
+    gint x;
+
+    bpp = has_alpha ? 4 : 3;
+
+    for (x = 0; x < width; x++) {
+        luma = (y[x] - 16) * COEF_Y;
+        cu = u[x >> 1] - 128;
+        cv = v[x >> 1] - 128;
+
+        dst[0] = CLAMP_BYTE ((luma + COEF_RV * cv) >> 6);
+        dst[1] = CLAMP_BYTE ((luma - COEF_GU * cu - COEF_GV * cv) >> 6);
+        dst[2] = CLAMP_BYTE ((luma + COEF_BU * cu) >> 6);
+        if (has_alpha) {
+            dst[3] = 0xff;
+        }
+        dst += bpp;
+    }
+}
+
+
+#ifdef HAVE_X86_KERNELS
+
+/* Converts 8 pixels, given as 16 bits luma and duplicated chroma
+ * terms, to 16 bits R, G and B. Saturation only happens where the
+ * result would be clamped to 255 anyway. */
+#define YUV_TO_RGB_EPI16(add, sub, srai, luma, rv, guv, bu, r, g, b) \
+    G_STMT_START {                                                   \
+        r = srai (add (luma, rv), 6);                                \
+        g = srai (sub (luma, guv), 6);                               \
+        b = srai (add (luma, bu), 6);                                \
+    } G_STMT_END
+
+__attribute__ ((target ("sse2")))
+static void
+_store_rgba_sse2 (guchar *dst, __m128i r, __m128i g, __m128i b)
+{
+    __m128i a, rg, ba;
+
+    a = _mm_set1_epi8 ((gchar) 0xff);
+
+    rg = _mm_unpacklo_epi8 (r, g);
+    ba = _mm_unpacklo_epi8 (b, a);
+    _mm_storeu_si128 ((__m128i *) dst, _mm_unpacklo_epi16 (rg, ba));
+    _mm_storeu_si128 ((__m128i *) (dst + 16), _mm_unpackhi_epi16 (rg, ba));
+
+    rg = _mm_unpackhi_epi8 (r, g);
+    ba = _mm_unpackhi_epi8 (b, a);
+    _mm_storeu_si128 ((__m128i *) (dst + 32), _mm_unpacklo_epi16 (rg, ba));
+    _mm_storeu_si128 ((__m128i *) (dst + 48), _mm_unpackhi_epi16 (rg, ba));
+}
+
+
+__attribute__ ((target ("sse2")))
+static void
+_row_sse2 (const guchar *y,
+           const guchar *u,
+           const guchar *v,
+           guchar *dst,
+           gint width,
+           gboolean has_alpha)
+{
+    __m128i zero, c16, c128;
+    __m128i yv, uv, vv;
+    __m128i ylo, yhi, cu, cv;
+    __m128i rv, guv, bu;
+    __m128i rlo, glo, blo, rhi, ghi, bhi;
+    guchar rgba[64];
+    gint bpp;
+    gint x, i;
+
+    bpp = has_alpha ? 4 : 3;
+    zero = _mm_setzero_si128 ();
+    c16 = _mm_set1_epi16 (16);
+    c128 = _mm_set1_epi16 (128);
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        yv = _mm_loadu_si128 ((const __m128i *) (y + x));
+        uv = _mm_loadl_epi64 ((const __m128i *) (u + x / 2));
+        vv = _mm_loadl_epi64 ((const __m128i *) (v + x / 2));
+
+        ylo = _mm_mullo_epi16 (_mm_sub_epi16 (_mm_unpacklo_epi8 (yv, zero), c16),
+                               _mm_set1_epi16 (COEF_Y));
+        yhi = _mm_mullo_epi16 (_mm_sub_epi16 (_mm_unpackhi_epi8 (yv, zero), c16),
+                               _mm_set1_epi16 (COEF_Y));
+        cu = _mm_sub_epi16 (_mm_unpacklo_epi8 (uv, zero), c128);
+        cv = _mm_sub_epi16 (_mm_unpacklo_epi8 (vv, zero), c128);
+
+        /* Chroma terms for 8 pairs of pixels */
+        rv = _mm_mullo_epi16 (cv, _mm_set1_epi16 (COEF_RV));
+        guv = _mm_add_epi16 (_mm_mullo_epi16 (cu, _mm_set1_epi16 (COEF_GU)),
+                             _mm_mullo_epi16 (cv, _mm_set1_epi16 (COEF_GV)));
+        bu = _mm_mullo_epi16 (cu, _mm_set1_epi16 (COEF_BU));
+
+        YUV_TO_RGB_EPI16 (_mm_adds_epi16, _mm_subs_epi16, _mm_srai_epi16, ylo,
+                          _mm_unpacklo_epi16 (rv, rv),
+                          _mm_unpacklo_epi16 (guv, guv),
+                          _mm_unpacklo_epi16 (bu, bu),
+                          rlo, glo, blo);
+        YUV_TO_RGB_EPI16 (_mm_adds_epi16, _mm_subs_epi16, _mm_srai_epi16, yhi,
+                          _mm_unpackhi_epi16 (rv, rv),
+                          _mm_unpackhi_epi16 (guv, guv),
+                          _mm_unpackhi_epi16 (bu, bu),
+                          rhi, ghi, bhi);
+
+        if (has_alpha) {
+            _store_rgba_sse2 (dst + x * 4,
+                              _mm_packus_epi16 (rlo, rhi),
+                              _mm_packus_epi16 (glo, ghi),
+                              _mm_packus_epi16 (blo, bhi));
+        } else {
+            /* SSE2 has no byte shuffle to pack 24 bits pixels */
+            _store_rgba_sse2 (rgba,
+                              _mm_packus_epi16 (rlo, rhi),
+                              _mm_packus_epi16 (glo, ghi),
+                              _mm_packus_epi16 (blo, bhi));
+            for (i = 0; i < 16; i++) {
+                dst[(x + i) * 3] = rgba[i * 4];
+                dst[(x + i) * 3 + 1] = rgba[i * 4 + 1];
+                dst[(x + i) * 3 + 2] = rgba[i * 4 + 2];
+            }
+        }
+    }
+
+    if (x < width) {
+        _row_c (y + x, u + x / 2, v + x / 2, dst + x * bpp,
+                width - x, has_alpha);
+    }
+}
+
+
+__attribute__ ((target ("avx2")))
+static void
+_store_rgb_ssse3 (guchar *dst, __m128i r, __m128i g, __m128i b)
+{
+    __m128i a, rg, ba, mask;
+    __m128i p0, p1, p2, p3;
+
+    a = _mm_setzero_si128 ();
+    mask = _mm_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                          -1, -1, -1, -1);
+
+    rg = _mm_unpacklo_epi8 (r, g);
+    ba = _mm_unpacklo_epi8 (b, a);
+    p0 = _mm_shuffle_epi8 (_mm_unpacklo_epi16 (rg, ba), mask);
+    p1 = _mm_shuffle_epi8 (_mm_unpackhi_epi16 (rg, ba), mask);
+    rg = _mm_unpackhi_epi8 (r, g);
+    ba = _mm_unpackhi_epi8 (b, a);
+    p2 = _mm_shuffle_epi8 (_mm_unpacklo_epi16 (rg, ba), mask);
+    p3 = _mm_shuffle_epi8 (_mm_unpackhi_epi16 (rg, ba), mask);
+
+    /* 4 x 12 bytes into 3 x 16 bytes */
+    _mm_storeu_si128 ((__m128i *) dst,
+                      _mm_or_si128 (p0, _mm_slli_si128 (p1, 12)));
+    _mm_storeu_si128 ((__m128i *) (dst + 16),
+                      _mm_or_si128 (_mm_srli_si128 (p1, 4),
+                                    _mm_slli_si128 (p2, 8)));
+    _mm_storeu_si128 ((__m128i *) (dst + 32),
+                      _mm_or_si128 (_mm_srli_si128 (p2, 8),
+                                    _mm_slli_si128 (p3, 4)));
+}
+
+
+__attribute__ ((target ("avx2")))
+static void
+_row_avx2 (const guchar *y,
+           const guchar *u,
+           const guchar *v,
+           guchar *dst,
+           gint width,
+           gboolean has_alpha)
+{
+    __m256i c16, c128;
+    __m256i ylo, yhi, cu, cv;
+    __m256i rv, guv, bu;
+    __m256i rlo, glo, blo, rhi, ghi, bhi;
+    __m256i r, g, b;
+    gint bpp;
+    gint x;
+
+    bpp = has_alpha ? 4 : 3;
+    c16 = _mm256_set1_epi16 (16);
+    c128 = _mm256_set1_epi16 (128);
+
+    for (x = 0; x + 32 <= width; x += 32) {
+        ylo = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (y + x)));
+        yhi = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (y + x + 16)));
+        ylo = _mm256_mullo_epi16 (_mm256_sub_epi16 (ylo, c16),
+                                  _mm256_set1_epi16 (COEF_Y));
+        yhi = _mm256_mullo_epi16 (_mm256_sub_epi16 (yhi, c16),
+                                  _mm256_set1_epi16 (COEF_Y));
+
+        /* Reorder the chroma so the in-lane unpacks below duplicate
+         * it in pixel order */
+        cu = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (u + x / 2)));
+        cv = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (v + x / 2)));
+        cu = _mm256_permute4x64_epi64 (_mm256_sub_epi16 (cu, c128), 0xd8);
+        cv = _mm256_permute4x64_epi64 (_mm256_sub_epi16 (cv, c128), 0xd8);
+
+        rv = _mm256_mullo_epi16 (cv, _mm256_set1_epi16 (COEF_RV));
+        guv = _mm256_add_epi16 (_mm256_mullo_epi16 (cu, _mm256_set1_epi16 (COEF_GU)),
+                                _mm256_mullo_epi16 (cv, _mm256_set1_epi16 (COEF_GV)));
+        bu = _mm256_mullo_epi16 (cu, _mm256_set1_epi16 (COEF_BU));
+
+        YUV_TO_RGB_EPI16 (_mm256_adds_epi16, _mm256_subs_epi16, _mm256_srai_epi16,
+                          ylo,
+                          _mm256_unpacklo_epi16 (rv, rv),
+                          _mm256_unpacklo_epi16 (guv, guv),
+                          _mm256_unpacklo_epi16 (bu, bu),
+                          rlo, glo, blo);
+        YUV_TO_RGB_EPI16 (_mm256_adds_epi16, _mm256_subs_epi16, _mm256_srai_epi16,
+                          yhi,
+                          _mm256_unpackhi_epi16 (rv, rv),
+                          _mm256_unpackhi_epi16 (guv, guv),
+                          _mm256_unpackhi_epi16 (bu, bu),
+                          rhi, ghi, bhi);
+
+        /* Packing is in-lane too */
+        r = _mm256_permute4x64_epi64 (_mm256_packus_epi16 (rlo, rhi), 0xd8);
+        g = _mm256_permute4x64_epi64 (_mm256_packus_epi16 (glo, ghi), 0xd8);
+        b = _mm256_permute4x64_epi64 (_mm256_packus_epi16 (blo, bhi), 0xd8);
+
+        if (has_alpha) {
+            _store_rgba_sse2 (dst + x * 4,
+                              _mm256_castsi256_si128 (r),
+                              _mm256_castsi256_si128 (g),
+                              _mm256_castsi256_si128 (b));
+            _store_rgba_sse2 (dst + (x + 16) * 4,
+                              _mm256_extracti128_si256 (r, 1),
+                              _mm256_extracti128_si256 (g, 1),
+                              _mm256_extracti128_si256 (b, 1));
+        } else {
+            _store_rgb_ssse3 (dst + x * 3,
+                              _mm256_castsi256_si128 (r),
+                              _mm256_castsi256_si128 (g),
+                              _mm256_castsi256_si128 (b));
+            _store_rgb_ssse3 (dst + (x + 16) * 3,
+                              _mm256_extracti128_si256 (r, 1),
+                              _mm256_extracti128_si256 (g, 1),
+                              _mm256_extracti128_si256 (b, 1));
+        }
+    }
+
+    if (x < width) {
+        _row_sse2 (y + x, u + x / 2, v + x / 2, dst + x * bpp,
+                   width - x, has_alpha);
+    }
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+
+#ifdef HAVE_NEON_KERNELS
+
+static void
+_row_neon (const guchar *y,
+           const guchar *u,
+           const guchar *v,
+           guchar *dst,
+           gint width,
+           gboolean has_alpha)
+{
+    uint8x16_t yv;
+    int16x8_t ylo, yhi, cu, cv;
+    int16x8_t rv, guv, bu;
+    int16x8x2_t rv2, guv2, bu2;
+    uint8x16x3_t rgb;
+    uint8x16x4_t rgba;
+    gint bpp;
+    gint x;
+
+    bpp = has_alpha ? 4 : 3;
+    rgba.val[3] = vdupq_n_u8 (0xff);
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        yv = vld1q_u8 (y + x);
+        ylo = vmulq_n_s16 (vreinterpretq_s16_u16 (vsubl_u8 (vget_low_u8 (yv),
+                                                             vdup_n_u8 (16))),
+                           COEF_Y);
+        yhi = vmulq_n_s16 (vreinterpretq_s16_u16 (vsubl_u8 (vget_high_u8 (yv),
+                                                             vdup_n_u8 (16))),
+                           COEF_Y);
+        cu = vreinterpretq_s16_u16 (vsubl_u8 (vld1_u8 (u + x / 2),
+                                              vdup_n_u8 (128)));
+        cv = vreinterpretq_s16_u16 (vsubl_u8 (vld1_u8 (v + x / 2),
+                                              vdup_n_u8 (128)));
+
+        rv = vmulq_n_s16 (cv, COEF_RV);
+        guv = vmlaq_n_s16 (vmulq_n_s16 (cu, COEF_GU), cv, COEF_GV);
+        bu = vmulq_n_s16 (cu, COEF_BU);
+        rv2 = vzipq_s16 (rv, rv);
+        guv2 = vzipq_s16 (guv, guv);
+        bu2 = vzipq_s16 (bu, bu);
+
+        rgb.val[0] = vcombine_u8 (vqshrun_n_s16 (vqaddq_s16 (ylo, rv2.val[0]), 6),
+                                  vqshrun_n_s16 (vqaddq_s16 (yhi, rv2.val[1]), 6));
+        rgb.val[1] = vcombine_u8 (vqshrun_n_s16 (vqsubq_s16 (ylo, guv2.val[0]), 6),
+                                  vqshrun_n_s16 (vqsubq_s16 (yhi, guv2.val[1]), 6));
+        rgb.val[2] = vcombine_u8 (vqshrun_n_s16 (vqaddq_s16 (ylo, bu2.val[0]), 6),
+                                  vqshrun_n_s16 (vqaddq_s16 (yhi, bu2.val[1]), 6));
+
+        if (has_alpha) {
+            rgba.val[0] = rgb.val[0];
+            rgba.val[1] = rgb.val[1];
+            rgba.val[2] = rgb.val[2];
+            vst4q_u8 (dst + x * 4, rgba);
+        } else {
+            vst3q_u8 (dst + x * 3, rgb);
+        }
+    }
+
+    if (x < width) {
+        _row_c (y + x, u + x / 2, v + x / 2, dst + x * bpp,
+                width - x, has_alpha);
+    }
+}
+
+#endif /* HAVE_NEON_KERNELS */
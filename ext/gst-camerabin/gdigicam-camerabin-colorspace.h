@@ -0,0 +1,69 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef _G_DIGICAM_CAMERABIN_COLORSPACE_H_
+#define _G_DIGICAM_CAMERABIN_COLORSPACE_H_
+
+#include <glib.h>
+#include <gst/video/video.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * GDigicamCamerabinSimd:
+ * @G_DIGICAM_CAMERABIN_SIMD_NONE: plain C kernels.
+ * @G_DIGICAM_CAMERABIN_SIMD_SSE2: x86 SSE2 kernels.
+ * @G_DIGICAM_CAMERABIN_SIMD_AVX2: x86 AVX2 kernels.
+ * @G_DIGICAM_CAMERABIN_SIMD_NEON: ARM NEON kernels.
+ *
+ * Instruction set extensions the colorspace kernels can use.
+ */
+    typedef enum {
+        G_DIGICAM_CAMERABIN_SIMD_NONE = 0,
+        G_DIGICAM_CAMERABIN_SIMD_SSE2 = 1 << 0,
+        G_DIGICAM_CAMERABIN_SIMD_AVX2 = 1 << 1,
+        G_DIGICAM_CAMERABIN_SIMD_NEON = 1 << 2,
+    } GDigicamCamerabinSimd;
+
+
+    gboolean _g_digicam_camerabin_colorspace_supported (GstVideoFormat format);
+    gboolean _g_digicam_camerabin_colorspace_convert (GstVideoFormat format,
+                                                      const guchar  *src,
+                                                      gint           width,
+                                                      gint           height,
+                                                      guchar        *dst,
+                                                      gint           dst_stride,
+                                                      gboolean       has_alpha);
+    guint _g_digicam_camerabin_colorspace_get_simd (void);
+    void _g_digicam_camerabin_colorspace_set_simd (guint simd);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,384 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Parallel JPEG encoding of the captured frames.
+ *
+ * Every frame is encoded by the first free thread of a pool, so a
+ * burst uses all the cores, but the pictures are saved in the order
+ * they were given: a finished frame waits for the ones given before,
+ * and whichever thread finishes the oldest one saves all the finished
+ * ones in a row. The number of frames in flight is bounded, a new one
+ * is refused while there is no room, so the captures can't get ahead
+ * of what the encoders sustain and the caller never waits. The saving
+ * itself can be handed to a #GDigicamCamerabinWriter. Single pictures
+ * can also be split in strips encoded in parallel, see
+ * _g_digicam_camerabin_jpeg_encode_strips().
+ */
+
+#include <config.h>
+
+#include "gdigicam-camerabin-encoder.h"
+#include "gdigicam-camerabin-jpeg.h"
+#include "gdigicam-debug.h"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+struct _GDigicamCamerabinEncoder {
+    GThreadPool *pool;
+    GMutex *lock;
+    GCond *cond;
+    guint queue_depth;
+    guint strips;
+    GDigicamCamerabinWriter *writer;
+    /* Jobs given and not saved yet, oldest first */
+    GQueue jobs;
+    /* Whether a thread is saving the finished jobs */
+    gboolean saving;
+};
+
+typedef struct _EncoderJob {
+    GstBuffer *frame;
+    GstVideoFormat format;
+    gint width;
+    gint height;
+    gint quality;
+    gchar *filename;
+    GDigicamCamerabinEncoderDoneFunc func;
+    gpointer user_data;
+    GDestroyNotify notify;
+    /* Result of the encoding */
+    gboolean encoded;
+    guchar *data;
+    gsize size;
+    GError *error;
+} EncoderJob;
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static void _encoder_run (EncoderJob *job,
+                          GDigicamCamerabinEncoder *encoder);
+static void _encoder_save (GDigicamCamerabinEncoder *encoder,
+                           EncoderJob *job);
+static void _encoder_job_free (EncoderJob *job);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_encoder_new:
+ * @threads: The number of frames encoded at the same time.
+ * @queue_depth: The maximum number of frames given and not saved
+ * yet.
+ * @strips: The number of strips each frame is split in, 1 to encode
+ * them whole.
+ * @writer: The #GDigicamCamerabinWriter saving the pictures, or #NULL
+ * to save them from the encoder threads.
+ * @error: Return location for a #GError, or #NULL.
+ *
+ * Creates a pool of JPEG encoders.
+ *
+ * Returns: A new #GDigicamCamerabinEncoder, or #NULL if the threads
+ * could not be created.
+ **/
+GDigicamCamerabinEncoder *
+_g_digicam_camerabin_encoder_new (guint                    threads,
+                                  guint                    queue_depth,
+                                  guint                    strips,
+                                  GDigicamCamerabinWriter *writer,
+                                  GError                 **error)
+{
+    GDigicamCamerabinEncoder *encoder = NULL;
+
+    g_return_val_if_fail (0 < threads, NULL);
+    g_return_val_if_fail (0 < queue_depth, NULL);
+
+    encoder = g_slice_new0 (GDigicamCamerabinEncoder);
+    encoder->pool = g_thread_pool_new ((GFunc) _encoder_run, encoder,
+                                       threads, FALSE, error);
+    if (NULL == encoder->pool) {
+        g_slice_free (GDigicamCamerabinEncoder, encoder);
+        return NULL;
+    }
+
+    encoder->lock = g_mutex_new ();
+    encoder->cond = g_cond_new ();
+    encoder->queue_depth = queue_depth;
+    encoder->strips = MAX (strips, 1);
+    encoder->writer = writer;
+    g_queue_init (&encoder->jobs);
+
+    return encoder;
+}
+
+
+/**
+ * _g_digicam_camerabin_encoder_free:
+ * @encoder: A #GDigicamCamerabinEncoder.
+ *
+ * Waits for all the given frames to be saved, or given to the writer,
+ * and frees @encoder.
+ **/
+void
+_g_digicam_camerabin_encoder_free (GDigicamCamerabinEncoder *encoder)
+{
+    if (NULL == encoder) {
+        return;
+    }
+
+    g_mutex_lock (encoder->lock);
+    while (!g_queue_is_empty (&encoder->jobs)) {
+        g_cond_wait (encoder->cond, encoder->lock);
+    }
+    g_mutex_unlock (encoder->lock);
+
+    g_thread_pool_free (encoder->pool, FALSE, TRUE);
+    g_cond_free (encoder->cond);
+    g_mutex_free (encoder->lock);
+    g_slice_free (GDigicamCamerabinEncoder, encoder);
+}
+
+
+/**
+ * _g_digicam_camerabin_encoder_push:
+ * @encoder: A #GDigicamCamerabinEncoder.
+ * @frame: The frame to encode. @encoder takes ownership of it.
+ * @format: The #GstVideoFormat of @frame.
+ * @width: Width of @frame.
+ * @height: Height of @frame.
+ * @quality: JPEG quality, from 1 to 100.
+ * @filename: The file to save the picture to.
+ * @func: Function called once the picture is saved.
+ * @user_data: Data to pass to @func.
+ * @notify: Function to free @user_data afterwards, or #NULL.
+ *
+ * Gives a frame to encode and save, without waiting. @func is called
+ * from the encoder threads once the picture is saved. If the queue of
+ * @encoder is full nothing is taken: @frame and @user_data stay owned
+ * by the caller and @func is never called.
+ *
+ * Returns: #TRUE if the frame was taken, #FALSE if the queue is full.
+ **/
+gboolean
+_g_digicam_camerabin_encoder_push (GDigicamCamerabinEncoder        *encoder,
+                                   GstBuffer                       *frame,
+                                   GstVideoFormat                   format,
+                                   gint                             width,
+                                   gint                             height,
+                                   gint                             quality,
+                                   const gchar                     *filename,
+                                   GDigicamCamerabinEncoderDoneFunc func,
+                                   gpointer                         user_data,
+                                   GDestroyNotify                   notify)
+{
+    EncoderJob *job = NULL;
+
+    g_return_val_if_fail (NULL != encoder, FALSE);
+    g_return_val_if_fail (GST_IS_BUFFER (frame), FALSE);
+    g_return_val_if_fail (NULL != filename, FALSE);
+
+    g_mutex_lock (encoder->lock);
+    if (g_queue_get_length (&encoder->jobs) >= encoder->queue_depth) {
+        g_mutex_unlock (encoder->lock);
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: encoder queue full.");
+        return FALSE;
+    }
+
+    job = g_slice_new0 (EncoderJob);
+    job->frame = frame;
+    job->format = format;
+    job->width = width;
+    job->height = height;
+    job->quality = quality;
+    job->filename = g_strdup (filename);
+    job->func = func;
+    job->user_data = user_data;
+    job->notify = notify;
+
+    g_queue_push_tail (&encoder->jobs, job);
+    g_mutex_unlock (encoder->lock);
+
+    g_thread_pool_push (encoder->pool, job, NULL);
+
+    return TRUE;
+}
+
+
+/**
+ * _g_digicam_camerabin_encoder_is_full:
+ * @encoder: A #GDigicamCamerabinEncoder.
+ *
+ * Tells whether a new frame would be refused, see
+ * _g_digicam_camerabin_encoder_push().
+ *
+ * Returns: #TRUE if the queue is full, #FALSE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_encoder_is_full (GDigicamCamerabinEncoder *encoder)
+{
+    gboolean full;
+
+    g_return_val_if_fail (NULL != encoder, FALSE);
+
+    g_mutex_lock (encoder->lock);
+    full = (g_queue_get_length (&encoder->jobs) >= encoder->queue_depth);
+    g_mutex_unlock (encoder->lock);
+
+    return full;
+}
+
+
+/**
+ * _g_digicam_camerabin_encoder_get_pending:
+ * @encoder: A #GDigicamCamerabinEncoder.
+ *
+ * Gets the number of frames given and not saved yet.
+ *
+ * Returns: The number of pending frames.
+ **/
+guint
+_g_digicam_camerabin_encoder_get_pending (GDigicamCamerabinEncoder *encoder)
+{
+    guint pending;
+
+    g_return_val_if_fail (NULL != encoder, 0);
+
+    g_mutex_lock (encoder->lock);
+    pending = g_queue_get_length (&encoder->jobs);
+    g_mutex_unlock (encoder->lock);
+
+    return pending;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static void
+_encoder_run (EncoderJob *job,
+              GDigicamCamerabinEncoder *encoder)
+{
+    EncoderJob *oldest = NULL;
+
+    if (!_g_digicam_camerabin_jpeg_encode_strips (job->format,
+                                                  GST_BUFFER_DATA (job->frame),
+                                                  job->width, job->height,
+                                                  job->quality,
+                                                  encoder->strips,
+                                                  &job->data, &job->size)) {
+        g_set_error (&job->error, GST_STREAM_ERROR, GST_STREAM_ERROR_ENCODE,
+                     "Unable to encode the picture");
+    }
+
+    /* The frame is not needed anymore, release its memory now */
+    gst_buffer_unref (job->frame);
+    job->frame = NULL;
+
+    g_mutex_lock (encoder->lock);
+    job->encoded = TRUE;
+
+    if (!encoder->saving) {
+        encoder->saving = TRUE;
+
+        oldest = g_queue_peek_head (&encoder->jobs);
+        while ((NULL != oldest) && oldest->encoded) {
+            g_mutex_unlock (encoder->lock);
+            _encoder_save (encoder, oldest);
+            g_mutex_lock (encoder->lock);
+
+            /* Only now there is room for another one */
+            g_queue_pop_head (&encoder->jobs);
+            _encoder_job_free (oldest);
+            g_cond_broadcast (encoder->cond);
+
+            oldest = g_queue_peek_head (&encoder->jobs);
+        }
+
+        encoder->saving = FALSE;
+    }
+
+    g_mutex_unlock (encoder->lock);
+}
+
+
+static void
+_encoder_save (GDigicamCamerabinEncoder *encoder,
+               EncoderJob *job)
+{
+    GstBuffer *buffer = NULL;
+
+    if ((NULL != encoder->writer) && (NULL == job->error)) {
+        buffer = gst_buffer_new ();
+        GST_BUFFER_DATA (buffer) = job->data;
+        GST_BUFFER_MALLOCDATA (buffer) = job->data;
+        GST_BUFFER_SIZE (buffer) = job->size;
+        job->data = NULL;
+
+        /* The writer calls back and frees the user data from now on */
+        _g_digicam_camerabin_writer_push (encoder->writer,
+                                          job->filename,
+                                          g_list_append (NULL, buffer),
+                                          (GDigicamCamerabinWriterDoneFunc) job->func,
+                                          job->user_data,
+                                          job->notify);
+        job->notify = NULL;
+        return;
+    }
+
+    if (NULL == job->error) {
+        g_file_set_contents (job->filename, (const gchar *) job->data,
+                             job->size, &job->error);
+    }
+
+    if (NULL != job->func) {
+        job->func (job->filename, job->error, job->user_data);
+    }
+}
+
+
+static void
+_encoder_job_free (EncoderJob *job)
+{
+    if (NULL != job->notify) {
+        job->notify (job->user_data);
+    }
+    if (NULL != job->frame) {
+        gst_buffer_unref (job->frame);
+    }
+    if (NULL != job->error) {
+        g_error_free (job->error);
+    }
+    g_free (job->data);
+    g_free (job->filename);
+    g_slice_free (EncoderJob, job);
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef _G_DIGICAM_CAMERABIN_ENCODER_H_
+#define _G_DIGICAM_CAMERABIN_ENCODER_H_
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "gdigicam-camerabin-writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * GDigicamCamerabinEncoder:
+ *
+ * A pool of JPEG encoders saving the pictures in the order they were
+ * given.
+ */
+    typedef struct _GDigicamCamerabinEncoder GDigicamCamerabinEncoder;
+
+/**
+ * GDigicamCamerabinEncoderDoneFunc:
+ * @filename: The file of the picture.
+ * @error: Why the picture was not saved, or #NULL if it was.
+ * @user_data: The data given with the picture.
+ *
+ * Called once a picture is saved, in the order the pictures were
+ * given.
+ */
+    typedef void (*GDigicamCamerabinEncoderDoneFunc) (const gchar  *filename,
+                                                      const GError *error,
+                                                      gpointer      user_data);
+
+
+    GDigicamCamerabinEncoder *_g_digicam_camerabin_encoder_new (guint                    threads,
+                                                                guint                    queue_depth,
+                                                                guint                    strips,
+                                                                GDigicamCamerabinWriter *writer,
+                                                                GError                 **error);
+    void _g_digicam_camerabin_encoder_free (GDigicamCamerabinEncoder *encoder);
+    gboolean _g_digicam_camerabin_encoder_push (GDigicamCamerabinEncoder        *encoder,
+                                                GstBuffer                       *frame,
+                                                GstVideoFormat                   format,
+                                                gint                             width,
+                                                gint                             height,
+                                                gint                             quality,
+                                                const gchar                     *filename,
+                                                GDigicamCamerabinEncoderDoneFunc func,
+                                                gpointer                         user_data,
+                                                GDestroyNotify                   notify);
+    gboolean _g_digicam_camerabin_encoder_is_full (GDigicamCamerabinEncoder *encoder);
+    guint _g_digicam_camerabin_encoder_get_pending (GDigicamCamerabinEncoder *encoder);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
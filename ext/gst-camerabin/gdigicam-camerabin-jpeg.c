@@ -0,0 +1,665 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * JPEG encoding of raw video frames with libjpeg.
+ *
+ * The frames are given to libjpeg as raw, already subsampled, YCbCr
+ * data, so no colorspace conversion nor chroma resampling is done. One
+ * iMCU row at a time is copied to scratch planes, padding the right
+ * and bottom edges by replicating the last pixels as libjpeg expects
+ * whole blocks.
+ *
+ * Big images can also be split in horizontal strips of whole iMCU
+ * rows, encoded at the same time by several threads. As the strips
+ * share the image settings and the standard Huffman tables, their
+ * entropy coded data are also valid restart intervals of the whole
+ * image, so they are joined with restart markers under the headers of
+ * the first one, with the full height and a restart interval of a
+ * strip. The result is a single baseline JPEG file.
+ */
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <config.h>
+
+#include <jpeglib.h>
+
+#include "gdigicam-camerabin-jpeg.h"
+#include "gdigicam-debug.h"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+typedef struct _ErrorManager {
+    struct jpeg_error_mgr pub;
+    jmp_buf jmp;
+} ErrorManager;
+
+typedef struct _MemoryDestination {
+    struct jpeg_destination_mgr pub;
+    guchar *data;
+    gsize allocated;
+    gsize size;
+} MemoryDestination;
+
+typedef struct _StripBatch {
+    GMutex *lock;
+    GCond *cond;
+    guint pending;
+} StripBatch;
+
+typedef struct _Strip {
+    StripBatch *batch;
+    GstVideoFormat format;
+    const guchar *src;
+    gint width;
+    gint height;
+    gint first_row;
+    gint rows;
+    gint quality;
+    guchar *data;
+    gsize size;
+    gboolean encoded;
+} Strip;
+
+typedef struct _Plane {
+    const guchar *pixels;
+    gint stride;
+    gint step;
+    gint width;
+    gint height;
+} Plane;
+
+
+/*****************************************/
+/* Private variables */
+/*****************************************/
+
+static GOnce strip_pool_once = G_ONCE_INIT;
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static gboolean _encode_rows (GstVideoFormat format,
+                              const guchar *src,
+                              gint width,
+                              gint height,
+                              gint first_row,
+                              gint rows,
+                              gint quality,
+                              guchar **data,
+                              gsize *size);
+static gpointer _strip_pool_new (gpointer data);
+static void _strip_run (Strip *strip,
+                        gpointer data);
+static gboolean _find_markers (const guchar *data,
+                               gsize size,
+                               gsize *sof,
+                               gsize *sos,
+                               gsize *scan);
+static gboolean _join_strips (Strip *strips,
+                              gint n_strips,
+                              gint height,
+                              guint restart_interval,
+                              guchar **data,
+                              gsize *size);
+
+static void _error_exit (j_common_ptr cinfo);
+static void _output_message (j_common_ptr cinfo);
+static void _init_destination (j_compress_ptr cinfo);
+static boolean _empty_output_buffer (j_compress_ptr cinfo);
+static void _term_destination (j_compress_ptr cinfo);
+static void _fill_row (guchar *dst,
+                       const Plane *plane,
+                       gint y,
+                       gint padded_width);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_jpeg_supported:
+ * @format: A #GstVideoFormat.
+ *
+ * Checks whether frames in @format can be encoded by
+ * _g_digicam_camerabin_jpeg_encode().
+ *
+ * Returns: #TRUE if @format is supported, #FALSE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_jpeg_supported (GstVideoFormat format)
+{
+    switch (format) {
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_UYVY:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+
+/**
+ * _g_digicam_camerabin_jpeg_encode:
+ * @format: The #GstVideoFormat of @src.
+ * @src: The source image, laid out as GStreamer does for @format.
+ * @width: Width of the image.
+ * @height: Height of the image.
+ * @quality: JPEG quality, from 1 to 100.
+ * @data: Return location of the encoded image, to be freed with
+ * g_free().
+ * @size: Return location of the size of @data.
+ *
+ * Encodes a YUV image as a baseline JFIF file, keeping the chroma
+ * subsampling of @format.
+ *
+ * Returns: #TRUE if @src was encoded, #FALSE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_jpeg_encode (GstVideoFormat format,
+                                  const guchar  *src,
+                                  gint           width,
+                                  gint           height,
+                                  gint           quality,
+                                  guchar       **data,
+                                  gsize         *size)
+{
+    g_return_val_if_fail (NULL != src, FALSE);
+    g_return_val_if_fail ((0 < width) && (0 < height), FALSE);
+    g_return_val_if_fail ((NULL != data) && (NULL != size), FALSE);
+
+    if (!_g_digicam_camerabin_jpeg_supported (format)) {
+        return FALSE;
+    }
+
+    return _encode_rows (format, src, width, height, 0, height, quality,
+                         data, size);
+}
+
+
+/**
+ * _g_digicam_camerabin_jpeg_encode_strips:
+ * @format: The #GstVideoFormat of @src.
+ * @src: The source image, laid out as GStreamer does for @format.
+ * @width: Width of the image.
+ * @height: Height of the image.
+ * @quality: JPEG quality, from 1 to 100.
+ * @strips: The number of strips encoded at the same time.
+ * @data: Return location of the encoded image, to be freed with
+ * g_free().
+ * @size: Return location of the size of @data.
+ *
+ * Encodes a YUV image as _g_digicam_camerabin_jpeg_encode() does,
+ * splitting it in up to @strips strips encoded in parallel. The file
+ * has a restart marker between two strips, so it is slightly bigger.
+ *
+ * Returns: #TRUE if @src was encoded, #FALSE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_jpeg_encode_strips (GstVideoFormat format,
+                                         const guchar  *src,
+                                         gint           width,
+                                         gint           height,
+                                         gint           quality,
+                                         guint          strips,
+                                         guchar       **data,
+                                         gsize         *size)
+{
+    GThreadPool *pool = NULL;
+    StripBatch batch;
+    Strip *strip = NULL;
+    gint mcu_height, mcu_rows, strip_rows, n_strips;
+    guint restart_interval;
+    gboolean result = TRUE;
+    gint i;
+
+    g_return_val_if_fail (NULL != src, FALSE);
+    g_return_val_if_fail ((0 < width) && (0 < height), FALSE);
+    g_return_val_if_fail ((NULL != data) && (NULL != size), FALSE);
+
+    if (!_g_digicam_camerabin_jpeg_supported (format)) {
+        return FALSE;
+    }
+
+    /* Strips of whole iMCU rows, fitting the 16 bits restart interval */
+    mcu_height = (GST_VIDEO_FORMAT_UYVY == format) ? DCTSIZE : 2 * DCTSIZE;
+    mcu_rows = (height + mcu_height - 1) / mcu_height;
+    strip_rows = (mcu_rows + MAX (strips, 1) - 1) / MAX (strips, 1);
+    strip_rows = MIN (strip_rows,
+                      G_MAXUINT16 / ((width + 2 * DCTSIZE - 1) / (2 * DCTSIZE)));
+    n_strips = (mcu_rows + strip_rows - 1) / strip_rows;
+    restart_interval = strip_rows * ((width + 2 * DCTSIZE - 1) / (2 * DCTSIZE));
+
+    pool = g_once (&strip_pool_once, _strip_pool_new, NULL);
+    if ((1 >= n_strips) || (0 == strip_rows) || (NULL == pool)) {
+        return _encode_rows (format, src, width, height, 0, height, quality,
+                             data, size);
+    }
+
+    batch.lock = g_mutex_new ();
+    batch.cond = g_cond_new ();
+    batch.pending = n_strips - 1;
+
+    strip = g_new0 (Strip, n_strips);
+    for (i = 0; i < n_strips; i++) {
+        strip[i].batch = &batch;
+        strip[i].format = format;
+        strip[i].src = src;
+        strip[i].width = width;
+        strip[i].height = height;
+        strip[i].first_row = i * strip_rows * mcu_height;
+        strip[i].rows = MIN (strip_rows * mcu_height,
+                             height - strip[i].first_row);
+        strip[i].quality = quality;
+    }
+
+    /* The first strip is encoded by the calling thread */
+    for (i = 1; i < n_strips; i++) {
+        g_thread_pool_push (pool, &strip[i], NULL);
+    }
+    strip[0].encoded = _encode_rows (format, src, width, height,
+                                     strip[0].first_row, strip[0].rows,
+                                     quality,
+                                     &strip[0].data, &strip[0].size);
+
+    g_mutex_lock (batch.lock);
+    while (0 < batch.pending) {
+        g_cond_wait (batch.cond, batch.lock);
+    }
+    g_mutex_unlock (batch.lock);
+
+    for (i = 0; i < n_strips; i++) {
+        result = result && strip[i].encoded;
+    }
+    if (result) {
+        result = _join_strips (strip, n_strips, height, restart_interval,
+                               data, size);
+    }
+
+    for (i = 0; i < n_strips; i++) {
+        g_free (strip[i].data);
+    }
+    g_free (strip);
+    g_cond_free (batch.cond);
+    g_mutex_free (batch.lock);
+
+    return result;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static gboolean
+_encode_rows (GstVideoFormat format,
+              const guchar *src,
+              gint width,
+              gint height,
+              gint first_row,
+              gint rows,
+              gint quality,
+              guchar **data,
+              gsize *size)
+{
+    struct jpeg_compress_struct cinfo;
+    ErrorManager error;
+    MemoryDestination destination;
+    JSAMPROW lines[3][2 * DCTSIZE];
+    JSAMPARRAY planes[3];
+    Plane source[3];
+    guchar *scratch = NULL;
+    gint v_sub, luma_rows, padded_width[3];
+    gint c, r, y;
+
+    /* 4:2:0 or 4:2:2, chroma is always halved horizontally */
+    v_sub = (GST_VIDEO_FORMAT_UYVY == format) ? 1 : 2;
+    luma_rows = v_sub * DCTSIZE;
+
+    /* The rows from @first_row, which is a whole iMCU row */
+    for (c = 0; c < 3; c++) {
+        source[c].stride = gst_video_format_get_row_stride (format, c, width);
+        source[c].step = gst_video_format_get_pixel_stride (format, c);
+        source[c].width = (0 == c) ? width : (width + 1) / 2;
+        source[c].height = (0 == c) ? rows : (rows + v_sub - 1) / v_sub;
+        source[c].pixels = src +
+            gst_video_format_get_component_offset (format, c, width, height) +
+            ((0 == c) ? first_row : first_row / v_sub) * source[c].stride;
+    }
+    padded_width[0] = GST_ROUND_UP_16 (width);
+    padded_width[1] = padded_width[0] / 2;
+    padded_width[2] = padded_width[1];
+
+    /* One iMCU row of every component */
+    scratch = g_malloc (luma_rows * padded_width[0] +
+                        2 * DCTSIZE * padded_width[1]);
+    planes[0] = lines[0];
+    planes[1] = lines[1];
+    planes[2] = lines[2];
+    for (r = 0; r < luma_rows; r++) {
+        lines[0][r] = scratch + r * padded_width[0];
+    }
+    for (r = 0; r < DCTSIZE; r++) {
+        lines[1][r] = scratch + luma_rows * padded_width[0] +
+            r * padded_width[1];
+        lines[2][r] = lines[1][r] + DCTSIZE * padded_width[1];
+    }
+
+    memset (&destination, 0, sizeof (destination));
+    destination.pub.init_destination = _init_destination;
+    destination.pub.empty_output_buffer = _empty_output_buffer;
+    destination.pub.term_destination = _term_destination;
+    destination.allocated = MAX (4096, width * height / 4);
+
+    cinfo.err = jpeg_std_error (&error.pub);
+    error.pub.error_exit = _error_exit;
+    error.pub.output_message = _output_message;
+    if (setjmp (error.jmp)) {
+        jpeg_destroy_compress (&cinfo);
+        g_free (destination.data);
+        g_free (scratch);
+        return FALSE;
+    }
+
+    jpeg_create_compress (&cinfo);
+    cinfo.dest = &destination.pub;
+    cinfo.image_width = width;
+    cinfo.image_height = rows;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults (&cinfo);
+    jpeg_set_quality (&cinfo, CLAMP (quality, 1, 100), TRUE);
+
+    cinfo.raw_data_in = TRUE;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = v_sub;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
+
+    jpeg_start_compress (&cinfo, TRUE);
+
+    while (cinfo.next_scanline < cinfo.image_height) {
+        y = cinfo.next_scanline;
+        for (r = 0; r < luma_rows; r++) {
+            _fill_row (lines[0][r], &source[0], y + r, padded_width[0]);
+        }
+        for (r = 0; r < DCTSIZE; r++) {
+            _fill_row (lines[1][r], &source[1], y / v_sub + r, padded_width[1]);
+            _fill_row (lines[2][r], &source[2], y / v_sub + r, padded_width[2]);
+        }
+        jpeg_write_raw_data (&cinfo, planes, luma_rows);
+    }
+
+    jpeg_finish_compress (&cinfo);
+    jpeg_destroy_compress (&cinfo);
+    g_free (scratch);
+
+    *data = destination.data;
+    *size = destination.size;
+
+    return TRUE;
+}
+
+
+static gpointer
+_strip_pool_new (gpointer data)
+{
+    GThreadPool *pool = NULL;
+    GError *error = NULL;
+    gint threads = 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+    threads = MAX (1, sysconf (_SC_NPROCESSORS_ONLN));
+#endif
+
+    /* Shared by all the encodings, threads are only kept while
+     * busy. Several encodings at once queue their strips rather than
+     * running more threads than CPUs */
+    pool = g_thread_pool_new ((GFunc) _strip_run, NULL, threads, FALSE, &error);
+    if (NULL == pool) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to create the "
+                        "JPEG strip threads: %s", error->message);
+        g_error_free (error);
+    }
+
+    return pool;
+}
+
+
+static void
+_strip_run (Strip *strip,
+            gpointer data)
+{
+    StripBatch *batch = strip->batch;
+
+    strip->encoded = _encode_rows (strip->format, strip->src,
+                                   strip->width, strip->height,
+                                   strip->first_row, strip->rows,
+                                   strip->quality,
+                                   &strip->data, &strip->size);
+
+    g_mutex_lock (batch->lock);
+    batch->pending--;
+    g_cond_signal (batch->cond);
+    g_mutex_unlock (batch->lock);
+}
+
+
+/* Offsets of the SOF0 and SOS markers, and of the entropy coded data
+ * following the latter, in a file written by _encode_rows() */
+static gboolean
+_find_markers (const guchar *data,
+               gsize size,
+               gsize *sof,
+               gsize *sos,
+               gsize *scan)
+{
+    gsize pos = 2;
+    guint length;
+
+    *sof = 0;
+    while (pos + 4 <= size) {
+        if (0xff != data[pos]) {
+            return FALSE;
+        }
+
+        length = (data[pos + 2] << 8) | data[pos + 3];
+        if (0xc0 == data[pos + 1]) {
+            *sof = pos;
+        } else if (0xda == data[pos + 1]) {
+            *sos = pos;
+            *scan = pos + 2 + length;
+            return (0 != *sof) && (*scan + 2 <= size);
+        }
+        pos += 2 + length;
+    }
+
+    return FALSE;
+}
+
+
+static gboolean
+_join_strips (Strip *strips,
+              gint n_strips,
+              gint height,
+              guint restart_interval,
+              guchar **data,
+              gsize *size)
+{
+    guchar *joined = NULL;
+    guchar *dst = NULL;
+    gsize sof, sos, scan, length;
+    gsize total;
+    gint i;
+
+    total = 0;
+    for (i = 0; i < n_strips; i++) {
+        total += strips[i].size + 2;
+    }
+    total += 6;
+
+    joined = g_malloc (total);
+    dst = joined;
+
+    for (i = 0; i < n_strips; i++) {
+        if (!_find_markers (strips[i].data, strips[i].size,
+                            &sof, &sos, &scan)) {
+            G_DIGICAM_WARN ("GDigicamCamerabin: unexpected JPEG strip "
+                            "layout.");
+            g_free (joined);
+            return FALSE;
+        }
+
+        /* The entropy coded data, without the EOI */
+        length = strips[i].size - 2 - scan;
+
+        if (0 == i) {
+            /* Headers with the whole height and the restart interval */
+            memcpy (dst, strips[i].data, sos);
+            dst[sof + 5] = (height >> 8) & 0xff;
+            dst[sof + 6] = height & 0xff;
+            dst += sos;
+
+            *dst++ = 0xff;
+            *dst++ = 0xdd;
+            *dst++ = 0x00;
+            *dst++ = 0x04;
+            *dst++ = (restart_interval >> 8) & 0xff;
+            *dst++ = restart_interval & 0xff;
+
+            memcpy (dst, strips[i].data + sos, scan - sos);
+            dst += scan - sos;
+        } else {
+            *dst++ = 0xff;
+            *dst++ = 0xd0 + ((i - 1) % 8);
+        }
+
+        memcpy (dst, strips[i].data + scan, length);
+        dst += length;
+    }
+
+    *dst++ = 0xff;
+    *dst++ = 0xd9;
+
+    *data = joined;
+    *size = dst - joined;
+
+    return TRUE;
+}
+
+static void
+_error_exit (j_common_ptr cinfo)
+{
+    ErrorManager *error = (ErrorManager *) cinfo->err;
+
+    (*cinfo->err->output_message) (cinfo);
+    longjmp (error->jmp, 1);
+}
+
+
+static void
+_output_message (j_common_ptr cinfo)
+{
+    gchar buffer[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message) (cinfo, buffer);
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: libjpeg: %s", buffer);
+}
+
+
+static void
+_init_destination (j_compress_ptr cinfo)
+{
+    MemoryDestination *destination = (MemoryDestination *) cinfo->dest;
+
+    destination->data = g_malloc (destination->allocated);
+    destination->pub.next_output_byte = destination->data;
+    destination->pub.free_in_buffer = destination->allocated;
+}
+
+
+static boolean
+_empty_output_buffer (j_compress_ptr cinfo)
+{
+    MemoryDestination *destination = (MemoryDestination *) cinfo->dest;
+    gsize used;
+
+    /* libjpeg only calls this with the whole buffer full */
+    used = destination->allocated;
+    destination->allocated *= 2;
+    destination->data = g_realloc (destination->data, destination->allocated);
+    destination->pub.next_output_byte = destination->data + used;
+    destination->pub.free_in_buffer = destination->allocated - used;
+
+    return TRUE;
+}
+
+
+static void
+_term_destination (j_compress_ptr cinfo)
+{
+    MemoryDestination *destination = (MemoryDestination *) cinfo->dest;
+
+    destination->size = destination->allocated -
+        destination->pub.free_in_buffer;
+}
+
+
+static void
+_fill_row (guchar *dst,
+           const Plane *plane,
+           gint y,
+           gint padded_width)
+{
+    const guchar *src = NULL;
+    gint x;
+
+    /* Rows below the image repeat the last one */
+    y = MIN (y, plane->height - 1);
+    src = plane->pixels + y * plane->stride;
+
+    if (1 == plane->step) {
+        memcpy (dst, src, plane->width);
+    } else {
+        for (x = 0; x < plane->width; x++) {
+            dst[x] = src[x * plane->step];
+        }
+    }
+
+    memset (dst + plane->width, dst[plane->width - 1],
+            padded_width - plane->width);
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef _G_DIGICAM_CAMERABIN_JPEG_H_
+#define _G_DIGICAM_CAMERABIN_JPEG_H_
+
+#include <glib.h>
+#include <gst/video/video.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+    gboolean _g_digicam_camerabin_jpeg_supported (GstVideoFormat format);
+    gboolean _g_digicam_camerabin_jpeg_encode (GstVideoFormat format,
+                                               const guchar  *src,
+                                               gint           width,
+                                               gint           height,
+                                               gint           quality,
+                                               guchar       **data,
+                                               gsize         *size);
+    gboolean _g_digicam_camerabin_jpeg_encode_strips (GstVideoFormat format,
+                                                      const guchar  *src,
+                                                      gint           width,
+                                                      gint           height,
+                                                      gint           quality,
+                                                      guint          strips,
+                                                      guchar       **data,
+                                                      gsize         *size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,430 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Metadata tags shared by all the captures of a session.
+ *
+ * Most of the tags written in the pictures and videos only depend on
+ * the device and on the current location, which change seldom. They
+ * are kept in ready made tag lists, rebuilt only when the metadata
+ * given by the application is different from the last one, so a
+ * capture just merges them and adds the few tags of its own.
+ */
+
+#include <string.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-metadata.h"
+#include "gdigicam-debug.h"
+
+/* for more information about image metadata tags, see:
+ * http://webcvs.freedesktop.org/gstreamer/gst-plugins-bad/tests/icles/metadata_editor.c
+ * and for the mapping:
+ * http://webcvs.freedesktop.org/gstreamer/gst-plugins-bad/ext/metadata/metadata_mapping.htm?view=co
+ */
+
+/* TODO: These location tags in quotes have to be in sync with
+ * other tags after GStreamer's headers are updated.
+ * See NB#125831 */
+#define GST_TAG_DEVICE_MAKE                 "device-make"
+#define GST_TAG_DEVICE_MODEL                "device-model"
+#define GST_TAG_CLASSIFICATION              "classification"
+#define GST_TAG_GEO_LOCATION_COUNTRY        "geo-location-country"
+#define GST_TAG_GEO_LOCATION_CITY           "geo-location-city"
+#define GST_TAG_GEO_LOCATION_SUBLOCATION    "geo-location-sublocation"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+struct _GDigicamCamerabinMetadataSession {
+    GDigicamCamerabinMetadata metadata;
+    gboolean valid;
+    GstTagList *picture_tags;
+    GstTagList *video_tags;
+    glong date_time;
+    gchar *date_str;
+};
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static void _metadata_session_update (GDigicamCamerabinMetadataSession *session,
+                                      const GDigicamCamerabinMetadata  *metadata);
+static gboolean _metadata_equal (const GDigicamCamerabinMetadata *a,
+                                 const GDigicamCamerabinMetadata *b);
+static void _add_geo_coordinates (GstTagList *list,
+                                  const GDigicamCamerabinMetadata *metadata);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_metadata_session_new:
+ *
+ * Creates an empty metadata session.
+ *
+ * Returns: A new #GDigicamCamerabinMetadataSession.
+ **/
+GDigicamCamerabinMetadataSession *
+_g_digicam_camerabin_metadata_session_new (void)
+{
+    return g_slice_new0 (GDigicamCamerabinMetadataSession);
+}
+
+
+/**
+ * _g_digicam_camerabin_metadata_session_free:
+ * @session: A #GDigicamCamerabinMetadataSession.
+ *
+ * Frees @session and the tag lists it holds.
+ **/
+void
+_g_digicam_camerabin_metadata_session_free (GDigicamCamerabinMetadataSession *session)
+{
+    if (NULL == session) {
+        return;
+    }
+
+    _g_digicam_camerabin_metadata_clear (&session->metadata);
+    if (NULL != session->picture_tags) {
+        gst_tag_list_free (session->picture_tags);
+    }
+    if (NULL != session->video_tags) {
+        gst_tag_list_free (session->video_tags);
+    }
+    g_free (session->date_str);
+
+    g_slice_free (GDigicamCamerabinMetadataSession, session);
+}
+
+
+/**
+ * _g_digicam_camerabin_metadata_session_get_picture_tags:
+ * @session: A #GDigicamCamerabinMetadataSession.
+ * @metadata: The #GDigicamCamerabinMetadata of the capture.
+ *
+ * Gets the tags of @metadata which are the same for all the
+ * pictures. The date and the orientation are not included.
+ *
+ * Returns: A tag list owned by @session, valid until the next call
+ * with a different @metadata.
+ **/
+const GstTagList *
+_g_digicam_camerabin_metadata_session_get_picture_tags (GDigicamCamerabinMetadataSession *session,
+                                                        const GDigicamCamerabinMetadata  *metadata)
+{
+    GstTagList *list = NULL;
+
+    g_return_val_if_fail (NULL != session, NULL);
+    g_return_val_if_fail (NULL != metadata, NULL);
+
+    _metadata_session_update (session, metadata);
+
+    if (NULL != session->picture_tags) {
+        return session->picture_tags;
+    }
+
+    metadata = &session->metadata;
+
+    /* Creating the tag list with the mandatory tags. */
+    list = gst_tag_list_new ();
+    gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                      GST_TAG_DEVICE_MAKE, metadata->make,
+                      GST_TAG_DEVICE_MODEL, metadata->model,
+                      NULL);
+
+    /* Adding coordinates, just if set. */
+    _add_geo_coordinates (list, metadata);
+
+    /* Adding optional metadata tags. */
+    if (NULL != metadata->author) {
+        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                          GST_TAG_COMPOSER, metadata->author,
+                          NULL);
+    }
+
+    /* We should have all the geotags. */
+    if (NULL != metadata->country_name) {
+        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                          GST_TAG_GEO_LOCATION_COUNTRY, metadata->country_name,
+                          NULL);
+        if (NULL != metadata->city_name) {
+            gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                              GST_TAG_GEO_LOCATION_CITY, metadata->city_name,
+                              NULL);
+        }
+        if (NULL != metadata->suburb_name) {
+            gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                              GST_TAG_GEO_LOCATION_SUBLOCATION, metadata->suburb_name,
+                              NULL);
+        }
+    }
+
+    session->picture_tags = list;
+
+    return session->picture_tags;
+}
+
+
+/**
+ * _g_digicam_camerabin_metadata_session_get_video_tags:
+ * @session: A #GDigicamCamerabinMetadataSession.
+ * @metadata: The #GDigicamCamerabinMetadata of the capture.
+ *
+ * Gets the tags of @metadata written in the videos.
+ *
+ * Returns: A tag list owned by @session, valid until the next call
+ * with a different @metadata.
+ **/
+const GstTagList *
+_g_digicam_camerabin_metadata_session_get_video_tags (GDigicamCamerabinMetadataSession *session,
+                                                      const GDigicamCamerabinMetadata  *metadata)
+{
+    const gchar *names[4];
+    GstTagList *list = NULL;
+    gchar *geo_name = NULL;
+    guint n = 0;
+
+    g_return_val_if_fail (NULL != session, NULL);
+    g_return_val_if_fail (NULL != metadata, NULL);
+
+    _metadata_session_update (session, metadata);
+
+    if (NULL != session->video_tags) {
+        return session->video_tags;
+    }
+
+    metadata = &session->metadata;
+
+    /* Creating the tag list with the mandatory tags. */
+    list = gst_tag_list_new ();
+    gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                      GST_TAG_CLASSIFICATION, metadata->unique_id,
+                      NULL);
+
+    /* Adding coordinates, just if set. */
+    _add_geo_coordinates (list, metadata);
+
+    /* Adding optional metadata tags. */
+    if (NULL != metadata->author) {
+        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                          GST_TAG_ARTIST, metadata->author,
+                          NULL);
+    }
+
+    /* We should have all the geotags. */
+    if (NULL != metadata->country_name) {
+        names[n++] = metadata->country_name;
+        if (NULL != metadata->city_name) {
+            names[n++] = metadata->city_name;
+        }
+        if (NULL != metadata->suburb_name) {
+            names[n++] = metadata->suburb_name;
+        }
+        names[n] = NULL;
+
+        geo_name = g_strjoinv (",", (gchar **) names);
+        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                          GST_TAG_GEO_LOCATION_NAME, geo_name,
+                          NULL);
+        g_free (geo_name);
+    }
+
+    session->video_tags = list;
+
+    return session->video_tags;
+}
+
+
+/**
+ * _g_digicam_camerabin_metadata_session_get_date:
+ * @session: A #GDigicamCamerabinMetadataSession.
+ *
+ * Gets the current UTC time in ISO 8601 format. The string is only
+ * formatted again when the second changes, which is also the
+ * resolution of the EXIF dates.
+ *
+ * Returns: A string owned by @session, valid until the next call.
+ **/
+const gchar *
+_g_digicam_camerabin_metadata_session_get_date (GDigicamCamerabinMetadataSession *session)
+{
+    GTimeVal time = { 0,0 };
+
+    g_return_val_if_fail (NULL != session, NULL);
+
+    g_get_current_time (&time);
+
+    if ((NULL == session->date_str) || (time.tv_sec != session->date_time)) {
+        g_free (session->date_str);
+        time.tv_usec = 0;
+        session->date_str = g_time_val_to_iso8601 (&time); /* this is UTC */
+        session->date_time = time.tv_sec;
+    }
+
+    return session->date_str;
+}
+
+
+/**
+ * _g_digicam_camerabin_metadata_copy:
+ * @dest: An empty #GDigicamCamerabinMetadata.
+ * @src: The #GDigicamCamerabinMetadata to copy.
+ *
+ * Copies @src in @dest, duplicating the strings.
+ **/
+void
+_g_digicam_camerabin_metadata_copy (GDigicamCamerabinMetadata       *dest,
+                                    const GDigicamCamerabinMetadata *src)
+{
+    g_return_if_fail (NULL != dest);
+    g_return_if_fail (NULL != src);
+
+    *dest = *src;
+    dest->make = g_strdup (src->make);
+    dest->model = g_strdup (src->model);
+    dest->author = g_strdup (src->author);
+    dest->unique_id = g_strdup (src->unique_id);
+    dest->country_name = g_strdup (src->country_name);
+    dest->city_name = g_strdup (src->city_name);
+    dest->suburb_name = g_strdup (src->suburb_name);
+}
+
+
+/**
+ * _g_digicam_camerabin_metadata_clear:
+ * @metadata: A #GDigicamCamerabinMetadata.
+ *
+ * Frees the strings of a #GDigicamCamerabinMetadata made by
+ * _g_digicam_camerabin_metadata_copy() and empties it.
+ **/
+void
+_g_digicam_camerabin_metadata_clear (GDigicamCamerabinMetadata *metadata)
+{
+    g_return_if_fail (NULL != metadata);
+
+    g_free (metadata->make);
+    g_free (metadata->model);
+    g_free (metadata->author);
+    g_free (metadata->unique_id);
+    g_free (metadata->country_name);
+    g_free (metadata->city_name);
+    g_free (metadata->suburb_name);
+    memset (metadata, 0, sizeof (GDigicamCamerabinMetadata));
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static void
+_metadata_session_update (GDigicamCamerabinMetadataSession *session,
+                          const GDigicamCamerabinMetadata  *metadata)
+{
+    if (session->valid && _metadata_equal (&session->metadata, metadata)) {
+        return;
+    }
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin::_metadata_session_update: "
+                     "New metadata session: \n"
+                     "\n\tmake: %s"
+                     "\n\tmodel: %s"
+                     "\n\tauthor: %s"
+                     "\n\tunique id: %s"
+                     "\n\tcountry: %s"
+                     "\n\tcity: %s"
+                     "\n\tsuburb: %s"
+                     "\n\taltitude: %f"
+                     "\n\tlatitude: %f"
+                     "\n\tlongtitude: %f",
+                     metadata->make,
+                     metadata->model,
+                     metadata->author,
+                     metadata->unique_id,
+                     metadata->country_name,
+                     metadata->city_name,
+                     metadata->suburb_name,
+                     metadata->altitude,
+                     metadata->latitude,
+                     metadata->longitude);
+
+    _g_digicam_camerabin_metadata_clear (&session->metadata);
+    _g_digicam_camerabin_metadata_copy (&session->metadata, metadata);
+    session->valid = TRUE;
+
+    if (NULL != session->picture_tags) {
+        gst_tag_list_free (session->picture_tags);
+        session->picture_tags = NULL;
+    }
+    if (NULL != session->video_tags) {
+        gst_tag_list_free (session->video_tags);
+        session->video_tags = NULL;
+    }
+}
+
+
+static gboolean
+_metadata_equal (const GDigicamCamerabinMetadata *a,
+                 const GDigicamCamerabinMetadata *b)
+{
+    /* The orientation is not compared, it is set for each capture */
+    return ((a->longitude == b->longitude) &&
+            (a->latitude == b->latitude) &&
+            (a->altitude == b->altitude) &&
+            (0 == g_strcmp0 (a->make, b->make)) &&
+            (0 == g_strcmp0 (a->model, b->model)) &&
+            (0 == g_strcmp0 (a->author, b->author)) &&
+            (0 == g_strcmp0 (a->unique_id, b->unique_id)) &&
+            (0 == g_strcmp0 (a->country_name, b->country_name)) &&
+            (0 == g_strcmp0 (a->city_name, b->city_name)) &&
+            (0 == g_strcmp0 (a->suburb_name, b->suburb_name)));
+}
+
+
+
+static void
+_add_geo_coordinates (GstTagList *list,
+                      const GDigicamCamerabinMetadata *metadata)
+{
+    if (G_MAXDOUBLE != metadata->latitude &&
+        G_MAXDOUBLE != metadata->longitude) {
+        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                          GST_TAG_GEO_LOCATION_LATITUDE, metadata->latitude,
+                          GST_TAG_GEO_LOCATION_LONGITUDE, metadata->longitude,
+                          NULL);
+        if (G_MAXDOUBLE != metadata->altitude) {
+            gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
+                              GST_TAG_GEO_LOCATION_ELEVATION, metadata->altitude,
+                              NULL);
+        }
+    }
+}
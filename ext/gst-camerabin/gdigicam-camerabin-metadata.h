@@ -0,0 +1,63 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef _G_DIGICAM_CAMERABIN_METADATA_H_
+#define _G_DIGICAM_CAMERABIN_METADATA_H_
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gdigicam-camerabin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * GDigicamCamerabinMetadataSession:
+ *
+ * Tags which don't change from one capture to the next one, built
+ * once and reused until the application metadata changes.
+ */
+    typedef struct _GDigicamCamerabinMetadataSession GDigicamCamerabinMetadataSession;
+
+
+    GDigicamCamerabinMetadataSession *_g_digicam_camerabin_metadata_session_new (void);
+    void _g_digicam_camerabin_metadata_session_free (GDigicamCamerabinMetadataSession *session);
+    const GstTagList *_g_digicam_camerabin_metadata_session_get_picture_tags (GDigicamCamerabinMetadataSession *session,
+                                                                              const GDigicamCamerabinMetadata  *metadata);
+    const GstTagList *_g_digicam_camerabin_metadata_session_get_video_tags (GDigicamCamerabinMetadataSession *session,
+                                                                            const GDigicamCamerabinMetadata  *metadata);
+    const gchar *_g_digicam_camerabin_metadata_session_get_date (GDigicamCamerabinMetadataSession *session);
+    void _g_digicam_camerabin_metadata_copy (GDigicamCamerabinMetadata       *dest,
+                                             const GDigicamCamerabinMetadata *src);
+    void _g_digicam_camerabin_metadata_clear (GDigicamCamerabinMetadata *metadata);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+
+/*
+ * Pictures and recordings written to a descriptor of the application.
+ *
+ * The descriptor may be an open file, a pipe or a memfd, and it is
+ * written to from wherever it was when handed, so the application can
+ * put its own data before. What the file sink would have written goes
+ * there instead: the data comes in order, except when the muxer goes
+ * back to update its headers. That is honoured if the descriptor can
+ * seek, and ignored otherwise, a stream can't be rewritten. A
+ * descriptor opened with O_APPEND is written as a stream too, since
+ * the system puts every write at its end whatever the offset asked,
+ * and gaps left by the muxer going forward on a stream are filled
+ * with zeros, as they would read from a file.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-output.h"
+#include "gdigicam-debug.h"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+struct _GDigicamCamerabinOutput {
+    gint fd;
+    /* Where the descriptor was when handed, -1 if it can't seek */
+    gint64 base;
+    /* Offset in the stream of the next data, and of its end */
+    guint64 position;
+    guint64 end;
+};
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static gboolean _output_write (GDigicamCamerabinOutput *output,
+                               const guint8 *data,
+                               gsize size,
+                               GError **error);
+static gboolean _output_fill (GDigicamCamerabinOutput *output,
+                              guint64 size,
+                              GError **error);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_output_new:
+ * @fd: A file descriptor open for writing.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Starts writing to @fd from its current position. The descriptor is
+ * duplicated, the caller can close @fd at once.
+ *
+ * Returns: the new #GDigicamCamerabinOutput, or #NULL if @fd is not
+ * valid or not open for writing.
+ **/
+GDigicamCamerabinOutput *
+_g_digicam_camerabin_output_new (gint     fd,
+                                 GError **error)
+{
+    GDigicamCamerabinOutput *output = NULL;
+    gint saved_errno;
+    gint dup_fd;
+    gint flags;
+
+    g_return_val_if_fail (0 <= fd, NULL);
+
+    flags = fcntl (fd, F_GETFL);
+    if (0 > flags) {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR,
+                     g_file_error_from_errno (saved_errno),
+                     "Unable to use descriptor %d: %s",
+                     fd, g_strerror (saved_errno));
+        return NULL;
+    }
+    if (O_RDONLY == (flags & O_ACCMODE)) {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_BADF,
+                     "Unable to use descriptor %d: not open for writing",
+                     fd);
+        return NULL;
+    }
+
+    dup_fd = dup (fd);
+    if (0 > dup_fd) {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR,
+                     g_file_error_from_errno (saved_errno),
+                     "Unable to use descriptor %d: %s",
+                     fd, g_strerror (saved_errno));
+        return NULL;
+    }
+
+    output = g_slice_new0 (GDigicamCamerabinOutput);
+    output->fd = dup_fd;
+    /* Appending, the offsets of pwrite() would be ignored */
+    output->base = (0 != (flags & O_APPEND)) ?
+        -1 : lseek (dup_fd, 0, SEEK_CUR);
+
+    return output;
+}
+
+
+/**
+ * _g_digicam_camerabin_output_write:
+ * @output: A #GDigicamCamerabinOutput.
+ * @buffer: The next data of the stream.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Writes @buffer where the stream is. After a failure nothing else is
+ * written.
+ *
+ * Returns: #FALSE if the descriptor can't be written, #TRUE
+ * otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_output_write (GDigicamCamerabinOutput  *output,
+                                   GstBuffer                *buffer,
+                                   GError                  **error)
+{
+    gboolean result;
+    guint skip;
+
+    g_return_val_if_fail (NULL != output, FALSE);
+    g_return_val_if_fail (GST_IS_BUFFER (buffer), FALSE);
+
+    if (0 > output->fd) {
+        return TRUE;
+    }
+
+    /* Going back on a stream, lost up to where the stream is */
+    skip = 0;
+    if ((output->position < output->end) && (0 > output->base)) {
+        skip = MIN (output->end - output->position, GST_BUFFER_SIZE (buffer));
+        if (skip == GST_BUFFER_SIZE (buffer)) {
+            output->position += skip;
+            return TRUE;
+        }
+        output->position += skip;
+    }
+
+    /* Going forward on a stream, the gap must be there */
+    if ((output->position > output->end) && (0 > output->base)) {
+        if (!_output_fill (output, output->position - output->end, error)) {
+            return FALSE;
+        }
+        output->end = output->position;
+    }
+
+    result = _output_write (output, GST_BUFFER_DATA (buffer) + skip,
+                            GST_BUFFER_SIZE (buffer) - skip, error);
+    output->position += GST_BUFFER_SIZE (buffer) - skip;
+    output->end = MAX (output->end, output->position);
+
+    return result;
+}
+
+
+/**
+ * _g_digicam_camerabin_output_seek:
+ * @output: A #GDigicamCamerabinOutput.
+ * @offset: The offset in the stream of the next data.
+ *
+ * Tells where the muxer writes the next data. On a descriptor which
+ * can't seek, going back skips the data up to the end of what was
+ * written, and going forward writes zeros up to @offset.
+ **/
+void
+_g_digicam_camerabin_output_seek (GDigicamCamerabinOutput *output,
+                                  guint64                  offset)
+{
+    g_return_if_fail (NULL != output);
+
+    if (offset == output->position) {
+        return;
+    }
+
+    if ((0 > output->base) && (offset < output->end)) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: the muxer went back to %"
+                         G_GUINT64_FORMAT " on a descriptor which can't "
+                         "seek.", offset);
+    }
+    output->position = offset;
+}
+
+
+/**
+ * _g_digicam_camerabin_output_free:
+ * @output: A #GDigicamCamerabinOutput.
+ *
+ * Closes the duplicated descriptor, leaving the one of the caller
+ * after the end of the data, and frees @output.
+ **/
+void
+_g_digicam_camerabin_output_free (GDigicamCamerabinOutput *output)
+{
+    g_return_if_fail (NULL != output);
+
+    if (0 <= output->fd) {
+        if (0 <= output->base) {
+            lseek (output->fd, output->base + output->end, SEEK_SET);
+        }
+        close (output->fd);
+    }
+    g_slice_free (GDigicamCamerabinOutput, output);
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static gboolean
+_output_write (GDigicamCamerabinOutput *output,
+               const guint8 *data,
+               gsize size,
+               GError **error)
+{
+    gssize written;
+    gint saved_errno;
+    guint64 offset;
+
+    offset = output->position;
+
+    while (0 < size) {
+        if (0 > output->base) {
+            written = write (output->fd, data, size);
+        } else {
+            written = pwrite (output->fd, data, size, output->base + offset);
+        }
+        if (0 > written) {
+            saved_errno = errno;
+            if (EINTR == saved_errno) {
+                continue;
+            }
+            g_set_error (error, G_FILE_ERROR,
+                         g_file_error_from_errno (saved_errno),
+                         "Unable to write to descriptor %d: %s",
+                         output->fd, g_strerror (saved_errno));
+            close (output->fd);
+            output->fd = -1;
+            return FALSE;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+
+    return TRUE;
+}
+
+
+static gboolean
+_output_fill (GDigicamCamerabinOutput *output,
+              guint64 size,
+              GError **error)
+{
+    static const guint8 zeros[4096] = { 0 };
+    gsize length;
+
+    /* Only for streams, so written where the stream is */
+    while (0 < size) {
+        length = MIN (size, sizeof (zeros));
+        if (!_output_write (output, zeros, length, error)) {
+            return FALSE;
+        }
+        size -= length;
+    }
+
+    return TRUE;
+}
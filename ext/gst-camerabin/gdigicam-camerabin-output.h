@@ -0,0 +1,59 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+
+#ifndef _G_DIGICAM_CAMERABIN_OUTPUT_H_
+#define _G_DIGICAM_CAMERABIN_OUTPUT_H_
+
+#include <gst/gst.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * GDigicamCamerabinOutput:
+ *
+ * A file descriptor given by the application, to which a picture or
+ * a recording is written instead of to a file of its own.
+ */
+    typedef struct _GDigicamCamerabinOutput GDigicamCamerabinOutput;
+
+
+    GDigicamCamerabinOutput *_g_digicam_camerabin_output_new (gint     fd,
+                                                              GError **error);
+    gboolean _g_digicam_camerabin_output_write (GDigicamCamerabinOutput  *output,
+                                                GstBuffer                *buffer,
+                                                GError                  **error);
+    void _g_digicam_camerabin_output_seek (GDigicamCamerabinOutput *output,
+                                           guint64                  offset);
+    void _g_digicam_camerabin_output_free (GDigicamCamerabinOutput *output);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
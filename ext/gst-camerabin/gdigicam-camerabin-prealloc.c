@@ -0,0 +1,274 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+
+/*
+ * Preallocation of the video recordings.
+ *
+ * The muxer appends to the file in small pieces, and allocating them
+ * one by one fragments the flash storage and gives write latency
+ * spikes, which end up as dropped frames. Space is reserved ahead of
+ * the end of the file for some seconds of the expected bitrate, with
+ * fallocate() keeping the size of the file, so the muxer doesn't see
+ * it. The bitrate is measured as the file grows, and more space is
+ * reserved whenever half of it is used. Once the file is finished it
+ * is truncated to its size, which gives the space not used back.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-prealloc.h"
+#include "gdigicam-debug.h"
+
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+#define HAVE_KEEP_SIZE_FALLOCATE 1
+#endif
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+struct _GDigicamCamerabinPrealloc {
+    gint fd;
+    gchar *filename;
+    /* Expected bytes per second, measured once the file grows */
+    guint64 rate;
+    guint seconds;
+    GTimer *timer;
+    guint64 start;
+    guint64 written;
+    guint64 allocated;
+    gboolean disabled;
+};
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static void _prealloc_extend (GDigicamCamerabinPrealloc *prealloc);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_prealloc_new:
+ * @filename: The file being written, which must exist.
+ * @bitrate: Expected bitrate of the file, in bits per second.
+ * @seconds: How many seconds of @bitrate are reserved ahead.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Starts reserving space for @filename, from its current end.
+ *
+ * Returns: the new #GDigicamCamerabinPrealloc, or #NULL if the file
+ * can't be opened or the system doesn't support preallocation.
+ **/
+GDigicamCamerabinPrealloc *
+_g_digicam_camerabin_prealloc_new (const gchar  *filename,
+                                   guint         bitrate,
+                                   guint         seconds,
+                                   GError      **error)
+{
+#ifdef HAVE_KEEP_SIZE_FALLOCATE
+    GDigicamCamerabinPrealloc *prealloc = NULL;
+    struct stat buf;
+    gint saved_errno;
+    gint fd;
+
+    g_return_val_if_fail (NULL != filename, NULL);
+
+    fd = g_open (filename, O_WRONLY, 0);
+    if (0 > fd) {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR,
+                     g_file_error_from_errno (saved_errno),
+                     "Unable to open %s: %s",
+                     filename, g_strerror (saved_errno));
+        return NULL;
+    }
+
+    prealloc = g_slice_new0 (GDigicamCamerabinPrealloc);
+    prealloc->fd = fd;
+    prealloc->filename = g_strdup (filename);
+    prealloc->rate = MAX (1, bitrate / 8);
+    prealloc->seconds = seconds;
+    prealloc->timer = g_timer_new ();
+
+    /* The muxer may have written the headers already */
+    if (0 == fstat (fd, &buf)) {
+        prealloc->start = buf.st_size;
+    }
+    prealloc->written = prealloc->start;
+    prealloc->allocated = prealloc->start;
+
+    _prealloc_extend (prealloc);
+
+    return prealloc;
+#else
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOSYS,
+                 "Unable to preallocate %s: not supported",
+                 filename);
+    return NULL;
+#endif
+}
+
+
+/**
+ * _g_digicam_camerabin_prealloc_written:
+ * @prealloc: A #GDigicamCamerabinPrealloc.
+ * @size: Bytes which are going to be appended to the file.
+ *
+ * Accounts the bytes going to the file, reserving more space when
+ * half of it is used.
+ **/
+void
+_g_digicam_camerabin_prealloc_written (GDigicamCamerabinPrealloc *prealloc,
+                                       gsize                      size)
+{
+    gdouble elapsed;
+
+    g_return_if_fail (NULL != prealloc);
+
+    prealloc->written += size;
+
+    if (prealloc->disabled ||
+        (prealloc->written + prealloc->rate * prealloc->seconds / 2 <
+         prealloc->allocated)) {
+        return;
+    }
+
+    /* Too early for a meaningful bitrate, the muxer writes the
+     * headers in a burst */
+    elapsed = g_timer_elapsed (prealloc->timer, NULL);
+    if (1.0 <= elapsed) {
+        prealloc->rate = MAX (1, (prealloc->written - prealloc->start) /
+                              elapsed);
+    }
+
+    _prealloc_extend (prealloc);
+}
+
+
+/**
+ * _g_digicam_camerabin_prealloc_get_allocated:
+ * @prealloc: A #GDigicamCamerabinPrealloc.
+ *
+ * Gets up to where the file has space reserved.
+ *
+ * Returns: the offset of the end of the reserved space.
+ **/
+guint64
+_g_digicam_camerabin_prealloc_get_allocated (GDigicamCamerabinPrealloc *prealloc)
+{
+    g_return_val_if_fail (NULL != prealloc, 0);
+
+    return prealloc->allocated;
+}
+
+
+/**
+ * _g_digicam_camerabin_prealloc_finish:
+ * @prealloc: A #GDigicamCamerabinPrealloc.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Gives back the space reserved after the end of the file, by
+ * truncating it to its size, and frees @prealloc. The file must not
+ * be written anymore.
+ *
+ * Returns: #TRUE if success, #FALSE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_prealloc_finish (GDigicamCamerabinPrealloc  *prealloc,
+                                      GError                    **error)
+{
+    struct stat buf;
+    gboolean result = TRUE;
+    gint saved_errno;
+
+    g_return_val_if_fail (NULL != prealloc, FALSE);
+
+    if ((0 != fstat (prealloc->fd, &buf)) ||
+        (0 != ftruncate (prealloc->fd, buf.st_size))) {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR,
+                     g_file_error_from_errno (saved_errno),
+                     "Unable to truncate %s: %s",
+                     prealloc->filename, g_strerror (saved_errno));
+        result = FALSE;
+    }
+
+    close (prealloc->fd);
+    g_timer_destroy (prealloc->timer);
+    g_free (prealloc->filename);
+    g_slice_free (GDigicamCamerabinPrealloc, prealloc);
+
+    return result;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static void
+_prealloc_extend (GDigicamCamerabinPrealloc *prealloc)
+{
+#ifdef HAVE_KEEP_SIZE_FALLOCATE
+    guint64 end;
+    gint saved_errno;
+
+    end = prealloc->written + prealloc->rate * prealloc->seconds;
+    if (end <= prealloc->allocated) {
+        return;
+    }
+
+    if (0 != fallocate (prealloc->fd, FALLOC_FL_KEEP_SIZE,
+                        prealloc->allocated, end - prealloc->allocated)) {
+        /* Not supported by the file system, or full. Either way the
+         * file just grows as usual from now on. */
+        saved_errno = errno;
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: not preallocating %s "
+                         "anymore: %s",
+                         prealloc->filename, g_strerror (saved_errno));
+        prealloc->disabled = TRUE;
+        return;
+    }
+
+    prealloc->allocated = end;
+#endif
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+
+#ifndef _G_DIGICAM_CAMERABIN_PREALLOC_H_
+#define _G_DIGICAM_CAMERABIN_PREALLOC_H_
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * GDigicamCamerabinPrealloc:
+ *
+ * Space reserved ahead of a file which is being written, so it is not
+ * allocated in small pieces as it grows.
+ */
+    typedef struct _GDigicamCamerabinPrealloc GDigicamCamerabinPrealloc;
+
+
+    GDigicamCamerabinPrealloc *_g_digicam_camerabin_prealloc_new (const gchar  *filename,
+                                                                  guint         bitrate,
+                                                                  guint         seconds,
+                                                                  GError      **error);
+    void _g_digicam_camerabin_prealloc_written (GDigicamCamerabinPrealloc *prealloc,
+                                                gsize                      size);
+    guint64 _g_digicam_camerabin_prealloc_get_allocated (GDigicamCamerabinPrealloc *prealloc);
+    gboolean _g_digicam_camerabin_prealloc_finish (GDigicamCamerabinPrealloc  *prealloc,
+                                                   GError                    **error);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,294 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Pre-record ring of video frames.
+ *
+ * CameraBin only feeds the video encoder once the recording has been
+ * started, so the first frames are lost while it spins up. The ring
+ * keeps the last frames of the source, bounded by time and by size,
+ * so they can be recorded first and the recording starts a bit
+ * before the user asked for it. The same ring keeps the full
+ * resolution frames of the zero shutter lag still captures.
+ */
+
+#include <config.h>
+
+#include "gdigicam-camerabin-prerecord.h"
+#include "gdigicam-debug.h"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+struct _GDigicamCamerabinPrerecord {
+    GMutex *lock;
+    GQueue frames;
+    GstClockTime duration;
+    guint max_bytes;
+    guint bytes;
+};
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static void _prerecord_trim (GDigicamCamerabinPrerecord *prerecord);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_prerecord_new:
+ * @duration: The time to keep.
+ * @max_bytes: The maximum size of the frames kept.
+ *
+ * Creates an empty pre-record ring.
+ *
+ * Returns: A new #GDigicamCamerabinPrerecord.
+ **/
+GDigicamCamerabinPrerecord *
+_g_digicam_camerabin_prerecord_new (GstClockTime duration,
+                                    guint        max_bytes)
+{
+    GDigicamCamerabinPrerecord *prerecord = NULL;
+
+    prerecord = g_slice_new0 (GDigicamCamerabinPrerecord);
+    prerecord->lock = g_mutex_new ();
+    g_queue_init (&prerecord->frames);
+    prerecord->duration = duration;
+    prerecord->max_bytes = max_bytes;
+
+    return prerecord;
+}
+
+
+/**
+ * _g_digicam_camerabin_prerecord_free:
+ * @prerecord: A #GDigicamCamerabinPrerecord.
+ *
+ * Frees @prerecord and the frames it holds.
+ **/
+void
+_g_digicam_camerabin_prerecord_free (GDigicamCamerabinPrerecord *prerecord)
+{
+    if (NULL == prerecord) {
+        return;
+    }
+
+    _g_digicam_camerabin_prerecord_clear (prerecord);
+    g_mutex_free (prerecord->lock);
+    g_slice_free (GDigicamCamerabinPrerecord, prerecord);
+}
+
+
+/**
+ * _g_digicam_camerabin_prerecord_push:
+ * @prerecord: A #GDigicamCamerabinPrerecord.
+ * @buffer: A video frame. The ring takes ownership of it.
+ *
+ * Adds @buffer to the ring, dropping the oldest frames which don't
+ * fit anymore. Frames without timestamp are ignored, and a frame
+ * older than the last one, as after a restart of the source, empties
+ * the ring first.
+ **/
+void
+_g_digicam_camerabin_prerecord_push (GDigicamCamerabinPrerecord *prerecord,
+                                     GstBuffer                  *buffer)
+{
+    GstBuffer *last = NULL;
+
+    g_return_if_fail (NULL != prerecord);
+    g_return_if_fail (GST_IS_BUFFER (buffer));
+
+    if (!GST_BUFFER_TIMESTAMP_IS_VALID (buffer)) {
+        gst_buffer_unref (buffer);
+        return;
+    }
+
+    g_mutex_lock (prerecord->lock);
+
+    last = g_queue_peek_tail (&prerecord->frames);
+    if ((NULL != last) &&
+        (GST_BUFFER_TIMESTAMP (buffer) <= GST_BUFFER_TIMESTAMP (last))) {
+        while (!g_queue_is_empty (&prerecord->frames)) {
+            gst_buffer_unref (g_queue_pop_head (&prerecord->frames));
+        }
+        prerecord->bytes = 0;
+    }
+
+    g_queue_push_tail (&prerecord->frames, buffer);
+    prerecord->bytes += GST_BUFFER_SIZE (buffer);
+    _prerecord_trim (prerecord);
+
+    g_mutex_unlock (prerecord->lock);
+}
+
+
+/**
+ * _g_digicam_camerabin_prerecord_clear:
+ * @prerecord: A #GDigicamCamerabinPrerecord.
+ *
+ * Drops all the frames of @prerecord.
+ **/
+void
+_g_digicam_camerabin_prerecord_clear (GDigicamCamerabinPrerecord *prerecord)
+{
+    GList *frames = NULL;
+
+    g_return_if_fail (NULL != prerecord);
+
+    frames = _g_digicam_camerabin_prerecord_take (prerecord, NULL);
+    g_list_foreach (frames, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (frames);
+}
+
+
+/**
+ * _g_digicam_camerabin_prerecord_pick:
+ * @prerecord: A #GDigicamCamerabinPrerecord.
+ * @timestamp: The wanted running time.
+ *
+ * Looks for the frame of @prerecord closest to @timestamp, leaving it
+ * in the ring.
+ *
+ * Returns: A new reference to the frame, or #NULL if the ring is
+ * empty.
+ **/
+GstBuffer *
+_g_digicam_camerabin_prerecord_pick (GDigicamCamerabinPrerecord *prerecord,
+                                     GstClockTime                timestamp)
+{
+    GstBuffer *frame = NULL;
+    GstBuffer *best = NULL;
+    GstClockTimeDiff distance, best_distance;
+    GList *item = NULL;
+
+    g_return_val_if_fail (NULL != prerecord, NULL);
+
+    g_mutex_lock (prerecord->lock);
+
+    best_distance = G_MAXINT64;
+    for (item = prerecord->frames.head; NULL != item; item = item->next) {
+        frame = item->data;
+        distance = ABS (GST_CLOCK_DIFF (timestamp, GST_BUFFER_TIMESTAMP (frame)));
+        if (distance >= best_distance) {
+            /* Timestamps only grow, it won't get closer */
+            break;
+        }
+        best = frame;
+        best_distance = distance;
+    }
+
+    if (NULL != best) {
+        gst_buffer_ref (best);
+    }
+
+    g_mutex_unlock (prerecord->lock);
+
+    return best;
+}
+
+
+/**
+ * _g_digicam_camerabin_prerecord_take:
+ * @prerecord: A #GDigicamCamerabinPrerecord.
+ * @duration: Return location for the time covered by the frames, or
+ * #NULL.
+ *
+ * Empties @prerecord, giving back its frames.
+ *
+ * Returns: A #GList with the frames, oldest first. The list and the
+ * frames belong to the caller.
+ **/
+GList *
+_g_digicam_camerabin_prerecord_take (GDigicamCamerabinPrerecord *prerecord,
+                                     GstClockTime               *duration)
+{
+    GstBuffer *first = NULL;
+    GstBuffer *last = NULL;
+    GList *frames = NULL;
+    guint n;
+
+    g_return_val_if_fail (NULL != prerecord, NULL);
+
+    g_mutex_lock (prerecord->lock);
+
+    if (NULL != duration) {
+        *duration = 0;
+        first = g_queue_peek_head (&prerecord->frames);
+        last = g_queue_peek_tail (&prerecord->frames);
+        n = g_queue_get_length (&prerecord->frames);
+
+        if (NULL == last) {
+            /* Nothing */
+        } else if (GST_BUFFER_DURATION_IS_VALID (last)) {
+            *duration = GST_BUFFER_TIMESTAMP (last) +
+                GST_BUFFER_DURATION (last) - GST_BUFFER_TIMESTAMP (first);
+        } else if (1 < n) {
+            /* Give the last frame the average duration */
+            *duration = gst_util_uint64_scale_int (GST_BUFFER_TIMESTAMP (last) -
+                                                   GST_BUFFER_TIMESTAMP (first),
+                                                   n, n - 1);
+        }
+    }
+
+    frames = prerecord->frames.head;
+    g_queue_init (&prerecord->frames);
+    prerecord->bytes = 0;
+
+    g_mutex_unlock (prerecord->lock);
+
+    return frames;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static void
+_prerecord_trim (GDigicamCamerabinPrerecord *prerecord)
+{
+    GstBuffer *first = NULL;
+    GstBuffer *last = NULL;
+
+    last = g_queue_peek_tail (&prerecord->frames);
+
+    while (!g_queue_is_empty (&prerecord->frames)) {
+        first = g_queue_peek_head (&prerecord->frames);
+        if ((prerecord->bytes <= prerecord->max_bytes) &&
+            (GST_BUFFER_TIMESTAMP (last) - GST_BUFFER_TIMESTAMP (first) <
+             prerecord->duration)) {
+            break;
+        }
+
+        prerecord->bytes -= GST_BUFFER_SIZE (first);
+        gst_buffer_unref (g_queue_pop_head (&prerecord->frames));
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef _G_DIGICAM_CAMERABIN_PRERECORD_H_
+#define _G_DIGICAM_CAMERABIN_PRERECORD_H_
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * GDigicamCamerabinPrerecord:
+ *
+ * The last frames of the video source, kept to be recorded before
+ * the frames following the start of the recording.
+ */
+    typedef struct _GDigicamCamerabinPrerecord GDigicamCamerabinPrerecord;
+
+
+    GDigicamCamerabinPrerecord *_g_digicam_camerabin_prerecord_new (GstClockTime duration,
+                                                                    guint        max_bytes);
+    void _g_digicam_camerabin_prerecord_free (GDigicamCamerabinPrerecord *prerecord);
+    void _g_digicam_camerabin_prerecord_push (GDigicamCamerabinPrerecord *prerecord,
+                                              GstBuffer                  *buffer);
+    GstBuffer *_g_digicam_camerabin_prerecord_pick (GDigicamCamerabinPrerecord *prerecord,
+                                                    GstClockTime                timestamp);
+    void _g_digicam_camerabin_prerecord_clear (GDigicamCamerabinPrerecord *prerecord);
+    GList *_g_digicam_camerabin_prerecord_take (GDigicamCamerabinPrerecord *prerecord,
+                                                GstClockTime               *duration);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,390 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Box filter downscaling of the previews to several sizes at once.
+ *
+ * The source is read once, row by row. Every row is added to a 16 bits
+ * accumulator row of each target, which is a plain vector add, and
+ * only when all the source rows of a destination row have been added
+ * the accumulator is reduced horizontally and averaged. So the
+ * expensive part runs once per source row and target while the row is
+ * in cache, and the horizontal work once per destination row.
+ */
+
+#include <string.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-scale.h"
+#include "gdigicam-camerabin-colorspace.h"
+#include "gdigicam-camerabin-scratch.h"
+#include "gdigicam-debug.h"
+
+#if defined(__GNUC__) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9))) && \
+    (defined(__i386__) || defined(__x86_64__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+typedef void (*AccumulateFunc) (guint16 *acc,
+                                const guchar *row,
+                                gint n);
+
+typedef struct _ScaleState {
+    GDigicamCamerabinScaleTarget *target;
+    guint16 *acc;
+    gint *x0;
+    gint row;
+    gint next_y;
+    gint rows;
+} ScaleState;
+
+
+/*****************************************/
+/* Private variables */
+/*****************************************/
+
+/* The accumulator rows of every target */
+static GStaticPrivate scratch_key = G_STATIC_PRIVATE_INIT;
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static AccumulateFunc _get_accumulate_func (void);
+static void _accumulate_c (guint16 *acc,
+                           const guchar *row,
+                           gint n);
+#ifdef HAVE_X86_KERNELS
+static void _accumulate_sse2 (guint16 *acc,
+                              const guchar *row,
+                              gint n);
+#endif
+#ifdef HAVE_NEON_KERNELS
+static void _accumulate_neon (guint16 *acc,
+                              const guchar *row,
+                              gint n);
+#endif
+static void _flush_row (ScaleState *state,
+                        gint src_width,
+                        gint bpp);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_scale_fit:
+ * @src_width: Width of the source image.
+ * @src_height: Height of the source image.
+ * @box_width: Width of the bounding box.
+ * @box_height: Height of the bounding box.
+ * @width: Width of the biggest image with the source aspect ratio
+ * fitting in the box.
+ * @height: Height of the biggest image with the source aspect ratio
+ * fitting in the box.
+ *
+ * Computes the size of a downscaled image. It is never bigger than the
+ * source, nor smaller than what _g_digicam_camerabin_scale_box()
+ * supports.
+ **/
+void
+_g_digicam_camerabin_scale_fit (gint  src_width,
+                                gint  src_height,
+                                guint box_width,
+                                guint box_height,
+                                gint *width,
+                                gint *height)
+{
+    gdouble scale;
+
+    scale = MIN ((gdouble) box_width / src_width,
+                 (gdouble) box_height / src_height);
+    scale = MIN (scale, 1.0);
+
+    *width = (gint) (src_width * scale + 0.5);
+    *height = (gint) (src_height * scale + 0.5);
+
+    *width = CLAMP (*width,
+                    (src_width + G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR - 1) /
+                    G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR,
+                    src_width);
+    *height = CLAMP (*height,
+                     (src_height + G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR - 1) /
+                     G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR,
+                     src_height);
+}
+
+
+/**
+ * _g_digicam_camerabin_scale_box:
+ * @src: Source pixels.
+ * @width: Source width.
+ * @height: Source height.
+ * @stride: Source row stride.
+ * @bpp: Bytes per pixel of the source and the targets.
+ * @targets: The images to produce.
+ * @n_targets: The number of elements in @targets.
+ *
+ * Downscales @src into every image in @targets in a single pass,
+ * averaging the source pixels covered by each destination
+ * pixel. Targets can't be bigger than the source, nor more than
+ * #G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR times smaller.
+ **/
+void
+_g_digicam_camerabin_scale_box (const guchar                 *src,
+                                gint                          width,
+                                gint                          height,
+                                gint                          stride,
+                                gint                          bpp,
+                                GDigicamCamerabinScaleTarget *targets,
+                                guint                         n_targets)
+{
+    AccumulateFunc accumulate = NULL;
+    ScaleState *states = NULL;
+    ScaleState *state = NULL;
+    const guchar *row = NULL;
+    guchar *scratch = NULL;
+    gsize size;
+    gint x, y;
+    guint i;
+
+    g_return_if_fail (NULL != src);
+    g_return_if_fail ((0 < bpp) && (4 >= bpp));
+    g_return_if_fail ((NULL != targets) || (0 == n_targets));
+
+    for (i = 0; i < n_targets; i++) {
+        g_return_if_fail ((0 < targets[i].width) &&
+                          (targets[i].width <= width) &&
+                          (width <= targets[i].width *
+                           G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR));
+        g_return_if_fail ((0 < targets[i].height) &&
+                          (targets[i].height <= height) &&
+                          (height <= targets[i].height *
+                           G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR));
+    }
+
+    accumulate = _get_accumulate_func ();
+
+    /* The states, then the accumulator and the column bounds of every
+     * target to average, all in a single block */
+    size = GST_ROUND_UP_16 (n_targets * sizeof (ScaleState));
+    for (i = 0; i < n_targets; i++) {
+        size += GST_ROUND_UP_16 (width * bpp * sizeof (guint16)) +
+            GST_ROUND_UP_16 ((targets[i].width + 1) * sizeof (gint));
+    }
+    scratch = _g_digicam_camerabin_scratch_get (&scratch_key, size);
+    memset (scratch, 0, size);
+
+    states = (ScaleState *) scratch;
+    scratch += GST_ROUND_UP_16 (n_targets * sizeof (ScaleState));
+
+    for (i = 0; i < n_targets; i++) {
+        state = &states[i];
+        state->target = &targets[i];
+
+        /* Same size, nothing to average */
+        if ((targets[i].width == width) && (targets[i].height == height)) {
+            continue;
+        }
+
+        state->acc = (guint16 *) scratch;
+        scratch += GST_ROUND_UP_16 (width * bpp * sizeof (guint16));
+        state->x0 = (gint *) scratch;
+        scratch += GST_ROUND_UP_16 ((targets[i].width + 1) * sizeof (gint));
+        for (x = 0; x <= targets[i].width; x++) {
+            state->x0[x] = x * width / targets[i].width;
+        }
+        state->row = 0;
+        state->next_y = height / targets[i].height;
+        state->rows = 0;
+    }
+
+    for (y = 0; y < height; y++) {
+        row = src + y * stride;
+
+        for (i = 0; i < n_targets; i++) {
+            state = &states[i];
+
+            if (NULL == state->acc) {
+                memcpy (state->target->pixels + y * state->target->stride,
+                        row, width * bpp);
+                continue;
+            }
+
+            accumulate (state->acc, row, width * bpp);
+            state->rows++;
+
+            if (y + 1 == state->next_y) {
+                _flush_row (state, width, bpp);
+                state->row++;
+                state->next_y = (state->row + 1) * height /
+                    state->target->height;
+            }
+        }
+    }
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static AccumulateFunc
+_get_accumulate_func (void)
+{
+    guint simd;
+
+    /* Same instruction sets as the colorspace conversion */
+    simd = _g_digicam_camerabin_colorspace_get_simd ();
+
+#ifdef HAVE_X86_KERNELS
+    if (simd & G_DIGICAM_CAMERABIN_SIMD_SSE2) {
+        return _accumulate_sse2;
+    }
+#endif
+
+#ifdef HAVE_NEON_KERNELS
+    if (simd & G_DIGICAM_CAMERABIN_SIMD_NEON) {
+        return _accumulate_neon;
+    }
+#endif
+
+    return _accumulate_c;
+}
+
+
+static void
+_accumulate_c (guint16 *acc,
+               const guchar *row,
+               gint n)
+{
+    gint i;
+
+    for (i = 0; i < n; i++) {
+        acc[i] += row[i];
+    }
+}
+
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__ ((target ("sse2")))
+static void
+_accumulate_sse2 (guint16 *acc,
+                  const guchar *row,
+                  gint n)
+{
+    __m128i zero, pixels;
+    __m128i *dst = NULL;
+    gint i;
+
+    zero = _mm_setzero_si128 ();
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        pixels = _mm_loadu_si128 ((const __m128i *) (row + i));
+        dst = (__m128i *) (acc + i);
+        _mm_storeu_si128 (dst,
+                          _mm_add_epi16 (_mm_loadu_si128 (dst),
+                                         _mm_unpacklo_epi8 (pixels, zero)));
+        _mm_storeu_si128 (dst + 1,
+                          _mm_add_epi16 (_mm_loadu_si128 (dst + 1),
+                                         _mm_unpackhi_epi8 (pixels, zero)));
+    }
+
+    _accumulate_c (acc + i, row + i, n - i);
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+
+#ifdef HAVE_NEON_KERNELS
+
+static void
+_accumulate_neon (guint16 *acc,
+                  const guchar *row,
+                  gint n)
+{
+    uint8x16_t pixels;
+    gint i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        pixels = vld1q_u8 (row + i);
+        vst1q_u16 (acc + i,
+                   vaddw_u8 (vld1q_u16 (acc + i), vget_low_u8 (pixels)));
+        vst1q_u16 (acc + i + 8,
+                   vaddw_u8 (vld1q_u16 (acc + i + 8), vget_high_u8 (pixels)));
+    }
+
+    _accumulate_c (acc + i, row + i, n - i);
+}
+
+#endif /* HAVE_NEON_KERNELS */
+
+
+static void
+_flush_row (ScaleState *state,
+            gint src_width,
+            gint bpp)
+{
+    GDigicamCamerabinScaleTarget *target = NULL;
+    guchar *dst = NULL;
+    guint32 sum[4];
+    guint32 count;
+    gint x, sx, c;
+
+    target = state->target;
+    dst = target->pixels + state->row * target->stride;
+
+    for (x = 0; x < target->width; x++) {
+        memset (sum, 0, sizeof (sum));
+        for (sx = state->x0[x]; sx < state->x0[x + 1]; sx++) {
+            for (c = 0; c < bpp; c++) {
+                sum[c] += state->acc[sx * bpp + c];
+            }
+        }
+
+        count = (state->x0[x + 1] - state->x0[x]) * state->rows;
+        for (c = 0; c < bpp; c++) {
+            *dst++ = (sum[c] + count / 2) / count;
+        }
+    }
+
+    memset (state->acc, 0, src_width * bpp * sizeof (guint16));
+    state->rows = 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef _G_DIGICAM_CAMERABIN_SCALE_H_
+#define _G_DIGICAM_CAMERABIN_SCALE_H_
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR:
+ *
+ * Maximum downscaling factor supported in each direction.
+ */
+#define G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR 256
+
+
+/**
+ * GDigicamCamerabinScaleTarget:
+ * @pixels: Destination pixels, with the same layout as the source.
+ * @width: Destination width, not bigger than the source one.
+ * @height: Destination height, not bigger than the source one.
+ * @stride: Destination row stride.
+ *
+ * One of the images produced by _g_digicam_camerabin_scale_box().
+ */
+    typedef struct {
+        guchar *pixels;
+        gint width;
+        gint height;
+        gint stride;
+    } GDigicamCamerabinScaleTarget;
+
+
+    void _g_digicam_camerabin_scale_fit (gint  src_width,
+                                         gint  src_height,
+                                         guint box_width,
+                                         guint box_height,
+                                         gint *width,
+                                         gint *height);
+    void _g_digicam_camerabin_scale_box (const guchar                 *src,
+                                         gint                          width,
+                                         gint                          height,
+                                         gint                          stride,
+                                         gint                          bpp,
+                                         GDigicamCamerabinScaleTarget *targets,
+                                         guint                         n_targets);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
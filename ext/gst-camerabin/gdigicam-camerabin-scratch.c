@@ -0,0 +1,106 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Working memory of the image operations.
+ *
+ * The conversions and scalings of the previews need blocks as big as
+ * a row or a few rows of the image. Every thread keeps the biggest
+ * block it needed for each operation, so the previews of a burst
+ * don't allocate them again.
+ */
+
+#include <config.h>
+
+#include "gdigicam-camerabin-scratch.h"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+typedef struct _Scratch {
+    gpointer data;
+    gsize size;
+} Scratch;
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static void _scratch_free (Scratch *scratch);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_scratch_get:
+ * @key: The #GStaticPrivate of the operation.
+ * @size: The size needed.
+ *
+ * Gets the block of the calling thread for the operation of @key,
+ * growing it to @size if needed. Its contents are undefined, and it
+ * is valid until the next call with @key from the same thread. It is
+ * freed with the thread.
+ *
+ * Returns: the block, of at least @size bytes.
+ **/
+gpointer
+_g_digicam_camerabin_scratch_get (GStaticPrivate *key,
+                                  gsize           size)
+{
+    Scratch *scratch = NULL;
+
+    g_return_val_if_fail (NULL != key, NULL);
+
+    scratch = g_static_private_get (key);
+    if (NULL == scratch) {
+        scratch = g_slice_new0 (Scratch);
+        g_static_private_set (key, scratch,
+                              (GDestroyNotify) _scratch_free);
+    }
+
+    if (size > scratch->size) {
+        g_free (scratch->data);
+        scratch->data = g_malloc (size);
+        scratch->size = size;
+    }
+
+    return scratch->data;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static void
+_scratch_free (Scratch *scratch)
+{
+    g_free (scratch->data);
+    g_slice_free (Scratch, scratch);
+}
@@ -0,0 +1,1003 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Segmented recordings.
+ *
+ * A fragmented recording is made of an initialization part, the ftyp
+ * and moov boxes, followed by fragments, each one a moof box and the
+ * mdat box of its samples. The stream is cut before a moof box whose
+ * video samples start at a keyframe, and the initialization part
+ * written again at the start of the next file makes it playable on its
+ * own. The stream is followed box by box, only the moof boxes are held
+ * until they are complete to look into them, and the muxer never has
+ * to stop.
+ *
+ * At the end the muxer writes a mfra box, with offsets into the whole
+ * stream, and goes back to update the duration in the moov box. Both
+ * are useless in a segment, the files are playable without them, so
+ * they are not written.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-segmenter.h"
+#include "gdigicam-camerabin-writeback.h"
+#include "gdigicam-debug.h"
+
+#define BOX_HEADER_SIZE 8
+#define BOX_LARGE_HEADER_SIZE 16
+#define BOX_TO_THE_END G_MAXUINT64
+
+/* Bigger moof boxes are written as they come, without cutting the
+ * stream before them */
+#define MOOF_MAX_SIZE (1024 * 1024)
+
+/* Optional fields of the tfhd and trun boxes, and the sample flag
+ * telling it doesn't start a group of pictures */
+#define TFHD_BASE_DATA_OFFSET 0x000001
+#define TFHD_SAMPLE_DESCRIPTION_INDEX 0x000002
+#define TFHD_DEFAULT_SAMPLE_DURATION 0x000008
+#define TFHD_DEFAULT_SAMPLE_SIZE 0x000010
+#define TFHD_DEFAULT_SAMPLE_FLAGS 0x000020
+#define TRUN_DATA_OFFSET 0x000001
+#define TRUN_FIRST_SAMPLE_FLAGS 0x000004
+#define TRUN_SAMPLE_DURATION 0x000100
+#define TRUN_SAMPLE_SIZE 0x000200
+#define TRUN_SAMPLE_FLAGS 0x000400
+#define SAMPLE_IS_NON_SYNC 0x00010000
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+struct _GDigicamCamerabinSegmenter {
+    gchar *filename;
+    GstClockTime duration;
+    guint64 max_bytes;
+    guint64 reserved;
+    gsize window;
+    /* Where the next segments go, if not with the first one, and
+     * whether the current one has to be cut to move there */
+    GMutex *lock;
+    gchar *directory;
+    gboolean moving;
+    /* The segment being written */
+    guint count;
+    gchar *current;
+    gint fd;
+    GDigicamCamerabinWriteback *writeback;
+    guint64 written;
+    GstClockTime start;
+    GstClockTime last;
+    GTimer *timer;
+    /* The segments already written, oldest first */
+    GQueue closed;
+    /* The initialization part, complete once the first fragment
+     * starts */
+    GByteArray *init;
+    gboolean fragmented;
+    /* The video track, found in the initialization part, and the
+     * flags of its samples when the fragments don't give them */
+    guint32 video_track;
+    guint32 video_flags;
+    /* The moof box being held until it is complete */
+    GByteArray *moof;
+    gboolean moof_held;
+    /* The box going through */
+    guint8 header[BOX_LARGE_HEADER_SIZE];
+    guint header_size;
+    guint64 box_left;
+    gboolean box_kept;
+    /* Bytes of the stream, and whether the muxer went back in it */
+    guint64 position;
+    gboolean went_back;
+    gboolean timestamped;
+};
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static gboolean _segmenter_open (GDigicamCamerabinSegmenter *segmenter,
+                                 GError **error);
+static void _segmenter_close (GDigicamCamerabinSegmenter *segmenter);
+static void _segmenter_make_room (GDigicamCamerabinSegmenter *segmenter,
+                                  const gchar *dirname);
+static gboolean _segmenter_is_full (GDigicamCamerabinSegmenter *segmenter);
+static gboolean _segmenter_parse (GDigicamCamerabinSegmenter *segmenter,
+                                  const guint8 *data,
+                                  gsize size,
+                                  GError **error);
+static gboolean _segmenter_box_start (GDigicamCamerabinSegmenter *segmenter,
+                                      GError **error);
+static gboolean _segmenter_moof_end (GDigicamCamerabinSegmenter *segmenter,
+                                     GError **error);
+static void _segmenter_find_video_track (GDigicamCamerabinSegmenter *segmenter);
+static gboolean _segmenter_starts_at_keyframe (GDigicamCamerabinSegmenter *segmenter);
+static gboolean _box_next (const guint8 **data,
+                           gsize *size,
+                           guint32 *type,
+                           const guint8 **payload,
+                           gsize *payload_size);
+static const guint8 *_box_find (const guint8 *data,
+                                gsize size,
+                                guint32 type,
+                                gsize *payload_size);
+static gboolean _segmenter_write (GDigicamCamerabinSegmenter *segmenter,
+                                  const guint8 *data,
+                                  gsize size,
+                                  GError **error);
+static gchar *_segment_filename (const gchar *filename,
+                                 guint count);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_segmenter_new:
+ * @filename: The file of the first segment.
+ * @duration: Time after which a new segment is started, or 0.
+ * @max_bytes: Size after which a new segment is started, or 0.
+ * @reserved: Free space kept in the file system by deleting the
+ * oldest segments, or 0.
+ * @window: Bytes of the segments flushed at once, see
+ * _g_digicam_camerabin_writeback_new(), or 0.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Starts writing a recording in segments. The first one goes to
+ * @filename, and the next ones to files named after it, with the
+ * number of the segment before the extension, from 2 on.
+ *
+ * Returns: the new #GDigicamCamerabinSegmenter, or #NULL if the first
+ * segment can't be created.
+ **/
+GDigicamCamerabinSegmenter *
+_g_digicam_camerabin_segmenter_new (const gchar   *filename,
+                                    GstClockTime   duration,
+                                    guint64        max_bytes,
+                                    guint64        reserved,
+                                    gsize          window,
+                                    GError       **error)
+{
+    GDigicamCamerabinSegmenter *segmenter = NULL;
+
+    g_return_val_if_fail (NULL != filename, NULL);
+
+    segmenter = g_slice_new0 (GDigicamCamerabinSegmenter);
+    segmenter->filename = g_strdup (filename);
+    segmenter->duration = duration;
+    segmenter->max_bytes = max_bytes;
+    segmenter->reserved = reserved;
+    segmenter->window = window;
+    segmenter->lock = g_mutex_new ();
+    segmenter->fd = -1;
+    segmenter->timer = g_timer_new ();
+    segmenter->init = g_byte_array_new ();
+    segmenter->moof = g_byte_array_new ();
+    g_queue_init (&segmenter->closed);
+
+    if (!_segmenter_open (segmenter, error)) {
+        _g_digicam_camerabin_segmenter_finish (segmenter);
+        return NULL;
+    }
+
+    return segmenter;
+}
+
+
+/**
+ * _g_digicam_camerabin_segmenter_push:
+ * @segmenter: A #GDigicamCamerabinSegmenter.
+ * @buffer: The next data of the recording.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Writes @buffer to the current segment, starting a new one before it
+ * if the current one is full and a fragment starting at a keyframe
+ * starts. Once a write fails, the rest of the recording is dropped.
+ *
+ * Returns: #FALSE if @buffer couldn't be written, #TRUE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_segmenter_push (GDigicamCamerabinSegmenter  *segmenter,
+                                     GstBuffer                   *buffer,
+                                     GError                     **error)
+{
+    g_return_val_if_fail (NULL != segmenter, FALSE);
+    g_return_val_if_fail (GST_IS_BUFFER (buffer), FALSE);
+
+    if ((0 > segmenter->fd) ||
+        (segmenter->went_back && segmenter->fragmented)) {
+        return TRUE;
+    }
+
+    if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer)) {
+        segmenter->timestamped = TRUE;
+        if (!GST_CLOCK_TIME_IS_VALID (segmenter->start)) {
+            segmenter->start = GST_BUFFER_TIMESTAMP (buffer);
+        }
+        if (GST_BUFFER_TIMESTAMP (buffer) >= segmenter->start) {
+            segmenter->last = GST_BUFFER_TIMESTAMP (buffer);
+        }
+    }
+
+    segmenter->position += GST_BUFFER_SIZE (buffer);
+
+    /* Not a fragmented stream, just one file written as it comes */
+    if (segmenter->went_back) {
+        return _segmenter_write (segmenter, GST_BUFFER_DATA (buffer),
+                                 GST_BUFFER_SIZE (buffer), error);
+    }
+
+    return _segmenter_parse (segmenter, GST_BUFFER_DATA (buffer),
+                             GST_BUFFER_SIZE (buffer), error);
+}
+
+
+/**
+ * _g_digicam_camerabin_segmenter_seek:
+ * @segmenter: A #GDigicamCamerabinSegmenter.
+ * @offset: The offset in the stream of the next data.
+ *
+ * Tells where the muxer writes the next data. Once it goes back to
+ * update what it already wrote, the rest of the recording is not
+ * written, unless the recording is not fragmented, then it is written
+ * where the muxer says.
+ **/
+void
+_g_digicam_camerabin_segmenter_seek (GDigicamCamerabinSegmenter *segmenter,
+                                     guint64                     offset)
+{
+    g_return_if_fail (NULL != segmenter);
+
+    if ((0 > segmenter->fd) || (offset == segmenter->position)) {
+        return;
+    }
+
+    segmenter->went_back = TRUE;
+    segmenter->position = offset;
+
+    if (segmenter->fragmented) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: the muxer went back to %"
+                         G_GUINT64_FORMAT ", not updating the segments.",
+                         offset);
+    } else if (0 > lseek (segmenter->fd, offset, SEEK_SET)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to seek in %s: %s",
+                        segmenter->current, g_strerror (errno));
+        _segmenter_close (segmenter);
+    }
+}
+
+
+/**
+ * _g_digicam_camerabin_segmenter_set_directory:
+ * @segmenter: A #GDigicamCamerabinSegmenter.
+ * @directory: The directory of the next segments.
+ *
+ * Moves the rest of the recording to another file system, with the
+ * same names as the segments would have had. The current segment is
+ * cut at the next fragment starting at a keyframe, whether it is full
+ * or not, so it doesn't go on filling the file system it is in. It
+ * can be called from any thread.
+ **/
+void
+_g_digicam_camerabin_segmenter_set_directory (GDigicamCamerabinSegmenter *segmenter,
+                                              const gchar                *directory)
+{
+    g_return_if_fail (NULL != segmenter);
+    g_return_if_fail (NULL != directory);
+
+    g_mutex_lock (segmenter->lock);
+    g_free (segmenter->directory);
+    segmenter->directory = g_strdup (directory);
+    segmenter->moving = TRUE;
+    g_mutex_unlock (segmenter->lock);
+}
+
+
+/**
+ * _g_digicam_camerabin_segmenter_makes_room:
+ * @segmenter: A #GDigicamCamerabinSegmenter.
+ * @directory: A directory.
+ *
+ * Tells whether the next segments go to @directory, and the oldest
+ * ones are deleted there to keep free space, see
+ * _g_digicam_camerabin_segmenter_new(). It can be called from any
+ * thread.
+ *
+ * Returns: #TRUE if the recording makes room in @directory itself,
+ * #FALSE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_segmenter_makes_room (GDigicamCamerabinSegmenter *segmenter,
+                                           const gchar                *directory)
+{
+    gchar *dirname = NULL;
+    gboolean result;
+
+    g_return_val_if_fail (NULL != segmenter, FALSE);
+    g_return_val_if_fail (NULL != directory, FALSE);
+
+    if (0 == segmenter->reserved) {
+        return FALSE;
+    }
+
+    g_mutex_lock (segmenter->lock);
+    if (NULL != segmenter->directory) {
+        dirname = g_strdup (segmenter->directory);
+    } else {
+        dirname = g_path_get_dirname (segmenter->filename);
+    }
+    g_mutex_unlock (segmenter->lock);
+
+    result = (0 == strcmp (dirname, directory));
+    g_free (dirname);
+
+    return result;
+}
+
+
+/**
+ * _g_digicam_camerabin_segmenter_get_count:
+ * @segmenter: A #GDigicamCamerabinSegmenter.
+ *
+ * Gets the number of segments started.
+ *
+ * Returns: the number of the current segment, from 1 on.
+ **/
+guint
+_g_digicam_camerabin_segmenter_get_count (GDigicamCamerabinSegmenter *segmenter)
+{
+    g_return_val_if_fail (NULL != segmenter, 0);
+
+    return segmenter->count;
+}
+
+
+/**
+ * _g_digicam_camerabin_segmenter_finish:
+ * @segmenter: A #GDigicamCamerabinSegmenter.
+ *
+ * Closes the last segment and frees @segmenter.
+ **/
+void
+_g_digicam_camerabin_segmenter_finish (GDigicamCamerabinSegmenter *segmenter)
+{
+    g_return_if_fail (NULL != segmenter);
+
+    _segmenter_close (segmenter);
+
+    while (!g_queue_is_empty (&segmenter->closed)) {
+        g_free (g_queue_pop_head (&segmenter->closed));
+    }
+    g_byte_array_free (segmenter->init, TRUE);
+    g_byte_array_free (segmenter->moof, TRUE);
+    g_timer_destroy (segmenter->timer);
+    g_mutex_free (segmenter->lock);
+    g_free (segmenter->directory);
+    g_free (segmenter->filename);
+    g_slice_free (GDigicamCamerabinSegmenter, segmenter);
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static gboolean
+_segmenter_open (GDigicamCamerabinSegmenter *segmenter,
+                 GError **error)
+{
+    gchar *filename = NULL;
+    gchar *basename = NULL;
+    gchar *dirname = NULL;
+    gint saved_errno;
+
+    filename = _segment_filename (segmenter->filename,
+                                  segmenter->count + 1);
+
+    g_mutex_lock (segmenter->lock);
+    if (NULL != segmenter->directory) {
+        basename = g_path_get_basename (filename);
+        g_free (filename);
+        filename = g_build_filename (segmenter->directory, basename, NULL);
+        g_free (basename);
+    }
+    segmenter->moving = FALSE;
+    g_mutex_unlock (segmenter->lock);
+
+    dirname = g_path_get_dirname (filename);
+    _segmenter_make_room (segmenter, dirname);
+    g_free (dirname);
+
+    segmenter->fd = g_open (filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (0 > segmenter->fd) {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR,
+                     g_file_error_from_errno (saved_errno),
+                     "Unable to create %s: %s",
+                     filename, g_strerror (saved_errno));
+        g_free (filename);
+        return FALSE;
+    }
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: recording segment %s.", filename);
+
+    segmenter->count++;
+    segmenter->current = filename;
+    segmenter->written = 0;
+    segmenter->start = GST_CLOCK_TIME_NONE;
+    segmenter->last = GST_CLOCK_TIME_NONE;
+    g_timer_start (segmenter->timer);
+
+    if (!_segmenter_write (segmenter, segmenter->init->data,
+                           segmenter->init->len, error)) {
+        return FALSE;
+    }
+
+    if (0 < segmenter->window) {
+        segmenter->writeback = _g_digicam_camerabin_writeback_new (filename,
+                                                                   segmenter->window,
+                                                                   NULL);
+    }
+
+    return TRUE;
+}
+
+
+static void
+_segmenter_close (GDigicamCamerabinSegmenter *segmenter)
+{
+    if (NULL != segmenter->writeback) {
+        _g_digicam_camerabin_writeback_finish (segmenter->writeback);
+        segmenter->writeback = NULL;
+    }
+    if (0 <= segmenter->fd) {
+        close (segmenter->fd);
+        segmenter->fd = -1;
+    }
+    if (NULL != segmenter->current) {
+        g_queue_push_tail (&segmenter->closed, segmenter->current);
+        segmenter->current = NULL;
+    }
+}
+
+
+static void
+_segmenter_make_room (GDigicamCamerabinSegmenter *segmenter,
+                      const gchar *dirname)
+{
+    struct statvfs buf;
+    GList *item = NULL;
+    GList *next = NULL;
+    gchar *segment_dirname = NULL;
+    gchar *oldest = NULL;
+
+    if (0 == segmenter->reserved) {
+        return;
+    }
+
+    /* Only the segments of this recording in the same file system,
+     * and never the last one */
+    item = segmenter->closed.head;
+    while ((NULL != item) && (NULL != item->next) &&
+           (0 == statvfs (dirname, &buf)) &&
+           ((guint64) buf.f_bavail * buf.f_frsize < segmenter->reserved)) {
+        next = item->next;
+        oldest = item->data;
+        segment_dirname = g_path_get_dirname (oldest);
+        if (0 == strcmp (segment_dirname, dirname)) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: running out of space, "
+                             "deleting segment %s.", oldest);
+            g_unlink (oldest);
+            g_free (oldest);
+            g_queue_delete_link (&segmenter->closed, item);
+        }
+        g_free (segment_dirname);
+        item = next;
+    }
+}
+
+
+static gboolean
+_segmenter_is_full (GDigicamCamerabinSegmenter *segmenter)
+{
+    gdouble seconds;
+    gboolean moving;
+
+    g_mutex_lock (segmenter->lock);
+    moving = segmenter->moving;
+    g_mutex_unlock (segmenter->lock);
+
+    if (moving) {
+        return TRUE;
+    }
+
+    if ((0 < segmenter->max_bytes) &&
+        (segmenter->written >= segmenter->max_bytes)) {
+        return TRUE;
+    }
+
+    if (0 == segmenter->duration) {
+        return FALSE;
+    }
+
+    /* Streams without timestamps are recorded in real time anyway */
+    if (!segmenter->timestamped) {
+        seconds = g_timer_elapsed (segmenter->timer, NULL);
+        return seconds * GST_SECOND >= segmenter->duration;
+    }
+
+    return (GST_CLOCK_TIME_IS_VALID (segmenter->start) &&
+            GST_CLOCK_TIME_IS_VALID (segmenter->last) &&
+            (segmenter->last - segmenter->start >= segmenter->duration));
+}
+
+
+static gboolean
+_segmenter_parse (GDigicamCamerabinSegmenter *segmenter,
+                  const guint8 *data,
+                  gsize size,
+                  GError **error)
+{
+    guint needed;
+    gsize length;
+
+    while (0 < size) {
+        if (0 == segmenter->box_left) {
+            /* The header of the next box, which may come in pieces */
+            needed = BOX_HEADER_SIZE;
+            if ((BOX_HEADER_SIZE <= segmenter->header_size) &&
+                (1 == GST_READ_UINT32_BE (segmenter->header))) {
+                needed = BOX_LARGE_HEADER_SIZE;
+            }
+
+            length = MIN (size, needed - segmenter->header_size);
+            memcpy (segmenter->header + segmenter->header_size, data, length);
+            segmenter->header_size += length;
+            data += length;
+            size -= length;
+
+            if ((segmenter->header_size < needed) ||
+                ((BOX_HEADER_SIZE == needed) &&
+                 (1 == GST_READ_UINT32_BE (segmenter->header)))) {
+                continue;
+            }
+
+            if (!_segmenter_box_start (segmenter, error)) {
+                return FALSE;
+            }
+            continue;
+        }
+
+        length = (gsize) MIN ((guint64) size, segmenter->box_left);
+        if (segmenter->moof_held) {
+            g_byte_array_append (segmenter->moof, data, length);
+        } else {
+            if (!segmenter->fragmented) {
+                g_byte_array_append (segmenter->init, data, length);
+            }
+            if (segmenter->box_kept &&
+                !_segmenter_write (segmenter, data, length, error)) {
+                return FALSE;
+            }
+        }
+        if (BOX_TO_THE_END != segmenter->box_left) {
+            segmenter->box_left -= length;
+        }
+        data += length;
+        size -= length;
+
+        if (segmenter->moof_held && (0 == segmenter->box_left) &&
+            !_segmenter_moof_end (segmenter, error)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+static gboolean
+_segmenter_box_start (GDigicamCamerabinSegmenter *segmenter,
+                      GError **error)
+{
+    guint64 box_size;
+    guint32 type;
+
+    box_size = GST_READ_UINT32_BE (segmenter->header);
+    type = GST_READ_UINT32_LE (segmenter->header + 4);
+    if (1 == box_size) {
+        box_size = GST_READ_UINT64_BE (segmenter->header + BOX_HEADER_SIZE);
+    }
+
+    if ((0 == box_size) || (box_size < segmenter->header_size)) {
+        /* Up to the end of the stream, or something we don't
+         * understand: no more cuts */
+        segmenter->box_left = BOX_TO_THE_END;
+    } else {
+        segmenter->box_left = box_size - segmenter->header_size;
+    }
+
+    if (GST_MAKE_FOURCC ('m', 'o', 'o', 'f') == type) {
+        if (!segmenter->fragmented) {
+            segmenter->fragmented = TRUE;
+            _segmenter_find_video_track (segmenter);
+        }
+
+        /* Held until it is known whether the stream can be cut
+         * before it */
+        if (MOOF_MAX_SIZE >= segmenter->box_left) {
+            g_byte_array_set_size (segmenter->moof, 0);
+            g_byte_array_append (segmenter->moof, segmenter->header,
+                                 segmenter->header_size);
+            segmenter->moof_held = TRUE;
+            segmenter->header_size = 0;
+
+            if (0 == segmenter->box_left) {
+                return _segmenter_moof_end (segmenter, error);
+            }
+            return TRUE;
+        }
+    }
+
+    segmenter->box_kept = (GST_MAKE_FOURCC ('m', 'f', 'r', 'a') != type);
+
+    if (!segmenter->fragmented) {
+        g_byte_array_append (segmenter->init, segmenter->header,
+                             segmenter->header_size);
+    }
+    if (segmenter->box_kept &&
+        !_segmenter_write (segmenter, segmenter->header,
+                           segmenter->header_size, error)) {
+        return FALSE;
+    }
+
+    /* An empty box */
+    segmenter->header_size = 0;
+
+    return TRUE;
+}
+
+
+static gboolean
+_segmenter_moof_end (GDigicamCamerabinSegmenter *segmenter,
+                     GError **error)
+{
+    segmenter->moof_held = FALSE;
+
+    if (_segmenter_is_full (segmenter) &&
+        _segmenter_starts_at_keyframe (segmenter)) {
+        _segmenter_close (segmenter);
+        if (!_segmenter_open (segmenter, error)) {
+            return FALSE;
+        }
+    }
+
+    return _segmenter_write (segmenter, segmenter->moof->data,
+                             segmenter->moof->len, error);
+}
+
+
+static void
+_segmenter_find_video_track (GDigicamCamerabinSegmenter *segmenter)
+{
+    const guint8 *moov = NULL;
+    const guint8 *data = NULL;
+    const guint8 *trak = NULL;
+    const guint8 *tkhd = NULL;
+    const guint8 *mdia = NULL;
+    const guint8 *hdlr = NULL;
+    const guint8 *mvex = NULL;
+    const guint8 *trex = NULL;
+    gsize moov_size, size, trak_size, tkhd_size, mdia_size, hdlr_size;
+    gsize mvex_size, trex_size;
+    guint32 type;
+    guint offset;
+
+    moov = _box_find (segmenter->init->data, segmenter->init->len,
+                      GST_MAKE_FOURCC ('m', 'o', 'o', 'v'), &moov_size);
+    if (NULL == moov) {
+        return;
+    }
+
+    /* The track handled as video, its ID follows the times, which
+     * are bigger in the version 1 of tkhd */
+    data = moov;
+    size = moov_size;
+    while (_box_next (&data, &size, &type, &trak, &trak_size)) {
+        if (GST_MAKE_FOURCC ('t', 'r', 'a', 'k') != type) {
+            continue;
+        }
+        tkhd = _box_find (trak, trak_size,
+                          GST_MAKE_FOURCC ('t', 'k', 'h', 'd'), &tkhd_size);
+        mdia = _box_find (trak, trak_size,
+                          GST_MAKE_FOURCC ('m', 'd', 'i', 'a'), &mdia_size);
+        hdlr = NULL;
+        if (NULL != mdia) {
+            hdlr = _box_find (mdia, mdia_size,
+                              GST_MAKE_FOURCC ('h', 'd', 'l', 'r'),
+                              &hdlr_size);
+        }
+        if ((NULL == tkhd) || (4 > tkhd_size) ||
+            (NULL == hdlr) || (12 > hdlr_size) ||
+            (GST_MAKE_FOURCC ('v', 'i', 'd', 'e') !=
+             GST_READ_UINT32_LE (hdlr + 8))) {
+            continue;
+        }
+        offset = (1 == tkhd[0]) ? 20 : 12;
+        if (offset + 4 <= tkhd_size) {
+            segmenter->video_track = GST_READ_UINT32_BE (tkhd + offset);
+            break;
+        }
+    }
+
+    if (0 == segmenter->video_track) {
+        return;
+    }
+
+    mvex = _box_find (moov, moov_size,
+                      GST_MAKE_FOURCC ('m', 'v', 'e', 'x'), &mvex_size);
+    if (NULL == mvex) {
+        return;
+    }
+
+    data = mvex;
+    size = mvex_size;
+    while (_box_next (&data, &size, &type, &trex, &trex_size)) {
+        if ((GST_MAKE_FOURCC ('t', 'r', 'e', 'x') == type) &&
+            (24 <= trex_size) &&
+            (segmenter->video_track == GST_READ_UINT32_BE (trex + 4))) {
+            segmenter->video_flags = GST_READ_UINT32_BE (trex + 20);
+        }
+    }
+}
+
+
+static gboolean
+_segmenter_starts_at_keyframe (GDigicamCamerabinSegmenter *segmenter)
+{
+    const guint8 *data = NULL;
+    const guint8 *moof = NULL;
+    const guint8 *traf = NULL;
+    const guint8 *tfhd = NULL;
+    const guint8 *trun = NULL;
+    gsize size, moof_size, traf_size, tfhd_size, trun_size;
+    guint32 type, flags, sample_flags;
+    guint offset;
+
+    data = segmenter->moof->data;
+    size = segmenter->moof->len;
+    if (!_box_next (&data, &size, &type, &moof, &moof_size)) {
+        return FALSE;
+    }
+
+    /* The first sample of the video, or of the first track if the
+     * video one is unknown */
+    data = moof;
+    size = moof_size;
+    while (_box_next (&data, &size, &type, &traf, &traf_size)) {
+        if (GST_MAKE_FOURCC ('t', 'r', 'a', 'f') != type) {
+            continue;
+        }
+
+        tfhd = _box_find (traf, traf_size,
+                          GST_MAKE_FOURCC ('t', 'f', 'h', 'd'), &tfhd_size);
+        if ((NULL == tfhd) || (8 > tfhd_size) ||
+            ((0 != segmenter->video_track) &&
+             (segmenter->video_track != GST_READ_UINT32_BE (tfhd + 4)))) {
+            continue;
+        }
+
+        sample_flags = segmenter->video_flags;
+        flags = GST_READ_UINT32_BE (tfhd) & 0xffffff;
+        offset = 8;
+        if (flags & TFHD_BASE_DATA_OFFSET) {
+            offset += 8;
+        }
+        if (flags & TFHD_SAMPLE_DESCRIPTION_INDEX) {
+            offset += 4;
+        }
+        if (flags & TFHD_DEFAULT_SAMPLE_DURATION) {
+            offset += 4;
+        }
+        if (flags & TFHD_DEFAULT_SAMPLE_SIZE) {
+            offset += 4;
+        }
+        if (flags & TFHD_DEFAULT_SAMPLE_FLAGS) {
+            if (offset + 4 > tfhd_size) {
+                return FALSE;
+            }
+            sample_flags = GST_READ_UINT32_BE (tfhd + offset);
+        }
+
+        trun = _box_find (traf, traf_size,
+                          GST_MAKE_FOURCC ('t', 'r', 'u', 'n'), &trun_size);
+        if ((NULL == trun) || (8 > trun_size) ||
+            (0 == GST_READ_UINT32_BE (trun + 4))) {
+            return FALSE;
+        }
+
+        flags = GST_READ_UINT32_BE (trun) & 0xffffff;
+        offset = 8;
+        if (flags & TRUN_DATA_OFFSET) {
+            offset += 4;
+        }
+        if (flags & TRUN_FIRST_SAMPLE_FLAGS) {
+            if (offset + 4 > trun_size) {
+                return FALSE;
+            }
+            sample_flags = GST_READ_UINT32_BE (trun + offset);
+        } else if (flags & TRUN_SAMPLE_FLAGS) {
+            if (flags & TRUN_SAMPLE_DURATION) {
+                offset += 4;
+            }
+            if (flags & TRUN_SAMPLE_SIZE) {
+                offset += 4;
+            }
+            if (offset + 4 > trun_size) {
+                return FALSE;
+            }
+            sample_flags = GST_READ_UINT32_BE (trun + offset);
+        }
+
+        return (0 == (sample_flags & SAMPLE_IS_NON_SYNC));
+    }
+
+    return FALSE;
+}
+
+
+static gboolean
+_box_next (const guint8 **data,
+           gsize *size,
+           guint32 *type,
+           const guint8 **payload,
+           gsize *payload_size)
+{
+    guint64 box_size;
+    guint header_size = BOX_HEADER_SIZE;
+
+    if (BOX_HEADER_SIZE > *size) {
+        return FALSE;
+    }
+
+    box_size = GST_READ_UINT32_BE (*data);
+    *type = GST_READ_UINT32_LE (*data + 4);
+    if (1 == box_size) {
+        if (BOX_LARGE_HEADER_SIZE > *size) {
+            return FALSE;
+        }
+        box_size = GST_READ_UINT64_BE (*data + BOX_HEADER_SIZE);
+        header_size = BOX_LARGE_HEADER_SIZE;
+    } else if (0 == box_size) {
+        box_size = *size;
+    }
+
+    if ((box_size < header_size) || (box_size > *size)) {
+        return FALSE;
+    }
+
+    *payload = *data + header_size;
+    *payload_size = box_size - header_size;
+    *data += box_size;
+    *size -= box_size;
+
+    return TRUE;
+}
+
+
+static const guint8 *
+_box_find (const guint8 *data,
+           gsize size,
+           guint32 type,
+           gsize *payload_size)
+{
+    const guint8 *payload = NULL;
+    guint32 found;
+
+    while (_box_next (&data, &size, &found, &payload, payload_size)) {
+        if (type == found) {
+            return payload;
+        }
+    }
+
+    return NULL;
+}
+
+
+static gboolean
+_segmenter_write (GDigicamCamerabinSegmenter *segmenter,
+                  const guint8 *data,
+                  gsize size,
+                  GError **error)
+{
+    gssize written;
+    gint saved_errno;
+
+    if (NULL != segmenter->writeback) {
+        _g_digicam_camerabin_writeback_written (segmenter->writeback, size);
+    }
+
+    while (0 < size) {
+        written = write (segmenter->fd, data, size);
+        if (0 > written) {
+            saved_errno = errno;
+            if (EINTR == saved_errno) {
+                continue;
+            }
+            g_set_error (error, G_FILE_ERROR,
+                         g_file_error_from_errno (saved_errno),
+                         "Unable to write %s: %s",
+                         segmenter->current, g_strerror (saved_errno));
+            _segmenter_close (segmenter);
+            return FALSE;
+        }
+        segmenter->written += written;
+        data += written;
+        size -= written;
+    }
+
+    return TRUE;
+}
+
+
+static gchar *
+_segment_filename (const gchar *filename,
+                   guint count)
+{
+    const gchar *basename = NULL;
+    const gchar *extension = NULL;
+    gchar *stem = NULL;
+    gchar *result = NULL;
+
+    if (1 == count) {
+        return g_strdup (filename);
+    }
+
+    basename = strrchr (filename, G_DIR_SEPARATOR);
+    basename = (NULL != basename) ? basename + 1 : filename;
+    extension = strrchr (basename, '.');
+    if ((NULL == extension) || (basename == extension)) {
+        extension = basename + strlen (basename);
+    }
+
+    stem = g_strndup (filename, extension - filename);
+    result = g_strdup_printf ("%s-%03u%s", stem, count, extension);
+    g_free (stem);
+
+    return result;
+}
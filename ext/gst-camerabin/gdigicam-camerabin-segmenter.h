@@ -0,0 +1,67 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef _G_DIGICAM_CAMERABIN_SEGMENTER_H_
+#define _G_DIGICAM_CAMERABIN_SEGMENTER_H_
+
+#include <gst/gst.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * GDigicamCamerabinSegmenter:
+ *
+ * Splitter of a fragmented recording into several files, each one
+ * playable on its own.
+ */
+    typedef struct _GDigicamCamerabinSegmenter GDigicamCamerabinSegmenter;
+
+
+    GDigicamCamerabinSegmenter *_g_digicam_camerabin_segmenter_new (const gchar   *filename,
+                                                                    GstClockTime   duration,
+                                                                    guint64        max_bytes,
+                                                                    guint64        reserved,
+                                                                    gsize          window,
+                                                                    GError       **error);
+    gboolean _g_digicam_camerabin_segmenter_push (GDigicamCamerabinSegmenter  *segmenter,
+                                                  GstBuffer                   *buffer,
+                                                  GError                     **error);
+    void _g_digicam_camerabin_segmenter_seek (GDigicamCamerabinSegmenter *segmenter,
+                                              guint64                     offset);
+    void _g_digicam_camerabin_segmenter_set_directory (GDigicamCamerabinSegmenter *segmenter,
+                                                       const gchar                *directory);
+    gboolean _g_digicam_camerabin_segmenter_makes_room (GDigicamCamerabinSegmenter *segmenter,
+                                                        const gchar                *directory);
+    guint _g_digicam_camerabin_segmenter_get_count (GDigicamCamerabinSegmenter *segmenter);
+    void _g_digicam_camerabin_segmenter_finish (GDigicamCamerabinSegmenter *segmenter);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,314 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+
+/*
+ * Freedesktop.org thumbnails made from the capture preview.
+ *
+ * The thumbnails are written as described in the Thumbnail Managing
+ * Standard, so file managers and galleries find them in the cache
+ * instead of decoding the full resolution picture. All the work is
+ * done in a single low priority thread, out of the capture path.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-thumbnail.h"
+#include "gdigicam-camerabin-scale.h"
+#include "gdigicam-debug.h"
+
+#define G_DIGICAM_CAMERABIN_THUMBNAIL_DIR "thumbnails"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+typedef struct _ThumbnailJob {
+    GdkPixbuf *preview;
+    gchar *filename;
+    GDigicamThumbnail mode;
+} ThumbnailJob;
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static gpointer _thumbnail_pool_new (gpointer data);
+static void _thumbnail_job_free (ThumbnailJob *job);
+static void _thumbnail_write (gpointer data,
+                              gpointer user_data);
+static gboolean _thumbnail_save (GdkPixbuf   *thumbnail,
+                                 const gchar *flavour,
+                                 const gchar *md5,
+                                 const gchar *uri,
+                                 const gchar *mtime);
+
+static GOnce thumbnail_pool_once = G_ONCE_INIT;
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_thumbnail_save:
+ * @preview: The preview of the picture.
+ * @filename: The file the picture has been saved to.
+ * @mode: The #GDigicamThumbnail flags with the thumbnails to write.
+ *
+ * Queues the writing of the thumbnails of @filename, made from
+ * @preview. It returns immediately, the thumbnails are written in
+ * the background.
+ **/
+void
+_g_digicam_camerabin_thumbnail_save (GdkPixbuf         *preview,
+                                     const gchar       *filename,
+                                     GDigicamThumbnail  mode)
+{
+    ThumbnailJob *job = NULL;
+    GThreadPool *pool = NULL;
+
+    g_return_if_fail (GDK_IS_PIXBUF (preview));
+    g_return_if_fail (NULL != filename);
+
+    if (G_DIGICAM_THUMBNAIL_NONE == mode) {
+        return;
+    }
+
+    pool = g_once (&thumbnail_pool_once, _thumbnail_pool_new, NULL);
+    if (NULL == pool) {
+        return;
+    }
+
+    job = g_slice_new0 (ThumbnailJob);
+    job->preview = g_object_ref (preview);
+    job->filename = g_strdup (filename);
+    job->mode = mode;
+
+    g_thread_pool_push (pool, job, NULL);
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static gpointer
+_thumbnail_pool_new (gpointer data)
+{
+    GThreadPool *pool = NULL;
+    GError *error = NULL;
+
+    /* One thread is enough, and keeps the jobs in capture order */
+    pool = g_thread_pool_new (_thumbnail_write, NULL, 1, FALSE, &error);
+    if (NULL == pool) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to create the "
+                        "thumbnailing thread: %s", error->message);
+        g_error_free (error);
+    }
+
+    return pool;
+}
+
+
+static void
+_thumbnail_job_free (ThumbnailJob *job)
+{
+    g_object_unref (job->preview);
+    g_free (job->filename);
+    g_slice_free (ThumbnailJob, job);
+}
+
+
+static void
+_thumbnail_write (gpointer data,
+                  gpointer user_data)
+{
+    ThumbnailJob *job = NULL;
+    GdkPixbuf *thumbnails[2] = { NULL, NULL };
+    GDigicamCamerabinScaleTarget targets[2];
+    const gchar *flavours[2];
+    struct stat st;
+    gchar *path = NULL;
+    gchar *current_dir = NULL;
+    gchar *uri = NULL;
+    gchar *md5 = NULL;
+    gchar *mtime = NULL;
+    GError *error = NULL;
+    gint src_w, src_h;
+    guint box, n, i;
+
+    job = (ThumbnailJob *) data;
+
+    TSTAMP (gst-before-thumbnail);
+
+    /* The URI has to be the one of the absolute path */
+    if (g_path_is_absolute (job->filename)) {
+        path = g_strdup (job->filename);
+    } else {
+        current_dir = g_get_current_dir ();
+        path = g_build_filename (current_dir, job->filename, NULL);
+        g_free (current_dir);
+    }
+
+    uri = g_filename_to_uri (path, NULL, &error);
+    if (NULL == uri) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: no thumbnail for %s: %s",
+                        path, error->message);
+        goto free;
+    }
+
+    /* Thumbnails are only valid for the modification time they
+     * were made for */
+    if (0 != g_stat (path, &st)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: no thumbnail for %s: %s",
+                        path, g_strerror (errno));
+        goto free;
+    }
+    mtime = g_strdup_printf ("%lu", (gulong) st.st_mtime);
+    md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+
+    /* Both sizes are made in the same pass over the preview */
+    src_w = gdk_pixbuf_get_width (job->preview);
+    src_h = gdk_pixbuf_get_height (job->preview);
+    n = 0;
+    for (i = 0; i < G_N_ELEMENTS (thumbnails); i++) {
+        if (0 == i) {
+            if (!(job->mode & G_DIGICAM_THUMBNAIL_NORMAL)) {
+                continue;
+            }
+            box = G_DIGICAM_CAMERABIN_THUMBNAIL_NORMAL_SIZE;
+            flavours[n] = "normal";
+        } else {
+            if (!(job->mode & G_DIGICAM_THUMBNAIL_LARGE)) {
+                continue;
+            }
+            box = G_DIGICAM_CAMERABIN_THUMBNAIL_LARGE_SIZE;
+            flavours[n] = "large";
+        }
+
+        _g_digicam_camerabin_scale_fit (src_w, src_h, box, box,
+                                        &targets[n].width,
+                                        &targets[n].height);
+        thumbnails[n] = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
+                                        gdk_pixbuf_get_has_alpha (job->preview),
+                                        8,
+                                        targets[n].width,
+                                        targets[n].height);
+        targets[n].pixels = gdk_pixbuf_get_pixels (thumbnails[n]);
+        targets[n].stride = gdk_pixbuf_get_rowstride (thumbnails[n]);
+        n++;
+    }
+
+    _g_digicam_camerabin_scale_box (gdk_pixbuf_get_pixels (job->preview),
+                                    src_w, src_h,
+                                    gdk_pixbuf_get_rowstride (job->preview),
+                                    gdk_pixbuf_get_n_channels (job->preview),
+                                    targets, n);
+
+    for (i = 0; i < n; i++) {
+        _thumbnail_save (thumbnails[i], flavours[i], md5, uri, mtime);
+        g_object_unref (thumbnails[i]);
+    }
+
+    TSTAMP (gst-after-thumbnail);
+
+free:
+    if (NULL != error) {
+        g_error_free (error);
+    }
+    g_free (mtime);
+    g_free (md5);
+    g_free (uri);
+    g_free (path);
+    _thumbnail_job_free (job);
+}
+
+
+static gboolean
+_thumbnail_save (GdkPixbuf   *thumbnail,
+                 const gchar *flavour,
+                 const gchar *md5,
+                 const gchar *uri,
+                 const gchar *mtime)
+{
+    gchar *dir = NULL;
+    gchar *name = NULL;
+    gchar *path = NULL;
+    gchar *tmp_path = NULL;
+    GError *error = NULL;
+    gboolean result = FALSE;
+
+    dir = g_build_filename (g_get_home_dir (),
+                            "." G_DIGICAM_CAMERABIN_THUMBNAIL_DIR,
+                            flavour, NULL);
+    if (0 != g_mkdir_with_parents (dir, 0700)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to create %s: %s",
+                        dir, g_strerror (errno));
+        goto free;
+    }
+
+    name = g_strconcat (md5, ".png", NULL);
+    path = g_build_filename (dir, name, NULL);
+
+    /* Readers must never see a partially written thumbnail */
+    tmp_path = g_strdup_printf ("%s.gdigicam-%u", path, (guint) getpid ());
+    if (!gdk_pixbuf_save (thumbnail, tmp_path, "png", &error,
+                          "tEXt::Thumb::URI", uri,
+                          "tEXt::Thumb::MTime", mtime,
+                          "tEXt::Software", PACKAGE,
+                          NULL)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to write %s: %s",
+                        tmp_path, error->message);
+        g_error_free (error);
+        g_unlink (tmp_path);
+        goto free;
+    }
+
+    g_chmod (tmp_path, 0600);
+    if (0 != g_rename (tmp_path, path)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to write %s: %s",
+                        path, g_strerror (errno));
+        g_unlink (tmp_path);
+        goto free;
+    }
+
+    result = TRUE;
+
+free:
+    g_free (tmp_path);
+    g_free (path);
+    g_free (name);
+    g_free (dir);
+
+    return result;
+}
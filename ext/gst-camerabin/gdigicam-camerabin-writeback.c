@@ -0,0 +1,240 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+
+/*
+ * Streaming writeback of the video recordings.
+ *
+ * A long recording is written once and never read back by us, but it
+ * goes through the page cache like any other file: it piles up dirty
+ * until the kernel decides to flush a lot of it at once, stalling the
+ * writes, and then stays cached, evicting the application. So the file
+ * is flushed as it grows instead, in windows of a fixed size: the
+ * writeback of a window is started as soon as it is complete, and the
+ * window before it, which had a whole window of time to get to the
+ * disk, is waited for and dropped from the cache. At most a few
+ * windows are ever dirty, and the disk is kept busy at a steady pace.
+ *
+ * The writes themselves are done by somebody else, the file sink, and
+ * are seen a bit earlier than they reach the file, so the window just
+ * written is left alone.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-writeback.h"
+#include "gdigicam-debug.h"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+struct _GDigicamCamerabinWriteback {
+    gint fd;
+    gsize window;
+    /* Bytes given to the file */
+    guint64 written;
+    /* Up to where the writeback has been started */
+    guint64 started;
+    /* Up to where the file is on disk and out of the cache */
+    guint64 dropped;
+};
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static void _writeback_start (GDigicamCamerabinWriteback *writeback,
+                              guint64 offset,
+                              guint64 length);
+static void _writeback_drop (GDigicamCamerabinWriteback *writeback,
+                             guint64 offset,
+                             guint64 length);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_writeback_new:
+ * @filename: The file being written, which must exist.
+ * @window: Bytes flushed at once.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Starts flushing @filename as it grows from its current end.
+ *
+ * Returns: the new #GDigicamCamerabinWriteback, or #NULL if the file
+ * can't be opened.
+ **/
+GDigicamCamerabinWriteback *
+_g_digicam_camerabin_writeback_new (const gchar  *filename,
+                                    gsize         window,
+                                    GError      **error)
+{
+    GDigicamCamerabinWriteback *writeback = NULL;
+    struct stat buf;
+    gint saved_errno;
+    gint fd;
+
+    g_return_val_if_fail (NULL != filename, NULL);
+    g_return_val_if_fail (0 < window, NULL);
+
+    fd = g_open (filename, O_RDONLY, 0);
+    if (0 > fd) {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR,
+                     g_file_error_from_errno (saved_errno),
+                     "Unable to open %s: %s",
+                     filename, g_strerror (saved_errno));
+        return NULL;
+    }
+
+    writeback = g_slice_new0 (GDigicamCamerabinWriteback);
+    writeback->fd = fd;
+    writeback->window = window;
+
+    /* The muxer may have written the headers already, they are
+     * rewritten at the end anyway */
+    if (0 == fstat (fd, &buf)) {
+        writeback->written = buf.st_size;
+    }
+
+    return writeback;
+}
+
+
+/**
+ * _g_digicam_camerabin_writeback_written:
+ * @writeback: A #GDigicamCamerabinWriteback.
+ * @size: Bytes which are going to be appended to the file.
+ *
+ * Accounts the bytes going to the file, flushing the windows which
+ * are complete. It waits for the disk when it is slower than the
+ * file grows, so it should be called from the thread writing the
+ * file.
+ **/
+void
+_g_digicam_camerabin_writeback_written (GDigicamCamerabinWriteback *writeback,
+                                        gsize                       size)
+{
+    g_return_if_fail (NULL != writeback);
+
+    writeback->written += size;
+
+    /* The last window may not be in the file yet */
+    while (writeback->started + 2 * writeback->window <= writeback->written) {
+        _writeback_start (writeback, writeback->started, writeback->window);
+        writeback->started += writeback->window;
+
+        if (writeback->dropped + 2 * writeback->window <= writeback->started) {
+            _writeback_drop (writeback, writeback->dropped,
+                             writeback->window);
+            writeback->dropped += writeback->window;
+        }
+    }
+}
+
+
+/**
+ * _g_digicam_camerabin_writeback_finish:
+ * @writeback: A #GDigicamCamerabinWriteback.
+ *
+ * Starts the writeback of the rest of the file, drops what is already
+ * on disk from the cache, and frees @writeback. It doesn't wait for
+ * the disk.
+ **/
+void
+_g_digicam_camerabin_writeback_finish (GDigicamCamerabinWriteback *writeback)
+{
+    g_return_if_fail (NULL != writeback);
+
+    /* Up to the end of the file */
+    _writeback_start (writeback, writeback->dropped, 0);
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise (writeback->fd, writeback->dropped, 0,
+                   POSIX_FADV_DONTNEED);
+#endif
+
+    close (writeback->fd);
+    g_slice_free (GDigicamCamerabinWriteback, writeback);
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static void
+_writeback_start (GDigicamCamerabinWriteback *writeback,
+                  guint64 offset,
+                  guint64 length)
+{
+#ifdef HAVE_SYNC_FILE_RANGE
+    if (0 != sync_file_range (writeback->fd, offset, length,
+                              SYNC_FILE_RANGE_WRITE)) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: unable to start the "
+                         "writeback: %s", g_strerror (errno));
+    }
+#endif
+}
+
+
+static void
+_writeback_drop (GDigicamCamerabinWriteback *writeback,
+                 guint64 offset,
+                 guint64 length)
+{
+#ifdef HAVE_SYNC_FILE_RANGE
+    if (0 != sync_file_range (writeback->fd, offset, length,
+                              SYNC_FILE_RANGE_WAIT_BEFORE |
+                              SYNC_FILE_RANGE_WRITE |
+                              SYNC_FILE_RANGE_WAIT_AFTER)) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: unable to wait for the "
+                         "writeback: %s", g_strerror (errno));
+    }
+#else
+    /* The whole file, but only what is still dirty */
+    fdatasync (writeback->fd);
+#endif
+
+#ifdef HAVE_POSIX_FADVISE
+    /* Only the clean pages go, so it is harmless if some are not on
+     * disk yet */
+    posix_fadvise (writeback->fd, offset, length, POSIX_FADV_DONTNEED);
+#endif
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+
+#ifndef _G_DIGICAM_CAMERABIN_WRITEBACK_H_
+#define _G_DIGICAM_CAMERABIN_WRITEBACK_H_
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * GDigicamCamerabinWriteback:
+ *
+ * Steady writeback of a file which is being written, keeping it out of
+ * the page cache once it is on disk.
+ */
+    typedef struct _GDigicamCamerabinWriteback GDigicamCamerabinWriteback;
+
+
+    GDigicamCamerabinWriteback *_g_digicam_camerabin_writeback_new (const gchar  *filename,
+                                                                    gsize         window,
+                                                                    GError      **error);
+    void _g_digicam_camerabin_writeback_written (GDigicamCamerabinWriteback *writeback,
+                                                 gsize                       size);
+    void _g_digicam_camerabin_writeback_finish (GDigicamCamerabinWriteback *writeback);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,460 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Asynchronous and durable saving of the captured files.
+ *
+ * A slow card must stall neither the capture nor the streaming
+ * threads, so the files are handed to a thread of their own. Each file
+ * is written to a temporary one next to it, synced, and renamed over
+ * the final name, which is then never seen half written, not even
+ * after a power cut. The files given while the thread was busy are
+ * written as a batch: all of them first, then all the syncs, so the
+ * card commits them together, and a single sync of each directory
+ * makes all the renames durable. Only then the files are reported as
+ * saved.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-writer.h"
+#include "gdigicam-debug.h"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+struct _GDigicamCamerabinWriter {
+    GThread *thread;
+    GMutex *lock;
+    GCond *cond;
+    guint batch;
+    /* Files given and not written yet, oldest first */
+    GQueue jobs;
+    /* Files given and not reported yet, including the batch in
+     * progress */
+    guint pending;
+    gboolean stopping;
+};
+
+typedef struct _WriterJob {
+    gchar *filename;
+    GList *buffers;
+    GDigicamCamerabinWriterDoneFunc func;
+    gpointer user_data;
+    GDestroyNotify notify;
+    gchar *tmp_path;
+    gint fd;
+    GError *error;
+} WriterJob;
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static gpointer _writer_thread (GDigicamCamerabinWriter *writer);
+static void _writer_write_batch (GList *batch);
+static void _writer_job_write (WriterJob *job);
+static void _writer_job_sync (WriterJob *job);
+static void _writer_job_rename (WriterJob *job);
+static void _writer_job_fail (WriterJob *job,
+                              const gchar *action,
+                              gint saved_errno);
+static void _writer_job_free (WriterJob *job);
+static void _writer_sync_dir (const gchar *dir);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_writer_new:
+ * @batch: The maximum number of files synced together.
+ * @error: Return location for a #GError, or #NULL.
+ *
+ * Creates a file writer and its thread.
+ *
+ * Returns: A new #GDigicamCamerabinWriter, or #NULL if the thread
+ * could not be created.
+ **/
+GDigicamCamerabinWriter *
+_g_digicam_camerabin_writer_new (guint    batch,
+                                 GError **error)
+{
+    GDigicamCamerabinWriter *writer = NULL;
+
+    g_return_val_if_fail (0 < batch, NULL);
+
+    writer = g_slice_new0 (GDigicamCamerabinWriter);
+    writer->lock = g_mutex_new ();
+    writer->cond = g_cond_new ();
+    writer->batch = batch;
+    g_queue_init (&writer->jobs);
+
+    writer->thread = g_thread_create ((GThreadFunc) _writer_thread, writer,
+                                      TRUE, error);
+    if (NULL == writer->thread) {
+        g_cond_free (writer->cond);
+        g_mutex_free (writer->lock);
+        g_slice_free (GDigicamCamerabinWriter, writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+
+/**
+ * _g_digicam_camerabin_writer_free:
+ * @writer: A #GDigicamCamerabinWriter.
+ *
+ * Waits for all the given files to be saved and frees @writer.
+ **/
+void
+_g_digicam_camerabin_writer_free (GDigicamCamerabinWriter *writer)
+{
+    if (NULL == writer) {
+        return;
+    }
+
+    g_mutex_lock (writer->lock);
+    writer->stopping = TRUE;
+    g_cond_broadcast (writer->cond);
+    g_mutex_unlock (writer->lock);
+
+    g_thread_join (writer->thread);
+
+    g_cond_free (writer->cond);
+    g_mutex_free (writer->lock);
+    g_slice_free (GDigicamCamerabinWriter, writer);
+}
+
+
+/**
+ * _g_digicam_camerabin_writer_push:
+ * @writer: A #GDigicamCamerabinWriter.
+ * @filename: The file to save.
+ * @buffers: The #GstBuffer<!-- -->s with the contents of the file, in
+ * order. @writer takes ownership of the list and the buffers.
+ * @func: Function called once the file is saved.
+ * @user_data: Data to pass to @func.
+ * @notify: Function to free @user_data afterwards, or #NULL.
+ *
+ * Gives a file to save. It returns immediately.
+ **/
+void
+_g_digicam_camerabin_writer_push (GDigicamCamerabinWriter        *writer,
+                                  const gchar                    *filename,
+                                  GList                          *buffers,
+                                  GDigicamCamerabinWriterDoneFunc func,
+                                  gpointer                        user_data,
+                                  GDestroyNotify                  notify)
+{
+    WriterJob *job = NULL;
+
+    g_return_if_fail (NULL != writer);
+    g_return_if_fail (NULL != filename);
+
+    job = g_slice_new0 (WriterJob);
+    job->filename = g_strdup (filename);
+    job->buffers = buffers;
+    job->func = func;
+    job->user_data = user_data;
+    job->notify = notify;
+    job->fd = -1;
+
+    g_mutex_lock (writer->lock);
+    g_queue_push_tail (&writer->jobs, job);
+    writer->pending++;
+    g_cond_broadcast (writer->cond);
+    g_mutex_unlock (writer->lock);
+}
+
+
+/**
+ * _g_digicam_camerabin_writer_get_pending:
+ * @writer: A #GDigicamCamerabinWriter.
+ *
+ * Gets the number of files given and not saved yet.
+ *
+ * Returns: The number of pending files.
+ **/
+guint
+_g_digicam_camerabin_writer_get_pending (GDigicamCamerabinWriter *writer)
+{
+    guint pending;
+
+    g_return_val_if_fail (NULL != writer, 0);
+
+    g_mutex_lock (writer->lock);
+    pending = writer->pending;
+    g_mutex_unlock (writer->lock);
+
+    return pending;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static gpointer
+_writer_thread (GDigicamCamerabinWriter *writer)
+{
+    GList *batch = NULL;
+    WriterJob *job = NULL;
+    guint n;
+
+    g_mutex_lock (writer->lock);
+
+    while (TRUE) {
+        while (g_queue_is_empty (&writer->jobs) && !writer->stopping) {
+            g_cond_wait (writer->cond, writer->lock);
+        }
+        if (g_queue_is_empty (&writer->jobs)) {
+            break;
+        }
+
+        /* Whatever piled up while the previous batch was written */
+        batch = NULL;
+        for (n = 0; n < writer->batch; n++) {
+            job = g_queue_pop_head (&writer->jobs);
+            if (NULL == job) {
+                break;
+            }
+            batch = g_list_prepend (batch, job);
+        }
+        batch = g_list_reverse (batch);
+
+        g_mutex_unlock (writer->lock);
+        _writer_write_batch (batch);
+        g_list_free (batch);
+        g_mutex_lock (writer->lock);
+
+        writer->pending -= n;
+    }
+
+    g_mutex_unlock (writer->lock);
+
+    return NULL;
+}
+
+
+static void
+_writer_write_batch (GList *batch)
+{
+    GList *dirs = NULL;
+    GList *item = NULL;
+    WriterJob *job = NULL;
+    gchar *dir = NULL;
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: writing %u files",
+                     g_list_length (batch));
+
+    for (item = batch; NULL != item; item = g_list_next (item)) {
+        _writer_job_write (item->data);
+    }
+
+    /* The data of all of them is queued by now, so the syncs after
+     * the first one have little left to wait for */
+    for (item = batch; NULL != item; item = g_list_next (item)) {
+        _writer_job_sync (item->data);
+    }
+
+    for (item = batch; NULL != item; item = g_list_next (item)) {
+        job = item->data;
+        _writer_job_rename (job);
+
+        if (NULL == job->error) {
+            dir = g_path_get_dirname (job->filename);
+            if (NULL == g_list_find_custom (dirs, dir,
+                                            (GCompareFunc) g_strcmp0)) {
+                dirs = g_list_prepend (dirs, dir);
+            } else {
+                g_free (dir);
+            }
+        }
+    }
+
+    /* The renames are durable once their directories are */
+    for (item = dirs; NULL != item; item = g_list_next (item)) {
+        _writer_sync_dir (item->data);
+        g_free (item->data);
+    }
+    g_list_free (dirs);
+
+    TSTAMP (after-writer-batch);
+
+    for (item = batch; NULL != item; item = g_list_next (item)) {
+        job = item->data;
+        if (NULL != job->func) {
+            job->func (job->filename, job->error, job->user_data);
+        }
+        _writer_job_free (job);
+    }
+}
+
+
+static void
+_writer_job_write (WriterJob *job)
+{
+    GstBuffer *buffer = NULL;
+    GList *item = NULL;
+    const guint8 *data = NULL;
+    gsize left;
+    gssize written;
+
+    job->tmp_path = g_strdup_printf ("%s.gdigicam-XXXXXX", job->filename);
+    job->fd = g_mkstemp (job->tmp_path);
+    if (0 > job->fd) {
+        _writer_job_fail (job, "create", errno);
+        return;
+    }
+
+    /* As readable as the files saved by CameraBin */
+    fchmod (job->fd, 0644);
+
+    for (item = job->buffers; NULL != item; item = g_list_next (item)) {
+        buffer = item->data;
+        data = GST_BUFFER_DATA (buffer);
+        left = GST_BUFFER_SIZE (buffer);
+
+        while (0 < left) {
+            written = write (job->fd, data, left);
+            if (0 > written) {
+                if (EINTR == errno) {
+                    continue;
+                }
+                _writer_job_fail (job, "write", errno);
+                return;
+            }
+            data += written;
+            left -= written;
+        }
+    }
+}
+
+
+static void
+_writer_job_sync (WriterJob *job)
+{
+    if (NULL != job->error) {
+        return;
+    }
+
+    if (0 != fsync (job->fd)) {
+        _writer_job_fail (job, "sync", errno);
+        return;
+    }
+
+    if (0 != close (job->fd)) {
+        job->fd = -1;
+        _writer_job_fail (job, "close", errno);
+        return;
+    }
+    job->fd = -1;
+}
+
+
+static void
+_writer_job_rename (WriterJob *job)
+{
+    if (NULL != job->error) {
+        return;
+    }
+
+    if (0 != g_rename (job->tmp_path, job->filename)) {
+        _writer_job_fail (job, "rename", errno);
+    }
+}
+
+
+static void
+_writer_job_fail (WriterJob *job,
+                  const gchar *action,
+                  gint saved_errno)
+{
+    g_set_error (&job->error, G_FILE_ERROR,
+                 g_file_error_from_errno (saved_errno),
+                 "Unable to %s %s: %s", action, job->filename,
+                 g_strerror (saved_errno));
+
+    if (0 <= job->fd) {
+        close (job->fd);
+        job->fd = -1;
+    }
+    if (NULL != job->tmp_path) {
+        g_unlink (job->tmp_path);
+    }
+}
+
+
+static void
+_writer_job_free (WriterJob *job)
+{
+    if (NULL != job->notify) {
+        job->notify (job->user_data);
+    }
+    if (0 <= job->fd) {
+        close (job->fd);
+    }
+    if (NULL != job->error) {
+        g_error_free (job->error);
+    }
+    g_list_foreach (job->buffers, (GFunc) gst_buffer_unref, NULL);
+    g_list_free (job->buffers);
+    g_free (job->tmp_path);
+    g_free (job->filename);
+    g_slice_free (WriterJob, job);
+}
+
+
+static void
+_writer_sync_dir (const gchar *dir)
+{
+    gint fd;
+
+    fd = g_open (dir, O_RDONLY, 0);
+    if (0 > fd) {
+        return;
+    }
+
+    /* Not every file system syncs directories, the files are
+     * durable anyway */
+    if (0 != fsync (fd)) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: unable to sync %s: %s",
+                         dir, g_strerror (errno));
+    }
+    close (fd);
+}
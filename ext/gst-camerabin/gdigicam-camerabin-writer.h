@@ -0,0 +1,74 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef _G_DIGICAM_CAMERABIN_WRITER_H_
+#define _G_DIGICAM_CAMERABIN_WRITER_H_
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * GDigicamCamerabinWriter:
+ *
+ * A thread saving files out of the streaming threads, each one
+ * replacing the previous file atomically once it is on disk.
+ */
+    typedef struct _GDigicamCamerabinWriter GDigicamCamerabinWriter;
+
+/**
+ * GDigicamCamerabinWriterDoneFunc:
+ * @filename: The saved file.
+ * @error: Why the file was not saved, or #NULL if it was.
+ * @user_data: The data given with the file.
+ *
+ * Called from the writer thread once a file is durably saved, in the
+ * order the files were given.
+ */
+    typedef void (*GDigicamCamerabinWriterDoneFunc) (const gchar  *filename,
+                                                     const GError *error,
+                                                     gpointer      user_data);
+
+
+    GDigicamCamerabinWriter *_g_digicam_camerabin_writer_new (guint    batch,
+                                                              GError **error);
+    void _g_digicam_camerabin_writer_free (GDigicamCamerabinWriter *writer);
+    void _g_digicam_camerabin_writer_push (GDigicamCamerabinWriter        *writer,
+                                           const gchar                    *filename,
+                                           GList                          *buffers,
+                                           GDigicamCamerabinWriterDoneFunc func,
+                                           gpointer                        user_data,
+                                           GDestroyNotify                  notify);
+    guint _g_digicam_camerabin_writer_get_pending (GDigicamCamerabinWriter *writer);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
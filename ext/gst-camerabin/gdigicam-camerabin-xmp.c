@@ -0,0 +1,659 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Metadata written after the picture has been saved.
+ *
+ * When the metadata is deferred, camerabin saves the picture with the
+ * capture data only, and the application metadata is added afterwards
+ * as an XMP packet, in a background thread, so it doesn't delay the
+ * capture. The location, which may not be known yet when the picture
+ * is taken, can be updated later in the same way.
+ */
+
+#include <string.h>
+
+#include <config.h>
+
+#include "gdigicam-camerabin-xmp.h"
+#include "gdigicam-camerabin-metadata.h"
+#include "gdigicam-debug.h"
+
+/* Signature of the XMP APP1 segments, with its trailing NUL */
+#define G_DIGICAM_CAMERABIN_XMP_NS "http://ns.adobe.com/xap/1.0/"
+
+#define JPEG_MARKER_SOI  0xd8
+#define JPEG_MARKER_APP0 0xe0
+#define JPEG_MARKER_APP1 0xe1
+
+/* Pictures whose location can still be updated in the worker */
+#define G_DIGICAM_CAMERABIN_XMP_HISTORY 16
+
+/* Captured pictures kept until they are saved. More than a burst, the
+ * oldest ones are from captures which failed without telling */
+#define G_DIGICAM_CAMERABIN_XMP_PENDING 32
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+typedef struct _XmpRecord {
+    gchar *filename;
+    GDigicamCamerabinMetadata metadata;
+    gchar *date;
+    /* Order of the capture, for the pending ones */
+    guint serial;
+} XmpRecord;
+
+typedef struct _XmpJob {
+    XmpRecord *record;
+    gboolean update;
+    /* Called once the metadata is written */
+    GDigicamCamerabinXmpDoneFunc func;
+    gpointer user_data;
+} XmpJob;
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static gpointer _xmp_pool_new (gpointer data);
+static void _xmp_push (XmpRecord                    *record,
+                       gboolean                      update,
+                       GDigicamCamerabinXmpDoneFunc  func,
+                       gpointer                      user_data);
+static void _xmp_run (gpointer data,
+                      gpointer user_data);
+static XmpRecord *_xmp_record_new (const gchar                     *filename,
+                                   const GDigicamCamerabinMetadata *metadata,
+                                   const gchar                     *date);
+static void _xmp_record_free (XmpRecord *record);
+static void _xmp_record_set_location (XmpRecord                       *record,
+                                      const GDigicamCamerabinMetadata *metadata);
+static void _xmp_record_save (XmpRecord *record);
+static void _xmp_pending_find_oldest (gpointer key,
+                                      gpointer value,
+                                      gpointer user_data);
+static void _append_coordinate (GString     *packet,
+                                const gchar *name,
+                                gdouble      value,
+                                gchar        positive,
+                                gchar        negative);
+
+static GOnce xmp_pool_once = G_ONCE_INIT;
+static GStaticMutex xmp_lock = G_STATIC_MUTEX_INIT;
+
+/* Captured pictures not saved yet, protected by xmp_lock */
+static GHashTable *xmp_pending = NULL;
+static guint xmp_serial = 0;
+
+/* Pictures already written, only used from the worker thread */
+static GQueue xmp_history = G_QUEUE_INIT;
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_camerabin_xmp_prepare:
+ * @filename: The file the picture is going to be saved to.
+ * @metadata: The #GDigicamCamerabinMetadata of the picture.
+ * @date: The capture date, in ISO 8601 format.
+ *
+ * Keeps the metadata of a picture being captured until
+ * _g_digicam_camerabin_xmp_write() is called for it.
+ **/
+void
+_g_digicam_camerabin_xmp_prepare (const gchar                     *filename,
+                                  const GDigicamCamerabinMetadata *metadata,
+                                  const gchar                     *date)
+{
+    XmpRecord *record = NULL;
+    XmpRecord *oldest = NULL;
+
+    g_return_if_fail (NULL != filename);
+    g_return_if_fail (NULL != metadata);
+
+    record = _xmp_record_new (filename, metadata, date);
+
+    g_static_mutex_lock (&xmp_lock);
+    if (NULL == xmp_pending) {
+        xmp_pending = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                             (GDestroyNotify) _xmp_record_free);
+    }
+    record->serial = xmp_serial++;
+    g_hash_table_replace (xmp_pending, record->filename, record);
+    if (G_DIGICAM_CAMERABIN_XMP_PENDING < g_hash_table_size (xmp_pending)) {
+        g_hash_table_foreach (xmp_pending, _xmp_pending_find_oldest, &oldest);
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: %s was never saved, dropping "
+                         "its metadata", oldest->filename);
+        g_hash_table_remove (xmp_pending, oldest->filename);
+    }
+    g_static_mutex_unlock (&xmp_lock);
+}
+
+
+/**
+ * _g_digicam_camerabin_xmp_cancel:
+ * @filename: The file the picture was going to be saved to.
+ *
+ * Drops the metadata kept for @filename with
+ * _g_digicam_camerabin_xmp_prepare(), when its capture failed.
+ **/
+void
+_g_digicam_camerabin_xmp_cancel (const gchar *filename)
+{
+    g_return_if_fail (NULL != filename);
+
+    g_static_mutex_lock (&xmp_lock);
+    if (NULL != xmp_pending) {
+        g_hash_table_remove (xmp_pending, filename);
+    }
+    g_static_mutex_unlock (&xmp_lock);
+}
+
+
+/**
+ * _g_digicam_camerabin_xmp_write:
+ * @filename: The file the picture has been saved to.
+ * @func: Function called from the background thread once the file
+ * is rewritten, or #NULL.
+ * @user_data: Data to pass to @func.
+ *
+ * Queues the writing of the metadata kept for @filename with
+ * _g_digicam_camerabin_xmp_prepare(). It returns immediately, the
+ * file is rewritten in the background.
+ *
+ * Returns: #FALSE if there was no metadata kept for @filename, then
+ * @func is never called, #TRUE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_xmp_write (const gchar                  *filename,
+                                GDigicamCamerabinXmpDoneFunc  func,
+                                gpointer                      user_data)
+{
+    XmpRecord *record = NULL;
+
+    g_return_val_if_fail (NULL != filename, FALSE);
+
+    /* Queued with the lock held, so no update can get before it */
+    g_static_mutex_lock (&xmp_lock);
+    if (NULL != xmp_pending) {
+        record = g_hash_table_lookup (xmp_pending, filename);
+        if (NULL != record) {
+            g_hash_table_steal (xmp_pending, filename);
+            _xmp_push (record, FALSE, func, user_data);
+        }
+    }
+    g_static_mutex_unlock (&xmp_lock);
+
+    return (NULL != record);
+}
+
+
+/**
+ * _g_digicam_camerabin_xmp_update_location:
+ * @filename: The file of the picture.
+ * @metadata: A #GDigicamCamerabinMetadata with the new location.
+ *
+ * Replaces the coordinates and the location names of a picture. If
+ * the picture hasn't been saved yet they are just written with the
+ * rest of its metadata, otherwise the file is rewritten in the
+ * background.
+ **/
+void
+_g_digicam_camerabin_xmp_update_location (const gchar                     *filename,
+                                          const GDigicamCamerabinMetadata *metadata)
+{
+    XmpRecord *record = NULL;
+
+    g_return_if_fail (NULL != filename);
+    g_return_if_fail (NULL != metadata);
+
+    g_static_mutex_lock (&xmp_lock);
+    if (NULL != xmp_pending) {
+        record = g_hash_table_lookup (xmp_pending, filename);
+    }
+    if (NULL != record) {
+        _xmp_record_set_location (record, metadata);
+    } else {
+        /* The worker knows the rest of the metadata */
+        _xmp_push (_xmp_record_new (filename, metadata, NULL), TRUE,
+                   NULL, NULL);
+    }
+    g_static_mutex_unlock (&xmp_lock);
+}
+
+
+/**
+ * _g_digicam_camerabin_xmp_packet_new:
+ * @metadata: A #GDigicamCamerabinMetadata.
+ * @date: The capture date, in ISO 8601 format, or #NULL.
+ *
+ * Serializes @metadata as an XMP packet.
+ *
+ * Returns: A newly allocated string.
+ **/
+gchar *
+_g_digicam_camerabin_xmp_packet_new (const GDigicamCamerabinMetadata *metadata,
+                                     const gchar                     *date)
+{
+    GString *packet = NULL;
+    gchar *value = NULL;
+
+    g_return_val_if_fail (NULL != metadata, NULL);
+
+    packet = g_string_new ("<?xpacket begin=\"\xef\xbb\xbf\" "
+                           "id=\"W5M0MpCehiHzreSzNTczkc9d\"?>\n"
+                           "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">\n"
+                           "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">\n"
+                           "<rdf:Description rdf:about=\"\"\n"
+                           " xmlns:tiff=\"http://ns.adobe.com/tiff/1.0/\"\n"
+                           " xmlns:exif=\"http://ns.adobe.com/exif/1.0/\"\n"
+                           " xmlns:xmp=\"http://ns.adobe.com/xap/1.0/\"\n"
+                           " xmlns:dc=\"http://purl.org/dc/elements/1.1/\"\n"
+                           " xmlns:photoshop=\"http://ns.adobe.com/photoshop/1.0/\"\n"
+                           " xmlns:Iptc4xmpCore=\"http://iptc.org/std/Iptc4xmpCore/1.0/xmlns/\"");
+
+    if (NULL != metadata->make) {
+        value = g_markup_printf_escaped ("\n tiff:Make=\"%s\"", metadata->make);
+        g_string_append (packet, value);
+        g_free (value);
+    }
+    if (NULL != metadata->model) {
+        value = g_markup_printf_escaped ("\n tiff:Model=\"%s\"", metadata->model);
+        g_string_append (packet, value);
+        g_free (value);
+    }
+    if ((1 <= metadata->orientation) && (8 >= metadata->orientation)) {
+        g_string_append_printf (packet, "\n tiff:Orientation=\"%u\"",
+                                metadata->orientation);
+    }
+    if (NULL != date) {
+        value = g_markup_printf_escaped ("\n xmp:CreateDate=\"%s\""
+                                         "\n xmp:ModifyDate=\"%s\""
+                                         "\n exif:DateTimeOriginal=\"%s\"",
+                                         date, date, date);
+        g_string_append (packet, value);
+        g_free (value);
+    }
+
+    /* Adding coordinates, just if set. */
+    if (G_MAXDOUBLE != metadata->latitude &&
+        G_MAXDOUBLE != metadata->longitude) {
+        g_string_append (packet, "\n exif:GPSVersionID=\"2.2.0.0\"");
+        _append_coordinate (packet, "exif:GPSLatitude",
+                            metadata->latitude, 'N', 'S');
+        _append_coordinate (packet, "exif:GPSLongitude",
+                            metadata->longitude, 'E', 'W');
+        if (G_MAXDOUBLE != metadata->altitude) {
+            /* In centimeters, as an EXIF rational */
+            g_string_append_printf (packet,
+                                    "\n exif:GPSAltitude=\"%u/100\""
+                                    "\n exif:GPSAltitudeRef=\"%d\"",
+                                    (guint) (ABS (metadata->altitude) * 100 + 0.5),
+                                    (0 > metadata->altitude) ? 1 : 0);
+        }
+    }
+
+    /* We should have all the geotags. */
+    if (NULL != metadata->country_name) {
+        value = g_markup_printf_escaped ("\n photoshop:Country=\"%s\"",
+                                         metadata->country_name);
+        g_string_append (packet, value);
+        g_free (value);
+        if (NULL != metadata->city_name) {
+            value = g_markup_printf_escaped ("\n photoshop:City=\"%s\"",
+                                             metadata->city_name);
+            g_string_append (packet, value);
+            g_free (value);
+        }
+        if (NULL != metadata->suburb_name) {
+            value = g_markup_printf_escaped ("\n Iptc4xmpCore:Location=\"%s\"",
+                                             metadata->suburb_name);
+            g_string_append (packet, value);
+            g_free (value);
+        }
+    }
+
+    g_string_append (packet, ">\n");
+
+    if (NULL != metadata->author) {
+        value = g_markup_printf_escaped ("<dc:creator><rdf:Seq><rdf:li>%s"
+                                         "</rdf:li></rdf:Seq></dc:creator>\n",
+                                         metadata->author);
+        g_string_append (packet, value);
+        g_free (value);
+    }
+
+    g_string_append (packet,
+                     "</rdf:Description>\n"
+                     "</rdf:RDF>\n"
+                     "</x:xmpmeta>\n"
+                     "<?xpacket end=\"w\"?>");
+
+    return g_string_free (packet, FALSE);
+}
+
+
+/**
+ * _g_digicam_camerabin_xmp_embed:
+ * @filename: A JPEG file.
+ * @packet: An XMP packet.
+ * @error: A #GError to report failures, or #NULL.
+ *
+ * Puts @packet in @filename, after the JFIF and EXIF segments. A
+ * previous XMP packet is replaced. The file is written to a
+ * temporary file first and then renamed, so it is never left half
+ * written.
+ *
+ * Returns: #TRUE if the file was rewritten, #FALSE otherwise.
+ **/
+gboolean
+_g_digicam_camerabin_xmp_embed (const gchar  *filename,
+                                const gchar  *packet,
+                                GError      **error)
+{
+    const gsize ns_length = sizeof (G_DIGICAM_CAMERABIN_XMP_NS);
+    guchar *data = NULL;
+    GString *output = NULL;
+    gsize length, offset, segment, old_start, old_end;
+    gsize packet_length;
+    gboolean result = FALSE;
+    guchar marker;
+
+    g_return_val_if_fail (NULL != filename, FALSE);
+    g_return_val_if_fail (NULL != packet, FALSE);
+
+    packet_length = strlen (packet);
+    if (G_MAXUINT16 < 2 + ns_length + packet_length) {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "XMP packet too big");
+        return FALSE;
+    }
+
+    if (!g_file_get_contents (filename, (gchar **) &data, &length, error)) {
+        return FALSE;
+    }
+
+    if ((4 > length) || (0xff != data[0]) || (JPEG_MARKER_SOI != data[1])) {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "%s is not a JPEG file", filename);
+        goto free;
+    }
+
+    /* Skip the JFIF and EXIF segments, looking for an old packet */
+    offset = 2;
+    old_start = old_end = 0;
+    while ((offset + 4 <= length) && (0xff == data[offset])) {
+        marker = data[offset + 1];
+        if ((JPEG_MARKER_APP0 != marker) && (JPEG_MARKER_APP1 != marker)) {
+            break;
+        }
+
+        segment = 2 + ((data[offset + 2] << 8) | data[offset + 3]);
+        if (offset + segment > length) {
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                         "%s is truncated", filename);
+            goto free;
+        }
+
+        if ((JPEG_MARKER_APP1 == marker) &&
+            (4 + ns_length <= segment) &&
+            (0 == memcmp (data + offset + 4, G_DIGICAM_CAMERABIN_XMP_NS,
+                          ns_length))) {
+            old_start = offset;
+            old_end = offset + segment;
+        }
+
+        offset += segment;
+    }
+
+    if (0 == old_end) {
+        old_start = old_end = offset;
+    }
+
+    output = g_string_sized_new (length + 4 + ns_length + packet_length);
+    g_string_append_len (output, (gchar *) data, old_start);
+    g_string_append_len (output, (gchar *) data + old_end, offset - old_end);
+    g_string_append_c (output, 0xff);
+    g_string_append_c (output, JPEG_MARKER_APP1);
+    g_string_append_c (output, ((2 + ns_length + packet_length) >> 8) & 0xff);
+    g_string_append_c (output, (2 + ns_length + packet_length) & 0xff);
+    g_string_append_len (output, G_DIGICAM_CAMERABIN_XMP_NS, ns_length);
+    g_string_append_len (output, packet, packet_length);
+    g_string_append_len (output, (gchar *) data + offset, length - offset);
+
+    result = g_file_set_contents (filename, output->str, output->len, error);
+
+    g_string_free (output, TRUE);
+
+free:
+    g_free (data);
+
+    return result;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static gpointer
+_xmp_pool_new (gpointer data)
+{
+    GThreadPool *pool = NULL;
+    GError *error = NULL;
+
+    /* One thread keeps the updates after the writes they modify */
+    pool = g_thread_pool_new (_xmp_run, NULL, 1, FALSE, &error);
+    if (NULL == pool) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to create the "
+                        "metadata thread: %s", error->message);
+        g_error_free (error);
+    }
+
+    return pool;
+}
+
+
+static void
+_xmp_push (XmpRecord                    *record,
+           gboolean                      update,
+           GDigicamCamerabinXmpDoneFunc  func,
+           gpointer                      user_data)
+{
+    GThreadPool *pool = NULL;
+    XmpJob *job = NULL;
+
+    job = g_slice_new0 (XmpJob);
+    job->record = record;
+    job->update = update;
+    job->func = func;
+    job->user_data = user_data;
+
+    pool = g_once (&xmp_pool_once, _xmp_pool_new, NULL);
+    if (NULL == pool) {
+        /* Better late than never */
+        _xmp_run (job, NULL);
+        return;
+    }
+
+    g_thread_pool_push (pool, job, NULL);
+}
+
+
+static void
+_xmp_run (gpointer data,
+          gpointer user_data)
+{
+    XmpJob *job = NULL;
+    XmpRecord *record = NULL;
+    GList *item = NULL;
+
+    job = (XmpJob *) data;
+
+    if (job->update) {
+        for (item = xmp_history.head; NULL != item; item = item->next) {
+            record = (XmpRecord *) item->data;
+            if (0 == strcmp (record->filename, job->record->filename)) {
+                break;
+            }
+        }
+
+        if (NULL == item) {
+            G_DIGICAM_WARN ("GDigicamCamerabin: no metadata to update "
+                            "for %s", job->record->filename);
+            _xmp_record_free (job->record);
+            goto free;
+        }
+
+        _xmp_record_set_location (record, &job->record->metadata);
+        _xmp_record_free (job->record);
+        g_queue_unlink (&xmp_history, item);
+        g_queue_push_tail_link (&xmp_history, item);
+    } else {
+        record = job->record;
+        g_queue_push_tail (&xmp_history, record);
+        if (G_DIGICAM_CAMERABIN_XMP_HISTORY < g_queue_get_length (&xmp_history)) {
+            _xmp_record_free (g_queue_pop_head (&xmp_history));
+        }
+    }
+
+    TSTAMP (before-xmp-write);
+    _xmp_record_save (record);
+    TSTAMP (after-xmp-write);
+
+    if (NULL != job->func) {
+        job->func (record->filename, job->user_data);
+    }
+
+free:
+    g_slice_free (XmpJob, job);
+}
+
+
+static XmpRecord *
+_xmp_record_new (const gchar                     *filename,
+                 const GDigicamCamerabinMetadata *metadata,
+                 const gchar                     *date)
+{
+    XmpRecord *record = NULL;
+
+    record = g_slice_new0 (XmpRecord);
+    record->filename = g_strdup (filename);
+    _g_digicam_camerabin_metadata_copy (&record->metadata, metadata);
+    record->date = g_strdup (date);
+
+    return record;
+}
+
+
+static void
+_xmp_record_free (XmpRecord *record)
+{
+    g_free (record->filename);
+    _g_digicam_camerabin_metadata_clear (&record->metadata);
+    g_free (record->date);
+    g_slice_free (XmpRecord, record);
+}
+
+
+static void
+_xmp_record_set_location (XmpRecord                       *record,
+                          const GDigicamCamerabinMetadata *metadata)
+{
+    g_free (record->metadata.country_name);
+    g_free (record->metadata.city_name);
+    g_free (record->metadata.suburb_name);
+    record->metadata.country_name = g_strdup (metadata->country_name);
+    record->metadata.city_name = g_strdup (metadata->city_name);
+    record->metadata.suburb_name = g_strdup (metadata->suburb_name);
+    record->metadata.longitude = metadata->longitude;
+    record->metadata.latitude = metadata->latitude;
+    record->metadata.altitude = metadata->altitude;
+}
+
+
+static void
+_xmp_record_save (XmpRecord *record)
+{
+    GError *error = NULL;
+    gchar *packet = NULL;
+
+    packet = _g_digicam_camerabin_xmp_packet_new (&record->metadata,
+                                                  record->date);
+
+    if (!_g_digicam_camerabin_xmp_embed (record->filename, packet, &error)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to write the metadata "
+                        "of %s: %s", record->filename, error->message);
+        g_error_free (error);
+    }
+
+    g_free (packet);
+}
+
+
+static void
+_xmp_pending_find_oldest (gpointer key,
+                          gpointer value,
+                          gpointer user_data)
+{
+    XmpRecord *record = NULL;
+    XmpRecord **oldest = NULL;
+
+    record = (XmpRecord *) value;
+    oldest = (XmpRecord **) user_data;
+
+    /* The serials wrap around long after the records are gone */
+    if ((NULL == *oldest) ||
+        ((gint) (record->serial - (*oldest)->serial) < 0)) {
+        *oldest = record;
+    }
+}
+
+
+static void
+_append_coordinate (GString     *packet,
+                    const gchar *name,
+                    gdouble      value,
+                    gchar        positive,
+                    gchar        negative)
+{
+    gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+    gdouble magnitude;
+    gint degrees;
+
+    /* XMP GPSCoordinate, "DDD,MM.mmmmK" */
+    magnitude = ABS (value);
+    degrees = (gint) magnitude;
+    g_string_append_printf (packet, "\n %s=\"%d,%s%c\"",
+                            name, degrees,
+                            g_ascii_formatd (buffer, sizeof (buffer), "%.4f",
+                                             (magnitude - degrees) * 60),
+                            (0 > value) ? negative : positive);
+}
@@ -0,0 +1,61 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef _G_DIGICAM_CAMERABIN_XMP_H_
+#define _G_DIGICAM_CAMERABIN_XMP_H_
+
+#include <glib.h>
+
+#include "gdigicam-camerabin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+    typedef void (*GDigicamCamerabinXmpDoneFunc) (const gchar *filename,
+                                                  gpointer     user_data);
+
+
+    void _g_digicam_camerabin_xmp_prepare (const gchar                     *filename,
+                                           const GDigicamCamerabinMetadata *metadata,
+                                           const gchar                     *date);
+    gboolean _g_digicam_camerabin_xmp_write (const gchar                  *filename,
+                                             GDigicamCamerabinXmpDoneFunc  func,
+                                             gpointer                      user_data);
+    void _g_digicam_camerabin_xmp_cancel (const gchar *filename);
+    void _g_digicam_camerabin_xmp_update_location (const gchar                     *filename,
+                                                   const GDigicamCamerabinMetadata *metadata);
+    gchar *_g_digicam_camerabin_xmp_packet_new (const GDigicamCamerabinMetadata *metadata,
+                                                const gchar                     *date);
+    gboolean _g_digicam_camerabin_xmp_embed (const gchar  *filename,
+                                             const gchar  *packet,
+                                             GError      **error);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
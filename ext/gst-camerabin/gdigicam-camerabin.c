@@ -33,13 +33,31 @@
  * #GDigicamManager.
  **/
 
-#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <unistd.h>
+
 #include <gst/interfaces/photography.h>
 #include <gst/video/video.h>
 
 #include <config.h>
 
 #include "gdigicam-camerabin.h"
+#include "gdigicam-camerabin-colorspace.h"
+#ifdef HAVE_JPEG
+#include "gdigicam-camerabin-encoder.h"
+#include "gdigicam-camerabin-jpeg.h"
+#endif
+#include "gdigicam-camerabin-metadata.h"
+#include "gdigicam-camerabin-output.h"
+#include "gdigicam-camerabin-prealloc.h"
+#include "gdigicam-camerabin-prerecord.h"
+#include "gdigicam-camerabin-scale.h"
+#include "gdigicam-camerabin-segmenter.h"
+#include "gdigicam-camerabin-writeback.h"
+#include "gdigicam-camerabin-writer.h"
+#include "gdigicam-camerabin-xmp.h"
+#if G_DIGICAM_HAVE_GDKPIXBUF
+#include "gdigicam-camerabin-thumbnail.h"
+#endif
 #include "gdigicam-manager-private.h"
 #include "gdigicam-debug.h"
 
@@ -52,91 +70,346 @@
 
 #define GST_TAG_DATE_TIME_ORIGINAL          "date-time-original"
 #define GST_TAG_DATE_TIME_MODIFIED          "date-time-modified"
-#define GST_TAG_DEVICE_MAKE                 "device-make"
-#define GST_TAG_DEVICE_MODEL                "device-model"
-#define GST_TAG_CLASSIFICATION              "classification"
-#define GST_TAG_GEO_LOCATION_COUNTRY        "geo-location-country"
-#define GST_TAG_GEO_LOCATION_CITY           "geo-location-city"
-#define GST_TAG_GEO_LOCATION_SUBLOCATION    "geo-location-sublocation"
 #define GST_TAG_CAPTURE_ORIENTATION         "capture-orientation"
 
-/* FIXME: This should be customizable somehow. */
-#define G_DIGICAM_CAMERABIN_STILL_4X3_HIGH_WIDTH 2576;
-#define G_DIGICAM_CAMERABIN_STILL_4X3_HIGH_HEIGHT 1936;
-#define G_DIGICAM_CAMERABIN_STILL_4X3_MEDIUM_WIDTH 2048;
-#define G_DIGICAM_CAMERABIN_STILL_4X3_MEDIUM_HEIGHT 1536;
-#define G_DIGICAM_CAMERABIN_STILL_4X3_LOW_WIDTH 1280;
-#define G_DIGICAM_CAMERABIN_STILL_4X3_LOW_HEIGHT 960;
-
-#define G_DIGICAM_CAMERABIN_STILL_16X9_HIGH_WIDTH 2560;
-#define G_DIGICAM_CAMERABIN_STILL_16X9_HIGH_HEIGHT 1440;
-#define G_DIGICAM_CAMERABIN_STILL_16X9_MEDIUM_WIDTH 2560;
-#define G_DIGICAM_CAMERABIN_STILL_16X9_MEDIUM_HEIGHT 1440;
-#define G_DIGICAM_CAMERABIN_STILL_16X9_LOW_WIDTH 2560;
-#define G_DIGICAM_CAMERABIN_STILL_16X9_LOW_HEIGHT 1440;
-
-
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_HD_WIDTH 960;
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_HD_HEIGHT 720;
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_DVD_WIDTH 720;
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_DVD_HEIGHT 576;
-
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_HIGH_WIDTH 640;
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_HIGH_HEIGHT 480;
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_MEDIUM_WIDTH 640;
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_MEDIUM_HEIGHT 480;
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_LOW_WIDTH 320;
-#define G_DIGICAM_CAMERABIN_VIDEO_4X3_LOW_HEIGHT 240;
-
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_HD_WIDTH 1280;
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_HD_HEIGHT 720;
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_DVD_WIDTH 1024;
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_DVD_HEIGHT 576;
-
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_HIGH_WIDTH 848;
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_HIGH_HEIGHT 480;
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_MEDIUM_WIDTH 848;
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_MEDIUM_HEIGHT 480;
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_LOW_WIDTH 848;
-#define G_DIGICAM_CAMERABIN_VIDEO_16X9_LOW_HEIGHT 480;
-
-
-/* Viewfinder resolutions and fps for still picture. */
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_WIDTH 640;
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_HEIGHT 480;
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_FPS 2993;
-
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_WIDTH 800;
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_HEIGHT 450;
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_FPS 2988;
-
-/* Framerate for video widescreen mode. */
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_VIDEO_FPS 3000;
-
-/* Framerate for video 4x3 DVD (720x576)mode. */
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_DVD_VIDEO_FPS 3000;
-
-/* Framerate for video 4x3 HD (960x720) mode. */
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_HD_VIDEO_FPS 3000;
-
-/* Framerate for video 16x9 DVD (1024x576)mode. */
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_DVD_VIDEO_FPS 3000;
-
-/* Framerate for video 16x9 HD (1280x720) mode. */
-#define G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_HD_VIDEO_FPS 2500;
-
 #define G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_START_MESSAGE "photo-capture-start"
 #define G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_PICTURE_GOT_MESSAGE "photo-capture-end"
 #define G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_END_MESSAGE   "image-captured"
 #define G_DIGICAM_CAMERABIN_PHOTO_PREVIEW_MESSAGE       "preview-image"
+#define G_DIGICAM_CAMERABIN_PICTURE_BUFFER_MESSAGE      "gdigicam-picture-buffer"
+
+/* Where CameraBin saves the pictures only captured to memory */
+#define G_DIGICAM_CAMERABIN_NO_FILE "/dev/null"
 
 #define G_DIGICAM_CAMERABIN_DEFAULT_COLORKEY 0x000010
 
+/* Maximum number of prebuilt camerabins kept around for reuse. */
+#define G_DIGICAM_CAMERABIN_POOL_SIZE 2
+
+#define G_DIGICAM_CAMERABIN_POOL_KEY "gdigicam-camerabin-pool-key"
+#define G_DIGICAM_CAMERABIN_VF_RES_KEY "gdigicam-vf-res"
+#define G_DIGICAM_CAMERABIN_PREVIEW_RES_KEY "gdigicam-preview-res"
+#define G_DIGICAM_CAMERABIN_COLORKEY_KEY "gdigicam-camerabin-colorkey"
+#define G_DIGICAM_CAMERABIN_THUMBNAIL_KEY "gdigicam-camerabin-thumbnail"
+#define G_DIGICAM_CAMERABIN_PREVIEW_SET_KEY "gdigicam-camerabin-preview-set"
+#define G_DIGICAM_CAMERABIN_METADATA_KEY "gdigicam-camerabin-metadata"
+#define G_DIGICAM_CAMERABIN_DEFERRED_METADATA_KEY "gdigicam-camerabin-deferred-metadata"
+#define G_DIGICAM_CAMERABIN_PRERECORD_KEY "gdigicam-camerabin-prerecord"
+#define G_DIGICAM_CAMERABIN_ZSL_KEY "gdigicam-camerabin-zsl"
+#define G_DIGICAM_CAMERABIN_ENCODE_KEY "gdigicam-camerabin-encode"
+#define G_DIGICAM_CAMERABIN_WRITER_KEY "gdigicam-camerabin-writer"
+#define G_DIGICAM_CAMERABIN_RECORDING_KEY "gdigicam-camerabin-recording"
+#define G_DIGICAM_CAMERABIN_SEGMENTS_KEY "gdigicam-camerabin-segments"
+#define G_DIGICAM_CAMERABIN_OUTPUT_KEY "gdigicam-camerabin-output"
+#define G_DIGICAM_CAMERABIN_PROBE_STATES_KEY "gdigicam-camerabin-probe-states"
+
+/* Zero shutter lag history, the frames older than this are too late
+ * to be the one the user saw when pressing the shutter. */
+#define G_DIGICAM_CAMERABIN_ZSL_HISTORY (500 * GST_MSECOND)
+#define G_DIGICAM_CAMERABIN_ZSL_DEFAULT_QUALITY 85
+/* Frames waiting to be saved per encoder thread, by default */
+#define G_DIGICAM_CAMERABIN_ENCODER_QUEUE_PER_THREAD 2
+
+/* Pictures synced together at most, by default */
+#define G_DIGICAM_CAMERABIN_WRITER_BATCH 8
+
+/* Space reserved ahead of the recordings by default, in seconds of
+ * the expected bitrate, and bitrate expected until it is measured */
+#define G_DIGICAM_CAMERABIN_PREALLOC_SECONDS 10
+#define G_DIGICAM_CAMERABIN_PREALLOC_BITRATE 8000000
+
+/* Bytes of the recordings flushed at once by default */
+#define G_DIGICAM_CAMERABIN_WRITEBACK_WINDOW (2 * 1024 * 1024)
+
+/* Milliseconds of the recordings in each fragment by default, for the
+ * muxers writing fragmented files */
+#define G_DIGICAM_CAMERABIN_FRAGMENT_DURATION 1000
+
+/* Additional preview sizes scaled without allocating their targets */
+#define G_DIGICAM_CAMERABIN_PREVIEW_SIZES_ON_STACK 8
+
 typedef struct _PreviewHelper {
     GDigicamManager *mgr;
+    GstBuffer *buffer;
+    GstVideoFormat format;
+    gint width;
+    gint height;
+#if G_DIGICAM_HAVE_GDKPIXBUF
     GdkPixbuf *preview;
+    GPtrArray *previews;
+#endif
 } PreviewHelper;
 
+#if G_DIGICAM_HAVE_GDKPIXBUF
+/* Thumbnails written once the deferred metadata is */
+typedef struct _ThumbnailHelper {
+    GdkPixbuf *preview;
+    GDigicamThumbnail mode;
+} ThumbnailHelper;
+#endif
+
+typedef struct _PictureBufferHelper {
+    GDigicamManager *mgr;
+    GstBuffer *buffer;
+    gchar *filename;
+} PictureBufferHelper;
+
+/* Still picture entries store the capture resolution and the
+ * viewfinder one, video entries the recording resolution as both. */
+typedef struct _ResolutionEntry {
+    GDigicamMode mode;
+    GDigicamAspectratio aspect_ratio;
+    GDigicamResolution resolution;
+    gint res_w, res_h;
+    gint vf_w, vf_h;
+    gint fps_n, fps_d;
+} ResolutionEntry;
+
+/* Default resolutions and framerates. They can be overridden from
+ * the "still-*" and "video-*" sections of the config file. */
+static ResolutionEntry resolution_table[] = {
+    { G_DIGICAM_MODE_STILL, G_DIGICAM_ASPECTRATIO_4X3, G_DIGICAM_RESOLUTION_HIGH,
+      2576, 1936, 640, 480, 2993, 100 },
+    { G_DIGICAM_MODE_STILL, G_DIGICAM_ASPECTRATIO_4X3, G_DIGICAM_RESOLUTION_MEDIUM,
+      2048, 1536, 640, 480, 2993, 100 },
+    { G_DIGICAM_MODE_STILL, G_DIGICAM_ASPECTRATIO_4X3, G_DIGICAM_RESOLUTION_LOW,
+      1280, 960, 640, 480, 2993, 100 },
+    { G_DIGICAM_MODE_STILL, G_DIGICAM_ASPECTRATIO_16X9, G_DIGICAM_RESOLUTION_HIGH,
+      2560, 1440, 800, 450, 2988, 100 },
+    { G_DIGICAM_MODE_STILL, G_DIGICAM_ASPECTRATIO_16X9, G_DIGICAM_RESOLUTION_MEDIUM,
+      2560, 1440, 800, 450, 2988, 100 },
+    { G_DIGICAM_MODE_STILL, G_DIGICAM_ASPECTRATIO_16X9, G_DIGICAM_RESOLUTION_LOW,
+      2560, 1440, 800, 450, 2988, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_4X3, G_DIGICAM_RESOLUTION_HD,
+      960, 720, 960, 720, 3000, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_4X3, G_DIGICAM_RESOLUTION_DVD,
+      720, 576, 720, 576, 3000, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_4X3, G_DIGICAM_RESOLUTION_HIGH,
+      640, 480, 640, 480, 2993, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_4X3, G_DIGICAM_RESOLUTION_MEDIUM,
+      640, 480, 640, 480, 2993, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_4X3, G_DIGICAM_RESOLUTION_LOW,
+      320, 240, 320, 240, 2993, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_16X9, G_DIGICAM_RESOLUTION_HD,
+      1280, 720, 1280, 720, 2500, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_16X9, G_DIGICAM_RESOLUTION_DVD,
+      1024, 576, 1024, 576, 3000, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_16X9, G_DIGICAM_RESOLUTION_HIGH,
+      848, 480, 848, 480, 3000, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_16X9, G_DIGICAM_RESOLUTION_MEDIUM,
+      848, 480, 848, 480, 3000, 100 },
+    { G_DIGICAM_MODE_VIDEO, G_DIGICAM_ASPECTRATIO_16X9, G_DIGICAM_RESOLUTION_LOW,
+      848, 480, 848, 480, 3000, 100 },
+};
+
+static GOnce resolution_table_once = G_ONCE_INIT;
+
+/* Format camerabin delivers the previews in. YUV formats save a
+ * colorspace conversion inside the bin, we convert them ourselves. */
+static GOnce preview_format_once = G_ONCE_INIT;
+
+/* A frame size, and its maximum framerate, the video source is able
+ * to deliver without scaling. */
+typedef struct _SensorMode {
+    gint width;
+    gint height;
+    gint fps_n;
+    gint fps_d;
+} SensorMode;
+
+typedef struct _ElementBuild {
+    gchar *key;
+    gchar *videosrc;
+    gchar *videoenc;
+    gchar *videomux;
+    gchar *audiosrc;
+    gchar *audioenc;
+    gchar *imageenc;
+    gchar *imagepp;
+    gchar *ximagesink;
+    GstElement *element;
+    gint colorkey;
+    /* Request waiting for this build, NULL if it only warms the pool. */
+    gboolean requested;
+    GDigicamManager *manager;
+    GDigicamCamerabinElementReadyFunc func;
+    gpointer user_data;
+} ElementBuild;
+
+/* The states of a bin whose probes ever ran. A probe may be entering
+ * a state after it is removed, so they are only freed with the bin,
+ * see _probe_state_remove() */
+typedef struct _ProbeStates {
+    gint refs;
+    GSList *retired;
+} ProbeStates;
+
+/* The states whose probes run in the streaming threads start with it,
+ * see _probe_state_hold() */
+typedef struct _ProbeState {
+    volatile gint refs;
+    gboolean removed;
+    gsize size;
+    ProbeStates *states;
+    GDestroyNotify finalize;
+} ProbeState;
+
+static GStaticMutex probe_states_lock = G_STATIC_MUTEX_INIT;
+
+typedef struct _PrerecordState {
+    ProbeState probes;
+    GDigicamCamerabinPrerecord *ring;
+    guint milliseconds;
+    guint max_bytes;
+    /* Whether the source frames go to the ring */
+    volatile gint collecting;
+    GstPad *source_pad;
+    gulong source_probe;
+    GstPad *video_pad;
+    gulong video_probe;
+    GstPad *audio_pad;
+    gulong audio_probe;
+    /* Frames to record before the first live one, and the time they
+     * take, which the live frames are delayed */
+    GList *frames;
+    GstClockTime offset;
+    /* Set while the probes push their own buffers */
+    gboolean injecting;
+    gboolean audio_injecting;
+} PrerecordState;
+
+#ifdef HAVE_JPEG
+typedef struct _ZslState {
+    ProbeState probes;
+    GDigicamCamerabinPrerecord *ring;
+    guint max_bytes;
+    /* Whether the source frames go to the ring */
+    volatile gint collecting;
+    /* Capture resolution, the source runs at it in still mode */
+    volatile gint width;
+    volatile gint height;
+    GstPad *source_pad;
+    gulong source_probe;
+    /* The shared encoders, held while the ring is */
+    GDigicamCamerabinEncoder *encoder;
+} ZslState;
+
+/* The pictures CameraBin captures, encoded by the shared encoders
+ * instead of its image encoder, see
+ * g_digicam_camerabin_set_parallel_encoding() */
+typedef struct _EncodeState {
+    ProbeState probes;
+    GstElement *gst_camera_bin;
+    GstPad *encoder_pad;
+    gulong encoder_probe;
+    GDigicamCamerabinEncoder *encoder;
+    /* The file of the picture being captured, taken by the probe */
+    gchar *filename;
+} EncodeState;
+
+static GStaticMutex encode_lock = G_STATIC_MUTEX_INIT;
+
+/* Zero shutter lag pictures, and the ones encoded in parallel, are
+ * encoded out of the capture path, by as many threads as cores. The
+ * encoders are shared by the camerabins using them, and freed with
+ * the last one, so the pooled camerabins don't keep them. */
+static GStaticMutex image_encoder_lock = G_STATIC_MUTEX_INIT;
+static GDigicamCamerabinEncoder *image_encoder = NULL;
+static guint image_encoder_users = 0;
+#endif
+
+typedef struct _WriterState {
+    ProbeState probes;
+    GstElement *gst_camera_bin;
+    /* Whether the pictures are saved by the writer, and whether they
+     * are handed in the "picture-buffer" signal */
+    gboolean async;
+    gboolean picture_buffers;
+    GstPad *encoder_pad;
+    gulong encoder_probe;
+    /* The file sink, found once the pictures flow */
+    GstElement *sink;
+    GstPad *sink_pad;
+    gulong sink_probe;
+    /* Contents of the picture going to the sink */
+    GList *buffers;
+    /* Whether the picture going to the sink is only captured to
+     * memory, then the sink doesn't get it */
+    gboolean no_file;
+    /* Where the picture goes instead of its file, if anywhere */
+    GDigicamCamerabinOutput *output;
+} WriterState;
+
+/* Pictures given to the writer which CameraBin will say are saved as
+ * well, see _picture_done_filter() */
+typedef enum {
+    WRITER_FILE_EXPECTED = 1,
+    WRITER_FILE_SAVED,
+    WRITER_FILE_FAILED,
+    WRITER_FILE_DONE
+} WriterFileStatus;
+
+/* The pictures of all the bins are saved by a single thread */
+static GOnce writer_once = G_ONCE_INIT;
+static GStaticMutex writer_files_lock = G_STATIC_MUTEX_INIT;
+static GHashTable *writer_files = NULL;
+
+/* Set while "img-done" is emitted from the main loop, see
+ * _emit_picture_saved() */
+static GStaticPrivate picture_done_emission = G_STATIC_PRIVATE_INIT;
+
+/* A picture whose "img-done" is emitted from the main loop */
+typedef struct _PictureSavedHelper {
+    GstElement *gst_camera_bin;
+    gchar *filename;
+} PictureSavedHelper;
+
+typedef struct _RecordingConfig {
+    guint prealloc_seconds;
+    guint prealloc_bitrate;
+    gsize writeback_window;
+} RecordingConfig;
+
+typedef struct _SegmentsConfig {
+    guint seconds;
+    guint64 max_bytes;
+    guint64 reserved;
+} SegmentsConfig;
+
+typedef struct _RecordingState {
+    ProbeState probes;
+    /* The file sink of the recording */
+    GstElement *sink;
+    GstPad *sink_pad;
+    gulong sink_probe;
+    /* Set when the recording is segmented */
+    SegmentsConfig segments;
+    /* Created with the first data, once the sink has opened the file */
+    GDigicamCamerabinPrealloc *prealloc;
+    GDigicamCamerabinWriteback *writeback;
+    GDigicamCamerabinSegmenter *segmenter;
+    gboolean started;
+    /* Where the recording goes instead of its file, if anywhere */
+    GDigicamCamerabinOutput *output;
+} RecordingState;
+
+static GOnce recording_config_once = G_ONCE_INIT;
+
+/* Prebuilt camerabins ready to be handed out, and builds in flight. */
+static GStaticMutex element_pool_lock = G_STATIC_MUTEX_INIT;
+static GList *element_pool = NULL;
+static GList *element_builds = NULL;
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+/* The preview is posted from a streaming thread and the picture done
+ * from another one, protects the preview kept for the thumbnails. */
+static GStaticMutex thumbnail_lock = G_STATIC_MUTEX_INIT;
+
+/* The array of additional previews is given back from the main loop
+ * and taken again from a streaming thread */
+static GStaticMutex preview_set_lock = G_STATIC_MUTEX_INIT;
+#endif
+
 
 /**************************************************/
 /* Camerabin operations implementation prototypes */
@@ -162,6 +435,8 @@ static gboolean _g_digicam_camerabin_set_quality (GDigicamManager *manager,
                                                   gpointer user_data);
 static gboolean _g_digicam_camerabin_set_aspect_ratio_resolution (GDigicamManager *manager,
                                                                   gpointer user_data);
+static gboolean _g_digicam_camerabin_set_window_geometry (GDigicamManager *manager,
+                                                         gpointer user_data);
 static gboolean _g_digicam_camerabin_set_locks (GDigicamManager *manager,
                                                 gpointer user_data);
 static gboolean _g_digicam_camerabin_set_zoom (GDigicamManager *manager,
@@ -172,6 +447,8 @@ static gboolean _g_digicam_camerabin_set_preview_mode (GDigicamManager *manager,
                                                        gpointer user_data);
 static gboolean _g_digicam_camerabin_get_still_picture (GDigicamManager *manager,
                                                         gpointer user_data);
+static gboolean _g_digicam_camerabin_still_picture_busy (GDigicamManager *manager,
+                                                         gpointer user_data);
 static gboolean _g_digicam_camerabin_start_recording_video (GDigicamManager *manager,
                                                             gpointer user_data);
 static gboolean _g_digicam_camerabin_pause_recording_video (GDigicamManager *manager,
@@ -184,6 +461,12 @@ static void _g_digicam_camerabin_set_video_metadata (GstElement *gst_camera_bin,
                                                      const GDigicamCamerabinMetadata *metadata);
 static gboolean _g_digicam_camerabin_handle_bus_message (GDigicamManager *manager,
                                                          gpointer user_data);
+static gboolean _g_digicam_camerabin_handle_picture_done (GDigicamManager *manager,
+                                                         gpointer user_data);
+static gboolean _g_digicam_camerabin_switch_storage (GDigicamManager *manager,
+                                                     gpointer user_data);
+static gboolean _g_digicam_camerabin_make_room (GDigicamManager *manager,
+                                                gpointer user_data);
 static gboolean _g_digicam_camerabin_handle_sync_bus_message (GDigicamManager *manager,
 							      gpointer user_data);
 
@@ -193,31 +476,211 @@ static gboolean _g_digicam_camerabin_handle_sync_bus_message (GDigicamManager *m
 /**************************************************/
 
 
+static gchar *_element_pool_key (const gchar *videosrc,
+                                 const gchar *videoenc,
+                                 const gchar *videomux,
+                                 const gchar *audiosrc,
+                                 const gchar *audioenc,
+                                 const gchar *imageenc,
+                                 const gchar *imagepp,
+                                 const gchar *ximagesink);
+static guint _element_pool_count (const gchar *key);
+static ElementBuild *_element_build_new (const gchar *key,
+                                         const gchar *videosrc,
+                                         const gchar *videoenc,
+                                         const gchar *videomux,
+                                         const gchar *audiosrc,
+                                         const gchar *audioenc,
+                                         const gchar *imageenc,
+                                         const gchar *imagepp,
+                                         const gchar *ximagesink);
+static void _element_build_free (ElementBuild *build);
+static gboolean _element_build_start (ElementBuild *build);
+static gpointer _element_build_thread (gpointer data);
+static gboolean _element_ready (gpointer user_data);
+static gboolean _get_preview_info (GDigicamManager *manager,
+                                   GstBuffer *buff,
+                                   GstVideoFormat *format,
+                                   gint *width,
+                                   gint *height);
+#if G_DIGICAM_HAVE_GDKPIXBUF
+static void _thumbnail_after_metadata (const gchar *filename,
+                                       gpointer user_data);
 static void _pixbuf_destroy (guchar *pixels, gpointer data);
 static GdkPixbuf *_pixbuf_from_buffer (GDigicamManager *manager,
                                        GstBuffer *buff,
+                                       GstVideoFormat format,
+                                       gint width,
+                                       gint height,
                                        gboolean has_alpha);
+static void _keep_thumbnail_source (GDigicamManager *manager,
+                                    GdkPixbuf *preview);
+static GPtrArray *_scale_previews (GDigicamManager *manager,
+                                   GdkPixbuf *preview);
+static void _recycle_previews (GDigicamManager *manager,
+                               GPtrArray *previews);
+static void _preview_set_free (GPtrArray *previews);
+#endif
 static gboolean _emit_preview_signal (gpointer user_data);
 static gboolean _emit_capture_start_signal (gpointer user_data);
 static gboolean _emit_capture_end_signal (gpointer user_data);
 static gboolean _emit_picture_got_signal (gpointer user_data);
+static gboolean _emit_picture_buffer_signal (gpointer user_data);
 static GstCaps *_new_preview_caps (gint pre_w, gint pre_h);
-static void _get_aspect_ratio_and_resolution (GDigicamMode mode,
-                                              GDigicamAspectratio ar,
-                                              GDigicamResolution res,
-                                              gint *vf_w, gint *vf_h,
-                                              gint *res_w, gint *res_h,
-                                              gint *fps_n, gint *fps_d);
-static void _get_still_aspect_ratio_and_resolution (GDigicamAspectratio ar,
-                                                    GDigicamResolution res,
-                                                    gint *vf_w, gint *vf_h,
-                                                    gint *res_w, gint *res_h,
-                                                    gint *fps_n, gint *fps_d);
-static void _get_video_aspect_ratio_and_resolution (GDigicamAspectratio ar,
-                                                    GDigicamResolution res,
-                                                    gint *vf_w, gint *vf_h,
-                                                    gint *res_w, gint *res_h,
-                                                    gint *fps_n, gint *fps_d);
+static gboolean _get_preview_demand (GDigicamManager *manager,
+                                     gboolean enabled,
+                                     gint vf_w, gint vf_h,
+                                     gint *pre_w, gint *pre_h);
+static void _set_preview_caps (GDigicamManager *manager,
+                               GstElement *gst_camera_bin,
+                               gboolean enabled,
+                               gint vf_w, gint vf_h,
+                               gboolean force);
+static void _refresh_preview_caps (GDigicamManager *manager,
+                                   GstElement *gst_camera_bin);
+static GDigicamCamerabinMetadataSession *_get_metadata_session (GstElement *gst_camera_bin);
+static void _probe_state_init (ProbeState *probes,
+                               GstElement *gst_camera_bin,
+                               gsize size,
+                               GDestroyNotify finalize);
+static gboolean _probe_state_hold (ProbeState *probes);
+static void _probe_state_release (ProbeState *probes);
+static void _probe_state_remove (ProbeState *probes);
+static void _probe_states_unref (ProbeStates *states);
+static void _prerecord_state_free (PrerecordState *state);
+static void _prerecord_state_finalize (PrerecordState *state);
+static void _prerecord_set_collecting (GstElement *gst_camera_bin,
+                                       gboolean collecting);
+static void _prerecord_start (GstElement *gst_camera_bin);
+static void _prerecord_stop (GstElement *gst_camera_bin);
+static GstPad *_get_element_pad (GstElement *gst_camera_bin,
+                                 const gchar *property,
+                                 const gchar *name);
+static gboolean _prerecord_source_probe (GstPad *pad,
+                                         GstBuffer *buffer,
+                                         PrerecordState *state);
+static gboolean _prerecord_video_probe (GstPad *pad,
+                                        GstBuffer *buffer,
+                                        PrerecordState *state);
+static gboolean _prerecord_audio_probe (GstPad *pad,
+                                        GstBuffer *buffer,
+                                        PrerecordState *state);
+static gboolean _prerecord_delay (GstPad *pad,
+                                  GstBuffer *buffer,
+                                  PrerecordState *state,
+                                  gboolean *injecting);
+#ifdef HAVE_JPEG
+static void _zsl_state_free (ZslState *state);
+static void _zsl_state_finalize (ZslState *state);
+static void _zsl_set_collecting (GstElement *gst_camera_bin,
+                                 gboolean collecting);
+static void _zsl_set_resolution (GstElement *gst_camera_bin,
+                                 gint width, gint height);
+static gboolean _zsl_get_resolution (GstElement *gst_camera_bin,
+                                     gint *width, gint *height);
+static gboolean _zsl_source_probe (GstPad *pad,
+                                   GstBuffer *buffer,
+                                   ZslState *state);
+static gboolean _zsl_busy (GstElement *gst_camera_bin);
+static gboolean _zsl_capture (GDigicamManager *manager,
+                              GstElement *gst_camera_bin,
+                              GDigicamCamerabinPictureHelper *helper,
+                              gboolean *taken);
+static void _zsl_post_message (GstElement *element,
+                               const gchar *name,
+                               GstBuffer *buffer);
+static GstBuffer *_zsl_preview_new (GstElement *gst_camera_bin,
+                                    GstBuffer *frame,
+                                    GstVideoFormat format,
+                                    gint width, gint height);
+static gint _zsl_get_quality (GstElement *gst_camera_bin);
+static GDigicamCamerabinEncoder *_image_encoder_ref (void);
+static void _image_encoder_unref (GDigicamCamerabinEncoder *encoder);
+static gpointer _image_encoder_free (gpointer data);
+static GDigicamCamerabinEncoder *_image_encoder_new (void);
+static void _encode_state_free (EncodeState *state);
+static void _encode_state_finalize (EncodeState *state);
+static gboolean _encode_prepare (GstElement *gst_camera_bin,
+                                 const gchar *filename);
+static gboolean _encode_busy (GstElement *gst_camera_bin);
+static gboolean _encode_probe (GstPad *pad,
+                               GstBuffer *buffer,
+                               EncodeState *state);
+#endif
+static WriterState *_writer_state_get (GstElement *gst_camera_bin);
+static void _writer_files_expect (const gchar *filename);
+static void _writer_files_forget (const gchar *filename);
+static gboolean _writer_state_update (GstElement *gst_camera_bin,
+                                      gboolean async,
+                                      gboolean picture_buffers);
+static void _writer_state_free (WriterState *state);
+static void _writer_state_finalize (WriterState *state);
+static gboolean _writer_encoder_probe (GstPad *pad,
+                                       GstBuffer *buffer,
+                                       WriterState *state);
+static void _writer_post_picture (WriterState *state,
+                                  const gchar *filename);
+static void _writer_write_output (WriterState *state);
+static gboolean _writer_sink_probe (GstPad *pad,
+                                    GstMiniObject *data,
+                                    WriterState *state);
+static GstPad *_get_downstream_sink_pad (GstPad *pad);
+static gpointer _writer_new (gpointer data);
+static gpointer _recording_config_load (gpointer data);
+static void _recording_state_free (RecordingState *state);
+static void _recording_state_finalize (RecordingState *state);
+static void _videomux_set_fragments (GstElement *vmux,
+                                     guint duration);
+static gboolean _recording_start (GstElement *gst_camera_bin,
+                                  GDigicamCamerabinOutput *output);
+static gboolean _recording_sink_probe (GstPad *pad,
+                                       GstMiniObject *data,
+                                       RecordingState *state);
+static void _recording_state_changed (GstElement *gst_camera_bin,
+                                      GstMessage *message);
+static void _picture_saved (const gchar *filename,
+                            const GError *error,
+                            GstElement *gst_camera_bin);
+static void _picture_done_queue (GstElement *gst_camera_bin,
+                                 const gchar *filename);
+static gboolean _emit_picture_saved (gpointer user_data);
+static gboolean _picture_done_filter (GstElement *gst_camera_bin,
+                                      const gchar *filename,
+                                      gpointer user_data);
+static gboolean _picture_done_continue (GstElement *gst_camera_bin,
+                                        const gchar *filename);
+static gpointer _preview_format_load (gpointer data);
+static GstVideoFormat _get_preview_format (void);
+static gboolean _parse_resolution (const gchar *value,
+                                   gint *width, gint *height,
+                                   gint *fps_n, gint *fps_d);
+static gpointer _resolution_table_load (gpointer data);
+static gboolean _get_aspect_ratio_and_resolution (GDigicamMode mode,
+                                                  GDigicamAspectratio ar,
+                                                  GDigicamResolution res,
+                                                  gint *vf_w, gint *vf_h,
+                                                  gint *res_w, gint *res_h,
+                                                  gint *fps_n, gint *fps_d);
+static gboolean _get_structure_dimension (const GstStructure *structure,
+                                          const gchar *field,
+                                          gint requested,
+                                          gint *value);
+static GArray *_get_sensor_modes (GstElement *gst_camera_bin,
+                                  gint width, gint height);
+static gdouble _sensor_mode_cost (const SensorMode *sensor_mode,
+                                  gint width, gint height);
+static gboolean _select_sensor_mode (GstElement *gst_camera_bin,
+                                     gint width, gint height,
+                                     SensorMode *sensor_mode);
+static void _fit_viewfinder_to_window (gint vf_w, gint vf_h,
+                                       guint window_w, guint window_h,
+                                       gint *width, gint *height);
+static void _set_viewfinder_res_fps (GstElement *gst_camera_bin,
+                                     GDigicamMode mode,
+                                     gint vf_w, gint vf_h,
+                                     gint fps_n, gint fps_d,
+                                     guint window_w, guint window_h,
+                                     gboolean force);
 
 
 /*****************************/
@@ -263,11 +726,16 @@ g_digicam_camerabin_descriptor_new (const GstElement *gst_camera_bin)
     descriptor->set_audio_func = _g_digicam_camerabin_set_audio;
     descriptor->set_preview_mode_func = _g_digicam_camerabin_set_preview_mode;
     descriptor->get_still_picture_func = _g_digicam_camerabin_get_still_picture;
+    descriptor->still_picture_busy_func = _g_digicam_camerabin_still_picture_busy;
     descriptor->start_recording_video_func = _g_digicam_camerabin_start_recording_video;
     descriptor->pause_recording_video_func = _g_digicam_camerabin_pause_recording_video;
     descriptor->finish_recording_video_func = _g_digicam_camerabin_finish_recording_video;
     descriptor->handle_bus_message_func = _g_digicam_camerabin_handle_bus_message;
     descriptor->handle_sync_bus_message_func = _g_digicam_camerabin_handle_sync_bus_message;
+    descriptor->set_window_geometry_func = _g_digicam_camerabin_set_window_geometry;
+    descriptor->handle_picture_done_func = _g_digicam_camerabin_handle_picture_done;
+    descriptor->switch_storage_func = _g_digicam_camerabin_switch_storage;
+    descriptor->make_room_func = _g_digicam_camerabin_make_room;
     g_object_get (G_OBJECT (gst_camera_bin), "vfsink", &descriptor->viewfinder_sink, NULL);
 
     return descriptor;
@@ -321,6 +789,7 @@ g_digicam_camerabin_element_new (const gchar *videosrc,
     gint aenc_depth = 0;
     gint aenc_rate = 0;
     gint aenc_channels = 0;
+    guint fragment_duration = G_DIGICAM_CAMERABIN_FRAGMENT_DURATION;
     GKeyFile *key_file = NULL;
     gint ximg_colorkey = 0;
     GstElement *aenc_bin = NULL;
@@ -360,6 +829,13 @@ g_digicam_camerabin_element_new (const gchar *videosrc,
         goto cleanup;
     }
 
+    /* Ahead of the handlers of the users of the bin, see
+     * g_digicam_camerabin_set_async_writer() */
+    if (0 != g_signal_lookup ("img-done", G_OBJECT_TYPE (gst_camera_bin))) {
+        g_signal_connect (gst_camera_bin, "img-done",
+                          G_CALLBACK (_picture_done_filter), NULL);
+    }
+
 
     /* --------------------- videosrc --------------------- */
 
@@ -440,6 +916,17 @@ g_digicam_camerabin_element_new (const gchar *videosrc,
             vmux = gst_element_factory_make (element, NULL);
             g_free (element);
         }
+
+        /* fragment-duration parameter */
+        if (g_key_file_has_key (key_file,
+                                "videomux",
+                                "fragment-duration",
+                                NULL)) {
+            fragment_duration = MAX (0, g_key_file_get_integer (key_file,
+                                                                "videomux",
+                                                                "fragment-duration",
+                                                                NULL));
+        }
     } else {
 	if (NULL != videomux) {
 	    G_DIGICAM_DEBUG ("GDigicamCamerabin::g_digicam_camerabin_element_new: "
@@ -453,6 +940,7 @@ g_digicam_camerabin_element_new (const gchar *videosrc,
     }
 
     if (NULL != vmux) {
+        _videomux_set_fragments (vmux, fragment_duration);
 	g_object_set (G_OBJECT (gst_camera_bin), "videomux", vmux, NULL);
     } else {
 	G_DIGICAM_DEBUG ("GDigicamCamerabin::g_digicam_camerabin_element_new: "
@@ -757,517 +1245,950 @@ cleanup:
 }
 
 
-/****************************************************************/
-/* Private functions implementing the abstract public functions */
-/****************************************************************/
-
-
 /**
- * _g_digicam_camerabin_set_mode:
- * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinModeHelper.
+ * g_digicam_camerabin_element_prepare:
+ * @videosrc: name of a valid video source #GstElement.
+ * @videoenc: name of a valid video encoder #GstElement.
+ * @videomux: name of a valid video muxer #GstElement.
+ * @audiosrc: name of a valid audio source #GstElement.
+ * @audioenc: name of a valid audio encoder #GstElement.
+ * @imageenc: name of a valid image encoder #GstElement.
+ * @imagepp: name of a valid post processing #GstElement.
+ * @ximagesink: name of a valid X image sink #GstElement.
  *
- * Implementation of "set_mode" GDigicam operation specifically for
- * the "camerabin" GStreamer bin.
+ * Starts building a customized CameraBin #GstElement in a worker
+ * thread, so it is already available when
+ * g_digicam_camerabin_element_new_async() asks for one with the same
+ * elements. It is meant to be called as early as possible during the
+ * application start up. Nothing is done if the pool already holds, or
+ * is building, enough elements of this kind.
  *
- * Returns: #FALSE if invalid input arguments are received or the
- * operation fails, #TRUE otherwise.
+ * Returns: #True if success, #False otherwise.
  **/
-static gboolean
-_g_digicam_camerabin_set_mode (GDigicamManager *manager,
-                               gpointer user_data)
+gboolean
+g_digicam_camerabin_element_prepare (const gchar *videosrc,
+                                     const gchar *videoenc,
+                                     const gchar *videomux,
+                                     const gchar *audiosrc,
+                                     const gchar *audioenc,
+                                     const gchar *imageenc,
+                                     const gchar *imagepp,
+                                     const gchar *ximagesink)
 {
-    GDigicamCamerabinModeHelper *helper = NULL;
-    GError *error = NULL;
-    GstElement *bin = NULL;
-    gboolean result;
-
-    helper = (GDigicamCamerabinModeHelper *) user_data;
-
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting operation mode  ...\n");
+    ElementBuild *build = NULL;
+    gchar *key = NULL;
+    gboolean result = TRUE;
 
-    TSTAMP (gst-before-mode-changed);
-
-    /* Get "camerabin" Gstreamer bin  */
-    result = g_digicam_manager_get_gstreamer_bin (manager,
-                                                  &bin,
-                                                  &error);
-
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
-    }
+    key = _element_pool_key (videosrc, videoenc, videomux, audiosrc,
+                             audioenc, imageenc, imagepp, ximagesink);
 
+    g_static_mutex_lock (&element_pool_lock);
 
-    /* FIXME: Pending of camerabin integration */
-    switch (helper->mode) {
-    case G_DIGICAM_MODE_STILL:
-        g_object_set (bin, "mode", 0, NULL);
-        break;
-    case G_DIGICAM_MODE_VIDEO:
-        g_object_set (bin, "mode", 1, NULL);
-        break;
-    default:
-        g_assert_not_reached ();
+    if (G_DIGICAM_CAMERABIN_POOL_SIZE > _element_pool_count (key)) {
+        build = _element_build_new (key, videosrc, videoenc, videomux,
+                                    audiosrc, audioenc, imageenc,
+                                    imagepp, ximagesink);
+        result = _element_build_start (build);
     }
 
-    TSTAMP (gst-after-mode-changed);
+    g_static_mutex_unlock (&element_pool_lock);
 
-    /* free */
-free:
-    if (NULL != bin) {
-        gst_object_unref (bin);
-    }
-    if (NULL != error) {
-        g_error_free (error);
-    }
+    g_free (key);
 
     return result;
 }
 
 
 /**
- * _g_digicam_camerabin_set_flash_mode:
- * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinFlashModeHelper.
+ * g_digicam_camerabin_element_new_async:
+ * @manager: A #GDigicamManager to hand the element to, or #NULL.
+ * @videosrc: name of a valid video source #GstElement.
+ * @videoenc: name of a valid video encoder #GstElement.
+ * @videomux: name of a valid video muxer #GstElement.
+ * @audiosrc: name of a valid audio source #GstElement.
+ * @audioenc: name of a valid audio encoder #GstElement.
+ * @imageenc: name of a valid image encoder #GstElement.
+ * @imagepp: name of a valid post processing #GstElement.
+ * @ximagesink: name of a valid X image sink #GstElement.
+ * @func: A #GDigicamCamerabinElementReadyFunc to call when the
+ * element is ready, or #NULL.
+ * @user_data: Data to pass to @func.
  *
- * Implementation of "set_flash_mode" GDigicam operation specifically
- * for the "camerabin" GStreamer bin.
+ * Asynchronous version of g_digicam_camerabin_element_new(). The
+ * CameraBin #GstElement is taken from the pool of prebuilt elements
+ * if there is a matching one, otherwise it is built in a worker
+ * thread. Once it is ready, from the main loop, it is set in @manager
+ * with g_digicam_manager_set_gstreamer_bin() and @func is called.
  *
- * Returns: #FALSE if invalid input arguments are received or the
- * operation fails, #TRUE otherwise.
+ * The element passed to @func is owned by the library; call
+ * gst_object_ref() on it to keep it when @manager is #NULL.
+ *
+ * Returns: #True if success, #False otherwise.
  **/
-static gboolean
-_g_digicam_camerabin_set_flash_mode (GDigicamManager *manager,
-                                     gpointer user_data)
+gboolean
+g_digicam_camerabin_element_new_async (GDigicamManager *manager,
+                                       const gchar *videosrc,
+                                       const gchar *videoenc,
+                                       const gchar *videomux,
+                                       const gchar *audiosrc,
+                                       const gchar *audioenc,
+                                       const gchar *imageenc,
+                                       const gchar *imagepp,
+                                       const gchar *ximagesink,
+                                       GDigicamCamerabinElementReadyFunc func,
+                                       gpointer user_data)
 {
-    GDigicamCamerabinFlashModeHelper *helper = NULL;
-    GError *error = NULL;
-    GstElement *bin = NULL;
-    GstFlashMode value;
-    gboolean result;
-
-    helper = (GDigicamCamerabinFlashModeHelper *) user_data;
-
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting flash mode  ...\n");
-
-    /* Get "camerabin" Gstreamer bin  */
-    result = g_digicam_manager_get_gstreamer_bin (manager,
-                                                  &bin,
-                                                  &error);
+    ElementBuild *build = NULL;
+    GstElement *element = NULL;
+    GList *iter = NULL;
+    gchar *key = NULL;
+    gboolean result = TRUE;
+
+    g_return_val_if_fail ((NULL == manager) || G_DIGICAM_IS_MANAGER (manager),
+                          FALSE);
+
+    key = _element_pool_key (videosrc, videoenc, videomux, audiosrc,
+                             audioenc, imageenc, imagepp, ximagesink);
+
+    g_static_mutex_lock (&element_pool_lock);
+
+    /* Already built and waiting in the pool. */
+    for (iter = element_pool; NULL != iter; iter = g_list_next (iter)) {
+        if (0 == g_strcmp0 (key,
+                            g_object_get_data (G_OBJECT (iter->data),
+                                               G_DIGICAM_CAMERABIN_POOL_KEY))) {
+            element = GST_ELEMENT (iter->data);
+            element_pool = g_list_delete_link (element_pool, iter);
+            break;
+        }
+    }
 
+    /* Being built, but nobody asked for it yet. */
+    if (NULL == element) {
+        for (iter = element_builds; NULL != iter; iter = g_list_next (iter)) {
+            build = (ElementBuild *) iter->data;
+            if ((!build->requested) && (0 == g_strcmp0 (key, build->key))) {
+                break;
+            }
+            build = NULL;
+        }
+    }
 
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+    if ((NULL == element) && (NULL == build)) {
+        build = _element_build_new (key, videosrc, videoenc, videomux,
+                                    audiosrc, audioenc, imageenc,
+                                    imagepp, ximagesink);
+        if (!_element_build_start (build)) {
+            build = NULL;
+            result = FALSE;
+            goto unlock;
         }
-        goto free;
     }
 
-    switch (helper->flash_mode) {
-    case G_DIGICAM_FLASHMODE_AUTO:
-        /* FIXME: the AUTO scene mode is unimplemented in camerabin side.*/
-        value = GST_PHOTOGRAPHY_FLASH_MODE_AUTO;
-        break;
-    case G_DIGICAM_FLASHMODE_OFF:
-        value = GST_PHOTOGRAPHY_FLASH_MODE_OFF;
-        break;
-    case G_DIGICAM_FLASHMODE_ON:
-        value = GST_PHOTOGRAPHY_FLASH_MODE_ON;
-        break;
-    case G_DIGICAM_FLASHMODE_REDEYEREDUCTION:
-        value = GST_PHOTOGRAPHY_FLASH_MODE_RED_EYE;
-        break;
-    default:
-        g_assert_not_reached ();
+    if (NULL != element) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin::g_digicam_camerabin_element_new_async: "
+                         "reusing a prebuilt camerabin.");
+        build = _element_build_new (key, NULL, NULL, NULL, NULL,
+                                    NULL, NULL, NULL, NULL);
+        build->element = element;
+        build->colorkey =
+            GPOINTER_TO_INT (g_object_get_data (G_OBJECT (element),
+                                                G_DIGICAM_CAMERABIN_COLORKEY_KEY));
     }
 
-    /* Establish new flash mode */
-    result = gst_photography_set_flash_mode (GST_PHOTOGRAPHY (bin),
-                                             value);
+    build->requested = TRUE;
+    build->manager = (NULL != manager) ? g_object_ref (manager) : NULL;
+    build->func = func;
+    build->user_data = user_data;
 
-    /* free */
-free:
-    if (NULL != bin) {
-        gst_object_unref (bin);
-    }
-    if (NULL != error) {
-        g_error_free (error);
+    if (NULL != element) {
+        g_idle_add (_element_ready, build);
     }
 
+unlock:
+    g_static_mutex_unlock (&element_pool_lock);
+
+    g_free (key);
+
     return result;
 }
 
 
 /**
- * _g_digicam_camerabin_set_focus_mode:
- * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinFocusModeHelper.
- *
- * Implementation of "set_focus_mode" GDigicam operation specifically
- * for the "camerabin" GStreamer bin.
+ * g_digicam_camerabin_element_recycle:
+ * @gst_camera_bin: A CameraBin #GstElement previously obtained with
+ * g_digicam_camerabin_element_new_async().
  *
- * Returns: #FALSE if invalid input arguments are received or the
- * operation fails, #TRUE otherwise.
+ * Gives back @gst_camera_bin to the pool of prebuilt elements, so a
+ * later call to g_digicam_camerabin_element_new_async() can reuse
+ * it. The element must not be in use by any #GDigicamManager
+ * anymore. Its "img-done" handlers are disconnected and its
+ * filename, preview caps, mode and tags are reset, so the next user
+ * gets it as new. This function takes ownership of the reference
+ * passed.
  **/
-static gboolean
-_g_digicam_camerabin_set_focus_mode (GDigicamManager *manager,
-                                     gpointer user_data)
+void
+g_digicam_camerabin_element_recycle (GstElement *gst_camera_bin)
 {
-    GDigicamCamerabinFocusModeHelper *helper = NULL;
-    GstElement *bin = NULL;
-    GError *error = NULL;
-    gboolean result;
-
-    helper = (GDigicamCamerabinFocusModeHelper *) user_data;
+    const gchar *key = NULL;
+    gboolean pooled = FALSE;
+    guint signal_id = 0;
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting focus mode");
+    g_return_if_fail (GST_IS_ELEMENT (gst_camera_bin));
 
-    /* Get "camerabin" Gstreamer bin  */
-    result = g_digicam_manager_get_gstreamer_bin (manager,
-                                                  &bin,
-                                                  &error);
+    key = g_object_get_data (G_OBJECT (gst_camera_bin),
+                             G_DIGICAM_CAMERABIN_POOL_KEY);
 
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
+    if ((NULL == key) || (NULL != GST_OBJECT_PARENT (gst_camera_bin))) {
+        G_DIGICAM_WARN ("GDigicamCamerabin::g_digicam_camerabin_element_recycle: "
+                        "element can't be recycled.");
+        gst_object_unref (GST_OBJECT (gst_camera_bin));
+        return;
     }
 
-    /* TODO: Specific implementation to set the focus mode */
+    gst_element_set_state (gst_camera_bin, GST_STATE_NULL);
+
+    /* Nothing of the previous user must reach the next one: their
+     * handlers go away (the filter is connected again so it keeps
+     * running first) and the capture settings go back to defaults */
+    signal_id = g_signal_lookup ("img-done", G_OBJECT_TYPE (gst_camera_bin));
+    if (0 != signal_id) {
+        g_signal_handlers_disconnect_matched (gst_camera_bin,
+                                              G_SIGNAL_MATCH_ID,
+                                              signal_id, 0,
+                                              NULL, NULL, NULL);
+        g_signal_connect (gst_camera_bin, "img-done",
+                          G_CALLBACK (_picture_done_filter), NULL);
+    }
+    g_object_set (G_OBJECT (gst_camera_bin),
+                  "filename", "",
+                  "preview-caps", NULL,
+                  "mode", 0,
+                  NULL);
+    if (GST_IS_TAG_SETTER (gst_camera_bin)) {
+        gst_tag_setter_reset_tags (GST_TAG_SETTER (gst_camera_bin));
+    }
 
-    /* free */
-free:
-    if (NULL != bin) {
-        gst_object_unref (bin);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_VF_RES_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_PREVIEW_RES_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_METADATA_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_DEFERRED_METADATA_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_PRERECORD_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_ZSL_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_ENCODE_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_WRITER_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_RECORDING_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_SEGMENTS_KEY, NULL);
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_OUTPUT_KEY, NULL);
+
+    g_static_mutex_lock (&element_pool_lock);
+    if (G_DIGICAM_CAMERABIN_POOL_SIZE > _element_pool_count (key)) {
+        element_pool = g_list_append (element_pool, gst_camera_bin);
+        pooled = TRUE;
     }
-    if (NULL != error) {
-        g_error_free (error);
+    g_static_mutex_unlock (&element_pool_lock);
+
+    if (!pooled) {
+        gst_object_unref (GST_OBJECT (gst_camera_bin));
     }
+}
 
-    return result;
+
+/**
+ * g_digicam_camerabin_set_deferred_metadata:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @deferred: Whether to write the metadata after saving the pictures.
+ *
+ * Sets how the #GDigicamCamerabinMetadata of the pictures is
+ * written. By default it is given to CameraBin before the capture,
+ * which delays the capture a bit. When @deferred is #TRUE the
+ * pictures are saved with the capture data only, and the metadata is
+ * added as an XMP packet from a background thread after they are
+ * saved. The location can then be given later with
+ * g_digicam_camerabin_update_picture_location().
+ **/
+void
+g_digicam_camerabin_set_deferred_metadata (GstElement *gst_camera_bin,
+                                           gboolean deferred)
+{
+    g_return_if_fail (GST_IS_ELEMENT (gst_camera_bin));
+
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_DEFERRED_METADATA_KEY,
+                       GINT_TO_POINTER (deferred ? 1 : 0));
 }
 
 
 /**
- * _g_digicam_camerabin_set_focus_region_pattern:
- * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinFocusRegionPatternHelper.
+ * g_digicam_camerabin_get_deferred_metadata:
+ * @gst_camera_bin: A CameraBin #GstElement.
  *
- * Implementation of "set_focus_region_pattern" GDigicam operation
- * specifically for the "camerabin" GStreamer bin.
+ * Gets whether the metadata of the pictures is written after saving
+ * them. See g_digicam_camerabin_set_deferred_metadata().
  *
- * Returns: #FALSE if invalid input arguments are received or the
- * operation fails, #TRUE otherwise.
+ * Returns: #TRUE if the metadata is deferred, #FALSE otherwise.
  **/
-static gboolean
-_g_digicam_camerabin_set_focus_region_pattern (GDigicamManager *manager,
-                                               gpointer user_data)
+gboolean
+g_digicam_camerabin_get_deferred_metadata (GstElement *gst_camera_bin)
 {
-    GDigicamCamerabinFocusRegionPatternHelper *helper = NULL;
-    GstElement *bin = NULL;
-    GError *error = NULL;
-    gboolean result;
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
 
-    helper = (GDigicamCamerabinFocusRegionPatternHelper *) user_data;
-
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting focus region pattern");
+    return (0 != GPOINTER_TO_INT (g_object_get_data (G_OBJECT (gst_camera_bin),
+                                                     G_DIGICAM_CAMERABIN_DEFERRED_METADATA_KEY)));
+}
 
-    /* Get "camerabin" Gstreamer bin  */
-    result = g_digicam_manager_get_gstreamer_bin (manager,
-                                                  &bin,
-                                                  &error);
 
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
-    }
-
-    /* TODO: Specific implementation to set the focus region pattern */
-
-    /* free */
-free:
-    if (NULL != bin) {
-        gst_object_unref (bin);
-    }
-    if (NULL != error) {
-        g_error_free (error);
-    }
+/**
+ * g_digicam_camerabin_update_picture_location:
+ * @filename: The file of a picture taken with deferred metadata.
+ * @metadata: A #GDigicamCamerabinMetadata with the location of the
+ * picture.
+ *
+ * Replaces the coordinates and the location names of a picture taken
+ * after g_digicam_camerabin_set_deferred_metadata(), typically when
+ * the location was not known yet at capture time. The rest of
+ * @metadata is ignored. It returns immediately, the file is written
+ * in the background. Only the last pictures taken can be updated.
+ **/
+void
+g_digicam_camerabin_update_picture_location (const gchar *filename,
+                                             const GDigicamCamerabinMetadata *metadata)
+{
+    g_return_if_fail (NULL != filename);
+    g_return_if_fail (NULL != metadata);
 
-    return result;
+    _g_digicam_camerabin_xmp_update_location (filename, metadata);
 }
 
 
 /**
- * _g_digicam_camerabin_set_exposure_mode:
- * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinExposureModeHelper.
- *
- * Implementation of "set_exposure_mode" GDigicam operation
- * specifically for the "camerabin" GStreamer bin.
+ * g_digicam_camerabin_set_prerecord:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @milliseconds: The time recorded before the start of the
+ * recordings, or 0 to disable it.
+ * @max_bytes: The maximum memory used to keep it.
  *
- * Returns: #FALSE if invalid input arguments are received or the
- * operation fails, #TRUE otherwise.
+ * Makes the video recordings start up to @milliseconds before
+ * g_digicam_manager_start_recording_video() is called, so no frame is
+ * lost while the encoder starts. While the video mode is idle the
+ * last frames of the video source are copied to a ring bounded by
+ * @milliseconds and @max_bytes, and they are recorded first when the
+ * recording starts.
  **/
-static gboolean
-_g_digicam_camerabin_set_exposure_mode (GDigicamManager *manager,
-                                        gpointer user_data)
+void
+g_digicam_camerabin_set_prerecord (GstElement *gst_camera_bin,
+                                   guint milliseconds,
+                                   guint max_bytes)
 {
-    GDigicamCamerabinExposureModeHelper *helper = NULL;
-    GstElement *bin = NULL;
-    GstSceneMode value;
-    GDigicamFocusmode focus_mode;
-    gboolean macro_enabled;
-    GError *error = NULL;
-    gboolean result;
-    GDigicamMode mode;
-
-    helper = (GDigicamCamerabinExposureModeHelper *) user_data;
+    PrerecordState *state = NULL;
+    gint mode = 0;
 
-    TSTAMP (gst-scene-mode);
+    g_return_if_fail (GST_IS_ELEMENT (gst_camera_bin));
 
-    /* Get "camerabin" Gstreamer bin  */
-    result = g_digicam_manager_get_gstreamer_bin (manager,
-                                                  &bin,
-                                                  &error);
+    /* Drop the previous ring, if any */
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_PRERECORD_KEY, NULL);
 
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
+    if ((0 == milliseconds) || (0 == max_bytes)) {
+        return;
     }
 
-    result = g_digicam_manager_get_mode (manager,
-                                         &mode,
-                                         &error);
-
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
+    state = g_slice_new0 (PrerecordState);
+    _probe_state_init (&state->probes, gst_camera_bin,
+                       sizeof (PrerecordState),
+                       (GDestroyNotify) _prerecord_state_finalize);
+    state->milliseconds = milliseconds;
+    state->max_bytes = max_bytes;
+    state->ring = _g_digicam_camerabin_prerecord_new (milliseconds * GST_MSECOND,
+                                                      max_bytes);
+    state->source_pad = _get_element_pad (gst_camera_bin, "videosrc", "src");
+    if (NULL == state->source_pad) {
+        G_DIGICAM_WARN ("GDigicamCamerabin::g_digicam_camerabin_set_prerecord: "
+                        "no video source to record from.");
+        _prerecord_state_free (state);
+        return;
     }
+    state->source_probe = gst_pad_add_buffer_probe (state->source_pad,
+                                                    G_CALLBACK (_prerecord_source_probe),
+                                                    state);
 
-    if (mode == G_DIGICAM_MODE_VIDEO) {
-	if (helper->exposure_mode == G_DIGICAM_EXPOSUREMODE_NIGHT) {
-	    value = GST_PHOTOGRAPHY_SCENE_MODE_NIGHT;
-	} else {
-	    value = GST_PHOTOGRAPHY_SCENE_MODE_AUTO;
-	}
-    } else {
-	switch (helper->exposure_mode) {
-	case G_DIGICAM_EXPOSUREMODE_AUTO:
-	    if (NULL != error) {
-		g_error_free (error);
-		error = NULL;
-	    }
-
-	    result = g_digicam_manager_get_focus_mode (manager,
-						       &focus_mode,
-						       &macro_enabled,
-						       &error);
-
-	    /* Check errors */
-	    if (!result) {
-		if (NULL != error) {
-		    G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-		}
-		goto free;
-	    }
+    g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                            G_DIGICAM_CAMERABIN_PRERECORD_KEY,
+                            state,
+                            (GDestroyNotify) _prerecord_state_free);
 
-	    if (macro_enabled) {
-		value = GST_PHOTOGRAPHY_SCENE_MODE_CLOSEUP;
-	    } else {
-		value = GST_PHOTOGRAPHY_SCENE_MODE_AUTO;
-	    }
-	    break;
-	case G_DIGICAM_EXPOSUREMODE_LANDSCAPE:
-	    value = GST_PHOTOGRAPHY_SCENE_MODE_LANDSCAPE;
-	    break;
-	case G_DIGICAM_EXPOSUREMODE_NIGHT:
-	    value = GST_PHOTOGRAPHY_SCENE_MODE_NIGHT;
-	    break;
-	case G_DIGICAM_EXPOSUREMODE_PORTRAIT:
-	    value = GST_PHOTOGRAPHY_SCENE_MODE_PORTRAIT;
-	    break;
-	case G_DIGICAM_EXPOSUREMODE_SPORTS:
-	    value = GST_PHOTOGRAPHY_SCENE_MODE_SPORT;
-	    break;
-	default:
-	    g_assert_not_reached ();
-	}
-    }
+    g_object_get (gst_camera_bin, "mode", &mode, NULL);
+    _prerecord_set_collecting (gst_camera_bin, 1 == mode);
+}
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new scene mode to %i\n",
-                     value);
 
-    TSTAMP (gst-before-scenemode);
+/**
+ * g_digicam_camerabin_get_prerecord:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @milliseconds: Return location for the time recorded before the
+ * start of the recordings, or #NULL.
+ * @max_bytes: Return location for the maximum memory used to keep
+ * it, or #NULL.
+ *
+ * Gets the values given to g_digicam_camerabin_set_prerecord().
+ *
+ * Returns: #TRUE if the recordings start before they are requested,
+ * #FALSE otherwise.
+ **/
+gboolean
+g_digicam_camerabin_get_prerecord (GstElement *gst_camera_bin,
+                                   guint *milliseconds,
+                                   guint *max_bytes)
+{
+    PrerecordState *state = NULL;
 
-    result = gst_photography_set_scene_mode (GST_PHOTOGRAPHY (bin),
-                                             value);
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
 
-    TSTAMP (gst-after-scenemode);
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_PRERECORD_KEY);
 
-    /* free */
-free:
-    if (NULL != bin) {
-        gst_object_unref (bin);
+    if (NULL != milliseconds) {
+        *milliseconds = (NULL != state) ? state->milliseconds : 0;
     }
-    if (NULL != error) {
-        g_error_free (error);
+    if (NULL != max_bytes) {
+        *max_bytes = (NULL != state) ? state->max_bytes : 0;
     }
 
-    return result;
+    return (NULL != state);
 }
 
 
 /**
- * _g_digicam_camerabin_set_exposure_comp:
- * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinExposureCompHelper.
+ * g_digicam_camerabin_set_zsl:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @max_bytes: The maximum memory used to keep the frames, or 0 to
+ * disable it.
  *
- * Implementation of "set_exposure_comp" GDigicam operation
- * specifically for the "camerabin" GStreamer bin.
+ * Enables zero shutter lag still captures. The video source then runs
+ * at the capture resolution in still mode, and its last frames are
+ * copied to a ring bounded by @max_bytes. A still capture saves the
+ * frame closest to the moment g_digicam_manager_capture_still_picture()
+ * was called, encoded in the background, instead of waiting for the
+ * source to deliver a new one. If there is none yet, the capture is
+ * done by CameraBin as usual. The metadata of these pictures is always
+ * deferred, see g_digicam_camerabin_set_deferred_metadata().
  *
- * Returns: #FALSE if invalid input arguments are received or the
- * operation fails, #TRUE otherwise.
+ * The source resolution changes the next time the resolution or the
+ * aspect ratio are set, so this is best called before.
+ *
+ * Returns: #FALSE if zero shutter lag captures are not supported,
+ * #TRUE otherwise.
  **/
-static gboolean
-_g_digicam_camerabin_set_exposure_comp (GDigicamManager *manager,
-                                        gpointer user_data)
+gboolean
+g_digicam_camerabin_set_zsl (GstElement *gst_camera_bin,
+                             guint max_bytes)
 {
-    GDigicamCamerabinExposureCompHelper *helper = NULL;
-    GstElement *bin = NULL;
-    GError *error = NULL;
-    gboolean result;
+#ifdef HAVE_JPEG
+    ZslState *state = NULL;
+    gint mode = 0;
+#endif
 
-    helper = (GDigicamCamerabinExposureCompHelper *) user_data;
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
 
-    /* Get "camerabin" Gstreamer bin  */
-    result = g_digicam_manager_get_gstreamer_bin (manager,
-                                                  &bin,
-                                                  &error);
+#ifdef HAVE_JPEG
+    /* Drop the previous ring, if any */
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_ZSL_KEY, NULL);
 
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
+    if (0 == max_bytes) {
+        return TRUE;
     }
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new exposure value to %f\n",
-                     helper->exposure_comp);
+    state = g_slice_new0 (ZslState);
+    _probe_state_init (&state->probes, gst_camera_bin,
+                       sizeof (ZslState),
+                       (GDestroyNotify) _zsl_state_finalize);
+    state->max_bytes = max_bytes;
+    state->ring = _g_digicam_camerabin_prerecord_new (G_DIGICAM_CAMERABIN_ZSL_HISTORY,
+                                                      max_bytes);
+    state->source_pad = _get_element_pad (gst_camera_bin, "videosrc", "src");
+    if (NULL == state->source_pad) {
+        G_DIGICAM_WARN ("GDigicamCamerabin::g_digicam_camerabin_set_zsl: "
+                        "no video source to capture from.");
+        _zsl_state_free (state);
+        return FALSE;
+    }
+    state->encoder = _image_encoder_ref ();
+    state->source_probe = gst_pad_add_buffer_probe (state->source_pad,
+                                                    G_CALLBACK (_zsl_source_probe),
+                                                    state);
 
-    result = gst_photography_set_ev_compensation (GST_PHOTOGRAPHY (bin),
-                                                  helper->exposure_comp);
+    g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                            G_DIGICAM_CAMERABIN_ZSL_KEY,
+                            state,
+                            (GDestroyNotify) _zsl_state_free);
 
-    /* free */
-free:
-    if (NULL != bin) {
-        gst_object_unref (bin);
-    }
-    if (NULL != error) {
-        g_error_free (error);
+    g_object_get (gst_camera_bin, "mode", &mode, NULL);
+    _zsl_set_collecting (gst_camera_bin, 0 == mode);
+
+    return TRUE;
+#else
+    if (0 != max_bytes) {
+        G_DIGICAM_WARN ("GDigicamCamerabin::g_digicam_camerabin_set_zsl: "
+                        "built without JPEG support.");
     }
 
-    return result;
+    return (0 == max_bytes);
+#endif
 }
 
 
 /**
- * _g_digicam_camerabin_set_iso_sensitivity_mode:
- * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinIsoSensitivityHelper.
+ * g_digicam_camerabin_get_zsl:
+ * @gst_camera_bin: A CameraBin #GstElement.
  *
- * Implementation of "set_iso_sensitivity" GDigicam operation
- * specifically for the "camerabin" GStreamer bin.
+ * Gets the value given to g_digicam_camerabin_set_zsl().
  *
- * Returns: #FALSE if invalid input arguments are received or the
- * operation fails, #TRUE otherwise.
+ * Returns: The maximum memory used to keep the frames, 0 if zero
+ * shutter lag captures are disabled.
  **/
-static gboolean
-_g_digicam_camerabin_set_iso_sensitivity_mode (GDigicamManager *manager,
-                                               gpointer user_data)
+guint
+g_digicam_camerabin_get_zsl (GstElement *gst_camera_bin)
 {
-    GDigicamCamerabinIsoSensitivityHelper *helper = NULL;
-    GstElement *bin = NULL;
-    GError *error = NULL;
-    gboolean result;
+#ifdef HAVE_JPEG
+    ZslState *state = NULL;
+#endif
 
-    helper = (GDigicamCamerabinIsoSensitivityHelper *) user_data;
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), 0);
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new iso value to %i\n",
-                     helper->iso_value);
+#ifdef HAVE_JPEG
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_ZSL_KEY);
 
-    /* Get "camerabin" Gstreamer bin  */
-    result = g_digicam_manager_get_gstreamer_bin (manager,
-                                                  &bin,
-                                                  &error);
+    return (NULL != state) ? state->max_bytes : 0;
+#else
+    return 0;
+#endif
+}
 
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
+
+/**
+ * g_digicam_camerabin_set_parallel_encoding:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @parallel: Whether the pictures are encoded in parallel.
+ *
+ * Encodes the still pictures CameraBin captures with the encoders of
+ * the zero shutter lag pictures, see g_digicam_camerabin_set_zsl(),
+ * instead of its image encoder: as many pictures as cores are encoded
+ * at the same time, each one split in the strips set in the [imageenc]
+ * section of the configuration file, and saved by the writer, see
+ * g_digicam_camerabin_set_async_writer(). A capture fails with
+ * #G_DIGICAM_ERROR_BUSY while the encoders have no room, so the
+ * captures don't get ahead of them. The metadata of these pictures is
+ * always deferred, see g_digicam_camerabin_set_deferred_metadata().
+ *
+ * The pictures captured to memory, see
+ * g_digicam_camerabin_set_picture_buffers(), or given a descriptor,
+ * see g_digicam_camerabin_set_output_fd(), are still encoded by
+ * CameraBin.
+ *
+ * Returns: #FALSE if it is not supported, #TRUE otherwise.
+ **/
+gboolean
+g_digicam_camerabin_set_parallel_encoding (GstElement *gst_camera_bin,
+                                           gboolean parallel)
+{
+#ifdef HAVE_JPEG
+    EncodeState *state = NULL;
+#endif
+
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
+
+#ifdef HAVE_JPEG
+    if (!parallel) {
+        g_object_set_data (G_OBJECT (gst_camera_bin),
+                           G_DIGICAM_CAMERABIN_ENCODE_KEY, NULL);
+        return TRUE;
     }
 
-    /* Establish new iso value */
-    /* FIXME: what about the auto iso value ? */
-    result = gst_photography_set_iso_speed (GST_PHOTOGRAPHY (bin),
-                                            helper->iso_value);
-    /* free */
-free:
-    if (NULL != bin) {
-        gst_object_unref (bin);
+    if (NULL != g_object_get_data (G_OBJECT (gst_camera_bin),
+                                   G_DIGICAM_CAMERABIN_ENCODE_KEY)) {
+        return TRUE;
     }
-    if (NULL != error) {
-        g_error_free (error);
+
+    state = g_slice_new0 (EncodeState);
+    _probe_state_init (&state->probes, gst_camera_bin,
+                       sizeof (EncodeState),
+                       (GDestroyNotify) _encode_state_finalize);
+    state->gst_camera_bin = gst_camera_bin;
+    state->encoder_pad = _get_element_pad (gst_camera_bin, "imageenc",
+                                           "sink");
+    state->encoder = _image_encoder_ref ();
+    if ((NULL == state->encoder_pad) || (NULL == state->encoder)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin::"
+                        "g_digicam_camerabin_set_parallel_encoding: "
+                        "no image encoder to take the pictures from.");
+        _encode_state_free (state);
+        return FALSE;
     }
+    state->encoder_probe = gst_pad_add_buffer_probe (state->encoder_pad,
+                                                     G_CALLBACK (_encode_probe),
+                                                     state);
 
-    return result;
+    g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                            G_DIGICAM_CAMERABIN_ENCODE_KEY,
+                            state,
+                            (GDestroyNotify) _encode_state_free);
+
+    return TRUE;
+#else
+    if (parallel) {
+        G_DIGICAM_WARN ("GDigicamCamerabin::"
+                        "g_digicam_camerabin_set_parallel_encoding: "
+                        "built without JPEG support.");
+    }
+
+    return !parallel;
+#endif
 }
 
 
 /**
- * _g_digicam_camerabin_set_white_balance_mode:
- * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinWhitebalanceModeHelper.
+ * g_digicam_camerabin_get_parallel_encoding:
+ * @gst_camera_bin: A CameraBin #GstElement.
  *
- * Implementation of "set_white_balance_mode" GDigicam operation
- * specifically for the "camerabin" GStreamer bin.
+ * Gets the value set with g_digicam_camerabin_set_parallel_encoding().
  *
- * Returns: #FALSE if invalid input arguments are received or the
- * operation fails, #TRUE otherwise.
+ * Returns: #TRUE if the pictures are encoded in parallel, #FALSE
+ * otherwise.
  **/
-static gboolean
-_g_digicam_camerabin_set_white_balance_mode (GDigicamManager *manager,
-                                             gpointer user_data)
+gboolean
+g_digicam_camerabin_get_parallel_encoding (GstElement *gst_camera_bin)
 {
-    GDigicamCamerabinWhitebalanceModeHelper *helper = NULL;
-    GstElement *bin = NULL;
-    GError *error = NULL;
-    GstWhiteBalanceMode value;
-    gboolean result;
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
 
-    helper = (GDigicamCamerabinWhitebalanceModeHelper *) user_data;
+#ifdef HAVE_JPEG
+    return (NULL != g_object_get_data (G_OBJECT (gst_camera_bin),
+                                       G_DIGICAM_CAMERABIN_ENCODE_KEY));
+#else
+    return FALSE;
+#endif
+}
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new white balance "
-                     "value to %i\n",
-                     helper->wb_mode);
+
+/**
+ * g_digicam_camerabin_set_async_writer:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @enabled: Whether the still pictures are saved by GDigicam.
+ *
+ * Makes the still pictures be saved by a GDigicam thread instead of
+ * the CameraBin file sink, so a slow card doesn't stall the
+ * capture. The encoded pictures are written to a temporary file,
+ * synced and renamed to their name, and the ones of a burst are synced
+ * together. The "pict-done" signal of the #GDigicamManager is then
+ * only emitted once the picture is on disk, from the main loop, and
+ * the value it returns is ignored: CameraBin goes on with a burst if
+ * the "filename" of its next picture is set before the current one is
+ * done. Zero shutter lag pictures, see g_digicam_camerabin_set_zsl(),
+ * are always saved this way.
+ *
+ * Returns: #FALSE if the pictures can't be saved by GDigicam, #TRUE
+ * otherwise.
+ **/
+gboolean
+g_digicam_camerabin_set_async_writer (GstElement *gst_camera_bin,
+                                      gboolean enabled)
+{
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
+
+    if (enabled && (NULL == g_once (&writer_once, _writer_new, NULL))) {
+        return FALSE;
+    }
+
+    return _writer_state_update (gst_camera_bin,
+                                 enabled,
+                                 g_digicam_camerabin_get_picture_buffers (gst_camera_bin));
+}
+
+
+/**
+ * g_digicam_camerabin_get_async_writer:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ *
+ * Gets whether the still pictures are saved by GDigicam. See
+ * g_digicam_camerabin_set_async_writer().
+ *
+ * Returns: #TRUE if they are, #FALSE if CameraBin saves them.
+ **/
+gboolean
+g_digicam_camerabin_get_async_writer (GstElement *gst_camera_bin)
+{
+    WriterState *state = NULL;
+
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_WRITER_KEY);
+
+    return ((NULL != state) && state->async);
+}
+
+
+/**
+ * g_digicam_camerabin_set_picture_buffers:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @enabled: Whether the still pictures are captured to memory.
+ *
+ * Makes the encoded still pictures be handed in the "picture-buffer"
+ * signal of the #GDigicamManager, so they don't have to be read back
+ * from their files. A picture captured with a #NULL file_path in its
+ * #GDigicamCamerabinPictureHelper is then only captured to memory,
+ * nothing is written, and "pict-done" is emitted with a #NULL
+ * filename. Both signals are emitted from the main loop,
+ * "picture-buffer" first, and the value "pict-done" returns is
+ * ignored, as with g_digicam_camerabin_set_async_writer(). Zero
+ * shutter lag frames, see g_digicam_camerabin_set_zsl(), are not used
+ * for those.
+ *
+ * Returns: #FALSE if the pictures can't be captured to memory, #TRUE
+ * otherwise.
+ **/
+gboolean
+g_digicam_camerabin_set_picture_buffers (GstElement *gst_camera_bin,
+                                         gboolean enabled)
+{
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
+
+    return _writer_state_update (gst_camera_bin,
+                                 g_digicam_camerabin_get_async_writer (gst_camera_bin),
+                                 enabled);
+}
+
+
+/**
+ * g_digicam_camerabin_get_picture_buffers:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ *
+ * Gets whether the still pictures are captured to memory. See
+ * g_digicam_camerabin_set_picture_buffers().
+ *
+ * Returns: #TRUE if they are, #FALSE otherwise.
+ **/
+gboolean
+g_digicam_camerabin_get_picture_buffers (GstElement *gst_camera_bin)
+{
+    WriterState *state = NULL;
+
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_WRITER_KEY);
+
+    return ((NULL != state) && state->picture_buffers);
+}
+
+
+/**
+ * g_digicam_camerabin_set_output_fd:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @fd: A file descriptor open for writing, or -1.
+ *
+ * Makes the next still picture or video recording be written to @fd,
+ * from its current position, instead of to the file_path of its
+ * #GDigicamCamerabinPictureHelper or #GDigicamCamerabinVideoHelper,
+ * which is ignored. @fd can be an open file, a pipe or a memfd, it is
+ * duplicated, so the caller can close it at once. "pict-done" is
+ * emitted with a #NULL filename for the pictures written to it, and
+ * zero shutter lag frames, see g_digicam_camerabin_set_zsl(), are not
+ * used for those.
+ *
+ * Recordings written to a descriptor which can't seek, or which was
+ * opened with O_APPEND, must not need to go back, so their muxer
+ * should be fragmented, see g_digicam_camerabin_set_segments(). A
+ * recording which can't be written to @fd, because it doesn't go
+ * through a file sink, is not started. A -1 @fd forgets the one not
+ * used yet.
+ *
+ * Returns: #FALSE if @fd is not valid or not open for writing, #TRUE
+ * otherwise.
+ **/
+gboolean
+g_digicam_camerabin_set_output_fd (GstElement *gst_camera_bin,
+                                   gint fd)
+{
+    GDigicamCamerabinOutput *output = NULL;
+    GError *error = NULL;
+
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
+
+    if (0 <= fd) {
+        output = _g_digicam_camerabin_output_new (fd, &error);
+        if (NULL == output) {
+            G_DIGICAM_WARN ("GDigicamCamerabin: %s", error->message);
+            g_error_free (error);
+            return FALSE;
+        }
+    }
+
+    g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                            G_DIGICAM_CAMERABIN_OUTPUT_KEY,
+                            output,
+                            (GDestroyNotify) _g_digicam_camerabin_output_free);
+
+    return TRUE;
+}
+
+
+/**
+ * g_digicam_camerabin_set_segments:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @seconds: The length of the segments, or 0.
+ * @max_bytes: The size of the segments, or 0.
+ * @reserved: The free space kept in the file system by deleting the
+ * oldest segments of the recording, or 0 to keep them all.
+ *
+ * Makes the next video recordings be split in several files, each one
+ * playable on its own, without stopping the encoder or losing any
+ * frame. A new segment is started at the first keyframe after the
+ * current one reaches @seconds or @max_bytes. The first segment is
+ * written to the file given to
+ * g_digicam_manager_start_recording_video(), and the next ones to
+ * files named after it, with the number of the segment before the
+ * extension, like "video-002.mp4". Only the segments of the current
+ * recording are deleted to make room, and never the one before the
+ * current one.
+ *
+ * The video muxer has to write fragmented files, see the
+ * "fragment-duration" property of mp4mux, and its fragments have to
+ * be shorter than the segments.
+ *
+ * Returns: #FALSE if the video muxer doesn't write fragmented files,
+ * #TRUE otherwise.
+ **/
+gboolean
+g_digicam_camerabin_set_segments (GstElement *gst_camera_bin,
+                                  guint seconds,
+                                  guint64 max_bytes,
+                                  guint64 reserved)
+{
+    SegmentsConfig *segments = NULL;
+    GstElement *vmux = NULL;
+    guint fragment_duration = 0;
+
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
+
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_SEGMENTS_KEY, NULL);
+
+    if ((0 == seconds) && (0 == max_bytes)) {
+        return TRUE;
+    }
+
+    g_object_get (gst_camera_bin, "videomux", &vmux, NULL);
+    if (NULL != vmux) {
+        if (NULL != g_object_class_find_property (G_OBJECT_GET_CLASS (vmux),
+                                                  "fragment-duration")) {
+            g_object_get (vmux, "fragment-duration", &fragment_duration, NULL);
+        }
+        gst_object_unref (vmux);
+    }
+    if (0 == fragment_duration) {
+        G_DIGICAM_WARN ("GDigicamCamerabin::g_digicam_camerabin_set_segments: "
+                        "the video muxer doesn't write fragmented files.");
+        return FALSE;
+    }
+
+    segments = g_new0 (SegmentsConfig, 1);
+    segments->seconds = seconds;
+    segments->max_bytes = max_bytes;
+    segments->reserved = reserved;
+
+    g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                            G_DIGICAM_CAMERABIN_SEGMENTS_KEY,
+                            segments,
+                            g_free);
+
+    return TRUE;
+}
+
+
+/**
+ * g_digicam_camerabin_get_segments:
+ * @gst_camera_bin: A CameraBin #GstElement.
+ * @seconds: Return location for the length of the segments, or
+ * #NULL.
+ * @max_bytes: Return location for the size of the segments, or
+ * #NULL.
+ * @reserved: Return location for the free space kept, or #NULL.
+ *
+ * Gets the values given to g_digicam_camerabin_set_segments().
+ *
+ * Returns: #TRUE if the recordings are split in segments, #FALSE
+ * otherwise.
+ **/
+gboolean
+g_digicam_camerabin_get_segments (GstElement *gst_camera_bin,
+                                  guint *seconds,
+                                  guint64 *max_bytes,
+                                  guint64 *reserved)
+{
+    SegmentsConfig *segments = NULL;
+
+    g_return_val_if_fail (GST_IS_ELEMENT (gst_camera_bin), FALSE);
+
+    segments = g_object_get_data (G_OBJECT (gst_camera_bin),
+                                  G_DIGICAM_CAMERABIN_SEGMENTS_KEY);
+
+    if (NULL != seconds) {
+        *seconds = (NULL != segments) ? segments->seconds : 0;
+    }
+    if (NULL != max_bytes) {
+        *max_bytes = (NULL != segments) ? segments->max_bytes : 0;
+    }
+    if (NULL != reserved) {
+        *reserved = (NULL != segments) ? segments->reserved : 0;
+    }
+
+    return (NULL != segments);
+}
+
+
+/****************************************************************/
+/* Private functions implementing the abstract public functions */
+/****************************************************************/
+
+
+/**
+ * _g_digicam_camerabin_set_mode:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GDigicamCamerabinModeHelper.
+ *
+ * Implementation of "set_mode" GDigicam operation specifically for
+ * the "camerabin" GStreamer bin.
+ *
+ * Returns: #FALSE if invalid input arguments are received or the
+ * operation fails, #TRUE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_set_mode (GDigicamManager *manager,
+                               gpointer user_data)
+{
+    GDigicamCamerabinModeHelper *helper = NULL;
+    GError *error = NULL;
+    GstElement *bin = NULL;
+    gboolean result;
+
+    helper = (GDigicamCamerabinModeHelper *) user_data;
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting operation mode  ...\n");
+
+    TSTAMP (gst-before-mode-changed);
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
@@ -1282,34 +2203,27 @@ _g_digicam_camerabin_set_white_balance_mode (GDigicamManager *manager,
         goto free;
     }
 
-    /* Mapping values */
-    switch (helper->wb_mode) {
-    case G_DIGICAM_WHITEBALANCEMODE_AUTO:
-        value = GST_PHOTOGRAPHY_WB_MODE_AUTO;
-        break;
-    case G_DIGICAM_WHITEBALANCEMODE_SUNLIGHT:
-        value = GST_PHOTOGRAPHY_WB_MODE_DAYLIGHT;
-        break;
-    case G_DIGICAM_WHITEBALANCEMODE_CLOUDY:
-        value = GST_PHOTOGRAPHY_WB_MODE_CLOUDY;
-        break;
-    case G_DIGICAM_WHITEBALANCEMODE_TUNGSTEN:
-        value = GST_PHOTOGRAPHY_WB_MODE_TUNGSTEN;
-        break;
-    case G_DIGICAM_WHITEBALANCEMODE_FLUORESCENT:
-        value = GST_PHOTOGRAPHY_WB_MODE_FLUORESCENT;
+
+    /* FIXME: Pending of camerabin integration */
+    switch (helper->mode) {
+    case G_DIGICAM_MODE_STILL:
+        g_object_set (bin, "mode", 0, NULL);
         break;
-    case G_DIGICAM_WHITEBALANCEMODE_FLASH:
-        value = GST_PHOTOGRAPHY_WB_MODE_SUNSET;
+    case G_DIGICAM_MODE_VIDEO:
+        g_object_set (bin, "mode", 1, NULL);
         break;
     default:
         g_assert_not_reached ();
     }
 
+    /* Only an idle video mode fills the pre-record ring */
+    _prerecord_set_collecting (bin, G_DIGICAM_MODE_VIDEO == helper->mode);
+#ifdef HAVE_JPEG
+    /* And a still one the zero shutter lag one */
+    _zsl_set_collecting (bin, G_DIGICAM_MODE_STILL == helper->mode);
+#endif
 
-    /* Establish new white balance value  */
-    result = gst_photography_set_white_balance_mode (GST_PHOTOGRAPHY (bin),
-                                                     value);
+    TSTAMP (gst-after-mode-changed);
 
     /* free */
 free:
@@ -1325,34 +2239,36 @@ free:
 
 
 /**
- * _g_digicam_camerabin_set_quality:
+ * _g_digicam_camerabin_set_flash_mode:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinQualityHelper.
+ * @user_data: A #GDigicamCamerabinFlashModeHelper.
  *
- * Implementation of "set_quality" GDigicam operation specifically for
- * the "camerabin" GStreamer bin.
+ * Implementation of "set_flash_mode" GDigicam operation specifically
+ * for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
  * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_set_quality (GDigicamManager *manager,
-                                  gpointer user_data)
+_g_digicam_camerabin_set_flash_mode (GDigicamManager *manager,
+                                     gpointer user_data)
 {
-    GstElement *bin = NULL;
-    GDigicamCamerabinQualityHelper *helper = NULL;
+    GDigicamCamerabinFlashModeHelper *helper = NULL;
     GError *error = NULL;
+    GstElement *bin = NULL;
+    GstFlashMode value;
     gboolean result;
 
-    helper = (GDigicamCamerabinQualityHelper *) user_data;
+    helper = (GDigicamCamerabinFlashModeHelper *) user_data;
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new quality \n");
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting flash mode  ...\n");
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
                                                   &bin,
                                                   &error);
 
+
     /* Check errors */
     if (!result) {
         if (NULL != error) {
@@ -1361,10 +2277,27 @@ _g_digicam_camerabin_set_quality (GDigicamManager *manager,
         goto free;
     }
 
-    /* FIXME: once camera bin has support for quality, use proper API. */
-    /* Establish new quality value  */
-/*     result = gst_photography_set_quality (GST_PHOTOGRAPHY (bin), */
-/*                                           value); */
+    switch (helper->flash_mode) {
+    case G_DIGICAM_FLASHMODE_AUTO:
+        /* FIXME: the AUTO scene mode is unimplemented in camerabin side.*/
+        value = GST_PHOTOGRAPHY_FLASH_MODE_AUTO;
+        break;
+    case G_DIGICAM_FLASHMODE_OFF:
+        value = GST_PHOTOGRAPHY_FLASH_MODE_OFF;
+        break;
+    case G_DIGICAM_FLASHMODE_ON:
+        value = GST_PHOTOGRAPHY_FLASH_MODE_ON;
+        break;
+    case G_DIGICAM_FLASHMODE_REDEYEREDUCTION:
+        value = GST_PHOTOGRAPHY_FLASH_MODE_RED_EYE;
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+
+    /* Establish new flash mode */
+    result = gst_photography_set_flash_mode (GST_PHOTOGRAPHY (bin),
+                                             value);
 
     /* free */
 free:
@@ -1380,37 +2313,28 @@ free:
 
 
 /**
- * _g_digicam_camerabin_set_aspect_ratio_resolution:
+ * _g_digicam_camerabin_set_focus_mode:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinAspectRatioResolutionHelper.
+ * @user_data: A #GDigicamCamerabinFocusModeHelper.
  *
- * Implementation of "set_resolution" and "set_aspect_ratio" GDigicam
- * operations specifically for the "camerabin" GStreamer bin.
+ * Implementation of "set_focus_mode" GDigicam operation specifically
+ * for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
  * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_set_aspect_ratio_resolution (GDigicamManager *manager,
-                                                  gpointer user_data)
+_g_digicam_camerabin_set_focus_mode (GDigicamManager *manager,
+                                     gpointer user_data)
 {
-    GDigicamCamerabinAspectRatioResolutionHelper *helper = NULL;
+    GDigicamCamerabinFocusModeHelper *helper = NULL;
     GstElement *bin = NULL;
-    GstCaps *preview_caps = NULL;
-    GDigicamMode mode;
     GError *error = NULL;
-    gint vf_w, vf_h;
-    gint res_w, res_h;
-    gint fps_n, fps_d;
-    gboolean enabled;
     gboolean result;
 
-    helper = (GDigicamCamerabinAspectRatioResolutionHelper *) user_data;
-
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new aspect ratio "
-                     "and resolution \n");
+    helper = (GDigicamCamerabinFocusModeHelper *) user_data;
 
-    TSTAMP (gst-resolution);
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting focus mode");
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
@@ -1425,73 +2349,65 @@ _g_digicam_camerabin_set_aspect_ratio_resolution (GDigicamManager *manager,
         goto free;
     }
 
-    /* Get mode to set specific resolution and aspect ratio*/
-    result = g_digicam_manager_get_mode (manager,
-                                         &mode,
-                                         &error);
+    /* TODO: Specific implementation to set the focus mode */
 
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
+    /* free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
     }
 
+    return result;
+}
 
-    TSTAMP (gst-before-res-changed);
-
-    /* Get resolution specific values depending on the camera mode */
-    _get_aspect_ratio_and_resolution (mode,
-                                      helper->aspect_ratio,
-                                      helper->resolution,
-                                      &vf_w, &vf_h,
-                                      &res_w, &res_h,
-                                      &fps_n, &fps_d);
 
-    /* Set Image Capturing settings  */
-    if (G_DIGICAM_MODE_STILL == mode) {
- 	G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting capture resolution "
-                         "to %dx%d\n", res_w, res_h);
+/**
+ * _g_digicam_camerabin_set_focus_region_pattern:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GDigicamCamerabinFocusRegionPatternHelper.
+ *
+ * Implementation of "set_focus_region_pattern" GDigicam operation
+ * specifically for the "camerabin" GStreamer bin.
+ *
+ * Returns: #FALSE if invalid input arguments are received or the
+ * operation fails, #TRUE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_set_focus_region_pattern (GDigicamManager *manager,
+                                               gpointer user_data)
+{
+    GDigicamCamerabinFocusRegionPatternHelper *helper = NULL;
+    GstElement *bin = NULL;
+    GError *error = NULL;
+    gboolean result;
 
-        /* Capture resolution */
- 	g_signal_emit_by_name (bin,
- 			       "user-image-res",
- 			       res_w, res_h,
- 			       0);
-    }
+    helper = (GDigicamCamerabinFocusRegionPatternHelper *) user_data;
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new recording/viewfinder "
-                     "resolution and fps: %dx%d at %d/%d fps \n",
-                     vf_w, vf_h, fps_n, fps_d);
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting focus region pattern");
 
-    /* Sete Viewfinder and Recording settings */
-    g_signal_emit_by_name (bin,
-                           "user-res-fps",
-                           vf_w, vf_h,
-                           fps_n, fps_d,
-                           0);
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
 
-    /* Preview size will be the same as viewfinder size */
-    g_digicam_manager_preview_enabled (manager, &enabled, NULL);
-    if (enabled) {
-        preview_caps = _new_preview_caps (vf_w, vf_h);
- 	g_object_set (G_OBJECT (bin),
- 		      "preview-caps", preview_caps,
- 		      NULL);
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
     }
 
-
-    TSTAMP (gst-after-res-changed);
+    /* TODO: Specific implementation to set the focus region pattern */
 
     /* free */
 free:
     if (NULL != bin) {
         gst_object_unref (bin);
     }
-    if (NULL != preview_caps) {
-        gst_caps_unref (preview_caps);
-    }
     if (NULL != error) {
         g_error_free (error);
     }
@@ -1501,27 +2417,32 @@ free:
 
 
 /**
- * _g_digicam_camerabin_set_locks:
+ * _g_digicam_camerabin_set_exposure_mode:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinLocksHelper helper data
- * structure.
+ * @user_data: A #GDigicamCamerabinExposureModeHelper.
  *
- * Implementation of "set_focus_mode" GDigicam operation
+ * Implementation of "set_exposure_mode" GDigicam operation
  * specifically for the "camerabin" GStreamer bin.
  *
- * Returns: FALSE if invalid input arguments are received or
- * the operation fails, it returns TRUE otherwise.
+ * Returns: #FALSE if invalid input arguments are received or the
+ * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_set_locks (GDigicamManager *manager,
-                                gpointer user_data)
+_g_digicam_camerabin_set_exposure_mode (GDigicamManager *manager,
+                                        gpointer user_data)
 {
-    GDigicamCamerabinLocksHelper *helper = NULL;
+    GDigicamCamerabinExposureModeHelper *helper = NULL;
     GstElement *bin = NULL;
+    GstSceneMode value;
+    GDigicamFocusmode focus_mode;
+    gboolean macro_enabled;
     GError *error = NULL;
     gboolean result;
+    GDigicamMode mode;
 
-    helper = (GDigicamCamerabinLocksHelper *) user_data;
+    helper = (GDigicamCamerabinExposureModeHelper *) user_data;
+
+    TSTAMP (gst-scene-mode);
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
@@ -1536,15 +2457,78 @@ _g_digicam_camerabin_set_locks (GDigicamManager *manager,
         goto free;
     }
 
-    if (helper->locks & G_DIGICAM_LOCK_AUTOFOCUS) {
-        TSTAMP (before-gst-af);
-        G_DIGICAM_DEBUG ("GDigicamCamerabin: Emit autofocus to camerabin\n");
-	gst_photography_set_autofocus (GST_PHOTOGRAPHY (bin), TRUE);
+    result = g_digicam_manager_get_mode (manager,
+                                         &mode,
+                                         &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
+
+    if (mode == G_DIGICAM_MODE_VIDEO) {
+	if (helper->exposure_mode == G_DIGICAM_EXPOSUREMODE_NIGHT) {
+	    value = GST_PHOTOGRAPHY_SCENE_MODE_NIGHT;
+	} else {
+	    value = GST_PHOTOGRAPHY_SCENE_MODE_AUTO;
+	}
     } else {
-        G_DIGICAM_DEBUG ("GDigicamCamerabin: Stop autofocus to camerabin\n");
-	gst_photography_set_autofocus (GST_PHOTOGRAPHY (bin), FALSE);
+	switch (helper->exposure_mode) {
+	case G_DIGICAM_EXPOSUREMODE_AUTO:
+	    if (NULL != error) {
+		g_error_free (error);
+		error = NULL;
+	    }
+
+	    result = g_digicam_manager_get_focus_mode (manager,
+						       &focus_mode,
+						       &macro_enabled,
+						       &error);
+
+	    /* Check errors */
+	    if (!result) {
+		if (NULL != error) {
+		    G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+		}
+		goto free;
+	    }
+
+	    if (macro_enabled) {
+		value = GST_PHOTOGRAPHY_SCENE_MODE_CLOSEUP;
+	    } else {
+		value = GST_PHOTOGRAPHY_SCENE_MODE_AUTO;
+	    }
+	    break;
+	case G_DIGICAM_EXPOSUREMODE_LANDSCAPE:
+	    value = GST_PHOTOGRAPHY_SCENE_MODE_LANDSCAPE;
+	    break;
+	case G_DIGICAM_EXPOSUREMODE_NIGHT:
+	    value = GST_PHOTOGRAPHY_SCENE_MODE_NIGHT;
+	    break;
+	case G_DIGICAM_EXPOSUREMODE_PORTRAIT:
+	    value = GST_PHOTOGRAPHY_SCENE_MODE_PORTRAIT;
+	    break;
+	case G_DIGICAM_EXPOSUREMODE_SPORTS:
+	    value = GST_PHOTOGRAPHY_SCENE_MODE_SPORT;
+	    break;
+	default:
+	    g_assert_not_reached ();
+	}
     }
 
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new scene mode to %i\n",
+                     value);
+
+    TSTAMP (gst-before-scenemode);
+
+    result = gst_photography_set_scene_mode (GST_PHOTOGRAPHY (bin),
+                                             value);
+
+    TSTAMP (gst-after-scenemode);
+
     /* free */
 free:
     if (NULL != bin) {
@@ -1559,30 +2543,26 @@ free:
 
 
 /**
- * _g_digicam_camerabin_set_zoom:
+ * _g_digicam_camerabin_set_exposure_comp:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinZoomHelper.
+ * @user_data: A #GDigicamCamerabinExposureCompHelper.
  *
- * Implementation of "set_zoom" GDigicam operation specifically
- * for the "camerabin" GStreamer bin.
+ * Implementation of "set_exposure_comp" GDigicam operation
+ * specifically for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
  * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_set_zoom (GDigicamManager *manager,
-                               gpointer user_data)
+_g_digicam_camerabin_set_exposure_comp (GDigicamManager *manager,
+                                        gpointer user_data)
 {
-    GDigicamCamerabinZoomHelper *helper = NULL;
+    GDigicamCamerabinExposureCompHelper *helper = NULL;
     GstElement *bin = NULL;
     GError *error = NULL;
-    gint value;
     gboolean result;
 
-    helper = (GDigicamCamerabinZoomHelper *) user_data;
-
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new zoom value to %f\n",
-                     helper->value);
+    helper = (GDigicamCamerabinExposureCompHelper *) user_data;
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
@@ -1597,10 +2577,11 @@ _g_digicam_camerabin_set_zoom (GDigicamManager *manager,
         goto free;
     }
 
-    /* Establish new zoom value */
-    /* FIXME: What about digital zoom */
-    value = 100 * helper->value;
-    g_object_set (bin, "zoom", value, NULL);
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new exposure value to %f\n",
+                     helper->exposure_comp);
+
+    result = gst_photography_set_ev_compensation (GST_PHOTOGRAPHY (bin),
+                                                  helper->exposure_comp);
 
     /* free */
 free:
@@ -1616,30 +2597,29 @@ free:
 
 
 /**
- * _g_digicam_camerabin_set_audio:
+ * _g_digicam_camerabin_set_iso_sensitivity_mode:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinVideoHelper.
+ * @user_data: A #GDigicamCamerabinIsoSensitivityHelper.
  *
- * Implementation of "set_audio" GDigicam operation specifically for
- * the "camerabin" GStreamer bin.
+ * Implementation of "set_iso_sensitivity" GDigicam operation
+ * specifically for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
  * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_set_audio (GDigicamManager *manager,
-                                gpointer user_data)
+_g_digicam_camerabin_set_iso_sensitivity_mode (GDigicamManager *manager,
+                                               gpointer user_data)
 {
-    GDigicamCamerabinVideoHelper *helper = NULL;
+    GDigicamCamerabinIsoSensitivityHelper *helper = NULL;
     GstElement *bin = NULL;
-    gboolean audio_mute;
     GError *error = NULL;
     gboolean result;
 
-    helper = (GDigicamCamerabinVideoHelper *) user_data;
+    helper = (GDigicamCamerabinIsoSensitivityHelper *) user_data;
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new mute value to %d\n",
-                     helper->audio);
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new iso value to %i\n",
+                     helper->iso_value);
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
@@ -1654,15 +2634,10 @@ _g_digicam_camerabin_set_audio (GDigicamManager *manager,
         goto free;
     }
 
-    /* Establish new mute value */
-    if (helper->audio & G_DIGICAM_AUDIO_RECORDOFF) {
-    	audio_mute = TRUE;
-    } else {
-    	audio_mute = FALSE;
-    }
-
-    g_object_set (bin, "mute", audio_mute, NULL);
-
+    /* Establish new iso value */
+    /* FIXME: what about the auto iso value ? */
+    result = gst_photography_set_iso_speed (GST_PHOTOGRAPHY (bin),
+                                            helper->iso_value);
     /* free */
 free:
     if (NULL != bin) {
@@ -1676,55 +2651,38 @@ free:
 }
 
 
-
 /**
- * _g_digicam_camerabin_set_preview_mode:
+ * _g_digicam_camerabin_set_white_balance_mode:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinAspectRatioResolutionHelper.
+ * @user_data: A #GDigicamCamerabinWhitebalanceModeHelper.
  *
- * Implementation of "set_preview_mode" GDigicam operation
+ * Implementation of "set_white_balance_mode" GDigicam operation
  * specifically for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
  * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_set_preview_mode (GDigicamManager *manager,
-                                       gpointer user_data)
+_g_digicam_camerabin_set_white_balance_mode (GDigicamManager *manager,
+                                             gpointer user_data)
 {
-    GDigicamCamerabinPreviewHelper *helper = NULL;
+    GDigicamCamerabinWhitebalanceModeHelper *helper = NULL;
     GstElement *bin = NULL;
-    GstCaps *caps = NULL;
     GError *error = NULL;
-    GDigicamMode mode;
-    GDigicamAspectratio ar;
-    GDigicamResolution res;
-    gint vf_w, vf_h;
-    gint res_w, res_h;
-    gint fps_n, fps_d;
+    GstWhiteBalanceMode value;
     gboolean result;
 
-    helper = (GDigicamCamerabinPreviewHelper *) user_data;
+    helper = (GDigicamCamerabinWhitebalanceModeHelper *) user_data;
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new preview value to %d\n",
-                     helper->mode);
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new white balance "
+                     "value to %i\n",
+                     helper->wb_mode);
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
                                                   &bin,
                                                   &error);
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
-    }
 
-    /* Get operation mode */
-    result = g_digicam_manager_get_mode (manager,
-                                         &mode,
-                                         &error);
     /* Check errors */
     if (!result) {
         if (NULL != error) {
@@ -1733,19 +2691,76 @@ _g_digicam_camerabin_set_preview_mode (GDigicamManager *manager,
         goto free;
     }
 
-    /* Get resoluton */
-    result = g_digicam_manager_get_resolution (manager, &res, &error);
-
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
+    /* Mapping values */
+    switch (helper->wb_mode) {
+    case G_DIGICAM_WHITEBALANCEMODE_AUTO:
+        value = GST_PHOTOGRAPHY_WB_MODE_AUTO;
+        break;
+    case G_DIGICAM_WHITEBALANCEMODE_SUNLIGHT:
+        value = GST_PHOTOGRAPHY_WB_MODE_DAYLIGHT;
+        break;
+    case G_DIGICAM_WHITEBALANCEMODE_CLOUDY:
+        value = GST_PHOTOGRAPHY_WB_MODE_CLOUDY;
+        break;
+    case G_DIGICAM_WHITEBALANCEMODE_TUNGSTEN:
+        value = GST_PHOTOGRAPHY_WB_MODE_TUNGSTEN;
+        break;
+    case G_DIGICAM_WHITEBALANCEMODE_FLUORESCENT:
+        value = GST_PHOTOGRAPHY_WB_MODE_FLUORESCENT;
+        break;
+    case G_DIGICAM_WHITEBALANCEMODE_FLASH:
+        value = GST_PHOTOGRAPHY_WB_MODE_SUNSET;
+        break;
+    default:
+        g_assert_not_reached ();
     }
 
-    /* Get aspect ratio  */
-    result = g_digicam_manager_get_aspect_ratio (manager, &ar, &error);
+
+    /* Establish new white balance value  */
+    result = gst_photography_set_white_balance_mode (GST_PHOTOGRAPHY (bin),
+                                                     value);
+
+    /* free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
+
+    return result;
+}
+
+
+/**
+ * _g_digicam_camerabin_set_quality:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GDigicamCamerabinQualityHelper.
+ *
+ * Implementation of "set_quality" GDigicam operation specifically for
+ * the "camerabin" GStreamer bin.
+ *
+ * Returns: #FALSE if invalid input arguments are received or the
+ * operation fails, #TRUE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_set_quality (GDigicamManager *manager,
+                                  gpointer user_data)
+{
+    GstElement *bin = NULL;
+    GDigicamCamerabinQualityHelper *helper = NULL;
+    GError *error = NULL;
+    gboolean result;
+
+    helper = (GDigicamCamerabinQualityHelper *) user_data;
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new quality \n");
+
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
 
     /* Check errors */
     if (!result) {
@@ -1755,37 +2770,16 @@ _g_digicam_camerabin_set_preview_mode (GDigicamManager *manager,
         goto free;
     }
 
-    /* Get resolution specific values depending on the camera mode */
-    _get_aspect_ratio_and_resolution (mode,
-                                      ar, res,
-                                      &vf_w, &vf_h,
-                                      &res_w, &res_h,
-                                      &fps_n, &fps_d);
-
-    /* Establish new preview mode value */
-    if (helper->mode & G_DIGICAM_PREVIEW_ON) {
-        caps = _new_preview_caps (vf_w, vf_h);
-	g_object_set (G_OBJECT (bin),
-		      "preview-caps", caps,
-		      NULL);
-    } else if (helper->mode & G_DIGICAM_PREVIEW_OFF) {
-	g_object_set (G_OBJECT (bin),
-		      "preview-caps", NULL,
-		      NULL);
-    } else {
-        G_DIGICAM_ERR ("GDigicamCamerabin: invalid preview mode %d received.",
-                       helper->mode);
-        goto free;
-    }
+    /* FIXME: once camera bin has support for quality, use proper API. */
+    /* Establish new quality value  */
+/*     result = gst_photography_set_quality (GST_PHOTOGRAPHY (bin), */
+/*                                           value); */
 
     /* free */
 free:
     if (NULL != bin) {
         gst_object_unref (bin);
     }
-    if (NULL != caps) {
-        gst_caps_unref (caps);
-    }
     if (NULL != error) {
         g_error_free (error);
     }
@@ -1793,29 +2787,39 @@ free:
     return result;
 }
 
+
 /**
- * _g_digicam_camerabin_get_still_picture:
+ * _g_digicam_camerabin_set_aspect_ratio_resolution:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinPictureHelper.
+ * @user_data: A #GDigicamCamerabinAspectRatioResolutionHelper.
  *
- * Implementation of "get_still_picture" GDigicam operation
- * specifically for the "camerabin" GStreamer bin.
+ * Implementation of "set_resolution" and "set_aspect_ratio" GDigicam
+ * operations specifically for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
  * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_get_still_picture (GDigicamManager *manager,
-                                        gpointer user_data)
+_g_digicam_camerabin_set_aspect_ratio_resolution (GDigicamManager *manager,
+                                                  gpointer user_data)
 {
-    GDigicamCamerabinPictureHelper *helper = NULL;
+    GDigicamCamerabinAspectRatioResolutionHelper *helper = NULL;
     GstElement *bin = NULL;
+    GDigicamMode mode;
     GError *error = NULL;
+    gint vf_w, vf_h;
+    gint res_w, res_h;
+    gint fps_n, fps_d;
+    guint window_w = 0, window_h = 0;
+    gboolean enabled;
     gboolean result;
 
-    helper = (GDigicamCamerabinPictureHelper *) user_data;
+    helper = (GDigicamCamerabinAspectRatioResolutionHelper *) user_data;
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Capturing still picture ...");
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new aspect ratio "
+                     "and resolution \n");
+
+    TSTAMP (gst-resolution);
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
@@ -1830,17 +2834,64 @@ _g_digicam_camerabin_get_still_picture (GDigicamManager *manager,
         goto free;
     }
 
+    /* Get mode to set specific resolution and aspect ratio*/
+    result = g_digicam_manager_get_mode (manager,
+                                         &mode,
+                                         &error);
 
-    /* Set application domain metadata */
-    _g_digicam_camerabin_set_picture_metadata (bin, helper->metadata);
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
 
 
-    /* take picture */
-    g_object_set (bin, "filename", helper->file_path, NULL);
-    TSTAMP (before-gst-capture);
-    g_signal_emit_by_name (bin, "user-start", 0);
-    g_signal_emit_by_name (bin, "user-stop", 0);
-    TSTAMP (after-gst-capture);
+    TSTAMP (gst-before-res-changed);
+
+    /* Get resolution specific values depending on the camera mode */
+    result = _get_aspect_ratio_and_resolution (mode,
+                                               helper->aspect_ratio,
+                                               helper->resolution,
+                                               &vf_w, &vf_h,
+                                               &res_w, &res_h,
+                                               &fps_n, &fps_d);
+    if (!result) {
+        goto free;
+    }
+
+    /* Set Image Capturing settings  */
+    if (G_DIGICAM_MODE_STILL == mode) {
+ 	G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting capture resolution "
+                         "to %dx%d\n", res_w, res_h);
+
+        /* Capture resolution */
+ 	g_signal_emit_by_name (bin,
+ 			       "user-image-res",
+ 			       res_w, res_h,
+ 			       0);
+#ifdef HAVE_JPEG
+        _zsl_set_resolution (bin, res_w, res_h);
+#endif
+    }
+
+    /* Viewfinder and recording settings */
+    g_digicam_manager_get_window_geometry (manager,
+                                           &window_w, &window_h,
+                                           NULL);
+    _set_viewfinder_res_fps (bin, mode,
+                             vf_w, vf_h,
+                             fps_n, fps_d,
+                             window_w, window_h,
+                             TRUE);
+
+    /* Preview size depends on the viewfinder one */
+    g_digicam_manager_preview_enabled (manager, &enabled, NULL);
+    _set_preview_caps (manager, bin, enabled, vf_w, vf_h, TRUE);
+
+
+    TSTAMP (gst-after-res-changed);
 
     /* free */
 free:
@@ -1856,28 +2907,35 @@ free:
 
 
 /**
- * _gdigicam_camerabin_start_recording_video:
+ * _g_digicam_camerabin_set_window_geometry:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinVideoHelper.
+ * @user_data: A #GDigicamCamerabinWindowGeometryHelper.
  *
- * Implementation of "start_recording_video" GDigicam operation
+ * Implementation of "set_window_geometry" GDigicam operation
  * specifically for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
  * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_start_recording_video (GDigicamManager *manager,
-                                            gpointer user_data)
+_g_digicam_camerabin_set_window_geometry (GDigicamManager *manager,
+                                          gpointer user_data)
 {
-    GDigicamCamerabinVideoHelper *helper = NULL;
+    GDigicamCamerabinWindowGeometryHelper *helper = NULL;
     GstElement *bin = NULL;
+    GDigicamMode mode;
+    GDigicamAspectratio aspect_ratio;
+    GDigicamResolution resolution;
     GError *error = NULL;
+    gint vf_w, vf_h;
+    gint res_w, res_h;
+    gint fps_n, fps_d;
     gboolean result;
 
-    helper = (GDigicamCamerabinVideoHelper *) user_data;
+    helper = (GDigicamCamerabinWindowGeometryHelper *) user_data;
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Capturing video ...");
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new window geometry "
+                     "%dx%d\n", helper->width, helper->height);
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
@@ -1892,16 +2950,40 @@ _g_digicam_camerabin_start_recording_video (GDigicamManager *manager,
         goto free;
     }
 
+    /* Get mode to recompute the viewfinder size */
+    result = g_digicam_manager_get_mode (manager,
+                                         &mode,
+                                         &error);
 
-    /* Set application domain metadata */
-    _g_digicam_camerabin_set_video_metadata (bin, helper->metadata);
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
 
+    /* Nothing to negotiate until a resolution can be set */
+    if (!g_digicam_manager_get_aspect_ratio (manager,
+                                             &aspect_ratio,
+                                             &error) ||
+        !g_digicam_manager_get_resolution (manager,
+                                           &resolution,
+                                           &error) ||
+        !_get_aspect_ratio_and_resolution (mode,
+                                           aspect_ratio,
+                                           resolution,
+                                           &vf_w, &vf_h,
+                                           &res_w, &res_h,
+                                           &fps_n, &fps_d)) {
+        goto free;
+    }
 
-    /* Start recording mode */
-    g_object_set (bin, "filename", helper->file_path, NULL);
-    TSTAMP (before-gst-video-capture);
-    g_signal_emit_by_name(bin, "user-start", 0);
-    TSTAMP (after-gst-video-capture);
+    _set_viewfinder_res_fps (bin, mode,
+                             vf_w, vf_h,
+                             fps_n, fps_d,
+                             helper->width, helper->height,
+                             FALSE);
 
     /* free */
 free:
@@ -1912,33 +2994,32 @@ free:
         g_error_free (error);
     }
 
-    return TRUE;
+    return result;
 }
 
 
 /**
- * _g_digicam_camerabin_pause_recording_video:
+ * _g_digicam_camerabin_set_locks:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinVideoHelper.
+ * @user_data: A #GDigicamCamerabinLocksHelper helper data
+ * structure.
  *
- * Implementation of "pause_recording_video" GDigicam operation
+ * Implementation of "set_focus_mode" GDigicam operation
  * specifically for the "camerabin" GStreamer bin.
  *
- * Returns: #FALSE if invalid input arguments are received or the
- * operation fails, #TRUE otherwise.
+ * Returns: FALSE if invalid input arguments are received or
+ * the operation fails, it returns TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_pause_recording_video (GDigicamManager *manager,
-                                            gpointer user_data)
+_g_digicam_camerabin_set_locks (GDigicamManager *manager,
+                                gpointer user_data)
 {
-    GDigicamCamerabinVideoHelper *helper = NULL;
+    GDigicamCamerabinLocksHelper *helper = NULL;
     GstElement *bin = NULL;
     GError *error = NULL;
     gboolean result;
 
-    helper = (GDigicamCamerabinVideoHelper *) user_data;
-
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Recording operation paused \n");
+    helper = (GDigicamCamerabinLocksHelper *) user_data;
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
@@ -1953,11 +3034,13 @@ _g_digicam_camerabin_pause_recording_video (GDigicamManager *manager,
         goto free;
     }
 
-    /* Pause/Resume recording mode */
-    if (helper->resume) {
-        g_signal_emit_by_name (bin, "user-start", 0);
+    if (helper->locks & G_DIGICAM_LOCK_AUTOFOCUS) {
+        TSTAMP (before-gst-af);
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: Emit autofocus to camerabin\n");
+	gst_photography_set_autofocus (GST_PHOTOGRAPHY (bin), TRUE);
     } else {
-        g_signal_emit_by_name (bin, "user-pause", 0);
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: Stop autofocus to camerabin\n");
+	gst_photography_set_autofocus (GST_PHOTOGRAPHY (bin), FALSE);
     }
 
     /* free */
@@ -1974,28 +3057,30 @@ free:
 
 
 /**
- * _g_digicam_camerabin_finish_recording_video:
+ * _g_digicam_camerabin_set_zoom:
  * @manager: A #GDigicamManager.
- * @user_data: A #GDigicamCamerabinVideoHelper.
+ * @user_data: A #GDigicamCamerabinZoomHelper.
  *
- * Implementation of "finish_recording_video" GDigicam operation
- * specifically for the "camerabin" GStreamer bin.
+ * Implementation of "set_zoom" GDigicam operation specifically
+ * for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
  * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_finish_recording_video (GDigicamManager *manager,
-                                             gpointer user_data)
+_g_digicam_camerabin_set_zoom (GDigicamManager *manager,
+                               gpointer user_data)
 {
-    GDigicamCamerabinVideoHelper *helper = NULL;
+    GDigicamCamerabinZoomHelper *helper = NULL;
     GstElement *bin = NULL;
     GError *error = NULL;
+    gint value;
     gboolean result;
 
-    helper = (GDigicamCamerabinVideoHelper *) user_data;
+    helper = (GDigicamCamerabinZoomHelper *) user_data;
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: Recording operation stopped \n");
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new zoom value to %f\n",
+                     helper->value);
 
     /* Get "camerabin" Gstreamer bin  */
     result = g_digicam_manager_get_gstreamer_bin (manager,
@@ -2010,9 +3095,10 @@ _g_digicam_camerabin_finish_recording_video (GDigicamManager *manager,
         goto free;
     }
 
-    /* Stopping recording mode */
-    g_signal_emit_by_name (bin, "user-stop", 0);
-    TSTAMP (after-gst-capture-stop);
+    /* Establish new zoom value */
+    /* FIXME: What about digital zoom */
+    value = 100 * helper->value;
+    g_object_set (bin, "zoom", value, NULL);
 
     /* free */
 free:
@@ -2028,363 +3114,296 @@ free:
 
 
 /**
- * _g_digicam_camerabin_set_picture_metadata:
- * @gst_camera_bin: A camerabin #GstElement.
- * @metadata: A #GDigicamCamerabinMetadata.
- *
- * Sets the metadata in pictures.
+ * _g_digicam_camerabin_set_audio:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GDigicamCamerabinVideoHelper.
+ *
+ * Implementation of "set_audio" GDigicam operation specifically for
+ * the "camerabin" GStreamer bin.
+ *
+ * Returns: #FALSE if invalid input arguments are received or the
+ * operation fails, #TRUE otherwise.
  **/
-static void
-_g_digicam_camerabin_set_picture_metadata (GstElement *gst_camera_bin,
-                                           const GDigicamCamerabinMetadata *metadata)
+static gboolean
+_g_digicam_camerabin_set_audio (GDigicamManager *manager,
+                                gpointer user_data)
 {
-    /* for more information about image metadata tags, see:
-     * http://webcvs.freedesktop.org/gstreamer/gst-plugins-bad/tests/icles/metadata_editor.c
-     * and for the mapping:
-     * http://webcvs.freedesktop.org/gstreamer/gst-plugins-bad/ext/metadata/metadata_mapping.htm?view=co
-     */
+    GDigicamCamerabinVideoHelper *helper = NULL;
+    GstElement *bin = NULL;
+    gboolean audio_mute;
+    GError *error = NULL;
+    gboolean result;
 
-    /* TODO: These location tags in quotes have to be in sync with
-     * other tags after GStreamer's headers are updated.
-     * See NB#125831 */
+    helper = (GDigicamCamerabinVideoHelper *) user_data;
 
-    GstTagSetter *setter = NULL;
-    GstTagList *list = NULL;
-    GTimeVal time = { 0,0 };
-    gchar *date_str = NULL;
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new mute value to %d\n",
+                     helper->audio);
 
-    g_return_if_fail (GST_IS_ELEMENT (gst_camera_bin));
-    g_return_if_fail (NULL != metadata);
-    setter = GST_TAG_SETTER (gst_camera_bin);
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
 
-    /* Modified time */
-    g_get_current_time(&time);
-    date_str = g_time_val_to_iso8601 (&time); /* this is UTC */
-
-    ULOG_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_set_picture_metadata: "
-                "Writing Picture Metadata: \n"
-                "\n\tdate: %s"
-                "\n\tmake: %s"
-                "\n\tmodel: %s"
-                "\n\tauthor: %s"
-                "\n\tcountry: %s"
-                "\n\tcity: %s"
-                "\n\tsuburb: %s"
-                "\n\taltitude: %f"
-                "\n\tlatitude: %f"
-                "\n\tlongtitude: %f"
-                "\n\torientation: %d",
-                date_str, metadata->make,
-                metadata->model,
-                metadata->author,
-                metadata->country_name,
-                metadata->city_name,
-                metadata->suburb_name,
-                metadata->altitude,
-                metadata->latitude,
-                metadata->longitude,
-                metadata->orientation);
-
-    /* Creating the tag list with the mandatory tags. */
-    list = gst_tag_list_new ();
-    gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                      GST_TAG_DATE_TIME_ORIGINAL, date_str,
-                      GST_TAG_DATE_TIME_MODIFIED, date_str,
-                      GST_TAG_DEVICE_MAKE, metadata->make,
-                      GST_TAG_DEVICE_MODEL, metadata->model,
-                      GST_TAG_CAPTURE_ORIENTATION, metadata->orientation,
-                      NULL);
-
-    /* Adding coordinates, just if set. */
-    if (G_MAXDOUBLE != metadata->latitude &&
-        G_MAXDOUBLE != metadata->longitude) {
-        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                          GST_TAG_GEO_LOCATION_LATITUDE, metadata->latitude,
-                          GST_TAG_GEO_LOCATION_LONGITUDE, metadata->longitude,
-                          NULL);
-        if (G_MAXDOUBLE != metadata->altitude) {
-            gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                              GST_TAG_GEO_LOCATION_ELEVATION, metadata->altitude,
-                              NULL);
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
         }
+        goto free;
     }
 
-    /* Adding optional metadata tags. */
-    if (NULL != metadata->author) {
-        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                          GST_TAG_COMPOSER, metadata->author,
-                          NULL);
+    /* Establish new mute value */
+    if (helper->audio & G_DIGICAM_AUDIO_RECORDOFF) {
+    	audio_mute = TRUE;
+    } else {
+    	audio_mute = FALSE;
     }
 
-    /* We should have all the geotags. */
-    if (NULL != metadata->country_name) {
-        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                          GST_TAG_GEO_LOCATION_COUNTRY, metadata->country_name,
-                          NULL);
-        if (NULL != metadata->city_name) {
-                gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                                  GST_TAG_GEO_LOCATION_CITY, metadata->city_name,
-                                  NULL);
-            }
-        if (NULL != metadata->suburb_name) {
-            gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                              GST_TAG_GEO_LOCATION_SUBLOCATION, metadata->suburb_name,
-                              NULL);
-        }
-    }
+    g_object_set (bin, "mute", audio_mute, NULL);
 
-    /* Set metadata tags. */
-    gst_tag_setter_merge_tags (setter, list,
-                               GST_TAG_MERGE_REPLACE_ALL);
+    /* free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
 
-    /* Free. */
-    gst_tag_list_free (list);
-    g_free (date_str);
+    return result;
 }
 
 
+
 /**
- * _g_digicam_camerabin_set_video_metadata:
- * @gst_camera_bin: A camerabin #GstElement.
- * @metadata: A #GDigicamCamerabinMetadata.
+ * _g_digicam_camerabin_set_preview_mode:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GDigicamCamerabinAspectRatioResolutionHelper.
  *
- * Sets the metadata in videos.
+ * Implementation of "set_preview_mode" GDigicam operation
+ * specifically for the "camerabin" GStreamer bin.
+ *
+ * Returns: #FALSE if invalid input arguments are received or the
+ * operation fails, #TRUE otherwise.
  **/
-static void
-_g_digicam_camerabin_set_video_metadata (GstElement *gst_camera_bin,
-                                         const GDigicamCamerabinMetadata *metadata)
+static gboolean
+_g_digicam_camerabin_set_preview_mode (GDigicamManager *manager,
+                                       gpointer user_data)
 {
-    /* for more information about image metadata tags, see:
-     * http://webcvs.freedesktop.org/gstreamer/gst-plugins-bad/tests/icles/metadata_editor.c
-     * and for the mapping:
-     * http://webcvs.freedesktop.org/gstreamer/gst-plugins-bad/ext/metadata/metadata_mapping.htm?view=co
-     */
+    GDigicamCamerabinPreviewHelper *helper = NULL;
+    GstElement *bin = NULL;
+    GError *error = NULL;
+    GDigicamMode mode;
+    GDigicamAspectratio ar;
+    GDigicamResolution res;
+    gint vf_w, vf_h;
+    gint res_w, res_h;
+    gint fps_n, fps_d;
+    gboolean result;
 
-    /* TODO: These location tags in quotes have to be in sync with
-     * other tags after GStreamer's headers are updated.
-     * See NB#125831 */
+    helper = (GDigicamCamerabinPreviewHelper *) user_data;
 
-    GstTagSetter *setter = NULL;
-    GstTagList *list = NULL;
-    gchar *geo_name = NULL;
-    gchar *tmp = NULL;
-    /*we should not set Date if hantro is used as its automatically set by it.
-    If we set date and time, hantro extract only year from it and erase the automatic date */
-    /*TODO: Verfiy aumatice date set. */
-    /*GTimeVal time = { 0,0 };
-    gchar *date_str = NULL;*/
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new preview value to %d\n",
+                     helper->mode);
 
-    g_return_if_fail (GST_IS_ELEMENT (gst_camera_bin));
-    g_return_if_fail (NULL != metadata);
-    setter = GST_TAG_SETTER (gst_camera_bin);
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
 
-    /* Modified time */
-    /*g_get_current_time(&time);
-    date_str = g_time_val_to_iso8601 (&time);*/ /* this is UTC */
-
-    ULOG_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_set_video_metadata: "
-                "Writing Video Metadata: \n"
-                "\n\tauthor: %s"
-                "\n\tcountry: %s"
-                "\n\tcity: %s"
-                "\n\tsuburb: %s"
-                "\n\taltitude: %f"
-                "\n\tlatitude: %f"
-                "\n\tlongtitude: %f",
-                metadata->author,
-                metadata->country_name,
-                metadata->city_name,
-                metadata->suburb_name,
-                metadata->altitude,
-                metadata->latitude,
-                metadata->longitude);
-
-    /* Creating the tag list with the mandatory tags. */
-    list = gst_tag_list_new ();
-    gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                      GST_TAG_CLASSIFICATION, metadata->unique_id,
-                      NULL);
-
-    /* Adding coordinates, just if set. */
-    if (G_MAXDOUBLE != metadata->latitude &&
-        G_MAXDOUBLE != metadata->longitude) {
-        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                          GST_TAG_GEO_LOCATION_LATITUDE, metadata->latitude,
-                          GST_TAG_GEO_LOCATION_LONGITUDE, metadata->longitude,
-                          NULL);
-        if (G_MAXDOUBLE != metadata->altitude) {
-            gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                              GST_TAG_GEO_LOCATION_ELEVATION, metadata->altitude,
-                              NULL);
+    /* Get operation mode */
+    result = g_digicam_manager_get_mode (manager,
+                                         &mode,
+                                         &error);
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
         }
+        goto free;
     }
 
-    /* Adding optional metadata tags. */
-    if (NULL != metadata->author) {
-        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                          GST_TAG_ARTIST, metadata->author,
-                          NULL);
+    /* Get resoluton */
+    result = g_digicam_manager_get_resolution (manager, &res, &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
     }
 
-    /* We should have all the geotags. */
-    if (NULL != metadata->country_name) {
-        geo_name = g_strdup (metadata->country_name);
-        if (NULL != metadata->city_name) {
-            tmp = g_strconcat (geo_name,
-                               ",",
-                               metadata->city_name,
-                               NULL);
-            g_free (geo_name);
-            geo_name = tmp;
-            tmp = NULL;
-        }
-        if (NULL != metadata->suburb_name) {
-            tmp = g_strconcat (geo_name,
-                               ",",
-                               metadata->suburb_name,
-                               NULL);
-            g_free (geo_name);
-            geo_name = tmp;
-            tmp = NULL;
+    /* Get aspect ratio  */
+    result = g_digicam_manager_get_aspect_ratio (manager, &ar, &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
         }
+        goto free;
+    }
 
-        gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                          GST_TAG_GEO_LOCATION_NAME, geo_name,
-                          NULL);
+    /* Get resolution specific values depending on the camera mode */
+    result = _get_aspect_ratio_and_resolution (mode,
+                                               ar, res,
+                                               &vf_w, &vf_h,
+                                               &res_w, &res_h,
+                                               &fps_n, &fps_d);
+    if (!result) {
+        goto free;
     }
 
-    /* Set metadata tags. */
-    gst_tag_setter_merge_tags (setter, list,
-                               GST_TAG_MERGE_REPLACE_ALL);
+    /* Establish new preview mode value */
+    if (helper->mode & G_DIGICAM_PREVIEW_ON) {
+        _set_preview_caps (manager, bin, TRUE, vf_w, vf_h, TRUE);
+    } else if (helper->mode & G_DIGICAM_PREVIEW_OFF) {
+        _set_preview_caps (manager, bin, FALSE, vf_w, vf_h, TRUE);
+    } else {
+        G_DIGICAM_ERR ("GDigicamCamerabin: invalid preview mode %d received.",
+                       helper->mode);
+        goto free;
+    }
 
-    /* Free. */
-    gst_tag_list_free (list);
-    g_free (geo_name);
-    g_free (tmp);
-}
+    /* free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
 
+    return result;
+}
 
 /**
- * _g_digicam_camerabin_handle_bus_message:
+ * _g_digicam_camerabin_get_still_picture:
  * @manager: A #GDigicamManager.
- * @user_data: A #GstMessage.
+ * @user_data: A #GDigicamCamerabinPictureHelper.
  *
- * Function to handle custom gstreamer bus messages.
+ * Implementation of "get_still_picture" GDigicam operation
+ * specifically for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
  * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_handle_bus_message (GDigicamManager *manager,
-					 gpointer user_data)
+_g_digicam_camerabin_get_still_picture (GDigicamManager *manager,
+                                        gpointer user_data)
 {
-    const GstStructure *structure = NULL;
-    gint status = GST_PHOTOGRAPHY_FOCUS_STATUS_NONE;
-    const gchar *message_name = NULL;
-    GstState old = 0;
-    GstState new = 0;
-    GstState pending = 0;
-    GError *error = NULL;
-    GDigicamMode mode;
+    GDigicamCamerabinPictureHelper *helper = NULL;
+    GDigicamCamerabinMetadataSession *session = NULL;
+    GDigicamCamerabinOutput *output = NULL;
+    WriterState *state = NULL;
     GstElement *bin = NULL;
-    gboolean result = FALSE;
+    const gchar *file_path = NULL;
+    GError *error = NULL;
+    gboolean taken = FALSE;
+    gboolean encoded = FALSE;
+    gboolean result;
 
-    switch (GST_MESSAGE_TYPE (GST_MESSAGE (user_data))) {
-    case GST_MESSAGE_STATE_CHANGED:
-        /* Don't care if it is not coming from camerabin itself */
-	result = g_digicam_manager_get_gstreamer_bin (manager,
-                                                      &bin,
-                                                      &error);
+    helper = (GDigicamCamerabinPictureHelper *) user_data;
 
-        /* Check errors */
-        if (!result) {
-            if (NULL != error) {
-                G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
-                                 "%s", error->message);
-            }
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Capturing still picture ...");
+
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
+
+
+    /* The descriptor given for this capture replaces its file */
+    output = g_object_steal_data (G_OBJECT (bin),
+                                  G_DIGICAM_CAMERABIN_OUTPUT_KEY);
+    if (NULL != output) {
+        state = _writer_state_get (bin);
+        if (NULL == state) {
+            _g_digicam_camerabin_output_free (output);
+            result = FALSE;
             goto free;
         }
+        if (NULL != state->output) {
+            _g_digicam_camerabin_output_free (state->output);
+        }
+        state->output = output;
+    } else {
+        /* Nor does the one of a capture which never ended */
+        state = g_object_get_data (G_OBJECT (bin),
+                                   G_DIGICAM_CAMERABIN_WRITER_KEY);
+        if ((NULL != state) && (NULL != state->output)) {
+            _g_digicam_camerabin_output_free (state->output);
+            state->output = NULL;
+        }
+        file_path = helper->file_path;
+    }
 
-	if (GST_ELEMENT (GST_MESSAGE_SRC (GST_MESSAGE (user_data))) == bin) {
-	    gst_message_parse_state_changed (GST_MESSAGE (user_data),
-					     &old,
-					     &new,
-					     &pending);
-	    if (GST_STATE_PLAYING == new) {
-		result = g_digicam_manager_get_mode (manager,
-                                                     &mode,
-                                                     &error);
+    /* Without a file, the picture can only be captured to memory */
+    if ((NULL == file_path) && (NULL == output) &&
+        !g_digicam_camerabin_get_picture_buffers (bin)) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: no file to save the picture "
+                         "to.");
+        result = FALSE;
+        goto free;
+    }
 
-                /* Check errors */
-                if (!result) {
-                    if (NULL != error) {
-                        G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
-                                         "%s", error->message);
-                    }
-                    goto free;
-                }
+    /* Handlers may have come and gone since the preview was set */
+    _refresh_preview_caps (manager, bin);
 
-		switch (mode) {
-		case G_DIGICAM_MODE_STILL:
-		    g_object_set (bin, "mode", 0, NULL);
-		    break;
-		case G_DIGICAM_MODE_VIDEO:
-		    g_object_set (bin, "mode", 1, NULL);
-		    break;
-		default:
-		    g_assert_not_reached ();
-		}
-	    }
-	}
-	break;
-    case GST_MESSAGE_ELEMENT:
-	structure = gst_message_get_structure (GST_MESSAGE (user_data));
-	message_name = gst_structure_get_name (structure);
-
-	/* autofocus message */
-	if (g_strcmp0 (message_name, GST_PHOTOGRAPHY_AUTOFOCUS_DONE) == 0) {
-	    gst_structure_get_int (structure, "status", &status);
-	    switch (status) {
-	    case GST_PHOTOGRAPHY_FOCUS_STATUS_FAIL:
-		G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
-                                 "Autofocus failed message received.");
-		g_signal_emit_by_name (manager,
-				       "focus-done",
-				       G_DIGICAM_FOCUSMODESTATUS_UNABLETOREACH);
-		break;
-	    case GST_PHOTOGRAPHY_FOCUS_STATUS_SUCCESS:
-		G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
-                                 "Autofocus success message received.");
-		g_signal_emit_by_name (manager,
-				       "focus-done",
-				       G_DIGICAM_FOCUSMODESTATUS_REACHED);
-		break;
-	    case GST_PHOTOGRAPHY_FOCUS_STATUS_NONE:
-		G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
-                                 "Autofocus none message received.");
-		break;
-	    case GST_PHOTOGRAPHY_FOCUS_STATUS_RUNNING:
-		G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
-                                 "Autofocus running message received.");
-		break;
-	    default:
-		break;
-	    }
-	    return TRUE;
-	}
+#ifdef HAVE_JPEG
+    /* Nothing else to do if an already captured frame is used */
+    if ((NULL != file_path) &&
+        (!_zsl_capture (manager, bin, helper, &taken) || taken)) {
+        result = taken;
+        goto free;
+    }
 
-	/* Shake risk message */
-	if (g_strcmp0 (message_name, GST_PHOTOGRAPHY_SHAKE_RISK) == 0) {
-	    return TRUE;
-	}
+    /* Encoded in parallel instead of by the image encoder, then the
+     * picture is handed only from its file */
+    encoded = (NULL != file_path) &&
+        !g_digicam_camerabin_get_picture_buffers (bin) &&
+        _encode_prepare (bin, file_path);
+#endif
 
-	break;
-    default:
-	/* Not handling this message */
-	break;
+    /* Set application domain metadata, now or once saved */
+    if ((NULL != file_path) &&
+        (encoded || g_digicam_camerabin_get_deferred_metadata (bin))) {
+        session = _get_metadata_session (bin);
+        gst_tag_setter_reset_tags (GST_TAG_SETTER (bin));
+        _g_digicam_camerabin_xmp_prepare (file_path,
+                                          helper->metadata,
+                                          _g_digicam_camerabin_metadata_session_get_date (session));
+    } else {
+        _g_digicam_camerabin_set_picture_metadata (bin, helper->metadata);
     }
 
-    /* Free */
+    /* take picture */
+    g_object_set (bin, "filename",
+                  (NULL != file_path) ?
+                  file_path : G_DIGICAM_CAMERABIN_NO_FILE,
+                  NULL);
+    TSTAMP (before-gst-capture);
+    g_signal_emit_by_name (bin, "user-start", 0);
+    g_signal_emit_by_name (bin, "user-stop", 0);
+    TSTAMP (after-gst-capture);
+
+    /* free */
 free:
     if (NULL != bin) {
         gst_object_unref (bin);
@@ -2393,116 +3412,3228 @@ free:
         g_error_free (error);
     }
 
-    return TRUE;
+    return result;
 }
 
+
 /**
- * _g_digicam_camerabin_handle_sync_bus_message:
+ * _g_digicam_camerabin_still_picture_busy:
  * @manager: A #GDigicamManager.
- * @user_data: A #GstMessage.
+ * @user_data: A #GDigicamCamerabinPictureHelper.
  *
- * Function to handle custom gstreamer sync bus messages.
+ * Tells whether the still picture can't be captured yet, because it
+ * would go to the shared encoders and they have no room for it, see
+ * g_digicam_camerabin_set_zsl() and
+ * g_digicam_camerabin_set_parallel_encoding(). Taking it with
+ * CameraBin instead would let the captures get ahead of the encoders.
+ *
+ * Returns: #TRUE if the capture has to wait, #FALSE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_still_picture_busy (GDigicamManager *manager,
+                                         gpointer user_data)
+{
+    GDigicamCamerabinPictureHelper *helper = NULL;
+    GstElement *bin = NULL;
+    gboolean result = FALSE;
+
+    helper = (GDigicamCamerabinPictureHelper *) user_data;
+
+    if ((NULL == helper) || (NULL == helper->file_path) ||
+        !g_digicam_manager_get_gstreamer_bin (manager, &bin, NULL)) {
+        return FALSE;
+    }
+
+#ifdef HAVE_JPEG
+    /* The pictures given a descriptor are encoded by CameraBin */
+    if (NULL == g_object_get_data (G_OBJECT (bin),
+                                   G_DIGICAM_CAMERABIN_OUTPUT_KEY)) {
+        result = _zsl_busy (bin) ||
+            (!g_digicam_camerabin_get_picture_buffers (bin) &&
+             _encode_busy (bin));
+    }
+#endif
+
+    gst_object_unref (bin);
+
+    return result;
+}
+
+
+/**
+ * _gdigicam_camerabin_start_recording_video:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GDigicamCamerabinVideoHelper.
+ *
+ * Implementation of "start_recording_video" GDigicam operation
+ * specifically for the "camerabin" GStreamer bin.
  *
  * Returns: #FALSE if invalid input arguments are received or the
- * message is not processed, #TRUE otherwise.
+ * operation fails, #TRUE otherwise.
  **/
 static gboolean
-_g_digicam_camerabin_handle_sync_bus_message (GDigicamManager *manager,
-					      gpointer user_data)
+_g_digicam_camerabin_start_recording_video (GDigicamManager *manager,
+                                            gpointer user_data)
 {
-    const GstStructure *structure = NULL;
-    const gchar *message_name = NULL;
-    const GValue *value = NULL;
-    PreviewHelper *helper = NULL;
-    GstBuffer *buff = NULL;
-    GdkPixbuf *preview = NULL;
-    gboolean alpha;
+    GDigicamCamerabinVideoHelper *helper = NULL;
+    GDigicamCamerabinOutput *output = NULL;
     GstElement *bin = NULL;
     GError *error = NULL;
-    gboolean result = FALSE;
-    gboolean success = FALSE;
+    gboolean result;
 
-    structure = gst_message_get_structure (GST_MESSAGE (user_data));
-    g_return_val_if_fail (structure != NULL, FALSE);
-    message_name = gst_structure_get_name (structure);
+    helper = (GDigicamCamerabinVideoHelper *) user_data;
 
-    /* Don't care if it is not coming from camerabin itself */
-    success = g_digicam_manager_get_gstreamer_bin (manager,
-                                                   &bin,
-                                                   &error);
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Capturing video ...");
+
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
 
     /* Check errors */
-    if (!success) {
+    if (!result) {
         if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
-                             "%s", error->message);
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
         }
         goto free;
     }
 
-    if (GST_ELEMENT (GST_MESSAGE_SRC (GST_MESSAGE (user_data))) == bin) {
-        if (g_strcmp0 (message_name, G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_END_MESSAGE) == 0) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
-                             "Capture end message received.");
-            TSTAMP (after-gst-next-shot);
 
-            /* Release lock and inform capture was completed */
-            _g_digicam_manager_release_capture_lock (manager);
+    /* Set application domain metadata */
+    _g_digicam_camerabin_set_video_metadata (bin, helper->metadata);
 
-            /* Emit a signal in the main loop */
-            g_idle_add (_emit_capture_end_signal, manager);
 
-            result = TRUE;
-            goto free;
-        } else if (g_strcmp0 (message_name, G_DIGICAM_CAMERABIN_PHOTO_PREVIEW_MESSAGE) == 0) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
-                             "Image preview message received.");
-            TSTAMP (after-gst-snapshot);
-            value = gst_structure_get_value (structure, "buffer");
-            buff = gst_value_get_buffer (value);
-            alpha = FALSE;
+    /* The descriptor given for this recording replaces its file, the
+     * data going to the file sink is taken from the start */
+    output = g_object_steal_data (G_OBJECT (bin),
+                                  G_DIGICAM_CAMERABIN_OUTPUT_KEY);
+    if (!_recording_start (bin, output)) {
+        result = FALSE;
+        goto free;
+    }
 
-            /* Preview using the RGB row data from GstBuffer */
-            preview = _pixbuf_from_buffer (manager, buff, alpha);
+    /* Record the pre-record frames first */
+    _prerecord_start (bin);
 
-            /* FIXME: shouldn't we send the signal even if we don't have any data? */
-            /* Send the acquired preview */
-            if (NULL != preview) {
-                helper = g_slice_new0 (PreviewHelper);
-                helper->mgr = manager;
-                helper->preview = preview;
-                g_idle_add (_emit_preview_signal, helper);
-            }
+    /* Start recording mode */
+    g_object_set (bin, "filename",
+                  (NULL != output) ?
+                  G_DIGICAM_CAMERABIN_NO_FILE : helper->file_path,
+                  NULL);
+    TSTAMP (before-gst-video-capture);
+    g_signal_emit_by_name(bin, "user-start", 0);
+    TSTAMP (after-gst-video-capture);
 
-            result = TRUE;
-            goto free;
-        } else {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
-                             "Unhandled sync DBus message "
-                             "coming from camerabin.");
+    /* free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
+
+    return result;
+}
+
+
+/**
+ * _g_digicam_camerabin_pause_recording_video:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GDigicamCamerabinVideoHelper.
+ *
+ * Implementation of "pause_recording_video" GDigicam operation
+ * specifically for the "camerabin" GStreamer bin.
+ *
+ * Returns: #FALSE if invalid input arguments are received or the
+ * operation fails, #TRUE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_pause_recording_video (GDigicamManager *manager,
+                                            gpointer user_data)
+{
+    GDigicamCamerabinVideoHelper *helper = NULL;
+    GstElement *bin = NULL;
+    GError *error = NULL;
+    gboolean result;
+
+    helper = (GDigicamCamerabinVideoHelper *) user_data;
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Recording operation paused \n");
+
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
         }
+        goto free;
+    }
+
+    /* Pause/Resume recording mode */
+    if (helper->resume) {
+        g_signal_emit_by_name (bin, "user-start", 0);
     } else {
-        if (g_strcmp0 (message_name, G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_START_MESSAGE) == 0) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
-                             "Capture start message received.");
+        g_signal_emit_by_name (bin, "user-pause", 0);
+    }
 
-            /* Set lock and inform capture was started */
-            _g_digicam_manager_set_capture_lock (manager);
+    /* free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
 
-            /* Emit a signal in the main loop */
-            g_idle_add (_emit_capture_start_signal, manager);
+    return result;
+}
 
-            result = TRUE;
-            goto free;
-        } else if (g_strcmp0 (message_name, G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_PICTURE_GOT_MESSAGE) == 0) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
-                             "Picture got message received.");
 
-            /* Emit a signal in the main loop */
-            g_idle_add (_emit_picture_got_signal, manager);
+/**
+ * _g_digicam_camerabin_finish_recording_video:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GDigicamCamerabinVideoHelper.
+ *
+ * Implementation of "finish_recording_video" GDigicam operation
+ * specifically for the "camerabin" GStreamer bin.
+ *
+ * Returns: #FALSE if invalid input arguments are received or the
+ * operation fails, #TRUE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_finish_recording_video (GDigicamManager *manager,
+                                             gpointer user_data)
+{
+    GDigicamCamerabinVideoHelper *helper = NULL;
+    GstElement *bin = NULL;
+    GError *error = NULL;
+    gboolean result;
 
-            result = TRUE;
-            goto free;
+    helper = (GDigicamCamerabinVideoHelper *) user_data;
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Recording operation stopped \n");
+
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
+
+    /* Stopping recording mode */
+    g_signal_emit_by_name (bin, "user-stop", 0);
+    TSTAMP (after-gst-capture-stop);
+
+    _prerecord_stop (bin);
+
+    /* free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
+
+    return result;
+}
+
+
+/**
+ * _g_digicam_camerabin_set_picture_metadata:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @metadata: A #GDigicamCamerabinMetadata.
+ *
+ * Sets the metadata in pictures.
+ **/
+static void
+_g_digicam_camerabin_set_picture_metadata (GstElement *gst_camera_bin,
+                                           const GDigicamCamerabinMetadata *metadata)
+{
+    GDigicamCamerabinMetadataSession *session = NULL;
+    GstTagSetter *setter = NULL;
+    const gchar *date_str = NULL;
+
+    g_return_if_fail (GST_IS_ELEMENT (gst_camera_bin));
+    g_return_if_fail (NULL != metadata);
+    setter = GST_TAG_SETTER (gst_camera_bin);
+    session = _get_metadata_session (gst_camera_bin);
+
+    /* Modified time */
+    date_str = _g_digicam_camerabin_metadata_session_get_date (session);
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_set_picture_metadata: "
+                     "date: %s, orientation: %d",
+                     date_str, metadata->orientation);
+
+    /* Set the tags shared with the previous pictures, and then the
+     * ones of this capture */
+    gst_tag_setter_merge_tags (setter,
+                               _g_digicam_camerabin_metadata_session_get_picture_tags (session,
+                                                                                       metadata),
+                               GST_TAG_MERGE_REPLACE_ALL);
+    gst_tag_setter_add_tags (setter, GST_TAG_MERGE_REPLACE,
+                             GST_TAG_DATE_TIME_ORIGINAL, date_str,
+                             GST_TAG_DATE_TIME_MODIFIED, date_str,
+                             GST_TAG_CAPTURE_ORIENTATION, metadata->orientation,
+                             NULL);
+}
+
+
+/**
+ * _g_digicam_camerabin_set_video_metadata:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @metadata: A #GDigicamCamerabinMetadata.
+ *
+ * Sets the metadata in videos.
+ **/
+static void
+_g_digicam_camerabin_set_video_metadata (GstElement *gst_camera_bin,
+                                         const GDigicamCamerabinMetadata *metadata)
+{
+    GDigicamCamerabinMetadataSession *session = NULL;
+    GstTagSetter *setter = NULL;
+
+    /*we should not set Date if hantro is used as its automatically set by it.
+    If we set date and time, hantro extract only year from it and erase the automatic date */
+    /*TODO: Verfiy aumatice date set. */
+
+    g_return_if_fail (GST_IS_ELEMENT (gst_camera_bin));
+    g_return_if_fail (NULL != metadata);
+    setter = GST_TAG_SETTER (gst_camera_bin);
+    session = _get_metadata_session (gst_camera_bin);
+
+    /* Set metadata tags. */
+    gst_tag_setter_merge_tags (setter,
+                               _g_digicam_camerabin_metadata_session_get_video_tags (session,
+                                                                                     metadata),
+                               GST_TAG_MERGE_REPLACE_ALL);
+}
+
+
+/**
+ * _get_metadata_session:
+ * @gst_camera_bin: A camerabin #GstElement.
+ *
+ * Gets the metadata session of @gst_camera_bin, creating it the
+ * first time.
+ *
+ * Returns: A #GDigicamCamerabinMetadataSession owned by
+ * @gst_camera_bin.
+ **/
+static GDigicamCamerabinMetadataSession *
+_get_metadata_session (GstElement *gst_camera_bin)
+{
+    GDigicamCamerabinMetadataSession *session = NULL;
+
+    session = g_object_get_data (G_OBJECT (gst_camera_bin),
+                                 G_DIGICAM_CAMERABIN_METADATA_KEY);
+    if (NULL == session) {
+        session = _g_digicam_camerabin_metadata_session_new ();
+        g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                                G_DIGICAM_CAMERABIN_METADATA_KEY,
+                                session,
+                                (GDestroyNotify) _g_digicam_camerabin_metadata_session_free);
+    }
+
+    return session;
+}
+
+
+/**
+ * _probe_state_init:
+ * @probes: The #ProbeState of a state.
+ * @gst_camera_bin: The camerabin #GstElement the state belongs to.
+ * @size: The size of the state, as allocated with g_slice_alloc().
+ * @finalize: The function removing the probes of the state and
+ * freeing what it holds.
+ *
+ * Initializes @probes, with the reference of the owner of the
+ * state. The state itself is freed with @gst_camera_bin.
+ **/
+static void
+_probe_state_init (ProbeState *probes,
+                   GstElement *gst_camera_bin,
+                   gsize size,
+                   GDestroyNotify finalize)
+{
+    ProbeStates *states = NULL;
+
+    probes->refs = 1;
+    probes->removed = FALSE;
+    probes->size = size;
+    probes->finalize = finalize;
+
+    g_static_mutex_lock (&probe_states_lock);
+    states = g_object_get_data (G_OBJECT (gst_camera_bin),
+                                G_DIGICAM_CAMERABIN_PROBE_STATES_KEY);
+    if (NULL == states) {
+        /* With the reference of the bin */
+        states = g_slice_new0 (ProbeStates);
+        states->refs = 1;
+        g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                                G_DIGICAM_CAMERABIN_PROBE_STATES_KEY,
+                                states,
+                                (GDestroyNotify) _probe_states_unref);
+    }
+    states->refs++;
+    probes->states = states;
+    g_static_mutex_unlock (&probe_states_lock);
+}
+
+
+/**
+ * _probe_state_hold:
+ * @probes: The #ProbeState of a state.
+ *
+ * Takes a reference on the state for a probe about to use it, from
+ * the streaming thread. The state is only finalized, and its probes
+ * removed, once every probe using it is done.
+ *
+ * Returns: #FALSE if the state is already removed, and the probe has
+ * to let the data go untouched, #TRUE otherwise.
+ **/
+static gboolean
+_probe_state_hold (ProbeState *probes)
+{
+    gboolean held = FALSE;
+
+    g_static_mutex_lock (&probe_states_lock);
+    if (!probes->removed) {
+        g_atomic_int_inc (&probes->refs);
+        held = TRUE;
+    }
+    g_static_mutex_unlock (&probe_states_lock);
+
+    return held;
+}
+
+
+/**
+ * _probe_state_release:
+ * @probes: The #ProbeState of a state.
+ *
+ * Drops a reference on the state, finalizing it if it was the last
+ * one.
+ **/
+static void
+_probe_state_release (ProbeState *probes)
+{
+    if (g_atomic_int_dec_and_test (&probes->refs)) {
+        probes->finalize (probes);
+        _probe_states_unref (probes->states);
+    }
+}
+
+
+/**
+ * _probe_state_remove:
+ * @probes: The #ProbeState of a state.
+ *
+ * Drops the reference of the owner of the state. No probe uses it
+ * from then on, and it is finalized once the ones already using it
+ * are done. A probe which was already called when its handler was
+ * removed may still check the state afterwards, so its memory is kept
+ * until the bin is freed, and no data flows anymore.
+ **/
+static void
+_probe_state_remove (ProbeState *probes)
+{
+    g_static_mutex_lock (&probe_states_lock);
+    probes->removed = TRUE;
+    probes->states->retired = g_slist_prepend (probes->states->retired,
+                                               probes);
+    g_static_mutex_unlock (&probe_states_lock);
+
+    _probe_state_release (probes);
+}
+
+
+/**
+ * _probe_states_unref:
+ * @states: The #ProbeStates of a bin.
+ *
+ * Drops a reference on @states, freeing the states removed from the
+ * bin if it was the last one: the bin is gone and the states are
+ * finalized.
+ **/
+static void
+_probe_states_unref (ProbeStates *states)
+{
+    GSList *item = NULL;
+    ProbeState *probes = NULL;
+    gboolean last;
+
+    g_static_mutex_lock (&probe_states_lock);
+    last = (0 == --states->refs);
+    g_static_mutex_unlock (&probe_states_lock);
+
+    if (!last) {
+        return;
+    }
+
+    for (item = states->retired; NULL != item; item = g_slist_next (item)) {
+        probes = item->data;
+        g_slice_free1 (probes->size, probes);
+    }
+    g_slist_free (states->retired);
+    g_slice_free (ProbeStates, states);
+}
+
+
+/**
+ * _prerecord_state_free:
+ * @state: A #PrerecordState.
+ *
+ * Removes @state, it is freed once its probes are done with it.
+ **/
+static void
+_prerecord_state_free (PrerecordState *state)
+{
+    _probe_state_remove (&state->probes);
+}
+
+
+/**
+ * _prerecord_state_finalize:
+ * @state: A #PrerecordState.
+ *
+ * Removes the probes of @state and frees its ring and frames.
+ **/
+static void
+_prerecord_state_finalize (PrerecordState *state)
+{
+    if (NULL != state->source_pad) {
+        gst_pad_remove_buffer_probe (state->source_pad, state->source_probe);
+        gst_object_unref (state->source_pad);
+    }
+    if (NULL != state->video_pad) {
+        gst_pad_remove_buffer_probe (state->video_pad, state->video_probe);
+        gst_object_unref (state->video_pad);
+    }
+    if (NULL != state->audio_pad) {
+        gst_pad_remove_buffer_probe (state->audio_pad, state->audio_probe);
+        gst_object_unref (state->audio_pad);
+    }
+    g_list_foreach (state->frames, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (state->frames);
+    _g_digicam_camerabin_prerecord_free (state->ring);
+}
+
+
+/**
+ * _prerecord_set_collecting:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @collecting: Whether the source frames have to be kept.
+ *
+ * Starts or stops filling the pre-record ring, if any. The old frames
+ * are dropped, they don't belong to the current scene anymore.
+ **/
+static void
+_prerecord_set_collecting (GstElement *gst_camera_bin,
+                           gboolean collecting)
+{
+    PrerecordState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_PRERECORD_KEY);
+    if (NULL == state) {
+        return;
+    }
+
+    g_atomic_int_set (&state->collecting, collecting ? 1 : 0);
+    if (!collecting) {
+        _g_digicam_camerabin_prerecord_clear (state->ring);
+    }
+}
+
+
+/**
+ * _prerecord_start:
+ * @gst_camera_bin: A camerabin #GstElement.
+ *
+ * Takes the frames of the pre-record ring, if any, to record them
+ * before the live ones once the recording starts.
+ **/
+static void
+_prerecord_start (GstElement *gst_camera_bin)
+{
+    PrerecordState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_PRERECORD_KEY);
+    if (NULL == state) {
+        return;
+    }
+
+    g_atomic_int_set (&state->collecting, 0);
+    g_list_foreach (state->frames, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (state->frames);
+    state->frames = _g_digicam_camerabin_prerecord_take (state->ring,
+                                                         &state->offset);
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: pre-recording %u frames, "
+                     "%" GST_TIME_FORMAT,
+                     g_list_length (state->frames),
+                     GST_TIME_ARGS (state->offset));
+
+    /* The probes stay until the state is freed, so the last frames
+     * of a recording, still queued when it is stopped, are delayed
+     * as the rest */
+    if (NULL == state->video_pad) {
+        state->video_pad = _get_element_pad (gst_camera_bin, "videoenc", "sink");
+        if (NULL != state->video_pad) {
+            state->video_probe = gst_pad_add_buffer_probe (state->video_pad,
+                                                           G_CALLBACK (_prerecord_video_probe),
+                                                           state);
+        }
+    }
+
+    /* The audio is delayed as much as the live video */
+    if (NULL == state->audio_pad) {
+        state->audio_pad = _get_element_pad (gst_camera_bin, "audioenc", "sink");
+        if (NULL != state->audio_pad) {
+            state->audio_probe = gst_pad_add_buffer_probe (state->audio_pad,
+                                                           G_CALLBACK (_prerecord_audio_probe),
+                                                           state);
+        }
+    }
+
+    if (NULL == state->video_pad) {
+        g_list_foreach (state->frames, (GFunc) gst_mini_object_unref, NULL);
+        g_list_free (state->frames);
+        state->frames = NULL;
+        state->offset = 0;
+    }
+}
+
+
+/**
+ * _prerecord_stop:
+ * @gst_camera_bin: A camerabin #GstElement.
+ *
+ * Starts filling the pre-record ring again after a recording.
+ **/
+static void
+_prerecord_stop (GstElement *gst_camera_bin)
+{
+    PrerecordState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_PRERECORD_KEY);
+    if (NULL == state) {
+        return;
+    }
+
+    g_atomic_int_set (&state->collecting, 1);
+}
+
+
+/**
+ * _get_element_pad:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @property: The camerabin property holding the element.
+ * @name: The name of the pad.
+ *
+ * Gets a static pad of one of the elements set to camerabin.
+ *
+ * Returns: The #GstPad, or #NULL if there is no such element or pad.
+ **/
+static GstPad *
+_get_element_pad (GstElement *gst_camera_bin,
+                  const gchar *property,
+                  const gchar *name)
+{
+    GstElement *element = NULL;
+    GstPad *pad = NULL;
+
+    g_object_get (gst_camera_bin, property, &element, NULL);
+    if (NULL == element) {
+        return NULL;
+    }
+
+    pad = gst_element_get_static_pad (element, name);
+    gst_object_unref (element);
+
+    return pad;
+}
+
+
+/**
+ * _prerecord_source_probe:
+ * @pad: The source pad of the video source.
+ * @buffer: A video frame.
+ * @state: The #PrerecordState.
+ *
+ * Copies the frames of the source to the pre-record ring. They are
+ * copied because the sources usually have just a few buffers.
+ *
+ * Returns: #TRUE, the frame always goes on.
+ **/
+static gboolean
+_prerecord_source_probe (GstPad *pad,
+                         GstBuffer *buffer,
+                         PrerecordState *state)
+{
+    if (!_probe_state_hold (&state->probes)) {
+        return TRUE;
+    }
+
+    if (g_atomic_int_get (&state->collecting)) {
+        _g_digicam_camerabin_prerecord_push (state->ring,
+                                             gst_buffer_copy (buffer));
+    }
+
+    _probe_state_release (&state->probes);
+
+    return TRUE;
+}
+
+
+/**
+ * _prerecord_video_probe:
+ * @pad: The sink pad of the video encoder.
+ * @buffer: A video frame.
+ * @state: The #PrerecordState.
+ *
+ * Before the first live frame, feeds the encoder with the pre-record
+ * frames, with timestamps starting at the one of the live frame. The
+ * live frames are then delayed by the time the pre-record takes.
+ *
+ * Returns: #FALSE if a copy of the frame went on instead, #TRUE
+ * otherwise.
+ **/
+static gboolean
+_prerecord_video_probe (GstPad *pad,
+                        GstBuffer *buffer,
+                        PrerecordState *state)
+{
+    GstBuffer *frame = NULL;
+    GList *frames = NULL;
+    GList *item = NULL;
+    GstClockTime base, first;
+    GstFlowReturn flow = GST_FLOW_OK;
+    gboolean result = TRUE;
+
+    if (!_probe_state_hold (&state->probes)) {
+        return TRUE;
+    }
+
+    /* Our own frames go through untouched */
+    if (state->injecting || !GST_BUFFER_TIMESTAMP_IS_VALID (buffer)) {
+        goto free;
+    }
+
+    if (NULL != state->frames) {
+        frames = state->frames;
+        state->frames = NULL;
+        base = GST_BUFFER_TIMESTAMP (buffer);
+        first = GST_BUFFER_TIMESTAMP (frames->data);
+
+        if ((NULL == GST_BUFFER_CAPS (buffer)) ||
+            !gst_caps_is_equal (GST_BUFFER_CAPS (buffer),
+                                GST_BUFFER_CAPS (frames->data))) {
+            G_DIGICAM_WARN ("GDigicamCamerabin: the pre-record frames "
+                            "don't match the recorded ones.");
+            flow = GST_FLOW_NOT_NEGOTIATED;
+        }
+
+        state->injecting = TRUE;
+        for (item = frames; NULL != item; item = item->next) {
+            frame = GST_BUFFER (item->data);
+            if (GST_FLOW_OK != flow) {
+                gst_buffer_unref (frame);
+                continue;
+            }
+
+            frame = gst_buffer_make_metadata_writable (frame);
+            GST_BUFFER_TIMESTAMP (frame) = base + GST_BUFFER_TIMESTAMP (frame) - first;
+            if (item == frames) {
+                GST_BUFFER_FLAG_SET (frame, GST_BUFFER_FLAG_DISCONT);
+            }
+            flow = gst_pad_chain (pad, frame);
+        }
+        state->injecting = FALSE;
+        g_list_free (frames);
+    }
+
+    result = _prerecord_delay (pad, buffer, state, &state->injecting);
+
+    /* free */
+free:
+    _probe_state_release (&state->probes);
+
+    return result;
+}
+
+
+/**
+ * _prerecord_audio_probe:
+ * @pad: The sink pad of the audio encoder.
+ * @buffer: An audio buffer.
+ * @state: The #PrerecordState.
+ *
+ * Delays the audio as much as the live video frames.
+ *
+ * Returns: #FALSE if a copy of the buffer went on instead, #TRUE
+ * otherwise.
+ **/
+static gboolean
+_prerecord_audio_probe (GstPad *pad,
+                        GstBuffer *buffer,
+                        PrerecordState *state)
+{
+    gboolean result = TRUE;
+
+    if (!_probe_state_hold (&state->probes)) {
+        return TRUE;
+    }
+
+    /* Our own buffers go through untouched */
+    if (state->audio_injecting || !GST_BUFFER_TIMESTAMP_IS_VALID (buffer)) {
+        goto free;
+    }
+
+    result = _prerecord_delay (pad, buffer, state, &state->audio_injecting);
+
+    /* free */
+free:
+    _probe_state_release (&state->probes);
+
+    return result;
+}
+
+
+/**
+ * _prerecord_delay:
+ * @pad: The sink pad of an encoder.
+ * @buffer: A live buffer going to it.
+ * @state: The #PrerecordState.
+ * @injecting: The flag telling the probe of @pad its own buffers.
+ *
+ * Delays @buffer by the time the pre-record takes. Its timestamp is
+ * only changed in place if nobody else holds it, a copy with the new
+ * one goes to @pad otherwise.
+ *
+ * Returns: #FALSE if @buffer has to be dropped, as a copy went on
+ * instead, #TRUE otherwise.
+ **/
+static gboolean
+_prerecord_delay (GstPad *pad,
+                  GstBuffer *buffer,
+                  PrerecordState *state,
+                  gboolean *injecting)
+{
+    GstBuffer *copy = NULL;
+
+    if (0 == state->offset) {
+        return TRUE;
+    }
+
+    if (gst_buffer_is_metadata_writable (buffer)) {
+        GST_BUFFER_TIMESTAMP (buffer) += state->offset;
+        return TRUE;
+    }
+
+    copy = gst_buffer_make_metadata_writable (gst_buffer_ref (buffer));
+    GST_BUFFER_TIMESTAMP (copy) += state->offset;
+
+    *injecting = TRUE;
+    gst_pad_chain (pad, copy);
+    *injecting = FALSE;
+
+    return FALSE;
+}
+
+
+#ifdef HAVE_JPEG
+
+/**
+ * _zsl_state_free:
+ * @state: A #ZslState.
+ *
+ * Removes @state, it is freed once its probe is done with it.
+ **/
+static void
+_zsl_state_free (ZslState *state)
+{
+    _probe_state_remove (&state->probes);
+}
+
+
+/**
+ * _zsl_state_finalize:
+ * @state: A #ZslState.
+ *
+ * Removes the probe of @state, drops its encoders and frees its ring.
+ **/
+static void
+_zsl_state_finalize (ZslState *state)
+{
+    if (NULL != state->source_pad) {
+        gst_pad_remove_buffer_probe (state->source_pad, state->source_probe);
+        gst_object_unref (state->source_pad);
+    }
+    if (NULL != state->encoder) {
+        _image_encoder_unref (state->encoder);
+    }
+    _g_digicam_camerabin_prerecord_free (state->ring);
+}
+
+
+/**
+ * _zsl_set_collecting:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @collecting: Whether the source frames have to be kept.
+ *
+ * Starts or stops filling the zero shutter lag ring, if any.
+ **/
+static void
+_zsl_set_collecting (GstElement *gst_camera_bin,
+                     gboolean collecting)
+{
+    ZslState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_ZSL_KEY);
+    if (NULL == state) {
+        return;
+    }
+
+    g_atomic_int_set (&state->collecting, collecting ? 1 : 0);
+    if (!collecting) {
+        _g_digicam_camerabin_prerecord_clear (state->ring);
+    }
+}
+
+
+/**
+ * _zsl_set_resolution:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @width: The capture width.
+ * @height: The capture height.
+ *
+ * Sets the size of the frames the zero shutter lag ring keeps, if
+ * any. The frames of the previous size are dropped.
+ **/
+static void
+_zsl_set_resolution (GstElement *gst_camera_bin,
+                     gint width, gint height)
+{
+    ZslState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_ZSL_KEY);
+    if (NULL == state) {
+        return;
+    }
+
+    g_atomic_int_set (&state->width, width);
+    g_atomic_int_set (&state->height, height);
+    _g_digicam_camerabin_prerecord_clear (state->ring);
+}
+
+
+/**
+ * _zsl_get_resolution:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @width: Return location for the capture width.
+ * @height: Return location for the capture height.
+ *
+ * Gets the size the video source has to run at in still mode for
+ * zero shutter lag captures.
+ *
+ * Returns: #FALSE if they are disabled or the size is not known yet,
+ * #TRUE otherwise.
+ **/
+static gboolean
+_zsl_get_resolution (GstElement *gst_camera_bin,
+                     gint *width, gint *height)
+{
+    ZslState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_ZSL_KEY);
+    if ((NULL == state) || (0 == state->width) || (0 == state->height)) {
+        return FALSE;
+    }
+
+    *width = state->width;
+    *height = state->height;
+
+    return TRUE;
+}
+
+
+/**
+ * _zsl_source_probe:
+ * @pad: The source pad of the video source.
+ * @buffer: A video frame.
+ * @state: The #ZslState.
+ *
+ * Copies the capture sized frames of the source to the zero shutter
+ * lag ring. They are copied because the sources usually have just a
+ * few buffers.
+ *
+ * Returns: #TRUE, the frame always goes on.
+ **/
+static gboolean
+_zsl_source_probe (GstPad *pad,
+                   GstBuffer *buffer,
+                   ZslState *state)
+{
+    GstVideoFormat format;
+    gint width, height;
+
+    if (!_probe_state_hold (&state->probes)) {
+        return TRUE;
+    }
+
+    if (!g_atomic_int_get (&state->collecting) ||
+        (NULL == GST_BUFFER_CAPS (buffer)) ||
+        !gst_video_format_parse_caps (GST_BUFFER_CAPS (buffer),
+                                      &format, &width, &height)) {
+        goto free;
+    }
+
+    /* Frames from before the last resolution change are useless */
+    if ((width == g_atomic_int_get (&state->width)) &&
+        (height == g_atomic_int_get (&state->height)) &&
+        _g_digicam_camerabin_jpeg_supported (format)) {
+        _g_digicam_camerabin_prerecord_push (state->ring,
+                                             gst_buffer_copy (buffer));
+    }
+
+    /* free */
+free:
+    _probe_state_release (&state->probes);
+
+    return TRUE;
+}
+
+
+/**
+ * _zsl_busy:
+ * @gst_camera_bin: A camerabin #GstElement.
+ *
+ * Tells whether a zero shutter lag picture would be refused, because
+ * the encoders have as many frames as they can hold.
+ *
+ * Returns: #TRUE if the encoders are full, #FALSE otherwise.
+ **/
+static gboolean
+_zsl_busy (GstElement *gst_camera_bin)
+{
+    ZslState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_ZSL_KEY);
+
+    return ((NULL != state) && g_atomic_int_get (&state->collecting) &&
+            (NULL != state->encoder) &&
+            _g_digicam_camerabin_encoder_is_full (state->encoder));
+}
+
+
+/**
+ * _zsl_capture:
+ * @manager: A #GDigicamManager.
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @helper: The #GDigicamCamerabinPictureHelper of the capture.
+ * @taken: Return location for whether the picture was taken.
+ *
+ * Takes a still picture from the zero shutter lag ring, if any. The
+ * messages CameraBin posts during a capture are posted as well, so
+ * the picture is handled as any other one, and the "img-done" signal
+ * is emitted once the encoded frame is saved. It never waits for the
+ * encoders: while they are full the capture fails, the manager checks
+ * it beforehand, see _g_digicam_camerabin_still_picture_busy().
+ *
+ * Returns: #FALSE if the encoders refused the picture, #TRUE
+ * otherwise, CameraBin has to take it if @taken is #FALSE.
+ **/
+static gboolean
+_zsl_capture (GDigicamManager *manager,
+              GstElement *gst_camera_bin,
+              GDigicamCamerabinPictureHelper *helper,
+              gboolean *taken)
+{
+    GDigicamCamerabinMetadataSession *session = NULL;
+    ZslState *state = NULL;
+    GstClock *clock = NULL;
+    GstElement *source = NULL;
+    GstBuffer *frame = NULL;
+    GstBuffer *preview = NULL;
+    GstClockTime now;
+    GstVideoFormat format;
+    gint width, height;
+    gboolean result = TRUE;
+
+    *taken = FALSE;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_ZSL_KEY);
+    if ((NULL == state) || !g_atomic_int_get (&state->collecting)) {
+        goto free;
+    }
+
+    clock = gst_element_get_clock (gst_camera_bin);
+    if ((NULL == state->encoder) || (NULL == clock)) {
+        goto free;
+    }
+
+    /* The frames are stamped with the running time */
+    now = gst_clock_get_time (clock) -
+        gst_element_get_base_time (gst_camera_bin);
+    frame = _g_digicam_camerabin_prerecord_pick (state->ring, now);
+    if ((NULL == frame) ||
+        !gst_video_format_parse_caps (GST_BUFFER_CAPS (frame),
+                                      &format, &width, &height)) {
+        goto free;
+    }
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: zero shutter lag capture, "
+                     "%" GST_TIME_FORMAT " away from the shutter press",
+                     GST_TIME_ARGS ((GstClockTime)
+                                    ABS (GST_CLOCK_DIFF (now,
+                                                         GST_BUFFER_TIMESTAMP (frame)))));
+
+    /* The encoder doesn't know about tags */
+    session = _get_metadata_session (gst_camera_bin);
+    _g_digicam_camerabin_xmp_prepare (helper->file_path,
+                                      helper->metadata,
+                                      _g_digicam_camerabin_metadata_session_get_date (session));
+
+    /* Given before anything is posted, so a refused frame leaves
+     * nothing half done. "img-done" is emitted from the main loop,
+     * after the messages below. */
+    if (!_g_digicam_camerabin_encoder_push (state->encoder,
+                                            gst_buffer_ref (frame),
+                                            format, width, height,
+                                            _zsl_get_quality (gst_camera_bin),
+                                            helper->file_path,
+                                            (GDigicamCamerabinEncoderDoneFunc) _picture_saved,
+                                            gst_object_ref (gst_camera_bin),
+                                            (GDestroyNotify) gst_object_unref)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: zero shutter lag encoders "
+                        "full, picture not taken.");
+        /* Nothing was taken */
+        gst_buffer_unref (frame);
+        gst_object_unref (gst_camera_bin);
+        _g_digicam_camerabin_xmp_cancel (helper->file_path);
+        result = FALSE;
+        goto free;
+    }
+
+    source = gst_pad_get_parent_element (state->source_pad);
+    _zsl_post_message (source,
+                       G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_START_MESSAGE,
+                       NULL);
+
+    preview = _zsl_preview_new (gst_camera_bin, frame, format, width, height);
+    if (NULL != preview) {
+        _zsl_post_message (gst_camera_bin,
+                           G_DIGICAM_CAMERABIN_PHOTO_PREVIEW_MESSAGE,
+                           preview);
+        gst_buffer_unref (preview);
+    }
+
+    _zsl_post_message (source,
+                       G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_PICTURE_GOT_MESSAGE,
+                       NULL);
+
+    /* Ready for the next one while this one is encoded */
+    _zsl_post_message (gst_camera_bin,
+                       G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_END_MESSAGE,
+                       NULL);
+
+    *taken = TRUE;
+
+free:
+    if (NULL != frame) {
+        gst_buffer_unref (frame);
+    }
+    if (NULL != source) {
+        gst_object_unref (source);
+    }
+    if (NULL != clock) {
+        gst_object_unref (clock);
+    }
+
+    return result;
+}
+
+
+/**
+ * _zsl_post_message:
+ * @element: The #GstElement posting the message.
+ * @name: The name of the message.
+ * @buffer: A #GstBuffer to attach as the "buffer" field, or #NULL.
+ *
+ * Posts an element message like the ones of a CameraBin capture.
+ **/
+static void
+_zsl_post_message (GstElement *element,
+                   const gchar *name,
+                   GstBuffer *buffer)
+{
+    GstStructure *structure = NULL;
+
+    structure = gst_structure_empty_new (name);
+    if (NULL != buffer) {
+        gst_structure_set (structure,
+                           "buffer", GST_TYPE_BUFFER, buffer,
+                           NULL);
+    }
+
+    gst_element_post_message (element,
+                              gst_message_new_element (GST_OBJECT (element),
+                                                       structure));
+}
+
+
+/**
+ * _zsl_preview_new:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @frame: The captured frame.
+ * @format: The #GstVideoFormat of @frame.
+ * @width: Width of @frame.
+ * @height: Height of @frame.
+ *
+ * Downscales @frame to the preview CameraBin would have posted.
+ *
+ * Returns: The preview, or #NULL if there is no preview to post.
+ **/
+static GstBuffer *
+_zsl_preview_new (GstElement *gst_camera_bin,
+                  GstBuffer *frame,
+                  GstVideoFormat format,
+                  gint width, gint height)
+{
+    GDigicamCamerabinScaleTarget target;
+    GstVideoFormat preview_format;
+    GstBuffer *scaled = NULL;
+    GstBuffer *preview = NULL;
+    GstCaps *caps = NULL;
+    const gchar *res = NULL;
+    gint pre_w = 0, pre_h = 0, fps_n = 0, fps_d = 0;
+    gint planes, c, offset;
+    gint src_w, src_h, bpp;
+
+    /* Camerabin previews are disabled when nobody wants them */
+    res = g_object_get_data (G_OBJECT (gst_camera_bin),
+                             G_DIGICAM_CAMERABIN_PREVIEW_RES_KEY);
+    if ((NULL == res) ||
+        !_parse_resolution (res, &pre_w, &pre_h, &fps_n, &fps_d)) {
+        return NULL;
+    }
+
+    preview_format = _get_preview_format ();
+    if ((format != preview_format) &&
+        (GST_VIDEO_FORMAT_RGB != preview_format)) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: no zero shutter lag preview, "
+                         "the frames are not in the preview format.");
+        return NULL;
+    }
+
+    /* Whole chroma samples */
+    pre_w = MIN (pre_w, width) & ~1;
+    pre_h = MIN (pre_h, height) & ~1;
+    if ((0 == pre_w) || (0 == pre_h) ||
+        (width > pre_w * G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR / 2) ||
+        (height > pre_h * G_DIGICAM_CAMERABIN_SCALE_MAX_FACTOR / 2)) {
+        return NULL;
+    }
+
+    switch (format) {
+    case GST_VIDEO_FORMAT_I420:
+        planes = 3;
+        break;
+    case GST_VIDEO_FORMAT_NV12:
+        planes = 2;
+        break;
+    default:
+        /* UYVY, scaled as 4 bytes macropixels */
+        planes = 1;
+        break;
+    }
+
+    scaled = gst_buffer_new_and_alloc (gst_video_format_get_size (format,
+                                                                  pre_w,
+                                                                  pre_h));
+    for (c = 0; c < planes; c++) {
+        if (GST_VIDEO_FORMAT_UYVY == format) {
+            src_w = width / 2;
+            src_h = height;
+            target.width = pre_w / 2;
+            target.height = pre_h;
+            bpp = 4;
+        } else if (0 == c) {
+            src_w = width;
+            src_h = height;
+            target.width = pre_w;
+            target.height = pre_h;
+            bpp = 1;
+        } else {
+            src_w = (width + 1) / 2;
+            src_h = (height + 1) / 2;
+            target.width = pre_w / 2;
+            target.height = pre_h / 2;
+            bpp = (GST_VIDEO_FORMAT_NV12 == format) ? 2 : 1;
+        }
+
+        offset = (GST_VIDEO_FORMAT_UYVY == format) ? 0 :
+            gst_video_format_get_component_offset (format, c, pre_w, pre_h);
+        target.pixels = GST_BUFFER_DATA (scaled) + offset;
+        target.stride = gst_video_format_get_row_stride (format, c, pre_w);
+
+        offset = (GST_VIDEO_FORMAT_UYVY == format) ? 0 :
+            gst_video_format_get_component_offset (format, c, width, height);
+        _g_digicam_camerabin_scale_box (GST_BUFFER_DATA (frame) + offset,
+                                        src_w, src_h,
+                                        gst_video_format_get_row_stride (format, c,
+                                                                         width),
+                                        bpp,
+                                        &target, 1);
+    }
+
+    if (GST_VIDEO_FORMAT_RGB == preview_format) {
+        preview = gst_buffer_new_and_alloc (gst_video_format_get_size (preview_format,
+                                                                       pre_w,
+                                                                       pre_h));
+        _g_digicam_camerabin_colorspace_convert (format,
+                                                 GST_BUFFER_DATA (scaled),
+                                                 pre_w, pre_h,
+                                                 GST_BUFFER_DATA (preview),
+                                                 gst_video_format_get_row_stride (preview_format,
+                                                                                  0, pre_w),
+                                                 FALSE);
+        gst_buffer_unref (scaled);
+    } else {
+        preview = scaled;
+    }
+
+    caps = _new_preview_caps (pre_w, pre_h);
+    gst_buffer_set_caps (preview, caps);
+    gst_caps_unref (caps);
+    GST_BUFFER_TIMESTAMP (preview) = GST_BUFFER_TIMESTAMP (frame);
+
+    return preview;
+}
+
+
+/**
+ * _zsl_get_quality:
+ * @gst_camera_bin: A camerabin #GstElement.
+ *
+ * Gets the quality the image encoder of @gst_camera_bin is set to,
+ * so the zero shutter lag pictures look as the other ones.
+ *
+ * Returns: The JPEG quality.
+ **/
+static gint
+_zsl_get_quality (GstElement *gst_camera_bin)
+{
+    GstElement *encoder = NULL;
+    gint quality = G_DIGICAM_CAMERABIN_ZSL_DEFAULT_QUALITY;
+
+    g_object_get (gst_camera_bin, "imageenc", &encoder, NULL);
+    if (NULL == encoder) {
+        return quality;
+    }
+
+    if (NULL != g_object_class_find_property (G_OBJECT_GET_CLASS (encoder),
+                                              "quality")) {
+        g_object_get (encoder, "quality", &quality, NULL);
+    }
+    gst_object_unref (encoder);
+
+    return quality;
+}
+
+
+/**
+ * _image_encoder_ref:
+ *
+ * Gets the encoders shared by the zero shutter lag rings and the
+ * camerabins encoding in parallel, creating them for the first one.
+ *
+ * Returns: The #GDigicamCamerabinEncoder, to drop with
+ * _image_encoder_unref(), or #NULL if it could not be created.
+ **/
+static GDigicamCamerabinEncoder *
+_image_encoder_ref (void)
+{
+    GDigicamCamerabinEncoder *encoder = NULL;
+
+    g_static_mutex_lock (&image_encoder_lock);
+    if (NULL == image_encoder) {
+        image_encoder = _image_encoder_new ();
+    }
+    if (NULL != image_encoder) {
+        image_encoder_users++;
+        encoder = image_encoder;
+    }
+    g_static_mutex_unlock (&image_encoder_lock);
+
+    return encoder;
+}
+
+
+/**
+ * _image_encoder_unref:
+ * @encoder: The #GDigicamCamerabinEncoder got with _image_encoder_ref().
+ *
+ * Drops a use of the shared encoders. The last one frees them from a
+ * thread of their own, once the pictures still in them are saved:
+ * the last reference to a camerabin can be dropped by an encoder
+ * thread, which can't wait for itself, and the main loop mustn't wait
+ * for the encoders either.
+ **/
+static void
+_image_encoder_unref (GDigicamCamerabinEncoder *encoder)
+{
+    gboolean last = FALSE;
+
+    g_static_mutex_lock (&image_encoder_lock);
+    g_assert (encoder == image_encoder);
+    if (0 == --image_encoder_users) {
+        image_encoder = NULL;
+        last = TRUE;
+    }
+    g_static_mutex_unlock (&image_encoder_lock);
+
+    if (last &&
+        (NULL == g_thread_create (_image_encoder_free, encoder, FALSE, NULL))) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to free the zero "
+                        "shutter lag encoders.");
+    }
+}
+
+
+/**
+ * _image_encoder_free:
+ * @data: A #GDigicamCamerabinEncoder.
+ *
+ * Thread freeing the shared encoders once nobody uses them, see
+ * _image_encoder_unref().
+ *
+ * Returns: #NULL.
+ **/
+static gpointer
+_image_encoder_free (gpointer data)
+{
+    _g_digicam_camerabin_encoder_free ((GDigicamCamerabinEncoder *) data);
+
+    return NULL;
+}
+
+
+static GDigicamCamerabinEncoder *
+_image_encoder_new (void)
+{
+    GDigicamCamerabinEncoder *encoder = NULL;
+    GError *error = NULL;
+    gint threads = 1;
+    gint queue_depth = 0;
+    gint strips = 1;
+#ifdef USE_CONFIG_FILE
+    GKeyFile *key_file = NULL;
+#endif
+
+#ifdef _SC_NPROCESSORS_ONLN
+    threads = MAX (1, sysconf (_SC_NPROCESSORS_ONLN));
+#endif
+
+#ifdef USE_CONFIG_FILE
+    key_file = g_key_file_new ();
+    if (g_key_file_load_from_file (key_file,
+                                   G_KEY_FILE_PATH,
+                                   G_KEY_FILE_NONE,
+                                   NULL) &&
+        g_key_file_get_boolean (key_file,
+                                "global",
+                                "useconfigfile",
+                                NULL)) {
+        if (g_key_file_has_key (key_file, "imageenc", "threads", NULL)) {
+            threads = MAX (1, g_key_file_get_integer (key_file, "imageenc",
+                                                      "threads", NULL));
+        }
+        queue_depth = g_key_file_get_integer (key_file, "imageenc",
+                                              "queue-depth", NULL);
+        if (g_key_file_has_key (key_file, "imageenc", "strips", NULL)) {
+            strips = MAX (1, g_key_file_get_integer (key_file, "imageenc",
+                                                     "strips", NULL));
+        }
+    }
+    g_key_file_free (key_file);
+#endif
+
+    if (0 >= queue_depth) {
+        queue_depth = threads * G_DIGICAM_CAMERABIN_ENCODER_QUEUE_PER_THREAD;
+    }
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: %d image encoders, "
+                     "%d frames queued at most, in %d strips",
+                     threads, queue_depth, strips);
+
+    encoder = _g_digicam_camerabin_encoder_new (threads, queue_depth, strips,
+                                                g_once (&writer_once,
+                                                        _writer_new, NULL),
+                                                &error);
+    if (NULL == encoder) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to create the "
+                        "image encoders: %s",
+                        error->message);
+        g_error_free (error);
+    }
+
+    return encoder;
+}
+
+
+/**
+ * _encode_state_free:
+ * @state: An #EncodeState.
+ *
+ * Removes @state, it is freed once its probe is done with it.
+ **/
+static void
+_encode_state_free (EncodeState *state)
+{
+    _probe_state_remove (&state->probes);
+}
+
+
+/**
+ * _encode_state_finalize:
+ * @state: An #EncodeState.
+ *
+ * Removes the probe of @state and drops its encoders.
+ **/
+static void
+_encode_state_finalize (EncodeState *state)
+{
+    if (NULL != state->encoder_pad) {
+        gst_pad_remove_buffer_probe (state->encoder_pad,
+                                     state->encoder_probe);
+        gst_object_unref (state->encoder_pad);
+    }
+    if (NULL != state->encoder) {
+        _image_encoder_unref (state->encoder);
+    }
+    g_free (state->filename);
+}
+
+
+/**
+ * _encode_prepare:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @filename: The file of the picture about to be captured.
+ *
+ * Sets the picture CameraBin captures next to be encoded by the
+ * shared encoders, if they are used, see
+ * g_digicam_camerabin_set_parallel_encoding().
+ *
+ * Returns: #TRUE if the picture goes to the shared encoders, #FALSE
+ * if CameraBin encodes it.
+ **/
+static gboolean
+_encode_prepare (GstElement *gst_camera_bin,
+                 const gchar *filename)
+{
+    EncodeState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_ENCODE_KEY);
+    if (NULL == state) {
+        return FALSE;
+    }
+
+    g_static_mutex_lock (&encode_lock);
+    g_free (state->filename);
+    state->filename = g_strdup (filename);
+    g_static_mutex_unlock (&encode_lock);
+
+    return TRUE;
+}
+
+
+/**
+ * _encode_busy:
+ * @gst_camera_bin: A camerabin #GstElement.
+ *
+ * Tells whether the picture CameraBin captures next would be refused
+ * by the shared encoders, because they have as many frames as they
+ * can hold.
+ *
+ * Returns: #TRUE if the encoders are full, #FALSE otherwise.
+ **/
+static gboolean
+_encode_busy (GstElement *gst_camera_bin)
+{
+    EncodeState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_ENCODE_KEY);
+
+    return ((NULL != state) &&
+            _g_digicam_camerabin_encoder_is_full (state->encoder));
+}
+
+
+/**
+ * _encode_probe:
+ * @pad: The sink pad of the image encoder.
+ * @buffer: The captured frame.
+ * @state: The #EncodeState.
+ *
+ * Gives the frame of the picture set with _encode_prepare() to the
+ * shared encoders instead of the image encoder. CameraBin then says
+ * the picture is done with an empty file, which the writer replaces
+ * as for the pictures it saves, see _picture_done_filter(). The frames
+ * in a format the encoders don't know, and the ones they refuse
+ * because the captures got ahead of them, are left to the image
+ * encoder.
+ *
+ * Returns: #FALSE for the frames taken by the shared encoders, #TRUE
+ * for the rest.
+ **/
+static gboolean
+_encode_probe (GstPad *pad,
+               GstBuffer *buffer,
+               EncodeState *state)
+{
+    GstBuffer *frame = NULL;
+    gchar *filename = NULL;
+    GstVideoFormat format;
+    gint width, height;
+    gboolean result = TRUE;
+
+    if (!_probe_state_hold (&state->probes)) {
+        return TRUE;
+    }
+
+    g_static_mutex_lock (&encode_lock);
+    filename = state->filename;
+    state->filename = NULL;
+    g_static_mutex_unlock (&encode_lock);
+
+    if ((NULL == filename) ||
+        (NULL == GST_BUFFER_CAPS (buffer)) ||
+        !gst_video_format_parse_caps (GST_BUFFER_CAPS (buffer),
+                                      &format, &width, &height) ||
+        !_g_digicam_camerabin_jpeg_supported (format)) {
+        goto free;
+    }
+
+    /* Before the sink gets the end of the stream */
+    _writer_files_expect (filename);
+
+    /* Copied, the source only has a few buffers */
+    frame = gst_buffer_copy (buffer);
+    if (!_g_digicam_camerabin_encoder_push (state->encoder,
+                                            frame,
+                                            format, width, height,
+                                            _zsl_get_quality (state->gst_camera_bin),
+                                            filename,
+                                            (GDigicamCamerabinEncoderDoneFunc) _picture_saved,
+                                            gst_object_ref (state->gst_camera_bin),
+                                            (GDestroyNotify) gst_object_unref)) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: image encoders full, "
+                         "leaving \"%s\" to CameraBin.", filename);
+        gst_buffer_unref (frame);
+        gst_object_unref (state->gst_camera_bin);
+        _writer_files_forget (filename);
+        goto free;
+    }
+
+    result = FALSE;
+
+    /* free */
+free:
+    g_free (filename);
+    _probe_state_release (&state->probes);
+
+    return result;
+}
+
+#endif /* HAVE_JPEG */
+
+
+/**
+ * _writer_state_get:
+ * @gst_camera_bin: A camerabin #GstElement.
+ *
+ * Takes the encoded pictures over from the file sink, unless it is
+ * already done.
+ *
+ * Returns: the #WriterState of @gst_camera_bin, or #NULL if there is
+ * no image encoder to take them from.
+ **/
+static WriterState *
+_writer_state_get (GstElement *gst_camera_bin)
+{
+    WriterState *state = NULL;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_WRITER_KEY);
+    if (NULL != state) {
+        return state;
+    }
+
+    state = g_slice_new0 (WriterState);
+    _probe_state_init (&state->probes, gst_camera_bin,
+                       sizeof (WriterState),
+                       (GDestroyNotify) _writer_state_finalize);
+    state->gst_camera_bin = gst_camera_bin;
+    state->encoder_pad = _get_element_pad (gst_camera_bin, "imageenc", "src");
+    if (NULL == state->encoder_pad) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: no image encoder to take "
+                        "the pictures from.");
+        _writer_state_free (state);
+        return NULL;
+    }
+    state->encoder_probe = gst_pad_add_buffer_probe (state->encoder_pad,
+                                                     G_CALLBACK (_writer_encoder_probe),
+                                                     state);
+
+    g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                            G_DIGICAM_CAMERABIN_WRITER_KEY,
+                            state,
+                            (GDestroyNotify) _writer_state_free);
+
+    return state;
+}
+
+
+/**
+ * _writer_state_update:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @async: Whether the pictures are saved by the writer.
+ * @picture_buffers: Whether the pictures are captured to memory.
+ *
+ * Takes the encoded pictures over from the file sink if any of them
+ * is needed, and gives them back otherwise.
+ *
+ * Returns: #FALSE if there is no image encoder to take them from,
+ * #TRUE otherwise.
+ **/
+static gboolean
+_writer_state_update (GstElement *gst_camera_bin,
+                      gboolean async,
+                      gboolean picture_buffers)
+{
+    WriterState *state = NULL;
+
+    if (!async && !picture_buffers) {
+        g_object_set_data (G_OBJECT (gst_camera_bin),
+                           G_DIGICAM_CAMERABIN_WRITER_KEY, NULL);
+        return TRUE;
+    }
+
+    state = _writer_state_get (gst_camera_bin);
+    if (NULL == state) {
+        return FALSE;
+    }
+
+    state->async = async;
+    state->picture_buffers = picture_buffers;
+
+    return TRUE;
+}
+
+
+/**
+ * _writer_files_expect:
+ * @filename: The file of a picture given to the writer.
+ *
+ * Tells that CameraBin will say the picture is saved, with an empty
+ * file, while the writer saves it, see _picture_done_filter().
+ **/
+static void
+_writer_files_expect (const gchar *filename)
+{
+    g_static_mutex_lock (&writer_files_lock);
+    if (NULL == writer_files) {
+        writer_files = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, NULL);
+    }
+    g_hash_table_insert (writer_files, g_strdup (filename),
+                         GINT_TO_POINTER (WRITER_FILE_EXPECTED));
+    g_static_mutex_unlock (&writer_files_lock);
+}
+
+
+/**
+ * _writer_files_forget:
+ * @filename: The file of a picture told to _writer_files_expect().
+ *
+ * Takes back a picture which the writer won't get after all.
+ **/
+static void
+_writer_files_forget (const gchar *filename)
+{
+    g_static_mutex_lock (&writer_files_lock);
+    if (NULL != writer_files) {
+        g_hash_table_remove (writer_files, filename);
+    }
+    g_static_mutex_unlock (&writer_files_lock);
+}
+
+
+/**
+ * _writer_state_free:
+ * @state: A #WriterState.
+ *
+ * Removes @state, it is freed once its probes are done with it.
+ **/
+static void
+_writer_state_free (WriterState *state)
+{
+    _probe_state_remove (&state->probes);
+}
+
+
+/**
+ * _writer_state_finalize:
+ * @state: A #WriterState.
+ *
+ * Gives the pictures back to the file sink and frees what @state
+ * holds.
+ **/
+static void
+_writer_state_finalize (WriterState *state)
+{
+    if (NULL != state->encoder_pad) {
+        gst_pad_remove_buffer_probe (state->encoder_pad, state->encoder_probe);
+        gst_object_unref (state->encoder_pad);
+    }
+    if (NULL != state->sink_pad) {
+        gst_pad_remove_data_probe (state->sink_pad, state->sink_probe);
+        gst_object_unref (state->sink_pad);
+        gst_object_unref (state->sink);
+    }
+    g_list_foreach (state->buffers, (GFunc) gst_buffer_unref, NULL);
+    g_list_free (state->buffers);
+    if (NULL != state->output) {
+        _g_digicam_camerabin_output_free (state->output);
+    }
+}
+
+
+/**
+ * _writer_encoder_probe:
+ * @pad: The source pad of the image encoder.
+ * @buffer: An encoded picture.
+ * @state: The #WriterState.
+ *
+ * Finds the file sink the picture goes to, which CameraBin may have
+ * created just for this capture, and takes its input over.
+ *
+ * Returns: #TRUE, the picture always goes on.
+ **/
+static gboolean
+_writer_encoder_probe (GstPad *pad,
+                       GstBuffer *buffer,
+                       WriterState *state)
+{
+    GstElement *sink = NULL;
+    GstPad *sink_pad = NULL;
+
+    if (!_probe_state_hold (&state->probes)) {
+        return TRUE;
+    }
+
+    sink_pad = _get_downstream_sink_pad (pad);
+    if (sink_pad == state->sink_pad) {
+        if (NULL != sink_pad) {
+            gst_object_unref (sink_pad);
+        }
+        goto free;
+    }
+
+    if (NULL != state->sink_pad) {
+        gst_pad_remove_data_probe (state->sink_pad, state->sink_probe);
+        gst_object_unref (state->sink_pad);
+        gst_object_unref (state->sink);
+        state->sink_pad = NULL;
+        state->sink = NULL;
+
+        /* A capture which never ended */
+        g_list_foreach (state->buffers, (GFunc) gst_buffer_unref, NULL);
+        g_list_free (state->buffers);
+        state->buffers = NULL;
+    }
+
+    if (NULL == sink_pad) {
+        goto free;
+    }
+
+    sink = gst_pad_get_parent_element (sink_pad);
+    if ((NULL == sink) ||
+        (NULL == g_object_class_find_property (G_OBJECT_GET_CLASS (sink),
+                                               "location"))) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: the pictures don't go to a "
+                         "file sink, leaving them alone.");
+        if (NULL != sink) {
+            gst_object_unref (sink);
+        }
+        gst_object_unref (sink_pad);
+        goto free;
+    }
+
+    state->sink = sink;
+    state->sink_pad = sink_pad;
+    state->sink_probe = gst_pad_add_data_probe (sink_pad,
+                                                G_CALLBACK (_writer_sink_probe),
+                                                state);
+
+    /* free */
+free:
+    _probe_state_release (&state->probes);
+
+    return TRUE;
+}
+
+
+/**
+ * _writer_sink_probe:
+ * @pad: The sink pad of the file sink.
+ * @data: A #GstBuffer or a #GstEvent going to the sink.
+ * @state: The #WriterState.
+ *
+ * Keeps the picture from the file sink, and gives it to the writer
+ * once complete. The sink goes through the capture as usual, so
+ * CameraBin doesn't notice, it just creates an empty file which the
+ * writer replaces. The complete picture is posted as well when it is
+ * captured to memory, and written to the descriptor given for it, if
+ * any. The pictures only captured to memory never reach the sink.
+ *
+ * Returns: #FALSE for the buffers saved by the writer or not saved at
+ * all, #TRUE for the rest.
+ **/
+static gboolean
+_writer_sink_probe (GstPad *pad,
+                    GstMiniObject *data,
+                    WriterState *state)
+{
+    gchar *filename = NULL;
+    gboolean result = TRUE;
+
+    if (!_probe_state_hold (&state->probes)) {
+        return TRUE;
+    }
+
+    if (GST_IS_BUFFER (data)) {
+        if (NULL == state->buffers) {
+            g_object_get (state->sink, "location", &filename, NULL);
+            state->no_file = (0 == g_strcmp0 (filename,
+                                              G_DIGICAM_CAMERABIN_NO_FILE));
+            g_free (filename);
+            filename = NULL;
+        }
+        state->buffers = g_list_append (state->buffers,
+                                        gst_buffer_ref (GST_BUFFER (data)));
+        result = !state->async && !state->no_file;
+        goto free;
+    }
+
+    if (!GST_IS_EVENT (data) ||
+        (GST_EVENT_EOS != GST_EVENT_TYPE (GST_EVENT (data))) ||
+        (NULL == state->buffers)) {
+        goto free;
+    }
+
+    g_object_get (state->sink, "location", &filename, NULL);
+    if (0 == g_strcmp0 (filename, G_DIGICAM_CAMERABIN_NO_FILE)) {
+        g_free (filename);
+        filename = NULL;
+    }
+
+    if (state->picture_buffers) {
+        _writer_post_picture (state, filename);
+    }
+
+    if (NULL != state->output) {
+        _writer_write_output (state);
+    }
+
+    if (!state->async || (NULL == filename)) {
+        g_list_foreach (state->buffers, (GFunc) gst_buffer_unref, NULL);
+        g_list_free (state->buffers);
+        state->buffers = NULL;
+        g_free (filename);
+        goto free;
+    }
+
+    /* Before the sink gets the end of the stream, and CameraBin says
+     * the picture is saved */
+    _writer_files_expect (filename);
+
+    _g_digicam_camerabin_writer_push (g_once (&writer_once, _writer_new, NULL),
+                                      filename,
+                                      state->buffers,
+                                      (GDigicamCamerabinWriterDoneFunc) _picture_saved,
+                                      gst_object_ref (state->gst_camera_bin),
+                                      (GDestroyNotify) gst_object_unref);
+    state->buffers = NULL;
+    g_free (filename);
+
+    /* free */
+free:
+    _probe_state_release (&state->probes);
+
+    return result;
+}
+
+
+/**
+ * _writer_post_picture:
+ * @state: The #WriterState.
+ * @filename: The file the picture is saved to, or #NULL.
+ *
+ * Posts the picture kept from the file sink in a single buffer, to
+ * be handed in the "picture-buffer" signal.
+ **/
+static void
+_writer_post_picture (WriterState *state,
+                      const gchar *filename)
+{
+    GstStructure *structure = NULL;
+    GstBuffer *picture = NULL;
+    GList *item = NULL;
+    guint size = 0;
+    guint8 *data = NULL;
+
+    /* Usually the encoders give it in one piece already */
+    if (NULL == state->buffers->next) {
+        picture = gst_buffer_ref (GST_BUFFER (state->buffers->data));
+    } else {
+        for (item = state->buffers; NULL != item; item = item->next) {
+            size += GST_BUFFER_SIZE (item->data);
+        }
+        picture = gst_buffer_new_and_alloc (size);
+        gst_buffer_copy_metadata (picture, GST_BUFFER (state->buffers->data),
+                                  GST_BUFFER_COPY_TIMESTAMPS |
+                                  GST_BUFFER_COPY_CAPS);
+        data = GST_BUFFER_DATA (picture);
+        for (item = state->buffers; NULL != item; item = item->next) {
+            memcpy (data, GST_BUFFER_DATA (item->data),
+                    GST_BUFFER_SIZE (item->data));
+            data += GST_BUFFER_SIZE (item->data);
+        }
+    }
+
+    structure = gst_structure_new (G_DIGICAM_CAMERABIN_PICTURE_BUFFER_MESSAGE,
+                                   "buffer", GST_TYPE_BUFFER, picture,
+                                   "filename", G_TYPE_STRING, filename,
+                                   NULL);
+    gst_buffer_unref (picture);
+
+    gst_element_post_message (state->gst_camera_bin,
+                              gst_message_new_element (GST_OBJECT (state->gst_camera_bin),
+                                                       structure));
+}
+
+
+/**
+ * _get_downstream_sink_pad:
+ * @pad: A source pad.
+ *
+ * Follows the elements linked after @pad to the last one.
+ *
+ * Returns: The sink pad of the last element, or #NULL if @pad is not
+ * linked.
+ **/
+static GstPad *
+_get_downstream_sink_pad (GstPad *pad)
+{
+    GstElement *element = NULL;
+    GstPad *peer = NULL;
+    GstPad *target = NULL;
+
+    gst_object_ref (pad);
+
+    while (NULL != (peer = gst_pad_get_peer (pad))) {
+        gst_object_unref (pad);
+
+        /* Into the bins */
+        while (GST_IS_GHOST_PAD (peer)) {
+            target = gst_ghost_pad_get_target (GST_GHOST_PAD (peer));
+            gst_object_unref (peer);
+            peer = target;
+            if (NULL == peer) {
+                return NULL;
+            }
+        }
+
+        element = gst_pad_get_parent_element (peer);
+        pad = (NULL != element) ?
+            gst_element_get_static_pad (element, "src") : NULL;
+        if (NULL != element) {
+            gst_object_unref (element);
+        }
+
+        if (NULL == pad) {
+            return peer;
+        }
+        gst_object_unref (peer);
+    }
+
+    gst_object_unref (pad);
+
+    return NULL;
+}
+
+
+static gpointer
+_writer_new (gpointer data)
+{
+    GDigicamCamerabinWriter *writer = NULL;
+    GError *error = NULL;
+    gint batch = G_DIGICAM_CAMERABIN_WRITER_BATCH;
+#ifdef USE_CONFIG_FILE
+    GKeyFile *key_file = NULL;
+#endif
+
+#ifdef USE_CONFIG_FILE
+    key_file = g_key_file_new ();
+    if (g_key_file_load_from_file (key_file,
+                                   G_KEY_FILE_PATH,
+                                   G_KEY_FILE_NONE,
+                                   NULL) &&
+        g_key_file_get_boolean (key_file,
+                                "global",
+                                "useconfigfile",
+                                NULL) &&
+        g_key_file_has_key (key_file, "writer", "batch", NULL)) {
+        batch = MAX (1, g_key_file_get_integer (key_file, "writer",
+                                                "batch", NULL));
+    }
+    g_key_file_free (key_file);
+#endif
+
+    writer = _g_digicam_camerabin_writer_new (batch, &error);
+    if (NULL == writer) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: unable to create the "
+                        "picture writer: %s",
+                        error->message);
+        g_error_free (error);
+    }
+
+    return writer;
+}
+
+
+/**
+ * _picture_saved:
+ * @filename: The file of the picture.
+ * @error: Why it was not saved, or #NULL.
+ * @gst_camera_bin: The camerabin #GstElement which took it.
+ *
+ * Runs in the writer thread once a picture saved by GDigicam is on
+ * disk, or couldn't be saved, then the error is posted on the bus. If
+ * CameraBin already said this picture is done, or never will, as for
+ * the zero shutter lag pictures, "img-done" is emitted from the main
+ * loop now. Otherwise _picture_done_filter() does it once CameraBin
+ * says so.
+ **/
+static void
+_picture_saved (const gchar *filename,
+                const GError *error,
+                GstElement *gst_camera_bin)
+{
+    WriterFileStatus status = 0;
+
+    TSTAMP (after-picture-save);
+
+    g_static_mutex_lock (&writer_files_lock);
+    if (NULL != writer_files) {
+        status = GPOINTER_TO_INT (g_hash_table_lookup (writer_files,
+                                                       filename));
+        if (WRITER_FILE_EXPECTED == status) {
+            g_hash_table_insert (writer_files, g_strdup (filename),
+                                 GINT_TO_POINTER ((NULL == error) ?
+                                                  WRITER_FILE_SAVED :
+                                                  WRITER_FILE_FAILED));
+        } else if (0 != status) {
+            g_hash_table_remove (writer_files, filename);
+        }
+    }
+    g_static_mutex_unlock (&writer_files_lock);
+
+    if (NULL == error) {
+        if (WRITER_FILE_EXPECTED != status) {
+            _picture_done_queue (gst_camera_bin, filename);
+        }
+        return;
+    }
+
+    G_DIGICAM_WARN ("GDigicamCamerabin: unable to save \"%s\": %s",
+                    filename, error->message);
+    _g_digicam_camerabin_xmp_cancel (filename);
+    gst_element_post_message (gst_camera_bin,
+                              gst_message_new_error (GST_OBJECT (gst_camera_bin),
+                                                     (GError *) error,
+                                                     (gchar *) filename));
+}
+
+
+/**
+ * _picture_done_queue:
+ * @gst_camera_bin: The camerabin #GstElement which took the picture.
+ * @filename: The file of the picture.
+ *
+ * Queues the emission of "img-done" for a picture in the main loop,
+ * after the "picture-buffer" of the picture, if any, which is queued
+ * the same way. The pictures only captured to memory are told about
+ * without a file.
+ **/
+static void
+_picture_done_queue (GstElement *gst_camera_bin,
+                     const gchar *filename)
+{
+    PictureSavedHelper *helper = NULL;
+
+    helper = g_slice_new0 (PictureSavedHelper);
+    helper->gst_camera_bin = gst_object_ref (gst_camera_bin);
+    if (0 != g_strcmp0 (filename, G_DIGICAM_CAMERABIN_NO_FILE)) {
+        helper->filename = g_strdup (filename);
+    }
+    g_idle_add (_emit_picture_saved, helper);
+}
+
+
+/**
+ * _emit_picture_saved:
+ * @user_data: A #PictureSavedHelper.
+ *
+ * Emits "img-done" for a picture saved by GDigicam, or only captured
+ * to memory, see _picture_done_queue(). The handlers of the users of
+ * the bin get it, the value they return is ignored: CameraBin is done
+ * with the picture already.
+ *
+ * Returns: #FALSE, to run only once.
+ **/
+static gboolean
+_emit_picture_saved (gpointer user_data)
+{
+    PictureSavedHelper *helper = NULL;
+    gboolean ret = FALSE;
+
+    helper = (PictureSavedHelper *) user_data;
+
+    g_static_private_set (&picture_done_emission, GINT_TO_POINTER (TRUE),
+                          NULL);
+    g_signal_emit_by_name (helper->gst_camera_bin, "img-done",
+                           helper->filename, &ret);
+    g_static_private_set (&picture_done_emission, NULL, NULL);
+
+    /* Free */
+    gst_object_unref (helper->gst_camera_bin);
+    g_free (helper->filename);
+    g_slice_free (PictureSavedHelper, helper);
+
+    return FALSE;
+}
+
+
+/**
+ * _writer_write_output:
+ * @state: The #WriterState.
+ *
+ * Writes the picture kept from the file sink to the descriptor given
+ * for it, and forgets the descriptor.
+ **/
+static void
+_writer_write_output (WriterState *state)
+{
+    GError *error = NULL;
+    GList *item = NULL;
+
+    for (item = state->buffers; NULL != item; item = item->next) {
+        if (!_g_digicam_camerabin_output_write (state->output,
+                                                GST_BUFFER (item->data),
+                                                &error)) {
+            G_DIGICAM_WARN ("GDigicamCamerabin: %s", error->message);
+            gst_element_post_message (state->sink,
+                                      gst_message_new_error (GST_OBJECT (state->sink),
+                                                             error, NULL));
+            g_error_free (error);
+            break;
+        }
+    }
+
+    _g_digicam_camerabin_output_free (state->output);
+    state->output = NULL;
+}
+
+
+/**
+ * _picture_done_filter:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @filename: The file of the picture.
+ * @user_data: Unused.
+ *
+ * Handler of "img-done" running before any other. When a picture goes
+ * to the writer, CameraBin says it is done once its file sink closes
+ * the file, which is still empty then. CameraBin gets its answer right
+ * away, so the next picture of a burst is captured while the writer
+ * saves this one, and the syncs of the burst are done together. The
+ * other handlers get "img-done" from the main loop once the picture is
+ * on disk, see _picture_saved(), and not at all if it couldn't be
+ * saved, the error is on the bus. The pictures handed in memory are
+ * told about from the main loop too, after their "picture-buffer".
+ *
+ * Returns: whether CameraBin goes on capturing, for the pictures told
+ * about later, #FALSE otherwise, the other handlers decide then.
+ **/
+static gboolean
+_picture_done_filter (GstElement *gst_camera_bin,
+                      const gchar *filename,
+                      gpointer user_data)
+{
+    WriterState *state = NULL;
+    WriterFileStatus status = 0;
+
+    /* Our own emission from the main loop, for the other handlers */
+    if ((NULL == filename) ||
+        (NULL != g_static_private_get (&picture_done_emission))) {
+        return FALSE;
+    }
+
+    g_static_mutex_lock (&writer_files_lock);
+    if (NULL != writer_files) {
+        status = GPOINTER_TO_INT (g_hash_table_lookup (writer_files,
+                                                       filename));
+        if (WRITER_FILE_EXPECTED == status) {
+            /* Told about once saved, see _picture_saved() */
+            g_hash_table_insert (writer_files, g_strdup (filename),
+                                 GINT_TO_POINTER (WRITER_FILE_DONE));
+        } else if (0 != status) {
+            g_hash_table_remove (writer_files, filename);
+        }
+    }
+    g_static_mutex_unlock (&writer_files_lock);
+
+    if (0 == status) {
+        state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                                   G_DIGICAM_CAMERABIN_WRITER_KEY);
+        if ((0 != g_strcmp0 (filename, G_DIGICAM_CAMERABIN_NO_FILE)) &&
+            ((NULL == state) || !state->picture_buffers)) {
+            /* Saved by CameraBin and not handed in memory, as usual */
+            return FALSE;
+        }
+    }
+
+    if ((0 == status) || (WRITER_FILE_SAVED == status)) {
+        _picture_done_queue (gst_camera_bin, filename);
+    }
+
+    g_signal_stop_emission_by_name (gst_camera_bin, "img-done");
+
+    return _picture_done_continue (gst_camera_bin, filename);
+}
+
+
+/**
+ * _picture_done_continue:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @filename: The file of the picture CameraBin is done with.
+ *
+ * Decides whether CameraBin goes on capturing after a picture whose
+ * "img-done" is emitted later. It can only if the name of the next
+ * picture is set already, as the handlers setting it from
+ * #GDigicamManager::pict-done run too late for CameraBin.
+ *
+ * Returns: #TRUE if CameraBin has the name of another picture, #FALSE
+ * otherwise.
+ **/
+static gboolean
+_picture_done_continue (GstElement *gst_camera_bin,
+                        const gchar *filename)
+{
+    gchar *next = NULL;
+    gboolean result;
+
+    g_object_get (gst_camera_bin, "filename", &next, NULL);
+    result = (NULL != next) && ('\0' != *next) &&
+        (0 != g_strcmp0 (next, filename));
+    g_free (next);
+
+    return result;
+}
+
+
+/**
+ * _videomux_set_fragments:
+ * @vmux: The video muxer #GstElement.
+ * @duration: Milliseconds of each fragment, 0 to write plain files.
+ *
+ * Makes @vmux write the recordings as a series of fragments, if it
+ * can. Each fragment is complete once written, so the file is playable
+ * up to the last one if the recording is interrupted, and finishing it
+ * only takes writing the last fragment instead of the whole index.
+ **/
+static void
+_videomux_set_fragments (GstElement *vmux,
+                         guint duration)
+{
+    if (0 == duration) {
+        return;
+    }
+
+    if (NULL == g_object_class_find_property (G_OBJECT_GET_CLASS (vmux),
+                                              "fragment-duration")) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin::g_digicam_camerabin_element_new: "
+                         "video mux can't write fragmented files.");
+        return;
+    }
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin::g_digicam_camerabin_element_new: "
+                     "recording in fragments of %u ms.", duration);
+    g_object_set (G_OBJECT (vmux), "fragment-duration", duration, NULL);
+}
+
+
+/**
+ * _recording_config_load:
+ * @data: Unused.
+ *
+ * Reads how much space is reserved ahead of the recordings, and how
+ * often they are flushed.
+ *
+ * Returns: A #RecordingConfig.
+ **/
+static gpointer
+_recording_config_load (gpointer data)
+{
+    RecordingConfig *config = NULL;
+#ifdef USE_CONFIG_FILE
+    GKeyFile *key_file = NULL;
+#endif
+
+    config = g_new0 (RecordingConfig, 1);
+    config->prealloc_seconds = G_DIGICAM_CAMERABIN_PREALLOC_SECONDS;
+    config->prealloc_bitrate = G_DIGICAM_CAMERABIN_PREALLOC_BITRATE;
+    config->writeback_window = G_DIGICAM_CAMERABIN_WRITEBACK_WINDOW;
+
+#ifdef USE_CONFIG_FILE
+    key_file = g_key_file_new ();
+    if (g_key_file_load_from_file (key_file,
+                                   G_KEY_FILE_PATH,
+                                   G_KEY_FILE_NONE,
+                                   NULL) &&
+        g_key_file_get_boolean (key_file,
+                                "global",
+                                "useconfigfile",
+                                NULL)) {
+        if (g_key_file_has_key (key_file, "prealloc", "seconds", NULL)) {
+            config->prealloc_seconds = MAX (0, g_key_file_get_integer (key_file,
+                                                                       "prealloc",
+                                                                       "seconds",
+                                                                       NULL));
+        }
+        if (g_key_file_has_key (key_file, "prealloc", "bitrate", NULL)) {
+            config->prealloc_bitrate = MAX (1, g_key_file_get_integer (key_file,
+                                                                       "prealloc",
+                                                                       "bitrate",
+                                                                       NULL));
+        }
+        if (g_key_file_has_key (key_file, "writeback", "window", NULL)) {
+            config->writeback_window = 1024 * MAX (0, g_key_file_get_integer (key_file,
+                                                                              "writeback",
+                                                                              "window",
+                                                                              NULL));
+        }
+    }
+    g_key_file_free (key_file);
+#endif
+
+    return config;
+}
+
+
+/**
+ * _recording_state_free:
+ * @state: A #RecordingState.
+ *
+ * Removes @state, it is finalized once its probe is done with it.
+ **/
+static void
+_recording_state_free (RecordingState *state)
+{
+    _probe_state_remove (&state->probes);
+}
+
+
+/**
+ * _recording_state_finalize:
+ * @state: A #RecordingState.
+ *
+ * Stops reserving space for the recording and flushing it, gives back
+ * the space not used and frees what @state holds.
+ **/
+static void
+_recording_state_finalize (RecordingState *state)
+{
+    GError *error = NULL;
+
+    if (NULL != state->sink_pad) {
+        gst_pad_remove_data_probe (state->sink_pad, state->sink_probe);
+        gst_object_unref (state->sink_pad);
+    }
+    if (NULL != state->sink) {
+        gst_object_unref (state->sink);
+    }
+    if ((NULL != state->prealloc) &&
+        !_g_digicam_camerabin_prealloc_finish (state->prealloc, &error)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: %s", error->message);
+        g_error_free (error);
+    }
+    if (NULL != state->writeback) {
+        _g_digicam_camerabin_writeback_finish (state->writeback);
+    }
+    if (NULL != state->segmenter) {
+        _g_digicam_camerabin_segmenter_finish (state->segmenter);
+    }
+    if (NULL != state->output) {
+        _g_digicam_camerabin_output_free (state->output);
+    }
+}
+
+
+/**
+ * _recording_start:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @output: The descriptor the recording goes to, or #NULL.
+ *
+ * Starts reserving space for the recording about to start and
+ * flushing it, or splitting it in segments, if it goes to a file. It
+ * takes @output over, and writes the recording to it instead. It is
+ * called before the recording starts, so the probe sees all the data
+ * going to the file sink.
+ *
+ * Returns: #FALSE if there is no file sink to take the recording to
+ * @output from, #TRUE otherwise.
+ **/
+static gboolean
+_recording_start (GstElement *gst_camera_bin,
+                  GDigicamCamerabinOutput *output)
+{
+    RecordingConfig *config = NULL;
+    RecordingState *state = NULL;
+    SegmentsConfig *segments = NULL;
+    GstPad *muxer_pad = NULL;
+    GstPad *sink_pad = NULL;
+    GstElement *sink = NULL;
+
+    /* The previous recording, if it never got to be closed */
+    g_object_set_data (G_OBJECT (gst_camera_bin),
+                       G_DIGICAM_CAMERABIN_RECORDING_KEY, NULL);
+
+    config = g_once (&recording_config_once, _recording_config_load, NULL);
+    segments = g_object_get_data (G_OBJECT (gst_camera_bin),
+                                  G_DIGICAM_CAMERABIN_SEGMENTS_KEY);
+    if ((NULL == output) && (NULL == segments) &&
+        (0 == config->prealloc_seconds) && (0 == config->writeback_window)) {
+        return TRUE;
+    }
+
+    muxer_pad = _get_element_pad (gst_camera_bin, "videomux", "src");
+    if (NULL != muxer_pad) {
+        sink_pad = _get_downstream_sink_pad (muxer_pad);
+        gst_object_unref (muxer_pad);
+    }
+    if (NULL == sink_pad) {
+        goto free;
+    }
+
+    sink = gst_pad_get_parent_element (sink_pad);
+    if ((NULL == sink) ||
+        (NULL == g_object_class_find_property (G_OBJECT_GET_CLASS (sink),
+                                               "location"))) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: the recording doesn't go to "
+                         "a file sink, leaving it alone.");
+        if (NULL != sink) {
+            gst_object_unref (sink);
+        }
+        gst_object_unref (sink_pad);
+        goto free;
+    }
+
+    state = g_slice_new0 (RecordingState);
+    _probe_state_init (&state->probes, gst_camera_bin,
+                       sizeof (RecordingState),
+                       (GDestroyNotify) _recording_state_finalize);
+    state->sink = sink;
+    state->sink_pad = sink_pad;
+    state->output = output;
+    output = NULL;
+    if (NULL != segments) {
+        state->segments = *segments;
+    }
+    state->sink_probe = gst_pad_add_data_probe (sink_pad,
+                                                G_CALLBACK (_recording_sink_probe),
+                                                state);
+
+    g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                            G_DIGICAM_CAMERABIN_RECORDING_KEY,
+                            state,
+                            (GDestroyNotify) _recording_state_free);
+
+    /* free */
+free:
+    if (NULL != output) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: no file sink to take the "
+                        "recording from, it can't go to the descriptor.");
+        _g_digicam_camerabin_output_free (output);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/**
+ * _recording_sink_probe:
+ * @pad: The sink pad of the file sink.
+ * @data: A #GstBuffer or a #GstEvent going to the sink.
+ * @state: The #RecordingState.
+ *
+ * Reserves space ahead of the data going to the file, and flushes
+ * what is already in it. A segmented recording is written by the
+ * segmenter instead, the sink only creates the file of the first
+ * segment, and one going to a descriptor is written to it.
+ *
+ * Returns: #FALSE for the buffers of a segmented recording or one
+ * going to a descriptor, #TRUE otherwise.
+ **/
+static gboolean
+_recording_sink_probe (GstPad *pad,
+                       GstMiniObject *data,
+                       RecordingState *state)
+{
+    RecordingConfig *config = NULL;
+    gchar *filename = NULL;
+    GError *error = NULL;
+    GstFormat format;
+    gint64 start;
+    gboolean result = TRUE;
+
+    if (!_probe_state_hold (&state->probes)) {
+        return TRUE;
+    }
+
+    if (GST_IS_EVENT (data)) {
+        if (((NULL != state->segmenter) || (NULL != state->output)) &&
+            (GST_EVENT_NEWSEGMENT == GST_EVENT_TYPE (GST_EVENT (data)))) {
+            gst_event_parse_new_segment (GST_EVENT (data), NULL, NULL,
+                                         &format, &start, NULL, NULL);
+            if ((GST_FORMAT_BYTES == format) && (0 <= start) &&
+                (NULL != state->segmenter)) {
+                _g_digicam_camerabin_segmenter_seek (state->segmenter, start);
+            } else if ((GST_FORMAT_BYTES == format) && (0 <= start)) {
+                _g_digicam_camerabin_output_seek (state->output, start);
+            }
+        }
+        goto free;
+    }
+
+    if (!GST_IS_BUFFER (data)) {
+        goto free;
+    }
+
+    if (NULL != state->output) {
+        if (!_g_digicam_camerabin_output_write (state->output,
+                                                GST_BUFFER (data),
+                                                &error)) {
+            G_DIGICAM_WARN ("GDigicamCamerabin: %s", error->message);
+            gst_element_post_message (state->sink,
+                                      gst_message_new_error (GST_OBJECT (state->sink),
+                                                             error, NULL));
+            g_error_free (error);
+        }
+        result = FALSE;
+        goto free;
+    }
+
+    if (!state->started) {
+        state->started = TRUE;
+
+        config = g_once (&recording_config_once, _recording_config_load, NULL);
+        g_object_get (state->sink, "location", &filename, NULL);
+        if ((NULL != filename) &&
+            ((0 < state->segments.seconds) || (0 < state->segments.max_bytes))) {
+            state->segmenter = _g_digicam_camerabin_segmenter_new (filename,
+                                                                   state->segments.seconds * GST_SECOND,
+                                                                   state->segments.max_bytes,
+                                                                   state->segments.reserved,
+                                                                   config->writeback_window,
+                                                                   &error);
+            if (NULL == state->segmenter) {
+                G_DIGICAM_WARN ("GDigicamCamerabin: %s", error->message);
+                g_clear_error (&error);
+            }
+        }
+        if ((NULL != filename) && (NULL == state->segmenter) &&
+            (0 < config->prealloc_seconds)) {
+            state->prealloc = _g_digicam_camerabin_prealloc_new (filename,
+                                                                 config->prealloc_bitrate,
+                                                                 config->prealloc_seconds,
+                                                                 &error);
+            if (NULL == state->prealloc) {
+                G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+                g_clear_error (&error);
+            }
+        }
+        if ((NULL != filename) && (NULL == state->segmenter) &&
+            (0 < config->writeback_window)) {
+            state->writeback = _g_digicam_camerabin_writeback_new (filename,
+                                                                   config->writeback_window,
+                                                                   &error);
+            if (NULL == state->writeback) {
+                G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+                g_clear_error (&error);
+            }
+        }
+        g_free (filename);
+    }
+
+    if (NULL != state->segmenter) {
+        if (!_g_digicam_camerabin_segmenter_push (state->segmenter,
+                                                  GST_BUFFER (data),
+                                                  &error)) {
+            G_DIGICAM_WARN ("GDigicamCamerabin: %s", error->message);
+            gst_element_post_message (state->sink,
+                                      gst_message_new_error (GST_OBJECT (state->sink),
+                                                             error, NULL));
+            g_error_free (error);
+        }
+        result = FALSE;
+        goto free;
+    }
+
+    if (NULL != state->prealloc) {
+        _g_digicam_camerabin_prealloc_written (state->prealloc,
+                                               GST_BUFFER_SIZE (data));
+    }
+    if (NULL != state->writeback) {
+        _g_digicam_camerabin_writeback_written (state->writeback,
+                                                GST_BUFFER_SIZE (data));
+    }
+
+    /* free */
+free:
+    _probe_state_release (&state->probes);
+
+    return result;
+}
+
+
+/**
+ * _recording_state_changed:
+ * @gst_camera_bin: A camerabin #GstElement.
+ * @message: A state changed #GstMessage.
+ *
+ * Truncates the recording to its size and drops it from the cache
+ * once its file sink closes it.
+ **/
+static void
+_recording_state_changed (GstElement *gst_camera_bin,
+                          GstMessage *message)
+{
+    RecordingState *state = NULL;
+    GstState old = 0;
+    GstState new = 0;
+    GstState pending = 0;
+
+    state = g_object_get_data (G_OBJECT (gst_camera_bin),
+                               G_DIGICAM_CAMERABIN_RECORDING_KEY);
+    if ((NULL == state) ||
+        (GST_OBJECT (state->sink) != GST_MESSAGE_SRC (message))) {
+        return;
+    }
+
+    gst_message_parse_state_changed (message, &old, &new, &pending);
+    if (GST_STATE_READY >= new) {
+        g_object_set_data (G_OBJECT (gst_camera_bin),
+                           G_DIGICAM_CAMERABIN_RECORDING_KEY, NULL);
+    }
+}
+
+
+/**
+ * _g_digicam_camerabin_handle_bus_message:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GstMessage.
+ *
+ * Function to handle custom gstreamer bus messages.
+ *
+ * Returns: #FALSE if invalid input arguments are received or the
+ * operation fails, #TRUE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_handle_bus_message (GDigicamManager *manager,
+					 gpointer user_data)
+{
+    const GstStructure *structure = NULL;
+    gint status = GST_PHOTOGRAPHY_FOCUS_STATUS_NONE;
+    const gchar *message_name = NULL;
+    GstState old = 0;
+    GstState new = 0;
+    GstState pending = 0;
+    GError *error = NULL;
+    GDigicamMode mode;
+    GstElement *bin = NULL;
+    gboolean result = FALSE;
+
+    switch (GST_MESSAGE_TYPE (GST_MESSAGE (user_data))) {
+    case GST_MESSAGE_STATE_CHANGED:
+        /* Don't care if it is not coming from camerabin itself */
+	result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                      &bin,
+                                                      &error);
+
+        /* Check errors */
+        if (!result) {
+            if (NULL != error) {
+                G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
+                                 "%s", error->message);
+            }
+            goto free;
+        }
+
+	_recording_state_changed (bin, GST_MESSAGE (user_data));
+
+	if (GST_ELEMENT (GST_MESSAGE_SRC (GST_MESSAGE (user_data))) == bin) {
+	    gst_message_parse_state_changed (GST_MESSAGE (user_data),
+					     &old,
+					     &new,
+					     &pending);
+	    if (GST_STATE_PLAYING == new) {
+		result = g_digicam_manager_get_mode (manager,
+                                                     &mode,
+                                                     &error);
+
+                /* Check errors */
+                if (!result) {
+                    if (NULL != error) {
+                        G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
+                                         "%s", error->message);
+                    }
+                    goto free;
+                }
+
+		switch (mode) {
+		case G_DIGICAM_MODE_STILL:
+		    g_object_set (bin, "mode", 0, NULL);
+		    break;
+		case G_DIGICAM_MODE_VIDEO:
+		    g_object_set (bin, "mode", 1, NULL);
+		    break;
+		default:
+		    g_assert_not_reached ();
+		}
+	    }
+	}
+	break;
+    case GST_MESSAGE_ELEMENT:
+	structure = gst_message_get_structure (GST_MESSAGE (user_data));
+	message_name = gst_structure_get_name (structure);
+
+	/* autofocus message */
+	if (g_strcmp0 (message_name, GST_PHOTOGRAPHY_AUTOFOCUS_DONE) == 0) {
+	    gst_structure_get_int (structure, "status", &status);
+	    switch (status) {
+	    case GST_PHOTOGRAPHY_FOCUS_STATUS_FAIL:
+		G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
+                                 "Autofocus failed message received.");
+		g_signal_emit_by_name (manager,
+				       "focus-done",
+				       G_DIGICAM_FOCUSMODESTATUS_UNABLETOREACH);
+		break;
+	    case GST_PHOTOGRAPHY_FOCUS_STATUS_SUCCESS:
+		G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
+                                 "Autofocus success message received.");
+		g_signal_emit_by_name (manager,
+				       "focus-done",
+				       G_DIGICAM_FOCUSMODESTATUS_REACHED);
+		break;
+	    case GST_PHOTOGRAPHY_FOCUS_STATUS_NONE:
+		G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
+                                 "Autofocus none message received.");
+		break;
+	    case GST_PHOTOGRAPHY_FOCUS_STATUS_RUNNING:
+		G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
+                                 "Autofocus running message received.");
+		break;
+	    default:
+		break;
+	    }
+	    return TRUE;
+	}
+
+	/* Shake risk message */
+	if (g_strcmp0 (message_name, GST_PHOTOGRAPHY_SHAKE_RISK) == 0) {
+	    return TRUE;
+	}
+
+	break;
+    default:
+	/* Not handling this message */
+	break;
+    }
+
+    /* Free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
+
+    return TRUE;
+}
+
+/**
+ * _g_digicam_camerabin_handle_picture_done:
+ * @manager: A #GDigicamManager.
+ * @user_data: The file name of the saved picture.
+ *
+ * Writes the deferred metadata of the picture, see
+ * g_digicam_camerabin_set_deferred_metadata(), and the thumbnails
+ * requested with g_digicam_manager_set_thumbnail_mode() from the
+ * preview of the picture, so nobody has to decode it again to make
+ * them. The thumbnails are written after the metadata, as they are
+ * only valid for the modification time of the final file.
+ *
+ * Returns: #FALSE if there was nothing to write, #TRUE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_handle_picture_done (GDigicamManager *manager,
+                                          gpointer user_data)
+{
+    const gchar *filename = NULL;
+    gboolean result = FALSE;
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    ThumbnailHelper *thumbnail = NULL;
+    GdkPixbuf *preview = NULL;
+    GDigicamThumbnail mode;
+#endif
+
+    filename = (const gchar *) user_data;
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    /* The preview is always posted before the picture is saved */
+    g_static_mutex_lock (&thumbnail_lock);
+    preview = g_object_steal_data (G_OBJECT (manager),
+                                   G_DIGICAM_CAMERABIN_THUMBNAIL_KEY);
+    g_static_mutex_unlock (&thumbnail_lock);
+
+    if (NULL != preview) {
+        if ((NULL != filename) &&
+            g_digicam_manager_get_thumbnail_mode (manager, &mode, NULL)) {
+            thumbnail = g_slice_new0 (ThumbnailHelper);
+            thumbnail->preview = g_object_ref (preview);
+            thumbnail->mode = mode;
+        }
+        g_object_unref (preview);
+        result = TRUE;
+    }
+
+    if ((NULL != filename) &&
+        _g_digicam_camerabin_xmp_write (filename,
+                                        (NULL != thumbnail) ?
+                                        _thumbnail_after_metadata : NULL,
+                                        thumbnail)) {
+        return TRUE;
+    }
+
+    /* No metadata to wait for */
+    if (NULL != thumbnail) {
+        _thumbnail_after_metadata (filename, thumbnail);
+    }
+#else
+    if (NULL != filename) {
+        result = _g_digicam_camerabin_xmp_write (filename, NULL, NULL);
+    }
+#endif
+
+    return result;
+}
+
+/**
+ * _g_digicam_camerabin_switch_storage:
+ * @manager: A #GDigicamManager.
+ * @user_data: The directory of the next storage target.
+ *
+ * Moves the recording going on to another storage target, from its
+ * next segment on. Only segmented recordings, see
+ * g_digicam_camerabin_set_segments(), can be moved without stopping
+ * them.
+ *
+ * Returns: #FALSE if the recording can't be moved, #TRUE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_switch_storage (GDigicamManager *manager,
+                                     gpointer user_data)
+{
+    const gchar *directory = NULL;
+    RecordingState *state = NULL;
+    GstElement *bin = NULL;
+    GError *error = NULL;
+    gboolean result;
+
+    directory = (const gchar *) user_data;
+
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
+
+    state = g_object_get_data (G_OBJECT (bin),
+                               G_DIGICAM_CAMERABIN_RECORDING_KEY);
+    if ((NULL == state) || (NULL == state->segmenter)) {
+        result = FALSE;
+        goto free;
+    }
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: next segments go to %s.",
+                     directory);
+    _g_digicam_camerabin_segmenter_set_directory (state->segmenter,
+                                                  directory);
+
+    /* free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
+
+    return result;
+}
+
+/**
+ * _g_digicam_camerabin_make_room:
+ * @manager: A #GDigicamManager.
+ * @user_data: The directory of the full storage target.
+ *
+ * Tells whether the recording going on deletes its oldest segments in
+ * the directory, see g_digicam_camerabin_set_segments(), so it can go
+ * on even if the storage target is full.
+ *
+ * Returns: #TRUE if the recording makes room itself, #FALSE
+ * otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_make_room (GDigicamManager *manager,
+                                gpointer user_data)
+{
+    const gchar *directory = NULL;
+    RecordingState *state = NULL;
+    GstElement *bin = NULL;
+    GError *error = NULL;
+    gboolean result;
+
+    directory = (const gchar *) user_data;
+
+    /* Get "camerabin" Gstreamer bin  */
+    result = g_digicam_manager_get_gstreamer_bin (manager,
+                                                  &bin,
+                                                  &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
+
+    state = g_object_get_data (G_OBJECT (bin),
+                               G_DIGICAM_CAMERABIN_RECORDING_KEY);
+    result = ((NULL != state) && (NULL != state->segmenter) &&
+              (NULL != directory) &&
+              _g_digicam_camerabin_segmenter_makes_room (state->segmenter,
+                                                         directory));
+
+    /* free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
+
+    return result;
+}
+
+
+/**
+ * _g_digicam_camerabin_handle_sync_bus_message:
+ * @manager: A #GDigicamManager.
+ * @user_data: A #GstMessage.
+ *
+ * Function to handle custom gstreamer sync bus messages.
+ *
+ * Returns: #FALSE if invalid input arguments are received or the
+ * message is not processed, #TRUE otherwise.
+ **/
+static gboolean
+_g_digicam_camerabin_handle_sync_bus_message (GDigicamManager *manager,
+					      gpointer user_data)
+{
+    const GstStructure *structure = NULL;
+    const gchar *message_name = NULL;
+    const GValue *value = NULL;
+    PreviewHelper *helper = NULL;
+    PictureBufferHelper *picture_helper = NULL;
+    GstBuffer *buff = NULL;
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    GdkPixbuf *preview = NULL;
+    gboolean alpha;
+#endif
+    GstVideoFormat format;
+    gint width, height;
+    GstElement *bin = NULL;
+    GError *error = NULL;
+    gboolean result = FALSE;
+    gboolean success = FALSE;
+
+    structure = gst_message_get_structure (GST_MESSAGE (user_data));
+    g_return_val_if_fail (structure != NULL, FALSE);
+    message_name = gst_structure_get_name (structure);
+
+    /* Don't care if it is not coming from camerabin itself */
+    success = g_digicam_manager_get_gstreamer_bin (manager,
+                                                   &bin,
+                                                   &error);
+
+    /* Check errors */
+    if (!success) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_bus_message: "
+                             "%s", error->message);
+        }
+        goto free;
+    }
+
+    if (GST_ELEMENT (GST_MESSAGE_SRC (GST_MESSAGE (user_data))) == bin) {
+        if (g_strcmp0 (message_name, G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_END_MESSAGE) == 0) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
+                             "Capture end message received.");
+            TSTAMP (after-gst-next-shot);
+
+            /* Release lock and inform capture was completed */
+            _g_digicam_manager_release_capture_lock (manager);
+
+            /* Emit a signal in the main loop */
+            g_idle_add (_emit_capture_end_signal, manager);
+
+            goto free;
+        } else if (g_strcmp0 (message_name, G_DIGICAM_CAMERABIN_PHOTO_PREVIEW_MESSAGE) == 0) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
+                             "Image preview message received.");
+            TSTAMP (after-gst-snapshot);
+            value = gst_structure_get_value (structure, "buffer");
+            buff = gst_value_get_buffer (value);
+
+            if (!_get_preview_info (manager, buff, &format, &width, &height)) {
+                goto free;
+            }
+
+            /* The buffer itself is always handed out, without copies */
+            helper = g_slice_new0 (PreviewHelper);
+            helper->mgr = manager;
+            helper->buffer = gst_buffer_ref (buff);
+            helper->format = format;
+            helper->width = width;
+            helper->height = height;
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+            alpha = FALSE;
+
+            /* Preview using the RGB row data from GstBuffer */
+            preview = _pixbuf_from_buffer (manager, buff,
+                                           format, width, height,
+                                           alpha);
+            if (NULL != preview) {
+                helper->preview = preview;
+                helper->previews = _scale_previews (manager, preview);
+                _keep_thumbnail_source (manager, preview);
+            }
+#endif
+
+            /* Send the acquired preview */
+            g_idle_add (_emit_preview_signal, helper);
+
+            goto free;
+        } else if (g_strcmp0 (message_name, G_DIGICAM_CAMERABIN_PICTURE_BUFFER_MESSAGE) == 0) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
+                             "Picture buffer message received.");
+            value = gst_structure_get_value (structure, "buffer");
+
+            picture_helper = g_slice_new0 (PictureBufferHelper);
+            picture_helper->mgr = manager;
+            picture_helper->buffer = gst_buffer_ref (gst_value_get_buffer (value));
+            picture_helper->filename = g_strdup (gst_structure_get_string (structure,
+                                                                           "filename"));
+
+            /* Send the encoded picture, "img-done" is queued after
+             * it, see _picture_done_filter() */
+            g_idle_add (_emit_picture_buffer_signal, picture_helper);
+
+            goto free;
+        } else {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
+                             "Unhandled sync DBus message "
+                             "coming from camerabin.");
+        }
+    } else {
+        if (g_strcmp0 (message_name, G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_START_MESSAGE) == 0) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
+                             "Capture start message received.");
+
+            /* Set lock and inform capture was started */
+            _g_digicam_manager_set_capture_lock (manager);
+
+            /* Emit a signal in the main loop */
+            g_idle_add (_emit_capture_start_signal, manager);
+
+            goto free;
+        } else if (g_strcmp0 (message_name, G_DIGICAM_CAMERABIN_PHOTO_CAPTURE_PICTURE_GOT_MESSAGE) == 0) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
+                             "Picture got message received.");
+
+            /* Emit a signal in the main loop */
+            g_idle_add (_emit_picture_got_signal, manager);
+
+            goto free;
         } else {
             G_DIGICAM_DEBUG ("GDigicamCamerabin::_g_digicam_camerabin_handle_sync_bus_message: "
                              "Unhandled sync DBus message "
@@ -2510,362 +6641,1316 @@ _g_digicam_camerabin_handle_sync_bus_message (GDigicamManager *manager,
         }
     }
 
-    /* Free */
-free:
-    if (NULL != bin) {
-        gst_object_unref (bin);
-    }
-    if (NULL != error) {
-        g_error_free (error);
-    }
+    /* Free */
+free:
+    if (NULL != bin) {
+        gst_object_unref (bin);
+    }
+    if (NULL != error) {
+        g_error_free (error);
+    }
+
+    return result;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+
+static gboolean
+_get_preview_info (GDigicamManager *manager,
+                   GstBuffer *buff,
+                   GstVideoFormat *format,
+                   gint *width,
+                   gint *height)
+{
+    GstCaps *caps = NULL;
+    const GstStructure *structure = NULL;
+    GError *error = NULL;
+    GDigicamMode mode;
+    GDigicamAspectratio ar;
+    GDigicamResolution res;
+    gint res_w, res_h;
+    gint fps_n, fps_d;
+    gboolean result;
+
+
+    /* Get mode to set specific resolution and aspect ratio*/
+    result = g_digicam_manager_get_mode (manager,
+                                         &mode,
+                                         &error);
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
+
+    /* Get resolution */
+    result = g_digicam_manager_get_resolution (manager, &res, &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
+
+    /* Get aspect ratio  */
+    result = g_digicam_manager_get_aspect_ratio (manager, &ar, &error);
+
+    /* Check errors */
+    if (!result) {
+        if (NULL != error) {
+            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        }
+        goto free;
+    }
+
+    /* Get resolution specific values depending on the camera mode */
+    result = _get_aspect_ratio_and_resolution (mode,
+                                               ar, res,
+                                               width, height,
+                                               &res_w, &res_h,
+                                               &fps_n, &fps_d);
+    if (!result) {
+        goto free;
+    }
+
+    /* The preview can be smaller than the viewfinder when only small
+     * ones are wanted, see _get_preview_demand() */
+    caps = GST_BUFFER_CAPS (buff);
+    if (NULL != caps) {
+        structure = gst_caps_get_structure (caps, 0);
+        gst_structure_get_int (structure, "width", width);
+        gst_structure_get_int (structure, "height", height);
+    }
+
+    *format = _get_preview_format ();
+
+    /* Check the buffer holds a whole preview */
+    if (GST_BUFFER_SIZE (buff) <
+        gst_video_format_get_size (*format, *width, *height)) {
+        G_DIGICAM_WARN ("GDigicamCamerabin: preview buffer too small for "
+                        "%dx%d.", *width, *height);
+        result = FALSE;
+    }
+
+free:
+    if (NULL != error) {
+        g_error_free (error);
+    }
+
+    return result;
+}
+
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+
+/**
+ * _thumbnail_after_metadata:
+ * @filename: The file of the picture.
+ * @user_data: A #ThumbnailHelper.
+ *
+ * Writes the thumbnails of a picture once its deferred metadata is,
+ * from the metadata thread, or right away if there was none.
+ **/
+static void
+_thumbnail_after_metadata (const gchar *filename,
+                           gpointer user_data)
+{
+    ThumbnailHelper *thumbnail = NULL;
+
+    thumbnail = (ThumbnailHelper *) user_data;
+
+    _g_digicam_camerabin_thumbnail_save (thumbnail->preview, filename,
+                                         thumbnail->mode);
+
+    g_object_unref (thumbnail->preview);
+    g_slice_free (ThumbnailHelper, thumbnail);
+}
+
+
+static void
+_pixbuf_destroy (guchar *pixels, gpointer data)
+{
+  gst_buffer_unref (GST_BUFFER (data));
+}
+
+
+static GdkPixbuf *
+_pixbuf_from_buffer (GDigicamManager *manager,
+                     GstBuffer *buff,
+                     GstVideoFormat format,
+                     gint width,
+                     gint height,
+                     gboolean has_alpha)
+{
+    GdkPixbuf *pix = NULL;
+    const guchar *data = NULL;
+    gint rowstride;
+
+    /* YUV previews are converted straight into the pixbuf, in the
+     * layout the application asked for */
+    if (GST_VIDEO_FORMAT_RGB != format) {
+        pix = _g_digicam_manager_get_preview_surface (manager, has_alpha,
+                                                      width, height);
+        if (NULL == pix) {
+            return NULL;
+        }
+
+        TSTAMP (gst-before-preview-conversion);
+        _g_digicam_camerabin_colorspace_convert (format,
+                                                 GST_BUFFER_DATA (buff),
+                                                 width, height,
+                                                 gdk_pixbuf_get_pixels (pix),
+                                                 gdk_pixbuf_get_rowstride (pix),
+                                                 has_alpha);
+        TSTAMP (gst-after-preview-conversion);
+
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: thumbail generated!!!");
+        return pix;
+    }
+
+    /* Build pixbuf. Camerabin only delivers packed 24 bits RGB */
+    g_return_val_if_fail (!has_alpha, NULL);
+    rowstride = gst_video_format_get_row_stride (format, 0, width);
+
+    /* Create pixbuf, ref it to keep data around as long as we use the
+     * pixbuf */
+    buff = gst_buffer_ref (buff);
+    data = GST_BUFFER_DATA (buff);
+    pix = gdk_pixbuf_new_from_data (data,
+                                    GDK_COLORSPACE_RGB,
+                                    has_alpha, 8, width, height,
+                                    rowstride,
+                                    _pixbuf_destroy, buff);
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: thumbail generated!!!");
+
+    return pix;
+}
+
+
+static void
+_keep_thumbnail_source (GDigicamManager *manager,
+                        GdkPixbuf *preview)
+{
+    GDigicamThumbnail mode;
+
+    if (!g_digicam_manager_get_thumbnail_mode (manager, &mode, NULL) ||
+        (G_DIGICAM_THUMBNAIL_NONE == mode)) {
+        return;
+    }
+
+    /* Replaces the one of a picture that was never saved, if any */
+    g_static_mutex_lock (&thumbnail_lock);
+    g_object_set_data_full (G_OBJECT (manager),
+                            G_DIGICAM_CAMERABIN_THUMBNAIL_KEY,
+                            g_object_ref (preview),
+                            g_object_unref);
+    g_static_mutex_unlock (&thumbnail_lock);
+}
+
+
+static GPtrArray *
+_scale_previews (GDigicamManager *manager,
+                 GdkPixbuf *preview)
+{
+    GPtrArray *previews = NULL;
+    GDigicamPreviewSize *sizes = NULL;
+    GDigicamCamerabinScaleTarget stack_targets[G_DIGICAM_CAMERABIN_PREVIEW_SIZES_ON_STACK];
+    GDigicamCamerabinScaleTarget *targets = NULL;
+    GdkPixbuf *pix = NULL;
+    guint n_sizes = 0;
+    gint src_w, src_h;
+    guint i;
+
+    if (!g_digicam_manager_get_preview_sizes (manager, &sizes, &n_sizes, NULL) ||
+        (0 == n_sizes)) {
+        goto free;
+    }
+
+    TSTAMP (gst-before-preview-scaling);
+
+    src_w = gdk_pixbuf_get_width (preview);
+    src_h = gdk_pixbuf_get_height (preview);
+
+    /* The array given back by the previous preview, if any */
+    g_static_mutex_lock (&preview_set_lock);
+    previews = g_object_steal_data (G_OBJECT (manager),
+                                    G_DIGICAM_CAMERABIN_PREVIEW_SET_KEY);
+    g_static_mutex_unlock (&preview_set_lock);
+    if (NULL == previews) {
+        previews = g_ptr_array_sized_new (n_sizes);
+    }
+
+    if (G_N_ELEMENTS (stack_targets) >= n_sizes) {
+        targets = stack_targets;
+    } else {
+        targets = g_new (GDigicamCamerabinScaleTarget, n_sizes);
+    }
+
+    for (i = 0; i < n_sizes; i++) {
+        _g_digicam_camerabin_scale_fit (src_w, src_h,
+                                        sizes[i].width, sizes[i].height,
+                                        &targets[i].width,
+                                        &targets[i].height);
+        pix = _g_digicam_manager_get_preview_surface (manager,
+                                                      gdk_pixbuf_get_has_alpha (preview),
+                                                      targets[i].width,
+                                                      targets[i].height);
+        targets[i].pixels = gdk_pixbuf_get_pixels (pix);
+        targets[i].stride = gdk_pixbuf_get_rowstride (pix);
+        g_ptr_array_add (previews, pix);
+    }
+
+    /* All the sizes at once, reading the preview a single time */
+    _g_digicam_camerabin_scale_box (gdk_pixbuf_get_pixels (preview),
+                                    src_w, src_h,
+                                    gdk_pixbuf_get_rowstride (preview),
+                                    gdk_pixbuf_get_n_channels (preview),
+                                    targets, n_sizes);
+
+    TSTAMP (gst-after-preview-scaling);
+
+free:
+    if (stack_targets != targets) {
+        g_free (targets);
+    }
+    g_free (sizes);
+
+    return previews;
+}
+
+
+/**
+ * _recycle_previews:
+ * @manager: A #GDigicamManager.
+ * @previews: The array of additional previews, once emitted.
+ *
+ * Keeps the emptied @previews for the next shot of @manager, so the
+ * array isn't allocated for every one. It is freed if there is one
+ * kept already.
+ **/
+static void
+_recycle_previews (GDigicamManager *manager,
+                   GPtrArray *previews)
+{
+    g_ptr_array_foreach (previews, (GFunc) g_object_unref, NULL);
+    g_ptr_array_set_size (previews, 0);
+
+    g_static_mutex_lock (&preview_set_lock);
+    if (NULL == g_object_get_data (G_OBJECT (manager),
+                                   G_DIGICAM_CAMERABIN_PREVIEW_SET_KEY)) {
+        g_object_set_data_full (G_OBJECT (manager),
+                                G_DIGICAM_CAMERABIN_PREVIEW_SET_KEY,
+                                previews,
+                                (GDestroyNotify) _preview_set_free);
+        previews = NULL;
+    }
+    g_static_mutex_unlock (&preview_set_lock);
+
+    if (NULL != previews) {
+        _preview_set_free (previews);
+    }
+}
+
+
+static void
+_preview_set_free (GPtrArray *previews)
+{
+    g_ptr_array_free (previews, TRUE);
+}
+
+
+#endif /* G_DIGICAM_HAVE_GDKPIXBUF */
+
+
+static gboolean
+_emit_preview_signal (gpointer user_data)
+{
+    PreviewHelper *helper = NULL;
+    guint32 fourcc;
+
+    helper = (PreviewHelper *) user_data;
+
+    /* The raw preview first */
+    if (GST_VIDEO_FORMAT_RGB == helper->format) {
+        fourcc = GST_MAKE_FOURCC ('R', 'G', 'B', ' ');
+    } else {
+        fourcc = gst_video_format_to_fourcc (helper->format);
+    }
+    g_signal_emit_by_name (helper->mgr,
+                           "preview-buffer", helper->buffer,
+                           fourcc,
+                           helper->width, helper->height,
+                           gst_video_format_get_row_stride (helper->format, 0,
+                                                            helper->width),
+                           0);
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    /* Emit image-preview signal */
+    if (NULL != helper->preview) {
+        g_signal_emit_by_name (helper->mgr,
+                               "image-preview", helper->preview,
+                               0);
+        g_object_unref (helper->preview);
+    }
+
+    /* And the additional sizes, if any */
+    if (NULL != helper->previews) {
+        g_signal_emit_by_name (helper->mgr,
+                               "image-preview-set", helper->previews,
+                               0);
+        _recycle_previews (helper->mgr, helper->previews);
+    }
+#endif
+
+    /* Free */
+    gst_buffer_unref (helper->buffer);
+    g_slice_free (PreviewHelper, helper);
+
+    return FALSE;
+}
+
+static gboolean
+_emit_capture_start_signal (gpointer user_data)
+{
+    GDigicamManager *manager = NULL;
+
+    manager = G_DIGICAM_MANAGER (user_data);
+
+    /* Emit the capture-start signal */
+    g_signal_emit_by_name (manager,
+                           "capture-start",
+                           0);
+
+    return FALSE;
+}
+
+static gboolean
+_emit_capture_end_signal (gpointer user_data)
+{
+    GDigicamManager *manager = NULL;
+
+    manager = G_DIGICAM_MANAGER (user_data);
+
+    /* Emit the capture-end signal */
+    g_signal_emit_by_name (manager,
+                           "capture-end",
+                           0);
+
+    return FALSE;
+}
+
+
+static gboolean
+_emit_picture_got_signal (gpointer user_data)
+{
+    GDigicamManager *manager = NULL;
+
+    manager = G_DIGICAM_MANAGER (user_data);
+
+    /* Emit the picture-got signal */
+    g_signal_emit_by_name (manager, "picture-got", 0);
+
+    return FALSE;
+}
+
+
+static gboolean
+_emit_picture_buffer_signal (gpointer user_data)
+{
+    PictureBufferHelper *helper = NULL;
+
+    helper = (PictureBufferHelper *) user_data;
+
+    /* Emit the picture-buffer signal */
+    g_signal_emit_by_name (helper->mgr,
+                           "picture-buffer", helper->buffer,
+                           helper->filename);
+
+    /* Free */
+    gst_buffer_unref (helper->buffer);
+    g_free (helper->filename);
+    g_slice_free (PictureBufferHelper, helper);
+
+    return FALSE;
+}
+
+
+static GstCaps *
+_new_preview_caps (gint pre_w,
+                   gint pre_h)
+{
+    GstCaps *caps = NULL;
+    GstVideoFormat format;
+
+    format = _get_preview_format ();
+
+    if (GST_VIDEO_FORMAT_RGB == format) {
+        caps = gst_caps_new_simple ("video/x-raw-rgb",
+                                    "width", G_TYPE_INT, pre_w,
+                                    "height", G_TYPE_INT, pre_h,
+                                    "bpp", G_TYPE_INT, 24,
+                                    NULL);
+    } else {
+        caps = gst_caps_new_simple ("video/x-raw-yuv",
+                                    "width", G_TYPE_INT, pre_w,
+                                    "height", G_TYPE_INT, pre_h,
+                                    "format", GST_TYPE_FOURCC,
+                                    gst_video_format_to_fourcc (format),
+                                    NULL);
+    }
+
+    return caps;
+}
+
+
+/* Size of the smallest preview serving everybody interested in the
+ * previews, or FALSE if nobody is. */
+static gboolean
+_get_preview_demand (GDigicamManager *manager,
+                     gboolean enabled,
+                     gint vf_w, gint vf_h,
+                     gint *pre_w, gint *pre_h)
+{
+    GDigicamManagerClass *klass = NULL;
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    GDigicamPreviewSize *sizes = NULL;
+    GDigicamThumbnail thumbnail_mode;
+    guint n_sizes = 0;
+    guint box;
+    gint w, h;
+    guint i;
+#endif
+
+    *pre_w = 0;
+    *pre_h = 0;
+
+    if (!enabled) {
+        return FALSE;
+    }
+
+    /* Whole preview listeners get it at the viewfinder size */
+    klass = G_DIGICAM_MANAGER_GET_CLASS (manager);
+    if ((NULL != klass->preview_buffer) ||
+        g_signal_has_handler_pending (manager,
+                                      g_signal_lookup ("preview-buffer",
+                                                       G_DIGICAM_TYPE_MANAGER),
+                                      0, FALSE)) {
+        *pre_w = vf_w;
+        *pre_h = vf_h;
+        return TRUE;
+    }
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    if ((NULL != klass->image_preview) ||
+        g_signal_has_handler_pending (manager,
+                                      g_signal_lookup ("image-preview",
+                                                       G_DIGICAM_TYPE_MANAGER),
+                                      0, FALSE)) {
+        *pre_w = vf_w;
+        *pre_h = vf_h;
+        return TRUE;
+    }
+
+    /* Otherwise the biggest of the additional sizes ... */
+    if (((NULL != klass->image_preview_set) ||
+         g_signal_has_handler_pending (manager,
+                                       g_signal_lookup ("image-preview-set",
+                                                        G_DIGICAM_TYPE_MANAGER),
+                                       0, FALSE)) &&
+        g_digicam_manager_get_preview_sizes (manager, &sizes, &n_sizes, NULL)) {
+        for (i = 0; i < n_sizes; i++) {
+            _g_digicam_camerabin_scale_fit (vf_w, vf_h,
+                                            sizes[i].width, sizes[i].height,
+                                            &w, &h);
+            *pre_w = MAX (*pre_w, w);
+            *pre_h = MAX (*pre_h, h);
+        }
+        g_free (sizes);
+    }
+
+    /* ... and the thumbnails */
+    if (g_digicam_manager_get_thumbnail_mode (manager, &thumbnail_mode, NULL) &&
+        (G_DIGICAM_THUMBNAIL_NONE != thumbnail_mode)) {
+        box = (thumbnail_mode & G_DIGICAM_THUMBNAIL_LARGE) ?
+            G_DIGICAM_CAMERABIN_THUMBNAIL_LARGE_SIZE :
+            G_DIGICAM_CAMERABIN_THUMBNAIL_NORMAL_SIZE;
+        _g_digicam_camerabin_scale_fit (vf_w, vf_h, box, box, &w, &h);
+        *pre_w = MAX (*pre_w, w);
+        *pre_h = MAX (*pre_h, h);
+    }
+#endif
+
+    if ((0 == *pre_w) || (0 == *pre_h)) {
+        return FALSE;
+    }
+
+    /* Chroma subsampled formats need even sizes */
+    *pre_w = MIN (GST_ROUND_UP_2 (*pre_w), vf_w);
+    *pre_h = MIN (GST_ROUND_UP_2 (*pre_h), vf_h);
+
+    return TRUE;
+}
+
+
+static void
+_set_preview_caps (GDigicamManager *manager,
+                   GstElement *gst_camera_bin,
+                   gboolean enabled,
+                   gint vf_w, gint vf_h,
+                   gboolean force)
+{
+    GstCaps *caps = NULL;
+    const gchar *last_res = NULL;
+    gchar *res = NULL;
+    gint pre_w, pre_h;
+
+    /* Camerabin only converts and scales previews with caps set */
+    if (_get_preview_demand (manager, enabled, vf_w, vf_h, &pre_w, &pre_h)) {
+        res = g_strdup_printf ("%dx%d", pre_w, pre_h);
+    } else {
+        res = g_strdup ("none");
+    }
+
+    last_res = g_object_get_data (G_OBJECT (gst_camera_bin),
+                                  G_DIGICAM_CAMERABIN_PREVIEW_RES_KEY);
+    if (!force && (0 == g_strcmp0 (res, last_res))) {
+        g_free (res);
+        return;
+    }
+
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting preview to %s\n", res);
+
+    if (0 != pre_w) {
+        caps = _new_preview_caps (pre_w, pre_h);
+    }
+    g_object_set (G_OBJECT (gst_camera_bin),
+                  "preview-caps", caps,
+                  NULL);
+    if (NULL != caps) {
+        gst_caps_unref (caps);
+    }
+
+    g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                            G_DIGICAM_CAMERABIN_PREVIEW_RES_KEY,
+                            res, g_free);
+}
+
+
+static void
+_refresh_preview_caps (GDigicamManager *manager,
+                       GstElement *gst_camera_bin)
+{
+    GDigicamMode mode;
+    GDigicamAspectratio ar;
+    GDigicamResolution res;
+    gint vf_w, vf_h;
+    gint res_w, res_h;
+    gint fps_n, fps_d;
+    gboolean enabled;
+
+    if (!g_digicam_manager_preview_enabled (manager, &enabled, NULL) ||
+        !g_digicam_manager_get_mode (manager, &mode, NULL) ||
+        !g_digicam_manager_get_resolution (manager, &res, NULL) ||
+        !g_digicam_manager_get_aspect_ratio (manager, &ar, NULL) ||
+        !_get_aspect_ratio_and_resolution (mode,
+                                           ar, res,
+                                           &vf_w, &vf_h,
+                                           &res_w, &res_h,
+                                           &fps_n, &fps_d)) {
+        return;
+    }
+
+    _set_preview_caps (manager, gst_camera_bin, enabled, vf_w, vf_h, FALSE);
+}
+
+
+static gpointer
+_preview_format_load (gpointer data)
+{
+    GstVideoFormat format = GST_VIDEO_FORMAT_UYVY;
+#ifdef USE_CONFIG_FILE
+    GKeyFile *key_file = NULL;
+    gchar *value = NULL;
+
+    key_file = g_key_file_new ();
+    if (!g_key_file_load_from_file (key_file,
+                                    G_KEY_FILE_PATH,
+                                    G_KEY_FILE_NONE,
+                                    NULL) ||
+        !g_key_file_get_boolean (key_file,
+                                 "global",
+                                 "useconfigfile",
+                                 NULL)) {
+        goto cleanup;
+    }
+
+    value = g_key_file_get_string (key_file, "preview", "format", NULL);
+    if (NULL == value) {
+        goto cleanup;
+    }
+
+    if (!g_ascii_strcasecmp (value, "rgb")) {
+        format = GST_VIDEO_FORMAT_RGB;
+    } else if (!g_ascii_strcasecmp (value, "i420")) {
+        format = GST_VIDEO_FORMAT_I420;
+    } else if (!g_ascii_strcasecmp (value, "nv12")) {
+        format = GST_VIDEO_FORMAT_NV12;
+    } else if (!g_ascii_strcasecmp (value, "uyvy")) {
+        format = GST_VIDEO_FORMAT_UYVY;
+    } else {
+        G_DIGICAM_WARN ("GDigicamCamerabin: invalid preview format "
+                        "\"%s\" in config file.", value);
+    }
+
+cleanup:
+    g_free (value);
+    g_key_file_free (key_file);
+#endif
+
+    return GINT_TO_POINTER (format);
+}
+
+
+static GstVideoFormat
+_get_preview_format (void)
+{
+    return GPOINTER_TO_INT (g_once (&preview_format_once,
+                                    _preview_format_load,
+                                    NULL));
+}
+
+
+static gboolean
+_parse_resolution (const gchar *value,
+                   gint *width, gint *height,
+                   gint *fps_n, gint *fps_d)
+{
+    gint w = 0, h = 0, n = 0, d = 0;
+    gint fields;
+
+    /* "WIDTHxHEIGHT" optionally followed by "@FPS_N/FPS_D" */
+    fields = sscanf (value, "%dx%d@%d/%d", &w, &h, &n, &d);
+    if ((2 > fields) || (0 >= w) || (0 >= h)) {
+        return FALSE;
+    }
+
+    *width = w;
+    *height = h;
+    if ((4 == fields) && (0 < n) && (0 < d)) {
+        *fps_n = n;
+        *fps_d = d;
+    }
+
+    return TRUE;
+}
+
+
+static gpointer
+_resolution_table_load (gpointer data)
+{
+#ifdef USE_CONFIG_FILE
+    ResolutionEntry *entry = NULL;
+    GKeyFile *key_file = NULL;
+    const gchar *res_name = NULL;
+    gchar *group = NULL;
+    gchar *value = NULL;
+    guint i;
+
+    key_file = g_key_file_new ();
+    if (!g_key_file_load_from_file (key_file,
+                                    G_KEY_FILE_PATH,
+                                    G_KEY_FILE_NONE,
+                                    NULL) ||
+        !g_key_file_get_boolean (key_file,
+                                 "global",
+                                 "useconfigfile",
+                                 NULL)) {
+        goto cleanup;
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (resolution_table); i++) {
+        entry = &resolution_table[i];
+
+        switch (entry->resolution) {
+        case G_DIGICAM_RESOLUTION_HD:
+            res_name = "hd";
+            break;
+        case G_DIGICAM_RESOLUTION_DVD:
+            res_name = "dvd";
+            break;
+        case G_DIGICAM_RESOLUTION_HIGH:
+            res_name = "high";
+            break;
+        case G_DIGICAM_RESOLUTION_MEDIUM:
+            res_name = "medium";
+            break;
+        default:
+            res_name = "low";
+            break;
+        }
+
+        group = g_strdup_printf ("%s-%s",
+                                 (G_DIGICAM_MODE_STILL == entry->mode) ?
+                                 "still" : "video",
+                                 (G_DIGICAM_ASPECTRATIO_4X3 == entry->aspect_ratio) ?
+                                 "4x3" : "16x9");
+
+        value = g_key_file_get_string (key_file, group, res_name, NULL);
+        if (NULL != value) {
+            if (!_parse_resolution (value,
+                                    &entry->res_w, &entry->res_h,
+                                    &entry->fps_n, &entry->fps_d)) {
+                G_DIGICAM_WARN ("GDigicamCamerabin: invalid resolution "
+                                "\"%s\" for %s/%s in config file.",
+                                value, group, res_name);
+            } else if (G_DIGICAM_MODE_VIDEO == entry->mode) {
+                entry->vf_w = entry->res_w;
+                entry->vf_h = entry->res_h;
+            }
+            g_free (value);
+        }
+
+        /* Still picture modes share the viewfinder settings */
+        if (G_DIGICAM_MODE_STILL == entry->mode) {
+            value = g_key_file_get_string (key_file, group, "viewfinder", NULL);
+            if ((NULL != value) &&
+                !_parse_resolution (value,
+                                    &entry->vf_w, &entry->vf_h,
+                                    &entry->fps_n, &entry->fps_d)) {
+                G_DIGICAM_WARN ("GDigicamCamerabin: invalid viewfinder "
+                                "resolution \"%s\" for %s in config file.",
+                                value, group);
+            }
+            g_free (value);
+        }
+
+        g_free (group);
+    }
+
+cleanup:
+    g_key_file_free (key_file);
+#endif
+
+    return NULL;
+}
+
+
+static gboolean
+_get_aspect_ratio_and_resolution (GDigicamMode mode,
+                                  GDigicamAspectratio ar,
+                                  GDigicamResolution res,
+                                  gint *vf_w, gint *vf_h,
+                                  gint *res_w, gint *res_h,
+                                  gint *fps_n, gint *fps_d)
+{
+    const ResolutionEntry *entry = NULL;
+    guint i;
+
+    g_once (&resolution_table_once, _resolution_table_load, NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (resolution_table); i++) {
+        entry = &resolution_table[i];
+        if ((mode == entry->mode) &&
+            (ar == entry->aspect_ratio) &&
+            (res == entry->resolution)) {
+            *vf_w = entry->vf_w;
+            *vf_h = entry->vf_h;
+            *res_w = entry->res_w;
+            *res_h = entry->res_h;
+            *fps_n = entry->fps_n;
+            *fps_d = entry->fps_d;
+            return TRUE;
+        }
+    }
+
+    G_DIGICAM_WARN ("GDigicamCamerabin: no resolution defined for mode %d, "
+                    "aspect ratio %d and resolution %d.", mode, ar, res);
 
-    return result;
+    return FALSE;
 }
 
 
-/*********************************/
-/* Private utility functions     */
-/*********************************/
+static gboolean
+_get_structure_dimension (const GstStructure *structure,
+                          const gchar *field,
+                          gint requested,
+                          gint *value)
+{
+    const GValue *gvalue = NULL;
 
+    gvalue = gst_structure_get_value (structure, field);
+    if (NULL == gvalue) {
+        return FALSE;
+    }
 
-static void
-_pixbuf_destroy (guchar *pixels, gpointer data)
-{
-  gst_buffer_unref (GST_BUFFER (data));
+    if (G_VALUE_HOLDS_INT (gvalue)) {
+        *value = g_value_get_int (gvalue);
+    } else if (GST_VALUE_HOLDS_INT_RANGE (gvalue)) {
+        /* The source scales for free inside the range */
+        *value = CLAMP (requested,
+                        gst_value_get_int_range_min (gvalue),
+                        gst_value_get_int_range_max (gvalue));
+    } else {
+        return FALSE;
+    }
+
+    return TRUE;
 }
 
 
-static GdkPixbuf *
-_pixbuf_from_buffer (GDigicamManager *manager,
-                     GstBuffer *buff,
-                     gboolean has_alpha)
+static GArray *
+_get_sensor_modes (GstElement *gst_camera_bin,
+                   gint width, gint height)
 {
-    GdkPixbuf *pix = NULL;
-    GstVideoFormat fmt = GST_VIDEO_FORMAT_RGB;
-    const guchar *data = NULL;
-    GError *error = NULL;
-    GDigicamMode mode;
-    GDigicamAspectratio ar;
-    GDigicamResolution res;
-    gint vf_w, vf_h;
-    gint res_w, res_h;
-    gint fps_n, fps_d;
-    gint minsize, buff_size, bytes_per_pixel;
-    gint rowstride;
-    gboolean result;
+    GArray *modes = NULL;
+    GstCaps *caps = NULL;
+    const GstStructure *structure = NULL;
+    const GValue *framerate = NULL;
+    SensorMode sensor_mode;
+    guint i;
 
+    modes = g_array_new (FALSE, TRUE, sizeof (SensorMode));
 
-    /* Get mode to set specific resolution and aspect ratio*/
-    result = g_digicam_manager_get_mode (manager,
-                                         &mode,
-                                         &error);
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
-        goto free;
+    if (NULL == g_object_class_find_property (G_OBJECT_GET_CLASS (gst_camera_bin),
+                                              "inputcaps")) {
+        return modes;
     }
 
-    /* Get resolution */
-    result = g_digicam_manager_get_resolution (manager, &res, &error);
-
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
-        }
+    g_object_get (G_OBJECT (gst_camera_bin), "inputcaps", &caps, NULL);
+    if ((NULL == caps) || gst_caps_is_any (caps)) {
         goto free;
     }
 
-    /* Get aspect ratio  */
-    result = g_digicam_manager_get_aspect_ratio (manager, &ar, &error);
+    for (i = 0; i < gst_caps_get_size (caps); i++) {
+        structure = gst_caps_get_structure (caps, i);
 
-    /* Check errors */
-    if (!result) {
-        if (NULL != error) {
-            G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+        if (!_get_structure_dimension (structure, "width",
+                                       width, &sensor_mode.width) ||
+            !_get_structure_dimension (structure, "height",
+                                       height, &sensor_mode.height)) {
+            continue;
         }
-        goto free;
+
+        /* Unknown framerates don't limit the requested one */
+        sensor_mode.fps_n = 0;
+        sensor_mode.fps_d = 1;
+        framerate = gst_structure_get_value (structure, "framerate");
+        if (NULL != framerate) {
+            if (GST_VALUE_HOLDS_FRACTION_RANGE (framerate)) {
+                framerate = gst_value_get_fraction_range_max (framerate);
+            }
+            if (GST_VALUE_HOLDS_FRACTION (framerate)) {
+                sensor_mode.fps_n = gst_value_get_fraction_numerator (framerate);
+                sensor_mode.fps_d = gst_value_get_fraction_denominator (framerate);
+            }
+        }
+
+        g_array_append_val (modes, sensor_mode);
     }
 
-    /* Get resolution specific values depending on the camera mode */
-    _get_aspect_ratio_and_resolution (mode,
-                                      ar, res,
-                                      &vf_w, &vf_h,
-                                      &res_w, &res_h,
-                                      &fps_n, &fps_d);
-
-    /* Build pixbuf */
-    rowstride = gst_video_format_get_row_stride (fmt, 0, vf_w);
-    if (has_alpha) {
-        bytes_per_pixel = 4;
-    } else {
-        bytes_per_pixel = 3;
+free:
+    if (NULL != caps) {
+        gst_caps_unref (caps);
     }
 
-    /* Last row needn't have row padding */
-    minsize = (rowstride * (vf_h - 1)) + (bytes_per_pixel * vf_w);
-    buff_size = GST_BUFFER_SIZE (buff);
-    g_return_val_if_fail (buff_size >= minsize, NULL);
+    return modes;
+}
+
 
-    /* Create pixbuf, ref it to keep data around as long as we use the
-     * pixbuf */
-    buff = gst_buffer_ref (buff);
-    data = GST_BUFFER_DATA (buff);
-    pix = gdk_pixbuf_new_from_data (data,
-                                    GDK_COLORSPACE_RGB,
-                                    has_alpha, 8, vf_w, vf_h,
-                                    rowstride,
-                                    _pixbuf_destroy, buff);
+/* Cost of producing @width x @height frames out of @sensor_mode: the
+ * fraction of the sensor readout thrown away by cropping it to the
+ * requested aspect ratio, plus the downscaling factor still needed
+ * afterwards. Upscaling is always more expensive than any crop or
+ * downscale. */
+static gdouble
+_sensor_mode_cost (const SensorMode *sensor_mode,
+                   gint width, gint height)
+{
+    gdouble sensor_area, used_area;
+    gdouble used_w, used_h;
+    gdouble crop, scale;
 
-    G_DIGICAM_DEBUG ("GDigicamCamerabin: thumbail generated!!!");
+    sensor_area = (gdouble) sensor_mode->width * sensor_mode->height;
 
-free:
-    return pix;
+    if (((gint64) sensor_mode->width * height) >
+        ((gint64) sensor_mode->height * width)) {
+        /* Wider than requested: the sides get cropped */
+        used_h = sensor_mode->height;
+        used_w = used_h * width / height;
+    } else {
+        used_w = sensor_mode->width;
+        used_h = used_w * height / width;
+    }
+    used_area = used_w * used_h;
+
+    crop = 1.0 - (used_area / sensor_area);
+    scale = used_area / ((gdouble) width * height);
+
+    if ((sensor_mode->width < width) || (sensor_mode->height < height)) {
+        return 1000.0 + (1.0 / scale) + crop;
+    }
+
+    return (scale - 1.0) + crop;
 }
 
 
 static gboolean
-_emit_preview_signal (gpointer user_data)
+_select_sensor_mode (GstElement *gst_camera_bin,
+                     gint width, gint height,
+                     SensorMode *sensor_mode)
 {
-    PreviewHelper *helper = NULL;
-
-    helper = (PreviewHelper *) user_data;
+    GArray *modes = NULL;
+    const SensorMode *candidate = NULL;
+    gdouble cost, best_cost = 0;
+    gboolean found = FALSE;
+    guint i;
+
+    modes = _get_sensor_modes (gst_camera_bin, width, height);
+
+    for (i = 0; i < modes->len; i++) {
+        candidate = &g_array_index (modes, SensorMode, i);
+        cost = _sensor_mode_cost (candidate, width, height);
+        if (!found || (cost < best_cost)) {
+            *sensor_mode = *candidate;
+            best_cost = cost;
+            found = TRUE;
+        }
+    }
 
-    /* Emit image-preview signal */
-    g_signal_emit_by_name (helper->mgr,
-                           "image-preview", helper->preview,
-                           0);
+    if (found) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: sensor mode %dx%d selected "
+                         "for %dx%d (cost %.3f)",
+                         sensor_mode->width, sensor_mode->height,
+                         width, height, best_cost);
+    }
 
-    /* Free */
-    g_object_unref (helper->preview);
-    g_slice_free (PreviewHelper, helper);
+    g_array_free (modes, TRUE);
 
-    return FALSE;
+    return found;
 }
 
-static gboolean
-_emit_capture_start_signal (gpointer user_data)
+static void
+_fit_viewfinder_to_window (gint vf_w, gint vf_h,
+                           guint window_w, guint window_h,
+                           gint *width, gint *height)
 {
-    GDigicamManager *manager = NULL;
+    gdouble scale;
 
-    manager = G_DIGICAM_MANAGER (user_data);
+    *width = vf_w;
+    *height = vf_h;
 
-    /* Emit the capture-start signal */
-    g_signal_emit_by_name (manager,
-                           "capture-start",
-                           0);
+    /* Unknown window, or bigger than the viewfinder: the sink will
+     * upscale it anyway, so there is nothing to save. */
+    if ((0 == window_w) || (0 == window_h) ||
+        ((window_w >= (guint) vf_w) && (window_h >= (guint) vf_h))) {
+        return;
+    }
 
-    return FALSE;
+    /* Keep the viewfinder aspect ratio, fitting it inside the
+     * window. Most sources and sinks want the width aligned to 8 and
+     * the height to 2. */
+    scale = MIN ((gdouble) window_w / vf_w, (gdouble) window_h / vf_h);
+    *width = MAX (8, ((gint) (vf_w * scale + 4)) & ~7);
+    *height = MAX (2, ((gint) (vf_h * scale + 1)) & ~1);
 }
 
-static gboolean
-_emit_capture_end_signal (gpointer user_data)
+
+static void
+_set_viewfinder_res_fps (GstElement *gst_camera_bin,
+                         GDigicamMode mode,
+                         gint vf_w, gint vf_h,
+                         gint fps_n, gint fps_d,
+                         guint window_w, guint window_h,
+                         gboolean force)
 {
-    GDigicamManager *manager = NULL;
+    SensorMode sensor_mode;
+    gint src_w, src_h;
+    gchar *res = NULL;
+    const gchar *last_res = NULL;
+    gboolean zsl = FALSE;
+
+    /* The recording resolution is fixed, but the still picture
+     * viewfinder can run at the window size and at whatever sensor
+     * mode is cheaper to produce, since the sink scales it anyway. */
+    src_w = vf_w;
+    src_h = vf_h;
+#ifdef HAVE_JPEG
+    /* Unless its frames are kept to be the pictures themselves */
+    zsl = (G_DIGICAM_MODE_STILL == mode) &&
+        _zsl_get_resolution (gst_camera_bin, &src_w, &src_h);
+#endif
+    if ((G_DIGICAM_MODE_STILL == mode) && !zsl) {
+        _fit_viewfinder_to_window (vf_w, vf_h,
+                                   window_w, window_h,
+                                   &src_w, &src_h);
+        if (_select_sensor_mode (gst_camera_bin,
+                                 src_w, src_h,
+                                 &sensor_mode)) {
+            src_w = sensor_mode.width;
+            src_h = sensor_mode.height;
+            if ((0 < sensor_mode.fps_n) &&
+                ((gint64) fps_n * sensor_mode.fps_d >
+                 (gint64) sensor_mode.fps_n * fps_d)) {
+                fps_n = sensor_mode.fps_n;
+                fps_d = sensor_mode.fps_d;
+            }
+        }
+    }
 
-    manager = G_DIGICAM_MANAGER (user_data);
+    /* Renegotiating restarts the source, so avoid it when the window
+     * change did not change the outcome. */
+    res = g_strdup_printf ("%d:%dx%d@%d/%d",
+                           mode, src_w, src_h, fps_n, fps_d);
+    last_res = g_object_get_data (G_OBJECT (gst_camera_bin),
+                                  G_DIGICAM_CAMERABIN_VF_RES_KEY);
+    if (!force && (0 == g_strcmp0 (res, last_res))) {
+        g_free (res);
+        return;
+    }
 
-    /* Emit the capture-end signal */
-    g_signal_emit_by_name (manager,
-                           "capture-end",
+    G_DIGICAM_DEBUG ("GDigicamCamerabin: Setting new recording/viewfinder "
+                     "resolution and fps: %dx%d at %d/%d fps \n",
+                     src_w, src_h, fps_n, fps_d);
+
+    g_signal_emit_by_name (gst_camera_bin,
+                           "user-res-fps",
+                           src_w, src_h,
+                           fps_n, fps_d,
                            0);
 
-    return FALSE;
+    g_object_set_data_full (G_OBJECT (gst_camera_bin),
+                            G_DIGICAM_CAMERABIN_VF_RES_KEY,
+                            res, g_free);
 }
 
 
-static gboolean
-_emit_picture_got_signal (gpointer user_data)
+static gchar *
+_element_pool_key (const gchar *videosrc,
+                   const gchar *videoenc,
+                   const gchar *videomux,
+                   const gchar *audiosrc,
+                   const gchar *audioenc,
+                   const gchar *imageenc,
+                   const gchar *imagepp,
+                   const gchar *ximagesink)
 {
-    GDigicamManager *manager = NULL;
+    return g_strdup_printf ("%s|%s|%s|%s|%s|%s|%s|%s",
+                            (NULL != videosrc) ? videosrc : "",
+                            (NULL != videoenc) ? videoenc : "",
+                            (NULL != videomux) ? videomux : "",
+                            (NULL != audiosrc) ? audiosrc : "",
+                            (NULL != audioenc) ? audioenc : "",
+                            (NULL != imageenc) ? imageenc : "",
+                            (NULL != imagepp) ? imagepp : "",
+                            (NULL != ximagesink) ? ximagesink : "");
+}
 
-    manager = G_DIGICAM_MANAGER (user_data);
 
-    /* Emit the picture-got signal */
-    g_signal_emit_by_name (manager, "picture-got", 0);
+/* Number of elements for @key either pooled or being built just to
+ * be pooled. Must be called with the pool lock held. */
+static guint
+_element_pool_count (const gchar *key)
+{
+    GList *iter = NULL;
+    ElementBuild *build = NULL;
+    guint count = 0;
+
+    for (iter = element_pool; NULL != iter; iter = g_list_next (iter)) {
+        if (0 == g_strcmp0 (key,
+                            g_object_get_data (G_OBJECT (iter->data),
+                                               G_DIGICAM_CAMERABIN_POOL_KEY))) {
+            count++;
+        }
+    }
 
-    return FALSE;
+    for (iter = element_builds; NULL != iter; iter = g_list_next (iter)) {
+        build = (ElementBuild *) iter->data;
+        if ((!build->requested) && (0 == g_strcmp0 (key, build->key))) {
+            count++;
+        }
+    }
+
+    return count;
 }
 
 
-static GstCaps *
-_new_preview_caps (gint pre_w,
-                   gint pre_h)
+static ElementBuild *
+_element_build_new (const gchar *key,
+                    const gchar *videosrc,
+                    const gchar *videoenc,
+                    const gchar *videomux,
+                    const gchar *audiosrc,
+                    const gchar *audioenc,
+                    const gchar *imageenc,
+                    const gchar *imagepp,
+                    const gchar *ximagesink)
 {
-    GstCaps *caps = NULL;
+    ElementBuild *build = NULL;
+
+    build = g_slice_new0 (ElementBuild);
+    build->key = g_strdup (key);
+    build->videosrc = g_strdup (videosrc);
+    build->videoenc = g_strdup (videoenc);
+    build->videomux = g_strdup (videomux);
+    build->audiosrc = g_strdup (audiosrc);
+    build->audioenc = g_strdup (audioenc);
+    build->imageenc = g_strdup (imageenc);
+    build->imagepp = g_strdup (imagepp);
+    build->ximagesink = g_strdup (ximagesink);
+
+    return build;
+}
 
-    caps = gst_caps_new_simple ("video/x-raw-rgb",
-                                "width", G_TYPE_INT, pre_w,
-                                "height", G_TYPE_INT, pre_h,
-                                "bpp", G_TYPE_INT, 24,
-                                NULL);
 
-    return caps;
+static void
+_element_build_free (ElementBuild *build)
+{
+    if (NULL != build->element) {
+        gst_object_unref (GST_OBJECT (build->element));
+    }
+    if (NULL != build->manager) {
+        g_object_unref (build->manager);
+    }
+
+    g_free (build->key);
+    g_free (build->videosrc);
+    g_free (build->videoenc);
+    g_free (build->videomux);
+    g_free (build->audiosrc);
+    g_free (build->audioenc);
+    g_free (build->imageenc);
+    g_free (build->imagepp);
+    g_free (build->ximagesink);
+
+    g_slice_free (ElementBuild, build);
 }
 
 
-static void
-_get_aspect_ratio_and_resolution (GDigicamMode mode,
-                                  GDigicamAspectratio ar,
-                                  GDigicamResolution res,
-                                  gint *vf_w, gint *vf_h,
-                                  gint *res_w, gint *res_h,
-                                  gint *fps_n, gint *fps_d)
+/* Must be called with the pool lock held. */
+static gboolean
+_element_build_start (ElementBuild *build)
 {
-    switch (mode) {
-    case G_DIGICAM_MODE_STILL:
-        _get_still_aspect_ratio_and_resolution (ar, res,
-                                                vf_w, vf_h,
-                                                res_w, res_h,
-                                                fps_n, fps_d);
-        break;
-    case G_DIGICAM_MODE_VIDEO:
-        _get_video_aspect_ratio_and_resolution (ar, res,
-                                                vf_w, vf_h,
-                                                res_w, res_h,
-                                                fps_n, fps_d);
-        break;
-    default:
-        g_assert_not_reached ();
+    GError *error = NULL;
+
+    element_builds = g_list_prepend (element_builds, build);
+
+    if (NULL == g_thread_create (_element_build_thread, build, FALSE, &error)) {
+        G_DIGICAM_ERR ("GDigicamCamerabin: impossible to create the "
+                       "camerabin builder thread: %s", error->message);
+        element_builds = g_list_remove (element_builds, build);
+        _element_build_free (build);
+        g_error_free (error);
+        return FALSE;
     }
+
+    return TRUE;
 }
 
 
-static void
-_get_still_aspect_ratio_and_resolution (GDigicamAspectratio ar,
-                                        GDigicamResolution res,
-                                        gint *vf_w, gint *vf_h,
-                                        gint *res_w, gint *res_h,
-                                        gint *fps_n, gint *fps_d)
-{
-    switch (ar) {
-    case G_DIGICAM_ASPECTRATIO_4X3:
-        switch (res) {
-        case G_DIGICAM_RESOLUTION_HIGH:
-            *res_w = G_DIGICAM_CAMERABIN_STILL_4X3_HIGH_WIDTH;
-            *res_h = G_DIGICAM_CAMERABIN_STILL_4X3_HIGH_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_MEDIUM:
-            *res_w = G_DIGICAM_CAMERABIN_STILL_4X3_MEDIUM_WIDTH;
-            *res_h = G_DIGICAM_CAMERABIN_STILL_4X3_MEDIUM_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_LOW:
-            *res_w = G_DIGICAM_CAMERABIN_STILL_4X3_LOW_WIDTH;
-            *res_h = G_DIGICAM_CAMERABIN_STILL_4X3_LOW_HEIGHT;
-            break;
-        default:
-            g_assert_not_reached ();
+static gpointer
+_element_build_thread (gpointer data)
+{
+    ElementBuild *build = NULL;
+    GstElement *element = NULL;
+    gint colorkey = 0;
+
+    build = (ElementBuild *) data;
+
+    TSTAMP (gst-before-camerabin-prebuilt);
+
+    element = g_digicam_camerabin_element_new (build->videosrc,
+                                               build->videoenc,
+                                               build->videomux,
+                                               build->audiosrc,
+                                               build->audioenc,
+                                               build->imageenc,
+                                               build->imagepp,
+                                               build->ximagesink,
+                                               &colorkey);
+
+    TSTAMP (gst-after-camerabin-prebuilt);
+
+    if (NULL != element) {
+        gst_object_ref (GST_OBJECT (element));
+        gst_object_sink (GST_OBJECT (element));
+        g_object_set_data_full (G_OBJECT (element),
+                                G_DIGICAM_CAMERABIN_POOL_KEY,
+                                g_strdup (build->key),
+                                g_free);
+        g_object_set_data (G_OBJECT (element),
+                           G_DIGICAM_CAMERABIN_COLORKEY_KEY,
+                           GINT_TO_POINTER (colorkey));
+    }
+
+    g_static_mutex_lock (&element_pool_lock);
+
+    element_builds = g_list_remove (element_builds, build);
+    build->element = element;
+    build->colorkey = colorkey;
+
+    if (build->requested) {
+        g_idle_add (_element_ready, build);
+    } else {
+        if (NULL != element) {
+            element_pool = g_list_append (element_pool, element);
+            build->element = NULL;
         }
-        *vf_w = G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_WIDTH;
-        *vf_h = G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_HEIGHT;
-        *fps_n = G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_FPS;
-        *fps_d = 100;
-        break;
-    case G_DIGICAM_ASPECTRATIO_16X9:
-        switch (res) {
-        case G_DIGICAM_RESOLUTION_HIGH:
-            *res_w = G_DIGICAM_CAMERABIN_STILL_16X9_HIGH_WIDTH;
-            *res_h = G_DIGICAM_CAMERABIN_STILL_16X9_HIGH_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_MEDIUM:
-            *res_w = G_DIGICAM_CAMERABIN_STILL_16X9_MEDIUM_WIDTH;
-            *res_h = G_DIGICAM_CAMERABIN_STILL_16X9_MEDIUM_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_LOW:
-            *res_w = G_DIGICAM_CAMERABIN_STILL_16X9_LOW_WIDTH;
-            *res_h = G_DIGICAM_CAMERABIN_STILL_16X9_LOW_HEIGHT;
-            break;
-        default:
-            g_assert_not_reached ();
-            }
-        *vf_w = G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_WIDTH;
-        *vf_h = G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_HEIGHT;
-        *fps_n = G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_FPS;
-        *fps_d = 100;
-        break;
-    default:
-        g_assert_not_reached ();
+        _element_build_free (build);
     }
+
+    g_static_mutex_unlock (&element_pool_lock);
+
+    return NULL;
 }
 
 
-static void
-_get_video_aspect_ratio_and_resolution (GDigicamAspectratio ar,
-                                        GDigicamResolution res,
-                                        gint *vf_w, gint *vf_h,
-                                        gint *res_w, gint *res_h,
-                                        gint *fps_n, gint *fps_d)
-{
-    switch (ar) {
-    case G_DIGICAM_ASPECTRATIO_4X3:
-        switch (res) {
-        case G_DIGICAM_RESOLUTION_HD:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_4X3_HD_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_4X3_HD_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_DVD:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_4X3_DVD_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_4X3_DVD_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_HIGH:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_4X3_HIGH_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_4X3_HIGH_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_MEDIUM:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_4X3_MEDIUM_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_4X3_MEDIUM_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_LOW:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_4X3_LOW_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_4X3_LOW_HEIGHT;
-            break;
-        default:
-            g_assert_not_reached ();
-        }
-        if(res == G_DIGICAM_RESOLUTION_HD)
-            *fps_n = G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_HD_VIDEO_FPS
-        else if(res == G_DIGICAM_RESOLUTION_DVD)
-            *fps_n = G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_DVD_VIDEO_FPS
-        else
-            *fps_n = G_DIGICAM_CAMERABIN_VIEWFINDER_4X3_FPS
-        *fps_d = 100;
-        break;
-    case G_DIGICAM_ASPECTRATIO_16X9:
-        switch (res) {
-        case G_DIGICAM_RESOLUTION_HD:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_16X9_HD_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_16X9_HD_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_DVD:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_16X9_DVD_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_16X9_DVD_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_HIGH:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_16X9_HIGH_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_16X9_HIGH_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_MEDIUM:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_16X9_MEDIUM_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_16X9_MEDIUM_HEIGHT;
-            break;
-        case G_DIGICAM_RESOLUTION_LOW:
-            *vf_w = G_DIGICAM_CAMERABIN_VIDEO_16X9_LOW_WIDTH;
-            *vf_h = G_DIGICAM_CAMERABIN_VIDEO_16X9_LOW_HEIGHT;
-            break;
-        default:
-            g_assert_not_reached ();
-        }
-        if(res == G_DIGICAM_RESOLUTION_HD)
-            *fps_n = G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_HD_VIDEO_FPS
-        else if(res == G_DIGICAM_RESOLUTION_DVD)
-            *fps_n = G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_DVD_VIDEO_FPS
-        else
-            *fps_n = G_DIGICAM_CAMERABIN_VIEWFINDER_16X9_VIDEO_FPS
-        *fps_d = 100;
-        break;
-    default:
-        g_assert_not_reached ();
+static gboolean
+_element_ready (gpointer user_data)
+{
+    ElementBuild *build = NULL;
+    GDigicamDescriptor *descriptor = NULL;
+    GError *error = NULL;
+
+    build = (ElementBuild *) user_data;
+
+    if (NULL == build->element) {
+        g_digicam_set_error (&error, G_DIGICAM_ERROR_FAILED,
+                             "GDigicamCamerabin: camerabin creation failed");
+    } else if (NULL != build->manager) {
+        descriptor = g_digicam_camerabin_descriptor_new (build->element);
+        g_digicam_manager_set_gstreamer_bin (build->manager,
+                                             build->element,
+                                             descriptor,
+                                             &error);
+        g_digicam_manager_descriptor_free (descriptor);
+    }
+
+    if (NULL != error) {
+        G_DIGICAM_DEBUG ("GDigicamCamerabin: %s", error->message);
+    }
+
+    if (NULL != build->func) {
+        build->func (build->manager,
+                     build->element,
+                     build->colorkey,
+                     error,
+                     build->user_data);
+    }
+
+    if (NULL != error) {
+        g_error_free (error);
     }
+
+    _element_build_free (build);
+
+    return FALSE;
 }
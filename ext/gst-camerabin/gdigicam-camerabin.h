@@ -199,6 +199,19 @@ extern "C" {
         GDigicamPreview preview_mode;
     } GDigicamCamerabinAspectRatioResolutionHelper;
 
+/**
+ * GDigicamCamerabinWindowGeometryHelper:
+ * @width: Width, in pixels, of the viewfinder window.
+ * @height: Height, in pixels, of the viewfinder window.
+ *
+ * Data structure with helper data to be used during
+ * "set_window_geometry" operation for 'camerabin'.
+ */
+    typedef struct  {
+        guint width;
+        guint height;
+    } GDigicamCamerabinWindowGeometryHelper;
+
 /**
  * GDigicamCamerabinLocksHelper:
  * @locks: A #GDigicamLock indicating the locks.
@@ -265,6 +278,25 @@ extern "C" {
         GDigicamPreview mode;
     } GDigicamCamerabinPreviewHelper;
 
+/**
+ * GDigicamCamerabinElementReadyFunc:
+ * @manager: The #GDigicamManager the element has been set to, or
+ * #NULL.
+ * @gst_camera_bin: The CameraBin #GstElement, or #NULL if its
+ * creation failed.
+ * @colorkey: The colorkey of the viewfinder sink.
+ * @error: A #GError describing the failure, or #NULL.
+ * @user_data: Data passed to g_digicam_camerabin_element_new_async().
+ *
+ * Function called from the main loop when a CameraBin #GstElement
+ * requested with g_digicam_camerabin_element_new_async() is ready.
+ */
+    typedef void (*GDigicamCamerabinElementReadyFunc) (GDigicamManager *manager,
+                                                       GstElement *gst_camera_bin,
+                                                       gint colorkey,
+                                                       const GError *error,
+                                                       gpointer user_data);
+
     /********************/
     /* Public functions */
     /********************/
@@ -279,6 +311,59 @@ extern "C" {
 						 const gchar *imagepp,
                                                  const gchar *ximagesink,
                                                  gint *colorkey);
+    gboolean g_digicam_camerabin_element_prepare (const gchar *videosrc,
+                                                  const gchar *videoenc,
+                                                  const gchar *videomux,
+                                                  const gchar *audiosrc,
+                                                  const gchar *audioenc,
+                                                  const gchar *imageenc,
+                                                  const gchar *imagepp,
+                                                  const gchar *ximagesink);
+    gboolean g_digicam_camerabin_element_new_async (GDigicamManager *manager,
+                                                    const gchar *videosrc,
+                                                    const gchar *videoenc,
+                                                    const gchar *videomux,
+                                                    const gchar *audiosrc,
+                                                    const gchar *audioenc,
+                                                    const gchar *imageenc,
+                                                    const gchar *imagepp,
+                                                    const gchar *ximagesink,
+                                                    GDigicamCamerabinElementReadyFunc func,
+                                                    gpointer user_data);
+    void g_digicam_camerabin_element_recycle (GstElement *gst_camera_bin);
+    void g_digicam_camerabin_set_deferred_metadata (GstElement *gst_camera_bin,
+                                                    gboolean deferred);
+    gboolean g_digicam_camerabin_get_deferred_metadata (GstElement *gst_camera_bin);
+    void g_digicam_camerabin_update_picture_location (const gchar *filename,
+                                                      const GDigicamCamerabinMetadata *metadata);
+    void g_digicam_camerabin_set_prerecord (GstElement *gst_camera_bin,
+                                            guint milliseconds,
+                                            guint max_bytes);
+    gboolean g_digicam_camerabin_get_prerecord (GstElement *gst_camera_bin,
+                                                guint *milliseconds,
+                                                guint *max_bytes);
+    gboolean g_digicam_camerabin_set_zsl (GstElement *gst_camera_bin,
+                                          guint max_bytes);
+    guint g_digicam_camerabin_get_zsl (GstElement *gst_camera_bin);
+    gboolean g_digicam_camerabin_set_parallel_encoding (GstElement *gst_camera_bin,
+                                                        gboolean parallel);
+    gboolean g_digicam_camerabin_get_parallel_encoding (GstElement *gst_camera_bin);
+    gboolean g_digicam_camerabin_set_async_writer (GstElement *gst_camera_bin,
+                                                   gboolean enabled);
+    gboolean g_digicam_camerabin_get_async_writer (GstElement *gst_camera_bin);
+    gboolean g_digicam_camerabin_set_picture_buffers (GstElement *gst_camera_bin,
+                                                      gboolean enabled);
+    gboolean g_digicam_camerabin_get_picture_buffers (GstElement *gst_camera_bin);
+    gboolean g_digicam_camerabin_set_output_fd (GstElement *gst_camera_bin,
+                                                gint fd);
+    gboolean g_digicam_camerabin_set_segments (GstElement *gst_camera_bin,
+                                               guint seconds,
+                                               guint64 max_bytes,
+                                               guint64 reserved);
+    gboolean g_digicam_camerabin_get_segments (GstElement *gst_camera_bin,
+                                               guint *seconds,
+                                               guint64 *max_bytes,
+                                               guint64 *reserved);
 
     G_END_DECLS
 
@@ -84,6 +84,10 @@ extern "C" {
      *  impossible to perform.
      * @G_DIGICAM_ERROR_PREVIEW_NOT_SUPPORTED: The preview operations are
      *  not supported.
+     * @G_DIGICAM_ERROR_NO_SPACE: There is not enough free space to
+     *  save the capture.
+     * @G_DIGICAM_ERROR_BUSY: The previous captures are still being
+     *  handled, the operation can be tried again later.
      *
      * Indicates the type of #GError.
      */
@@ -109,6 +113,8 @@ extern "C" {
         G_DIGICAM_ERROR_ZOOM_OUT_OF_RANGE,
         G_DIGICAM_ERROR_AUDIO_NOT_SUPPORTED,
         G_DIGICAM_ERROR_PREVIEW_NOT_SUPPORTED,
+        G_DIGICAM_ERROR_NO_SPACE,
+        G_DIGICAM_ERROR_BUSY,
     } GDigicamError;
 
 
@@ -27,6 +27,9 @@
 #include <glib-object.h>
 #include <gst/gst.h>
 
+#include "gdigicam-naming.h"
+#include "gdigicam-storage.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -53,13 +56,15 @@ extern "C" {
         GstElement *gst_bin;
         GstElement *gst_pipeline;
 	gulong xwindow_id;
+        guint window_width;
+        guint window_height;
 
 /*         gchar *saving_location; */
 /*         gchar *video_saving_location; */
-/*         gchar *photo_base_filename; */
-/*         gchar *video_base_filename; */
-/*         guint32 photo_file_counter; */
-/*         guint32 video_file_counter; */
+        GDigicamNaming *photo_naming;
+        GDigicamNaming *video_naming;
+        /* Names are reserved from any thread */
+        GMutex *naming_lock;
 
 /*         gulong photo_handler_signal_id; */
 
@@ -100,12 +105,34 @@ extern "C" {
         gboolean digital_zoom;
         GDigicamAudio audio;
         GDigicamPreview preview_mode;
+        GArray *preview_sizes;
+        /* The sizes are read from the streaming threads */
+        GMutex *preview_sizes_lock;
+        GDigicamThumbnail thumbnail_mode;
+#if G_DIGICAM_HAVE_GDKPIXBUF
+        GPtrArray *preview_pool;
+        GMutex *preview_pool_lock;
+#endif
 	GMutex *capture_lock;
+        /* The storage targets, in order of preference, the one the
+         * captures go to now, and the ones of the pictures not saved
+         * yet */
+        GList *storages;
+        GDigicamStorage *storage;
+        GQueue *shot_storages;
+        guint storage_watch;
+        gpointer recording_data;
     };
 
     /* Protected functions */
     void _g_digicam_manager_set_capture_lock (GDigicamManager *manager);
     void _g_digicam_manager_release_capture_lock (GDigicamManager *manager);
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    GdkPixbuf *_g_digicam_manager_get_preview_surface (GDigicamManager *manager,
+                                                       gboolean has_alpha,
+                                                       gint width,
+                                                       gint height);
+#endif
     gboolean _g_digicam_manager_is_valid_flag (GDigicamManager *manager,
                                                guint32 flag,
                                                guint32 low, guint32 high);
@@ -50,9 +50,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
+#include <glib/gstdio.h>
 /* #include <osso-log.h> */
 #include <gst/gst.h>
 #include <gst/interfaces/xoverlay.h>
@@ -90,10 +92,14 @@ enum
     CAPTURE_START_SIGNAL,
     CAPTURE_END_SIGNAL,
     PREVIEW_SIGNAL,
+    PREVIEW_SET_SIGNAL,
+    PREVIEW_BUFFER_SIGNAL,
+    PICTURE_BUFFER_SIGNAL,
     PICTURE_GOT_SIGNAL,
     INTERNAL_ERROR_SIGNAL,
     IO_ERROR_SIGNAL,
     NO_SPACE_ERROR_SIGNAL,
+    STORAGE_CHANGED_SIGNAL,
     LAST_SIGNAL
 };
 
@@ -102,6 +108,32 @@ static guint manager_signals [LAST_SIGNAL] = { 0 };
 #define MIN_ZOOM 1
 #define STATE_CHANGE_TIMEOUT 1000000000
 
+/* Recordings are not started with less than STORAGE_MIN_SECONDS left
+ * in the storage, and are finished when there are STORAGE_STOP_SECONDS
+ * left, so the muxer can still write its headers. The free space is
+ * read every STORAGE_WATCH_INTERVAL milliseconds while recording. */
+#define STORAGE_MIN_SECONDS 5
+#define STORAGE_STOP_SECONDS 2
+#define STORAGE_WATCH_INTERVAL 1000
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+/* Preview surfaces kept for reuse. Enough for the preview and a few
+ * additional sizes of two shots in flight. */
+#define PREVIEW_POOL_SIZE 8
+
+/* A preview pixbuf of the pool. The pool holds a toggle reference on
+ * it, so it knows when everybody else has released it. The pixels
+ * belong to the surface and only grow, a resize just wraps them in a
+ * new pixbuf. Once the pool is gone, the last pixbuf frees them. */
+typedef struct _PreviewSurface {
+    GdkPixbuf *pixbuf;
+    volatile gint busy;
+    guchar *pixels;
+    gsize size;
+    volatile gint orphaned;
+} PreviewSurface;
+#endif
+
 /***************************************/
 /* Gobject support function prototypes */
 /***************************************/
@@ -129,6 +161,27 @@ static void _g_digicam_manager_free_private (GDigicamManagerPrivate *priv);
 static void _mapping_capabilities (GstCaps *caps, GDigicamDescriptor *descriptor);
 gboolean _mapping_structure  (GQuark field_id, const GValue *value, gpointer user_data);
 static gboolean _picture_done (GObject *camera, const gchar *filename, gpointer user_data);
+#if G_DIGICAM_HAVE_GDKPIXBUF
+static void _preview_surface_toggle_notify (gpointer data, GObject *object, gboolean is_last_ref);
+static gboolean _preview_surface_set_pixbuf (PreviewSurface *surface, gboolean has_alpha, gint width, gint height);
+static void _preview_surface_free (PreviewSurface *surface);
+static void _preview_surface_release_pixels (guchar *pixels, gpointer data);
+#endif
+static guint32 _storage_key (GDigicamManagerPrivate *priv);
+static GDigicamStorage *_storage_select (GDigicamManagerPrivate *priv,
+                                         GDigicamMode mode,
+                                         GDigicamStorage *skip);
+static void _storage_set_current (GDigicamManager *manager,
+                                  GDigicamStorage *storage);
+static void _storage_clear (GDigicamManagerPrivate *priv);
+static void _storage_cancel_shots (GDigicamManagerPrivate *priv,
+                                   gboolean all);
+static void _naming_follow_storage (GDigicamManagerPrivate *priv,
+                                    GDigicamNaming **naming,
+                                    const gchar *from,
+                                    const gchar *to);
+static gboolean _storage_watch (gpointer user_data);
+static void _storage_stop_watch (GDigicamManagerPrivate *priv);
 static void _internal_error_recovering (GDigicamManager *self);
 static gboolean _evaluate_transition (GDigicamManagerPrivate *priv, GstStateChangeReturn result);
 
@@ -3661,6 +3714,321 @@ error:
 }
 
 
+/**
+ * g_digicam_manager_set_preview_sizes:
+ * @manager: A #GDigicamManager
+ * @sizes: The bounding boxes of the additional previews.
+ * @n_sizes: The number of elements in @sizes, 0 to disable the
+ * additional previews.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Sets the sizes of the additional previews to produce with every
+ * captured picture. They are all scaled down in a single pass from
+ * the preview and delivered with the
+ * #GDigicamManager::image-preview-set signal. Sizes bigger than the
+ * preview are produced at the preview size.
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_set_preview_sizes (GDigicamManager           *manager,
+                                     const GDigicamPreviewSize *sizes,
+                                     guint                      n_sizes,
+                                     GError                   **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+    guint i;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail ((NULL != sizes) || (0 == n_sizes), FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    /* Check GStreamer bin */
+    if (NULL == priv->gst_bin) {
+        error_code = G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET;
+        error_msg = g_strdup ("imposible to set the preview sizes "
+                              "since there is no GStreamer bin");
+        goto error;
+    }
+
+    /* Check preview capability */
+    if (!(priv->descriptor->supported_features &
+          G_DIGICAM_CAPABILITIES_PREVIEW)) {
+        error_code = G_DIGICAM_ERROR_PREVIEW_NOT_SUPPORTED;
+        error_msg = g_strdup ("imposible to set the preview sizes "
+                              "since the GStreamer bin "
+                              "has not this capability");
+        goto error;
+    }
+
+    /* Check sizes */
+    for (i = 0; i < n_sizes; i++) {
+        if ((0 == sizes[i].width) || (0 == sizes[i].height)) {
+            error_code = G_DIGICAM_ERROR_FAILED;
+            error_msg = g_strdup_printf ("invalid %dx%d preview size",
+                                         sizes[i].width, sizes[i].height);
+            goto error;
+        }
+    }
+
+    /* Performs operation */
+    g_mutex_lock (priv->preview_sizes_lock);
+    if (NULL != priv->preview_sizes) {
+        g_array_free (priv->preview_sizes, TRUE);
+        priv->preview_sizes = NULL;
+    }
+    if (0 < n_sizes) {
+        priv->preview_sizes = g_array_sized_new (FALSE, FALSE,
+                                                 sizeof (GDigicamPreviewSize),
+                                                 n_sizes);
+        g_array_append_vals (priv->preview_sizes, sizes, n_sizes);
+    }
+    g_mutex_unlock (priv->preview_sizes_lock);
+
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+	}
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_get_preview_sizes:
+ * @manager: A #GDigicamManager
+ * @sizes: A newly allocated array with the sizes of the additional
+ * previews, or %NULL if there are none. Free it with g_free().
+ * @n_sizes: The number of elements in @sizes.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Gets the sizes of the additional previews from the
+ * #GDigicamManager object. It can be called from any thread, @sizes
+ * is a copy taken under the lock of the setter.
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_get_preview_sizes (GDigicamManager      *manager,
+                                     GDigicamPreviewSize **sizes,
+                                     guint                *n_sizes,
+                                     GError              **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail (NULL != sizes, FALSE);
+    g_return_val_if_fail (NULL != n_sizes, FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    *sizes = NULL;
+    *n_sizes = 0;
+
+    /* Check GStreamer bin */
+    if (NULL == priv->gst_bin) {
+        error_code = G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET;
+        error_msg = g_strdup ("imposible to get the preview sizes "
+                              "since there is no GStreamer bin");
+        goto error;
+    }
+
+    /* Check preview capability */
+    if (!(priv->descriptor->supported_features &
+          G_DIGICAM_CAPABILITIES_PREVIEW)) {
+        error_code = G_DIGICAM_ERROR_PREVIEW_NOT_SUPPORTED;
+        error_msg = g_strdup ("imposible to get the preview sizes "
+                              "since the GStreamer bin "
+                              "has not this capability");
+        goto error;
+    }
+
+    /* Performs operation */
+    g_mutex_lock (priv->preview_sizes_lock);
+    if (NULL != priv->preview_sizes) {
+        *n_sizes = priv->preview_sizes->len;
+        *sizes = g_memdup (priv->preview_sizes->data,
+                           *n_sizes * sizeof (GDigicamPreviewSize));
+    }
+    g_mutex_unlock (priv->preview_sizes_lock);
+
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+	}
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_set_thumbnail_mode:
+ * @manager: A #GDigicamManager
+ * @mode: The #GDigicamThumbnail flags to set.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Sets which freedesktop.org thumbnails are written for every still
+ * picture, if the camera plugin descriptor provides the required
+ * capability (#G_DIGICAM_CAPABILITIES_PREVIEW). They are made from
+ * the preview, so other applications don't need to decode the whole
+ * picture to show it.
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_set_thumbnail_mode (GDigicamManager   *manager,
+                                      GDigicamThumbnail  mode,
+                                      GError           **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    /* Check GStreamer bin */
+    if (NULL == priv->gst_bin) {
+        error_code = G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET;
+        error_msg = g_strdup ("imposible to set the thumbnail mode "
+                              "since there is no GStreamer bin");
+        goto error;
+    }
+
+    /* Check preview capability */
+    if (!(priv->descriptor->supported_features &
+          G_DIGICAM_CAPABILITIES_PREVIEW)) {
+        error_code = G_DIGICAM_ERROR_PREVIEW_NOT_SUPPORTED;
+        error_msg = g_strdup ("imposible to set the thumbnail mode "
+                              "since the GStreamer bin "
+                              "has not this capability");
+        goto error;
+    }
+
+    /* Check the flags */
+    if (0 != (mode & ~(G_DIGICAM_THUMBNAIL_N - 1))) {
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup_printf ("invalid thumbnail mode %d", mode);
+        goto error;
+    }
+
+    /* Thumbnails are written when the picture is saved, nothing to
+     * do in the bin now. */
+    priv->thumbnail_mode = mode;
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+	}
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_get_thumbnail_mode:
+ * @manager: A #GDigicamManager
+ * @mode: The #GDigicamThumbnail flags.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Gets the #GDigicamThumbnail flags from the #GDigicamManager object.
+ *
+ * Returns: #True if success, #FALSE otherwise.
+ **/
+gboolean
+g_digicam_manager_get_thumbnail_mode (GDigicamManager   *manager,
+                                      GDigicamThumbnail *mode,
+                                      GError           **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail (NULL != mode, FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    *mode = G_DIGICAM_THUMBNAIL_NONE;
+
+    /* Check GStreamer bin */
+    if (NULL == priv->gst_bin) {
+        error_code = G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET;
+        error_msg = g_strdup ("imposible to get the thumbnail mode "
+                              "since there is no GStreamer bin");
+        goto error;
+    }
+
+    /* Check preview capability */
+    if (!(priv->descriptor->supported_features &
+          G_DIGICAM_CAPABILITIES_PREVIEW)) {
+        error_code = G_DIGICAM_ERROR_PREVIEW_NOT_SUPPORTED;
+        error_msg = g_strdup ("imposible to get the thumbnail mode "
+                              "since the GStreamer bin "
+                              "has not this capability");
+        goto error;
+    }
+
+    /* Performs operation */
+    *mode = priv->thumbnail_mode;
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+	}
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
 /**
  * g_digicam_manager_preview_enabled:
  * @manager: A #GDigicamManager
@@ -3935,22 +4303,28 @@ error:
 
 
 /**
- * g_digicam_manager_capture_still_picture:
+ * g_digicam_manager_set_window_geometry:
  * @manager: A #GDigicamManager
- * @filename: The file name to store the still picture created.
+ * @width: Width, in pixels, of the window the viewfinder is shown in.
+ * @height: Height, in pixels, of the window the viewfinder is shown
+ * in.
  * @error: A #GError to store the result of the operation.
  * @user_data: Data to be used with the customized set function
  *  provided by the user in the #GDigicamDescriptor.
  *
- * Captures a still picture.
+ * Lets the #GDigicamManager know the size of the window given in
+ * g_digicam_manager_play_bin(), so the viewfinder can be negotiated
+ * to match it instead of being scaled by the sink for every
+ * frame. It should be called again each time the window is resized.
  *
  * Returns: #True if success, #False otherwise.
  **/
 gboolean
-g_digicam_manager_capture_still_picture (GDigicamManager *manager,
-                                         const gchar     *filename,
-                                         GError         **error,
-                                         gpointer         user_data)
+g_digicam_manager_set_window_geometry (GDigicamManager *manager,
+                                       guint            width,
+                                       guint            height,
+                                       GError         **error,
+                                       gpointer         user_data)
 {
     GDigicamManagerPrivate *priv = NULL;
     gboolean result = FALSE;
@@ -3965,17 +4339,796 @@ g_digicam_manager_capture_still_picture (GDigicamManager *manager,
     /* Check GStreamer bin */
     if (NULL == priv->gst_bin) {
         error_code = G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET;
-        error_msg = g_strdup ("imposible to start still picture capture "
-                              "since there is no GStreamer bin.");
-        goto error;
-    }
-
-    /* Check still picture mode */
-    if (priv->mode != G_DIGICAM_MODE_STILL) {
-        error_code = G_DIGICAM_ERROR_INVALID_MODE;
-        error_msg = g_strdup ("imposible to start still picture capture "
-                              "since camera is not in still picture "
-                              "mode, required for this operation.");
+        error_msg = g_strdup ("imposible to set the window geometry "
+                              "since there is no GStreamer bin");
+        goto error;
+    }
+
+    /* Check viewfinder capability */
+    if (!(priv->descriptor->supported_features &
+          G_DIGICAM_CAPABILITIES_VIEWFINDER)) {
+        error_code = G_DIGICAM_ERROR_VIEWFINDER_NOT_SUPPORTED;
+        error_msg = g_strdup ("imposible to set the window geometry "
+                              "since the GStreamer bin "
+                              "has not this capability");
+        goto error;
+    }
+
+    /* Avoid to set the same value */
+    if ((width == priv->window_width) &&
+        (height == priv->window_height)) {
+        result = TRUE;
+        goto error;
+    }
+
+    /* The viewfinder is just scaled by the sink when the descriptor
+     * can not adapt it. */
+    if (NULL != priv->descriptor->set_window_geometry_func) {
+        G_DIGICAM_DEBUG ("GDigicamManager: Setting the window geometry "
+                         "to %dx%d ...\n", width, height);
+        result = priv->descriptor->set_window_geometry_func (manager,
+                                                             user_data);
+
+        /* Check operation result */
+        if (!result) {
+            error_code = G_DIGICAM_ERROR_FAILED;
+            error_msg = g_strdup_printf ("internal error setting the "
+                                         "%dx%d window geometry "
+                                         "in the GStreamer bin.",
+                                         width, height);
+            goto error;
+        }
+    }
+
+    priv->window_width = width;
+    priv->window_height = height;
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+	}
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_get_window_geometry:
+ * @manager: A #GDigicamManager
+ * @width: Width of the window the viewfinder is shown in, or 0 if
+ * unknown.
+ * @height: Height of the window the viewfinder is shown in, or 0 if
+ * unknown.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Gets the window geometry from the #GDigicamManager object.
+ *
+ * Returns: #True if success, #FALSE otherwise.
+ **/
+gboolean
+g_digicam_manager_get_window_geometry (GDigicamManager *manager,
+                                       guint           *width,
+                                       guint           *height,
+                                       GError         **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail (NULL != width, FALSE);
+    g_return_val_if_fail (NULL != height, FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    /* Check GStreamer bin */
+    if (NULL == priv->gst_bin) {
+        error_code = G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET;
+        error_msg = g_strdup ("imposible to get the window geometry "
+                              "since there is no GStreamer bin");
+        *width = 0;
+        *height = 0;
+        goto error;
+    }
+
+    /* Performs operation */
+    *width = priv->window_width;
+    *height = priv->window_height;
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+	}
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_set_storage:
+ * @manager: A #GDigicamManager
+ * @directory: The directory where the captures are saved, or %NULL.
+ * @reserved: Bytes of @directory which captures must leave free.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Sets the directory whose free space is tracked. From then on still
+ * pictures and video recordings which would not fit are refused with
+ * #G_DIGICAM_ERROR_NO_SPACE, and recordings are finished before the
+ * storage gets full, emitting the #GDigicamManager::no-space-error
+ * signal. The size of the pictures and the bitrate of the recordings
+ * are learned for every aspect ratio, resolution and quality. A %NULL
+ * @directory stops tracking the free space. It replaces all the
+ * storage targets, see g_digicam_manager_add_storage().
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_set_storage (GDigicamManager  *manager,
+                               const gchar      *directory,
+                               guint64           reserved,
+                               GError          **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    GDigicamStorage *storage = NULL;
+    GError *storage_error = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    /* Check the directory */
+    if (NULL != directory) {
+        storage = _g_digicam_storage_new (directory, reserved,
+                                          &storage_error);
+        if (NULL == storage) {
+            error_code = G_DIGICAM_ERROR_FAILED;
+            error_msg = g_strdup_printf ("imposible to set the storage: %s",
+                                         storage_error->message);
+            g_error_free (storage_error);
+            goto error;
+        }
+    }
+
+    /* Performs operation */
+    _storage_stop_watch (priv);
+    _storage_clear (priv);
+    if (NULL != storage) {
+        priv->storages = g_list_append (NULL, storage);
+        priv->storage = storage;
+    }
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+        }
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_add_storage:
+ * @manager: A #GDigicamManager
+ * @directory: Another directory where the captures can be saved.
+ * @reserved: Bytes of @directory which captures must leave free.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Adds a storage target after the ones already set with
+ * g_digicam_manager_set_storage() and this function, like a memory
+ * card after the internal memory. Every capture goes to the first
+ * target with enough free space, see g_digicam_manager_select_storage(),
+ * and a recording going on moves to the next target when its own is
+ * full, if the backend can. Captures are only refused with
+ * #G_DIGICAM_ERROR_NO_SPACE, and #GDigicamManager::no-space-error is
+ * only emitted, when all the targets are full.
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_add_storage (GDigicamManager  *manager,
+                               const gchar      *directory,
+                               guint64           reserved,
+                               GError          **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    GDigicamStorage *storage = NULL;
+    GError *storage_error = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail (NULL != directory, FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    /* Check the directory */
+    storage = _g_digicam_storage_new (directory, reserved, &storage_error);
+    if (NULL == storage) {
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup_printf ("imposible to add the storage: %s",
+                                     storage_error->message);
+        g_error_free (storage_error);
+        goto error;
+    }
+
+    /* Performs operation */
+    priv->storages = g_list_append (priv->storages, storage);
+    if (NULL == priv->storage) {
+        priv->storage = storage;
+    }
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+        }
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_select_storage:
+ * @manager: A #GDigicamManager
+ * @directory: The directory the next capture goes to, to be freed
+ * with g_free().
+ * @error: A #GError to store the result of the operation.
+ *
+ * Chooses the storage target for the next capture in the current
+ * mode, the first one with enough free space, so the application
+ * names its file there. #GDigicamManager::storage-changed is emitted
+ * if it is not the one of the previous capture. The namings set in
+ * the directory of the previous target, see
+ * g_digicam_manager_set_naming(), move to the new one.
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_select_storage (GDigicamManager  *manager,
+                               gchar           **directory,
+                               GError          **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    GDigicamStorage *storage = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail (NULL != directory, FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    *directory = NULL;
+
+    /* Check storage */
+    if (NULL == priv->storages) {
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup ("imposible to select the storage "
+                              "since there is no storage set");
+        goto error;
+    }
+
+    /* Performs operation */
+    storage = _storage_select (priv, priv->mode, NULL);
+    if (NULL == storage) {
+        error_code = G_DIGICAM_ERROR_NO_SPACE;
+        error_msg = g_strdup ("imposible to select the storage "
+                              "since all of them are full.");
+        goto error;
+    }
+    _storage_set_current (manager, storage);
+    *directory = g_strdup (_g_digicam_storage_get_directory (storage));
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+        }
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_get_storage:
+ * @manager: A #GDigicamManager
+ * @directory: The directory the captures go to now, to be freed with
+ * g_free().
+ * @error: A #GError to store the result of the operation.
+ *
+ * Gets the storage target the last capture went to, or the first one
+ * if there was none yet. It doesn't check whether it is full, see
+ * g_digicam_manager_select_storage().
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_get_storage (GDigicamManager  *manager,
+                               gchar           **directory,
+                               GError          **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail (NULL != directory, FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    *directory = NULL;
+
+    /* Check storage */
+    if (NULL == priv->storage) {
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup ("imposible to get the storage "
+                              "since there is no storage set");
+        goto error;
+    }
+
+    /* Performs operation */
+    *directory = g_strdup (_g_digicam_storage_get_directory (priv->storage));
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+        }
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_get_remaining_shots:
+ * @manager: A #GDigicamManager
+ * @shots: The number of still pictures that fit in the storage.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Estimates how many still pictures with the current aspect ratio,
+ * resolution and quality can still be saved in the storage set with
+ * g_digicam_manager_set_storage(), and the ones added with
+ * g_digicam_manager_add_storage().
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_get_remaining_shots (GDigicamManager  *manager,
+                                       guint            *shots,
+                                       GError          **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    GList *item = NULL;
+    GError *storage_error = NULL;
+    guint64 total = 0;
+    gboolean read = FALSE;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail (NULL != shots, FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    *shots = 0;
+
+    /* Check storage */
+    if (NULL == priv->storages) {
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup ("imposible to get the remaining shots "
+                              "since there is no storage set");
+        goto error;
+    }
+
+    /* Performs operation, on all the targets which can be read */
+    for (item = priv->storages; NULL != item; item = g_list_next (item)) {
+        g_clear_error (&storage_error);
+        if (_g_digicam_storage_refresh (item->data, &storage_error)) {
+            total += _g_digicam_storage_get_remaining_shots (item->data,
+                                                             _storage_key (priv));
+            read = TRUE;
+        }
+    }
+    if (!read) {
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup_printf ("imposible to get the remaining "
+                                     "shots: %s", storage_error->message);
+        g_error_free (storage_error);
+        goto error;
+    }
+    g_clear_error (&storage_error);
+    *shots = MIN (total, G_MAXUINT);
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+        }
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_get_remaining_seconds:
+ * @manager: A #GDigicamManager
+ * @seconds: The seconds of video that fit in the storage.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Estimates how many seconds of video with the current aspect ratio,
+ * resolution and quality can still be recorded in the storage set
+ * with g_digicam_manager_set_storage(), and the ones added with
+ * g_digicam_manager_add_storage(). While recording, it is what is
+ * left of the current recording.
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_get_remaining_seconds (GDigicamManager  *manager,
+                                         guint            *seconds,
+                                         GError          **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    GList *item = NULL;
+    GError *storage_error = NULL;
+    guint64 total = 0;
+    gboolean read = FALSE;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail (NULL != seconds, FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    *seconds = 0;
+
+    /* Check storage */
+    if (NULL == priv->storages) {
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup ("imposible to get the remaining seconds "
+                              "since there is no storage set");
+        goto error;
+    }
+
+    /* Performs operation, on all the targets which can be read */
+    for (item = priv->storages; NULL != item; item = g_list_next (item)) {
+        g_clear_error (&storage_error);
+        if (_g_digicam_storage_refresh (item->data, &storage_error)) {
+            total += _g_digicam_storage_get_remaining_seconds (item->data,
+                                                               _storage_key (priv));
+            read = TRUE;
+        }
+    }
+    if (!read) {
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup_printf ("imposible to get the remaining "
+                                     "seconds: %s", storage_error->message);
+        g_error_free (storage_error);
+        goto error;
+    }
+    g_clear_error (&storage_error);
+    *seconds = MIN (total, G_MAXUINT);
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+        }
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_set_naming:
+ * @manager: A #GDigicamManager
+ * @mode: #G_DIGICAM_MODE_STILL or #G_DIGICAM_MODE_VIDEO.
+ * @directory: The directory where the captures of @mode are saved, or
+ * %NULL.
+ * @pattern: The name of the captures, with a run of up to 9 '#'
+ * characters replaced by a counter, like "IMG_####.jpg".
+ * @error: A #GError to store the result of the operation.
+ *
+ * Sets how the names of the captures of @mode are generated with
+ * g_digicam_manager_reserve_filename(). The counter is saved in a
+ * hidden file of @directory, so numbering goes on where it was left,
+ * and the directory is only scanned the first time, for the names
+ * already used. A %NULL @directory stops generating names for @mode.
+ * If @directory is the one of a storage target, the names move with
+ * the captures to the next target when it is full, see
+ * g_digicam_manager_select_storage().
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_set_naming (GDigicamManager  *manager,
+                              GDigicamMode      mode,
+                              const gchar      *directory,
+                              const gchar      *pattern,
+                              GError          **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    GDigicamNaming *naming = NULL;
+    GDigicamNaming **current = NULL;
+    GError *naming_error = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail ((NULL == directory) || (NULL != pattern), FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    /* Check mode */
+    if (G_DIGICAM_MODE_STILL == mode) {
+        current = &priv->photo_naming;
+    } else if (G_DIGICAM_MODE_VIDEO == mode) {
+        current = &priv->video_naming;
+    } else {
+        error_code = G_DIGICAM_ERROR_INVALID_MODE;
+        error_msg = g_strdup ("imposible to set the naming of an "
+                              "invalid mode");
+        goto error;
+    }
+
+    /* The new naming may go on from the counter of the current one */
+    g_mutex_lock (priv->naming_lock);
+    if (NULL != *current) {
+        _g_digicam_naming_flush (*current);
+    }
+    g_mutex_unlock (priv->naming_lock);
+
+    /* Check the directory and the pattern, out of the lock since the
+     * directory may be scanned */
+    if (NULL != directory) {
+        naming = _g_digicam_naming_new (directory, pattern, &naming_error);
+        if (NULL == naming) {
+            error_code = G_DIGICAM_ERROR_FAILED;
+            error_msg = g_strdup_printf ("imposible to set the naming: %s",
+                                         naming_error->message);
+            g_error_free (naming_error);
+            goto error;
+        }
+    }
+
+    /* Performs operation */
+    g_mutex_lock (priv->naming_lock);
+    _g_digicam_naming_free (*current);
+    *current = naming;
+    g_mutex_unlock (priv->naming_lock);
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+        }
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_reserve_filename:
+ * @manager: A #GDigicamManager
+ * @mode: #G_DIGICAM_MODE_STILL or #G_DIGICAM_MODE_VIDEO.
+ * @filename: The full path of the reserved name, to be freed with
+ * g_free().
+ * @error: A #GError to store the result of the operation.
+ *
+ * Reserves the next name of the captures of @mode set with
+ * g_digicam_manager_set_naming(), creating an empty file, so it is
+ * never given twice, even to somebody else writing to the same
+ * directory. The names already taken are skipped. It doesn't need
+ * the main loop and can be called from any thread, like the one
+ * driving a burst.
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_reserve_filename (GDigicamManager  *manager,
+                                    GDigicamMode      mode,
+                                    gchar           **filename,
+                                    GError          **error)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    GDigicamNaming *naming = NULL;
+    GError *naming_error = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+    g_return_val_if_fail (NULL != filename, FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    *filename = NULL;
+
+    /* The naming can't be replaced meanwhile */
+    g_mutex_lock (priv->naming_lock);
+
+    /* Check naming */
+    if (G_DIGICAM_MODE_STILL == mode) {
+        naming = priv->photo_naming;
+    } else if (G_DIGICAM_MODE_VIDEO == mode) {
+        naming = priv->video_naming;
+    }
+    if (NULL == naming) {
+        g_mutex_unlock (priv->naming_lock);
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup ("imposible to reserve a file name "
+                              "since there is no naming set");
+        goto error;
+    }
+
+    /* Performs operation */
+    *filename = _g_digicam_naming_reserve (naming, &naming_error);
+    g_mutex_unlock (priv->naming_lock);
+    if (NULL == *filename) {
+        error_code = G_DIGICAM_ERROR_FAILED;
+        error_msg = g_strdup_printf ("imposible to reserve a file name: %s",
+                                     naming_error->message);
+        g_error_free (naming_error);
+        goto error;
+    }
+    result = TRUE;
+
+error:
+    if ((NULL != error) && (NULL == *error)) {
+        if ((!result) && (NULL != error_msg)) {
+            g_digicam_set_error (error, error_code, error_msg);
+        }
+    }
+
+    /* Free */
+    if (NULL != error_msg) {
+        g_free (error_msg);
+    }
+
+    return result;
+}
+
+
+/**
+ * g_digicam_manager_capture_still_picture:
+ * @manager: A #GDigicamManager
+ * @filename: The file name to store the still picture created.
+ * @error: A #GError to store the result of the operation.
+ * @user_data: Data to be used with the customized set function
+ *  provided by the user in the #GDigicamDescriptor.
+ *
+ * Captures a still picture.
+ *
+ * When storage targets are set, see g_digicam_manager_add_storage(),
+ * the picture is accounted in the first one with room, which is the
+ * one g_digicam_manager_select_storage() returns right before. The
+ * file of the picture is not moved there: callers must name it in
+ * that directory, for instance with g_digicam_manager_reserve_filename()
+ * and a naming set in the storage directory.
+ *
+ * If the digicam like #GstElement can't take another picture yet,
+ * like when its encoders are behind, it fails with
+ * #G_DIGICAM_ERROR_BUSY and the capture can be tried again later.
+ *
+ * Returns: #True if success, #False otherwise.
+ **/
+gboolean
+g_digicam_manager_capture_still_picture (GDigicamManager *manager,
+                                         const gchar     *filename,
+                                         GError         **error,
+                                         gpointer         user_data)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    GDigicamStorage *storage = NULL;
+    gboolean result = FALSE;
+    gchar *error_msg = NULL;
+    GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
+
+    g_return_val_if_fail (G_DIGICAM_IS_MANAGER (manager), FALSE);
+
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    /* Check GStreamer bin */
+    if (NULL == priv->gst_bin) {
+        error_code = G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET;
+        error_msg = g_strdup ("imposible to start still picture capture "
+                              "since there is no GStreamer bin.");
+        goto error;
+    }
+
+    /* Check still picture mode */
+    if (priv->mode != G_DIGICAM_MODE_STILL) {
+        error_code = G_DIGICAM_ERROR_INVALID_MODE;
+        error_msg = g_strdup ("imposible to start still picture capture "
+                              "since camera is not in still picture "
+                              "mode, required for this operation.");
         goto error;
     }
 
@@ -3987,6 +5140,28 @@ g_digicam_manager_capture_still_picture (GDigicamManager *manager,
         goto error;
     }
 
+    /* Check the previous pictures are out of the way */
+    if ((NULL != priv->descriptor->still_picture_busy_func) &&
+        priv->descriptor->still_picture_busy_func (manager, user_data)) {
+        error_code = G_DIGICAM_ERROR_BUSY;
+        error_msg = g_strdup ("imposible to start still picture capture "
+                              "since the previous ones are still being "
+                              "saved.");
+        goto error;
+    }
+
+    /* Check free space, choosing the target of this capture */
+    if (NULL != priv->storages) {
+        storage = _storage_select (priv, G_DIGICAM_MODE_STILL, NULL);
+        if (NULL == storage) {
+            error_code = G_DIGICAM_ERROR_NO_SPACE;
+            error_msg = g_strdup ("imposible to start still picture capture "
+                                  "since there is not enough free space.");
+            goto error;
+        }
+        _storage_set_current (manager, storage);
+    }
+
     /* Release AutoFocus locks */
     priv->locks = 0;
 
@@ -4003,6 +5178,12 @@ g_digicam_manager_capture_still_picture (GDigicamManager *manager,
         goto error;
     }
 
+    /* Account it until it is saved */
+    if (NULL != storage) {
+        _g_digicam_storage_shot_started (storage, _storage_key (priv));
+        g_queue_push_tail (priv->shot_storages, storage);
+    }
+
 error:
     if ((NULL != error) && (NULL == *error)) {
         if ((!result) && (NULL != error_msg)) {
@@ -4028,6 +5209,13 @@ error:
  *
  * Starts the video recording.
  *
+ * When storage targets are set, see g_digicam_manager_add_storage(),
+ * the recording is accounted in the first one with room, which is the
+ * one g_digicam_manager_select_storage() returns right before. The
+ * file of the recording is not moved there: callers must name it in
+ * that directory, for instance with g_digicam_manager_reserve_filename()
+ * and a naming set in the storage directory.
+ *
  * Returns: #True if success, #False otherwise.
  **/
 gboolean
@@ -4036,6 +5224,7 @@ g_digicam_manager_start_recording_video (GDigicamManager *manager,
 					 gpointer         user_data)
 {
     GDigicamManagerPrivate *priv = NULL;
+    GDigicamStorage *storage = NULL;
     gboolean result = FALSE;
     gchar *error_msg = NULL;
     GDigicamError error_code = G_DIGICAM_ERROR_FAILED;
@@ -4070,6 +5259,18 @@ g_digicam_manager_start_recording_video (GDigicamManager *manager,
         goto error;
     }
 
+    /* Check free space, choosing the target of this recording */
+    if (NULL != priv->storages) {
+        storage = _storage_select (priv, G_DIGICAM_MODE_VIDEO, NULL);
+        if (NULL == storage) {
+            error_code = G_DIGICAM_ERROR_NO_SPACE;
+            error_msg = g_strdup ("imposible to start video recording "
+                                  "since there is not enough free space.");
+            goto error;
+        }
+        _storage_set_current (manager, storage);
+    }
+
     /* Performs operation */
     G_DIGICAM_DEBUG ("GDigicam: Record video operation started\n");
     result = priv->descriptor->start_recording_video_func (manager,
@@ -4083,6 +5284,17 @@ g_digicam_manager_start_recording_video (GDigicamManager *manager,
         goto error;
     }
 
+    /* Watch the free space while recording */
+    if (NULL != priv->storage) {
+        _storage_stop_watch (priv);
+        _g_digicam_storage_recording_started (priv->storage,
+                                              _storage_key (priv));
+        priv->recording_data = user_data;
+        priv->storage_watch = g_timeout_add (STORAGE_WATCH_INTERVAL,
+                                             _storage_watch,
+                                             manager);
+    }
+
 error:
     if ((NULL != error) && (NULL == *error)) {
         if ((!result) && (NULL != error_msg)) {
@@ -4243,6 +5455,8 @@ g_digicam_manager_finish_recording_video (GDigicamManager *manager,
         goto error;
     }
 
+    _storage_stop_watch (priv);
+
     result = TRUE;
 
 error:
@@ -4365,6 +5579,11 @@ g_digicam_manager_descriptor_copy (const GDigicamDescriptor *orig_descriptor)
     descriptor->finish_recording_video_func = orig_descriptor->finish_recording_video_func;
     descriptor->handle_bus_message_func = orig_descriptor->handle_bus_message_func;
     descriptor->handle_sync_bus_message_func = orig_descriptor->handle_sync_bus_message_func;
+    descriptor->set_window_geometry_func = orig_descriptor->set_window_geometry_func;
+    descriptor->handle_picture_done_func = orig_descriptor->handle_picture_done_func;
+    descriptor->switch_storage_func = orig_descriptor->switch_storage_func;
+    descriptor->make_room_func = orig_descriptor->make_room_func;
+    descriptor->still_picture_busy_func = orig_descriptor->still_picture_busy_func;
 
     return descriptor;
 }
@@ -4396,6 +5615,88 @@ _g_digicam_manager_release_capture_lock (GDigicamManager *manager)
     g_mutex_unlock (priv->capture_lock);
 }
 
+#if G_DIGICAM_HAVE_GDKPIXBUF
+/*
+ * Hands out a @width x @height preview pixbuf, recycling one released
+ * by the previous previews when possible, so burst captures don't
+ * allocate a new one for every shot. A released one of another size
+ * is resized over its own pixels, which only grow. The caller owns
+ * the returned reference.
+ */
+GdkPixbuf *
+_g_digicam_manager_get_preview_surface (GDigicamManager *manager,
+                                        gboolean has_alpha,
+                                        gint width,
+                                        gint height)
+{
+    GDigicamManagerPrivate *priv = NULL;
+    PreviewSurface *surface = NULL;
+    PreviewSurface *spare = NULL;
+    GdkPixbuf *pixbuf = NULL;
+    guint i;
+
+    g_assert (G_DIGICAM_IS_MANAGER (manager));
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    g_mutex_lock (priv->preview_pool_lock);
+
+    /* A released surface of the same size, or another released one
+     * to resize */
+    for (i = 0; i < priv->preview_pool->len; i++) {
+        surface = g_ptr_array_index (priv->preview_pool, i);
+        if (!g_atomic_int_compare_and_exchange (&surface->busy,
+                                                FALSE, TRUE)) {
+            continue;
+        }
+
+        if ((NULL != surface->pixbuf) &&
+            (gdk_pixbuf_get_has_alpha (surface->pixbuf) == has_alpha) &&
+            (gdk_pixbuf_get_width (surface->pixbuf) == width) &&
+            (gdk_pixbuf_get_height (surface->pixbuf) == height)) {
+            if (NULL != spare) {
+                g_atomic_int_set (&spare->busy, FALSE);
+            }
+            pixbuf = g_object_ref (surface->pixbuf);
+            goto unlock;
+        }
+
+        if (NULL == spare) {
+            spare = surface;
+        } else {
+            g_atomic_int_set (&surface->busy, FALSE);
+        }
+    }
+
+    if (NULL == spare) {
+        if (PREVIEW_POOL_SIZE <= priv->preview_pool->len) {
+            G_DIGICAM_DEBUG ("GDigicamManager: All the preview surfaces "
+                             "are in use.");
+            goto unlock;
+        }
+        spare = g_slice_new0 (PreviewSurface);
+        spare->busy = TRUE;
+        g_ptr_array_add (priv->preview_pool, spare);
+    }
+
+    if (_preview_surface_set_pixbuf (spare, has_alpha, width, height)) {
+        pixbuf = spare->pixbuf;
+    } else {
+        g_atomic_int_set (&spare->busy, FALSE);
+    }
+
+unlock:
+    g_mutex_unlock (priv->preview_pool_lock);
+
+    /* Pool exhausted, the preview is still delivered */
+    if (NULL == pixbuf) {
+        pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, has_alpha, 8,
+                                 width, height);
+    }
+
+    return pixbuf;
+}
+#endif
+
 gboolean
 _g_digicam_manager_is_valid_flag (GDigicamManager *manager,
                                   guint32 flag,
@@ -4471,7 +5772,8 @@ _g_digicam_manager_class_init (GDigicamManagerClass *klass)
     /**
      * GDigicamManager::pict-done:
      * @manager: the gdigicam manager
-     * @filename: the name of the file just saved
+     * @filename: the name of the file just saved, or %NULL if the
+     * picture was only captured to memory
      *
      * Signal emited when the picture has just been taken. To continue taking
      * pictures just update @filename and return TRUE, otherwise return FALSE.
@@ -4518,11 +5820,17 @@ _g_digicam_manager_class_init (GDigicamManagerClass *klass)
                       g_cclosure_marshal_VOID__VOID,
                       G_TYPE_NONE, 0);
 
+#if G_DIGICAM_HAVE_GDKPIXBUF
     /**
      * GDigicamManager::image-preview:
      * @manager: the gdigicam manager
      *
-     * Signal emited when the image preview is generated.
+     * Signal emited when the image preview is generated. The pixbuf
+     * is reused for later previews once all the references to it
+     * have been released. Previews at the viewfinder size are only
+     * produced while this signal has handlers, otherwise just the
+     * sizes needed by #GDigicamManager::image-preview-set and the
+     * thumbnails are.
      */
 
     manager_signals[PREVIEW_SIGNAL] =
@@ -4534,6 +5842,85 @@ _g_digicam_manager_class_init (GDigicamManagerClass *klass)
                       g_cclosure_marshal_VOID__OBJECT,
                       G_TYPE_NONE, 1, GDK_TYPE_PIXBUF);
 
+    /**
+     * GDigicamManager::image-preview-set:
+     * @manager: the gdigicam manager
+     * @previews: a #GPtrArray with a #GdkPixbuf for each size set with
+     * g_digicam_manager_set_preview_sizes(), in the same order. It
+     * belongs to the emitter, which reuses it for the next shots, so
+     * the handlers have to reference the pixbufs they want to keep.
+     *
+     * Signal emited right after #GDigicamManager::image-preview when
+     * additional preview sizes have been requested.
+     */
+
+    manager_signals[PREVIEW_SET_SIGNAL] =
+        g_signal_new ("image-preview-set",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (GDigicamManagerClass, image_preview_set),
+                      NULL, NULL,
+                      g_cclosure_marshal_VOID__POINTER,
+                      G_TYPE_NONE, 1, G_TYPE_POINTER);
+#endif
+
+    /**
+     * GDigicamManager::preview-buffer:
+     * @manager: the gdigicam manager
+     * @buffer: the #GstBuffer with the preview pixels. It belongs to
+     * the emitter, handlers have to reference it to keep it.
+     * @fourcc: the pixel format, as a fourcc: UYVY, I420 or NV12, or
+     * "RGB " for packed 24 bits RGB.
+     * @width: the width of the preview.
+     * @height: the height of the preview.
+     * @stride: the row stride of the first plane of @buffer.
+     *
+     * Signal emited when the image preview is generated, before
+     * #GDigicamManager::image-preview. It hands the preview pixels
+     * as camerabin produced them, without copying nor converting
+     * them, and is available even without GdkPixbuf support.
+     */
+
+    manager_signals[PREVIEW_BUFFER_SIGNAL] =
+        g_signal_new ("preview-buffer",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (GDigicamManagerClass, preview_buffer),
+                      NULL, NULL,
+                      gdigicam_marshal_VOID__POINTER_UINT_INT_INT_INT,
+                      G_TYPE_NONE, 5,
+                      G_TYPE_POINTER,
+                      G_TYPE_UINT,
+                      G_TYPE_INT,
+                      G_TYPE_INT,
+                      G_TYPE_INT);
+
+    /**
+     * GDigicamManager::picture-buffer:
+     * @manager: the gdigicam manager
+     * @buffer: the #GstBuffer with the encoded picture. It belongs to
+     * the emitter, handlers have to reference it to keep it.
+     * @filename: the file the picture is saved to as well, or %NULL
+     * if it is only captured to memory.
+     *
+     * Signal emited when a picture captured to memory is encoded,
+     * with the same data as the file, if any, so it doesn't have to
+     * be read back. The backend decides which pictures are captured
+     * to memory. It is emitted from the main loop, before the
+     * #GDigicamManager::pict-done of that picture.
+     */
+
+    manager_signals[PICTURE_BUFFER_SIGNAL] =
+        g_signal_new ("picture-buffer",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (GDigicamManagerClass, picture_buffer),
+                      NULL, NULL,
+                      gdigicam_marshal_VOID__POINTER_STRING,
+                      G_TYPE_NONE, 2,
+                      G_TYPE_POINTER,
+                      G_TYPE_STRING);
+
     /**
      * GDigicamManager::picture-got:
      * @manager: the gdigicam manager
@@ -4598,6 +5985,25 @@ _g_digicam_manager_class_init (GDigicamManagerClass *klass)
                       NULL, NULL,
                       g_cclosure_marshal_VOID__VOID,
                       G_TYPE_NONE, 0);
+
+    /**
+     * GDigicamManager::storage-changed:
+     * @manager: the gdigicam manager
+     * @directory: the directory of the new storage target
+     *
+     * Signal emited when the captures start going to another of the
+     * storage targets, because the previous one is full or it has
+     * room again.
+     */
+
+    manager_signals[STORAGE_CHANGED_SIGNAL] =
+        g_signal_new ("storage-changed",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (GDigicamManagerClass, storage_changed),
+                      NULL, NULL,
+                      g_cclosure_marshal_VOID__STRING,
+                      G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 static void
@@ -4614,6 +6020,8 @@ _g_digicam_manager_init (GDigicamManager *manager)
     priv->gst_bin = NULL;
     priv->gst_pipeline = NULL;
     priv->xwindow_id = 0;
+    priv->window_width = 0;
+    priv->window_height = 0;
     priv->descriptor = NULL;
     priv->mode = G_DIGICAM_MODE_NONE;
     priv->flash_mode = G_DIGICAM_FLASHMODE_NONE;
@@ -4638,7 +6046,22 @@ _g_digicam_manager_init (GDigicamManager *manager)
     priv->digital_zoom = FALSE;
     priv->audio = G_DIGICAM_AUDIO_NONE;
     priv->preview_mode = G_DIGICAM_PREVIEW_NONE;
+    priv->preview_sizes = NULL;
+    priv->preview_sizes_lock = g_mutex_new ();
+    priv->thumbnail_mode = G_DIGICAM_THUMBNAIL_NONE;
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    priv->preview_pool = g_ptr_array_sized_new (PREVIEW_POOL_SIZE);
+    priv->preview_pool_lock = g_mutex_new ();
+#endif
     priv->capture_lock = g_mutex_new ();
+    priv->storages = NULL;
+    priv->storage = NULL;
+    priv->shot_storages = g_queue_new ();
+    priv->storage_watch = 0;
+    priv->recording_data = NULL;
+    priv->photo_naming = NULL;
+    priv->video_naming = NULL;
+    priv->naming_lock = g_mutex_new ();
 }
 
 static void
@@ -4658,7 +6081,35 @@ _g_digicam_manager_finalize (GObject *object)
         priv->capture_lock = NULL;
     }
 
+    _storage_stop_watch (priv);
+    _storage_clear (priv);
+    g_queue_free (priv->shot_storages);
+    priv->shot_storages = NULL;
+
+    _g_digicam_naming_free (priv->photo_naming);
+    priv->photo_naming = NULL;
+    _g_digicam_naming_free (priv->video_naming);
+    priv->video_naming = NULL;
+    g_mutex_free (priv->naming_lock);
+    priv->naming_lock = NULL;
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    /* Surfaces still in use are freed by their last holder */
+    if (NULL != priv->preview_pool) {
+        g_ptr_array_foreach (priv->preview_pool,
+                             (GFunc) _preview_surface_free, NULL);
+        g_ptr_array_free (priv->preview_pool, TRUE);
+        priv->preview_pool = NULL;
+    }
+    if (priv->preview_pool_lock) {
+        g_mutex_free (priv->preview_pool_lock);
+        priv->preview_pool_lock = NULL;
+    }
+#endif
+
     _g_digicam_manager_free_private (priv);
+    g_mutex_free (priv->preview_sizes_lock);
+    priv->preview_sizes_lock = NULL;
 
     super->finalize (object);
 }
@@ -4795,6 +6246,21 @@ _g_digicam_manager_bus_callback (GstBus     *bus,
 
         /* Trying to recover from an internal error. */
         _internal_error_recovering (self);
+        _storage_stop_watch (priv);
+
+        /* The pictures which failed are not going to be done. Just
+         * the oldest one when it was saved outside the bin, all of
+         * them when the bin went down */
+        _storage_cancel_shots (priv, G_FILE_ERROR != err->domain);
+
+        /* Files saved outside the bin report their own errors */
+        if ((G_FILE_ERROR == err->domain) &&
+            (G_FILE_ERROR_NOSPC == err->code)) {
+            g_signal_emit (G_OBJECT (data),
+                           manager_signals [NO_SPACE_ERROR_SIGNAL],
+                           0);
+            break;
+        }
 
         /* Analyzing the kind of error. */
         switch (err->code) {
@@ -4895,6 +6361,12 @@ _g_digicam_manager_cleanup_bin (GDigicamManagerPrivate *priv)
     }
 
     if (NULL != priv->gst_bin) {
+        /* The bin may outlive us, e.g. back in a pool of prebuilt
+         * elements */
+        g_signal_handlers_disconnect_matched (priv->gst_bin,
+                                              G_SIGNAL_MATCH_FUNC,
+                                              0, 0, NULL,
+                                              _picture_done, NULL);
         gst_object_unref (GST_OBJECT (priv->gst_bin));
         priv->gst_bin = NULL;
     }
@@ -4939,6 +6411,8 @@ _g_digicam_manager_free_private (GDigicamManagerPrivate *priv)
     _g_digicam_manager_cleanup_sink (priv, NULL);
     _g_digicam_manager_cleanup_bin (priv);
 
+    priv->window_width = 0;
+    priv->window_height = 0;
     priv->mode = G_DIGICAM_MODE_NONE;
     priv->flash_mode = G_DIGICAM_FLASHMODE_NONE;
     priv->is_flash_ready = FALSE;
@@ -4962,7 +6436,118 @@ _g_digicam_manager_free_private (GDigicamManagerPrivate *priv)
     priv->digital_zoom = FALSE;
     priv->audio = G_DIGICAM_AUDIO_NONE;
     priv->preview_mode = G_DIGICAM_PREVIEW_NONE;
+    g_mutex_lock (priv->preview_sizes_lock);
+    if (NULL != priv->preview_sizes) {
+        g_array_free (priv->preview_sizes, TRUE);
+        priv->preview_sizes = NULL;
+    }
+    g_mutex_unlock (priv->preview_sizes_lock);
+    priv->thumbnail_mode = G_DIGICAM_THUMBNAIL_NONE;
+}
+
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+static void
+_preview_surface_toggle_notify (gpointer data,
+                                GObject *object,
+                                gboolean is_last_ref)
+{
+    PreviewSurface *surface = NULL;
+
+    surface = (PreviewSurface *) data;
+
+    /* Only the pool references it, it can be handed out again */
+    if (is_last_ref) {
+        g_atomic_int_set (&surface->busy, FALSE);
+    }
+}
+
+
+static gboolean
+_preview_surface_set_pixbuf (PreviewSurface *surface,
+                             gboolean has_alpha,
+                             gint width,
+                             gint height)
+{
+    GdkPixbuf *pixbuf = NULL;
+    gint rowstride;
+    gsize size;
+
+    /* Only the pool holds the previous one, this finalizes it */
+    if (NULL != surface->pixbuf) {
+        g_object_remove_toggle_ref (G_OBJECT (surface->pixbuf),
+                                    _preview_surface_toggle_notify,
+                                    surface);
+        surface->pixbuf = NULL;
+    }
+
+    /* Same layout as gdk_pixbuf_new() */
+    rowstride = (width * (has_alpha ? 4 : 3) + 3) & ~3;
+    size = (gsize) rowstride * height;
+    if (size > surface->size) {
+        g_free (surface->pixels);
+        surface->size = 0;
+        surface->pixels = g_try_malloc (size);
+        if (NULL == surface->pixels) {
+            return FALSE;
+        }
+        surface->size = size;
+    }
+
+    pixbuf = gdk_pixbuf_new_from_data (surface->pixels,
+                                       GDK_COLORSPACE_RGB, has_alpha, 8,
+                                       width, height, rowstride,
+                                       _preview_surface_release_pixels,
+                                       surface);
+    if (NULL == pixbuf) {
+        return FALSE;
+    }
+
+    /* The pool takes the toggle reference, the one of the creation
+     * goes to the caller */
+    g_object_add_toggle_ref (G_OBJECT (pixbuf),
+                             _preview_surface_toggle_notify,
+                             surface);
+    surface->pixbuf = pixbuf;
+
+    return TRUE;
+}
+
+
+static void
+_preview_surface_free (PreviewSurface *surface)
+{
+    if (NULL == surface->pixbuf) {
+        g_free (surface->pixels);
+        g_slice_free (PreviewSurface, surface);
+        return;
+    }
+
+    /* The pixbuf frees the surface with its pixels once it is
+     * released, now if only the pool holds it */
+    g_atomic_int_set (&surface->orphaned, TRUE);
+    g_object_remove_toggle_ref (G_OBJECT (surface->pixbuf),
+                                _preview_surface_toggle_notify,
+                                surface);
+}
+
+
+static void
+_preview_surface_release_pixels (guchar *pixels,
+                                 gpointer data)
+{
+    PreviewSurface *surface = NULL;
+
+    surface = (PreviewSurface *) data;
+
+    /* Kept for the next pixbuf of the surface, unless the pool is
+     * gone */
+    if (g_atomic_int_get (&surface->orphaned)) {
+        g_free (pixels);
+        g_slice_free (PreviewSurface, surface);
+    }
 }
+#endif
 
 
 static gboolean
@@ -4972,6 +6557,8 @@ _picture_done (GObject *gst_element,
 {
     gboolean result;
     GDigicamManagerPrivate *priv = NULL;
+    GDigicamStorage *storage = NULL;
+    struct stat buf;
 
     priv = G_DIGICAM_MANAGER_GET_PRIVATE (user_data);
 
@@ -4979,6 +6566,23 @@ _picture_done (GObject *gst_element,
        the autofocus lock to allow a new one for the next picture */
     priv->locks = 0;
 
+    /* Learn how big the pictures are, in the target they went to */
+    storage = g_queue_pop_head (priv->shot_storages);
+    if (NULL != storage) {
+        if ((NULL != filename) && (0 == g_stat (filename, &buf))) {
+            _g_digicam_storage_shot_done (storage, buf.st_size);
+        } else {
+            _g_digicam_storage_shot_done (storage, 0);
+        }
+    }
+
+    /* Let the descriptor post-process the saved file */
+    if ((NULL != priv->descriptor) &&
+        (NULL != priv->descriptor->handle_picture_done_func)) {
+        priv->descriptor->handle_picture_done_func (G_DIGICAM_MANAGER (user_data),
+                                                    (gpointer) filename);
+    }
+
     g_signal_emit (G_OBJECT (user_data), manager_signals [PICT_DONE_SIGNAL], 0,
 		   filename, &result);
 
@@ -4986,6 +6590,251 @@ _picture_done (GObject *gst_element,
 }
 
 
+static guint32
+_storage_key (GDigicamManagerPrivate *priv)
+{
+    /* Every one of them fits in a byte */
+    return (priv->aspect_ratio << 16) | (priv->resolution << 8) |
+        priv->quality;
+}
+
+
+static gboolean
+_storage_watch (gpointer user_data)
+{
+    GDigicamManager *manager = NULL;
+    GDigicamManagerPrivate *priv = NULL;
+    GDigicamStorage *next = NULL;
+    const gchar *directory = NULL;
+    guint seconds;
+
+    manager = G_DIGICAM_MANAGER (user_data);
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    if (NULL == priv->storage) {
+        priv->storage_watch = 0;
+        return FALSE;
+    }
+
+    _g_digicam_storage_recording_update (priv->storage);
+    seconds = _g_digicam_storage_get_remaining_seconds (priv->storage,
+                                                        _storage_key (priv));
+    if (STORAGE_STOP_SECONDS < seconds) {
+        return TRUE;
+    }
+
+    /* A rolling recording goes on, deleting its oldest parts */
+    directory = _g_digicam_storage_get_directory (priv->storage);
+    if ((NULL != priv->descriptor) &&
+        (NULL != priv->descriptor->make_room_func) &&
+        priv->descriptor->make_room_func (manager, (gpointer) directory)) {
+        G_DIGICAM_DEBUG ("GDigicamManager::_storage_watch: "
+                         "only %u seconds left, the recording makes room "
+                         "in %s", seconds, directory);
+        return TRUE;
+    }
+    directory = NULL;
+
+    /* Move the next segments to another target, if the bin can */
+    next = _storage_select (priv, G_DIGICAM_MODE_VIDEO, priv->storage);
+    if (NULL != next) {
+        directory = _g_digicam_storage_get_directory (next);
+    }
+    if ((NULL != directory) &&
+        (NULL != priv->descriptor) &&
+        (NULL != priv->descriptor->switch_storage_func) &&
+        priv->descriptor->switch_storage_func (manager,
+                                               (gpointer) directory)) {
+        G_DIGICAM_DEBUG ("GDigicamManager::_storage_watch: "
+                         "only %u seconds left, recording in %s",
+                         seconds, directory);
+
+        _g_digicam_storage_recording_stopped (priv->storage);
+        _storage_set_current (manager, next);
+        _g_digicam_storage_recording_started (priv->storage,
+                                              _storage_key (priv));
+        return TRUE;
+    }
+
+    G_DIGICAM_DEBUG ("GDigicamManager::_storage_watch: "
+                     "only %u seconds left, finishing the recording",
+                     seconds);
+
+    /* This source is gone once we return */
+    priv->storage_watch = 0;
+    _g_digicam_storage_recording_stopped (priv->storage);
+
+    g_digicam_manager_finish_recording_video (manager, NULL,
+                                              priv->recording_data);
+    g_signal_emit (G_OBJECT (manager),
+                   manager_signals [NO_SPACE_ERROR_SIGNAL],
+                   0);
+
+    return FALSE;
+}
+
+
+static void
+_storage_stop_watch (GDigicamManagerPrivate *priv)
+{
+    if (0 != priv->storage_watch) {
+        g_source_remove (priv->storage_watch);
+        priv->storage_watch = 0;
+    }
+    if (NULL != priv->storage) {
+        _g_digicam_storage_recording_stopped (priv->storage);
+    }
+    priv->recording_data = NULL;
+}
+
+
+static GDigicamStorage *
+_storage_select (GDigicamManagerPrivate *priv,
+                 GDigicamMode mode,
+                 GDigicamStorage *skip)
+{
+    GDigicamStorage *storage = NULL;
+    GList *item = NULL;
+    gboolean read = FALSE;
+
+    /* The first target, in the order they were given, with room */
+    for (item = priv->storages; NULL != item; item = g_list_next (item)) {
+        storage = item->data;
+        if ((skip == storage) ||
+            !_g_digicam_storage_refresh (storage, NULL)) {
+            continue;
+        }
+        read = TRUE;
+
+        if (G_DIGICAM_MODE_VIDEO == mode) {
+            if (STORAGE_MIN_SECONDS <=
+                _g_digicam_storage_get_remaining_seconds (storage,
+                                                          _storage_key (priv))) {
+                return storage;
+            }
+        } else if (0 < _g_digicam_storage_get_remaining_shots (storage,
+                                                               _storage_key (priv))) {
+            return storage;
+        }
+    }
+
+    /* Nothing can be known, so the bin will tell */
+    if ((!read) && (NULL == skip)) {
+        return priv->storage;
+    }
+
+    return NULL;
+}
+
+
+static void
+_storage_set_current (GDigicamManager *manager,
+                      GDigicamStorage *storage)
+{
+    GDigicamManagerPrivate *priv = NULL;
+
+    priv = G_DIGICAM_MANAGER_GET_PRIVATE (manager);
+
+    if (storage == priv->storage) {
+        return;
+    }
+
+    if (NULL != priv->storage) {
+        _naming_follow_storage (priv, &priv->photo_naming,
+                                _g_digicam_storage_get_directory (priv->storage),
+                                _g_digicam_storage_get_directory (storage));
+        _naming_follow_storage (priv, &priv->video_naming,
+                                _g_digicam_storage_get_directory (priv->storage),
+                                _g_digicam_storage_get_directory (storage));
+    }
+
+    priv->storage = storage;
+    g_signal_emit (G_OBJECT (manager),
+                   manager_signals [STORAGE_CHANGED_SIGNAL],
+                   0,
+                   _g_digicam_storage_get_directory (storage));
+}
+
+
+static void
+_naming_follow_storage (GDigicamManagerPrivate *priv,
+                        GDigicamNaming **naming,
+                        const gchar *from,
+                        const gchar *to)
+{
+    GDigicamNaming *moved = NULL;
+    GError *error = NULL;
+    gchar *pattern = NULL;
+
+    g_mutex_lock (priv->naming_lock);
+    if ((NULL != *naming) &&
+        (0 == g_strcmp0 (_g_digicam_naming_get_directory (*naming), from))) {
+        pattern = g_strdup (_g_digicam_naming_get_pattern (*naming));
+    }
+    g_mutex_unlock (priv->naming_lock);
+
+    if (NULL == pattern) {
+        return;
+    }
+
+    /* Scanning the new directory can take a while, so names can
+     * still be reserved meanwhile in the old one */
+    moved = _g_digicam_naming_new (to, pattern, &error);
+    if (NULL == moved) {
+        G_DIGICAM_WARN ("GDigicamManager: names are still reserved in "
+                        "%s: %s", from, error->message);
+        g_error_free (error);
+        goto free;
+    }
+
+    /* Unless the naming has been set again meanwhile */
+    g_mutex_lock (priv->naming_lock);
+    if ((NULL != *naming) &&
+        (0 == g_strcmp0 (_g_digicam_naming_get_directory (*naming), from)) &&
+        (0 == g_strcmp0 (_g_digicam_naming_get_pattern (*naming), pattern))) {
+        _g_digicam_naming_free (*naming);
+        *naming = moved;
+        moved = NULL;
+    }
+    g_mutex_unlock (priv->naming_lock);
+
+free:
+    _g_digicam_naming_free (moved);
+    g_free (pattern);
+}
+
+
+static void
+_storage_clear (GDigicamManagerPrivate *priv)
+{
+    /* Pictures still being saved are not accounted any more */
+    while (!g_queue_is_empty (priv->shot_storages)) {
+        g_queue_pop_head (priv->shot_storages);
+    }
+
+    g_list_foreach (priv->storages, (GFunc) _g_digicam_storage_free, NULL);
+    g_list_free (priv->storages);
+    priv->storages = NULL;
+    priv->storage = NULL;
+}
+
+
+static void
+_storage_cancel_shots (GDigicamManagerPrivate *priv,
+                       gboolean all)
+{
+    GDigicamStorage *storage = NULL;
+
+    while (!g_queue_is_empty (priv->shot_storages)) {
+        storage = g_queue_pop_head (priv->shot_storages);
+        _g_digicam_storage_shot_cancelled (storage);
+        if (!all) {
+            break;
+        }
+    }
+}
+
+
 static void
 _internal_error_recovering (GDigicamManager *self)
 {
@@ -26,7 +26,12 @@
 
 #include <glib-object.h>
 #include <gst/gst.h>
+
+#include "gdigicam-version.h"
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -830,6 +835,39 @@ extern "C" {
         G_DIGICAM_PREVIEW_N         = (1 << 1)+1
     } GDigicamPreview;
 
+    /**
+     * GDigicamPreviewSize:
+     * @width: Maximum width of the preview.
+     * @height: Maximum height of the preview.
+     *
+     * Bounding box of an additional preview, which keeps the aspect
+     * ratio of the captured picture.
+     */
+    typedef struct {
+        guint width;
+        guint height;
+    } GDigicamPreviewSize;
+
+    /**
+     * GDigicamThumbnail:
+     * @G_DIGICAM_THUMBNAIL_NONE: No thumbnails are written.
+     * @G_DIGICAM_THUMBNAIL_NORMAL: Write the 128x128 "normal"
+     * thumbnail.
+     * @G_DIGICAM_THUMBNAIL_LARGE: Write the 256x256 "large"
+     * thumbnail.
+     * @G_DIGICAM_THUMBNAIL_N: Ceiling and number of thumbnail flags.
+     *
+     * Freedesktop.org thumbnails written for every still picture.
+     */
+    typedef enum {
+        G_DIGICAM_THUMBNAIL_NONE    = 0,
+
+        G_DIGICAM_THUMBNAIL_NORMAL  = 1 << 0,
+        G_DIGICAM_THUMBNAIL_LARGE   = 1 << 1,
+
+        G_DIGICAM_THUMBNAIL_N       = 1 << 2
+    } GDigicamThumbnail;
+
     /**
      * GDigicamDescriptor:
      * @name: The name of the digicam like #GstElement it owns to.
@@ -931,6 +969,24 @@ extern "C" {
      * handle the bus messages emitted by the bin
      * @handle_syncbus_message: custom #GDigicamManagerFunc to
      * handle the sync bus messages emitted by the bin
+     * @set_window_geometry_func: custom #GDigicamManagerFunc like
+     * function to adapt the viewfinder of the digicam like
+     * #GstElement to the size of the window it is shown in.
+     * @handle_picture_done_func: custom #GDigicamManagerFunc called
+     * with the file name each time a still picture has been saved,
+     * right before #GDigicamManager::pict-done is emitted.
+     * @switch_storage_func: custom #GDigicamManagerFunc called with
+     * the directory of the next storage target when the one the
+     * recording goes to is full. It returns %TRUE if the recording
+     * goes on in that directory, like a recording split in segments.
+     * @make_room_func: custom #GDigicamManagerFunc called with the
+     * directory of the storage target the recording goes to when it is
+     * full. It returns %TRUE if the recording frees space in it itself,
+     * like a recording split in segments which deletes the oldest ones.
+     * @still_picture_busy_func: custom #GDigicamManagerFunc called
+     * before a still picture is captured. It returns %TRUE if the
+     * digicam like #GstElement can't take another one yet, like when
+     * its encoders are behind.
      *
      * The #GDigicamDescriptor structure contains the capabilities of
      * the camera.
@@ -984,6 +1040,11 @@ extern "C" {
         GDigicamManagerFunc finish_recording_video_func;
         GDigicamManagerFunc handle_bus_message_func;
         GDigicamManagerFunc handle_sync_bus_message_func;
+        GDigicamManagerFunc set_window_geometry_func;
+        GDigicamManagerFunc handle_picture_done_func;
+        GDigicamManagerFunc switch_storage_func;
+        GDigicamManagerFunc make_room_func;
+        GDigicamManagerFunc still_picture_busy_func;
 /*         gdouble min_focus_distance_macro_disabled; */
 /*         gdouble min_focus_distance_macro_enabled; */
 /*         guint min_gamma; */
@@ -1064,13 +1125,34 @@ extern "C" {
 
 	void (*picture_got) (GDigicamManager *manager);
 
+#if G_DIGICAM_HAVE_GDKPIXBUF
 	void (*image_preview) (GDigicamManager *manager, GdkPixbuf *value);
+#else
+	void (*image_preview) (GDigicamManager *manager, gpointer value);
+#endif
 
 	void (*internal_error) (GDigicamManager *manager);
 
 	void (*io_error) (GDigicamManager *manager);
 
 	void (*no_space_error) (GDigicamManager *manager);
+
+	void (*image_preview_set) (GDigicamManager *manager,
+                                   GPtrArray *previews);
+
+	void (*preview_buffer) (GDigicamManager *manager,
+                                GstBuffer *buffer,
+                                guint32 fourcc,
+                                gint width,
+                                gint height,
+                                gint stride);
+
+	void (*picture_buffer) (GDigicamManager *manager,
+                                GstBuffer *buffer,
+                                const gchar *filename);
+
+	void (*storage_changed) (GDigicamManager *manager,
+                                 const gchar *directory);
     };
 
 
@@ -1266,6 +1348,49 @@ extern "C" {
     gboolean g_digicam_manager_get_preview_mode (GDigicamManager  *manager,
                                                  GDigicamPreview  *mode,
                                                  GError          **error);
+    gboolean g_digicam_manager_set_preview_sizes (GDigicamManager           *manager,
+                                                  const GDigicamPreviewSize *sizes,
+                                                  guint                      n_sizes,
+                                                  GError                   **error);
+    gboolean g_digicam_manager_get_preview_sizes (GDigicamManager      *manager,
+                                                  GDigicamPreviewSize **sizes,
+                                                  guint                *n_sizes,
+                                                  GError              **error);
+    gboolean g_digicam_manager_set_thumbnail_mode (GDigicamManager   *manager,
+                                                   GDigicamThumbnail  mode,
+                                                   GError           **error);
+    gboolean g_digicam_manager_get_thumbnail_mode (GDigicamManager   *manager,
+                                                   GDigicamThumbnail *mode,
+                                                   GError           **error);
+    gboolean g_digicam_manager_set_storage (GDigicamManager  *manager,
+                                            const gchar      *directory,
+                                            guint64           reserved,
+                                            GError          **error);
+    gboolean g_digicam_manager_add_storage (GDigicamManager  *manager,
+                                            const gchar      *directory,
+                                            guint64           reserved,
+                                            GError          **error);
+    gboolean g_digicam_manager_get_storage (GDigicamManager  *manager,
+                                            gchar           **directory,
+                                            GError          **error);
+    gboolean g_digicam_manager_select_storage (GDigicamManager  *manager,
+                                               gchar           **directory,
+                                               GError          **error);
+    gboolean g_digicam_manager_get_remaining_shots (GDigicamManager  *manager,
+                                                    guint            *shots,
+                                                    GError          **error);
+    gboolean g_digicam_manager_get_remaining_seconds (GDigicamManager  *manager,
+                                                      guint            *seconds,
+                                                      GError          **error);
+    gboolean g_digicam_manager_set_naming (GDigicamManager  *manager,
+                                           GDigicamMode      mode,
+                                           const gchar      *directory,
+                                           const gchar      *pattern,
+                                           GError          **error);
+    gboolean g_digicam_manager_reserve_filename (GDigicamManager  *manager,
+                                                 GDigicamMode      mode,
+                                                 gchar           **filename,
+                                                 GError          **error);
     gboolean g_digicam_manager_preview_enabled (GDigicamManager  *manager,
                                                 gboolean         *enabled,
                                                 GError          **error);
@@ -1284,6 +1409,15 @@ extern "C" {
     gboolean g_digicam_manager_get_xwindow_id (GDigicamManager *manager,
                                                gulong          *xwindow_id,
                                                GError         **error);
+    gboolean g_digicam_manager_set_window_geometry (GDigicamManager *manager,
+                                                    guint            width,
+                                                    guint            height,
+                                                    GError         **error,
+                                                    gpointer         user_data);
+    gboolean g_digicam_manager_get_window_geometry (GDigicamManager *manager,
+                                                    guint           *width,
+                                                    guint           *height,
+                                                    GError         **error);
     gboolean g_digicam_manager_capture_still_picture (GDigicamManager *manager,
                                                       const gchar     *filename,
                                                       GError          **error,
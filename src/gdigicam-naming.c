@@ -0,0 +1,423 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+
+
+/*
+ * Counter based names for the captures.
+ *
+ * Names come from a pattern with a run of '#' characters, replaced by
+ * a counter with as many digits, like "IMG_####.jpg". The counter of
+ * each pattern is kept in a hidden file of the directory, so it is
+ * never scanned but the first time, when the numbers already used are
+ * looked for. The file is not written for every name: a lease of
+ * numbers is taken at once, and the exact counter is saved when
+ * done. A name is reserved by creating its file exclusively, so it
+ * can't be taken twice, whoever else writes to the directory.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include "gdigicam-naming.h"
+#include "gdigicam-debug.h"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+#define NAMING_MAX_DIGITS 9
+
+struct _GDigicamNaming {
+    gchar *directory;
+    gchar *pattern;
+    gchar *prefix;
+    gchar *suffix;
+    guint digits;
+    guint32 max;
+    gchar *counter_file;
+    GMutex *lock;
+
+    /* Next number to try, and first one not leased yet */
+    guint32 next;
+    guint32 leased;
+};
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static gboolean _naming_parse_pattern (GDigicamNaming  *naming,
+                                       const gchar     *pattern,
+                                       GError         **error);
+static guint32 _naming_scan (GDigicamNaming *naming);
+static gboolean _naming_save (GDigicamNaming  *naming,
+                              guint32          counter,
+                              GError         **error);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_naming_new:
+ * @directory: Directory where the captures are saved.
+ * @pattern: Name of the captures, with a run of '#' characters
+ * replaced by the counter.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Creates a name generator for the captures saved in @directory,
+ * going on from its saved counter, or after the names already used
+ * the first time.
+ *
+ * Returns: the new #GDigicamNaming, or %NULL if @pattern is not
+ * valid or @directory can't be read.
+ **/
+GDigicamNaming *
+_g_digicam_naming_new (const gchar  *directory,
+                       const gchar  *pattern,
+                       GError      **error)
+{
+    GDigicamNaming *naming = NULL;
+    gchar *basename = NULL;
+    gchar *contents = NULL;
+    gchar *end = NULL;
+    guint64 counter;
+
+    g_return_val_if_fail (NULL != directory, NULL);
+    g_return_val_if_fail (NULL != pattern, NULL);
+
+    if (!g_file_test (directory, G_FILE_TEST_IS_DIR)) {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOTDIR,
+                     "%s is not a directory", directory);
+        return NULL;
+    }
+
+    naming = g_new0 (GDigicamNaming, 1);
+    naming->directory = g_strdup (directory);
+    naming->pattern = g_strdup (pattern);
+    naming->lock = g_mutex_new ();
+
+    if (!_naming_parse_pattern (naming, pattern, error)) {
+        _g_digicam_naming_free (naming);
+        return NULL;
+    }
+
+    basename = g_strdup_printf (".%s.counter", pattern);
+    naming->counter_file = g_build_filename (directory, basename, NULL);
+    g_free (basename);
+
+    /* The counter, or the numbers used before there was one */
+    if (g_file_get_contents (naming->counter_file, &contents, NULL, NULL)) {
+        counter = g_ascii_strtoull (contents, &end, 10);
+        if ((end == contents) || (naming->max + 1 < counter)) {
+            G_DIGICAM_WARN ("GDigicamNaming: ignoring the invalid counter "
+                            "of %s.", naming->counter_file);
+            counter = _naming_scan (naming);
+        }
+        g_free (contents);
+    } else {
+        counter = _naming_scan (naming);
+    }
+
+    naming->next = MAX (counter, 1);
+    naming->leased = naming->next;
+
+    return naming;
+}
+
+
+/**
+ * _g_digicam_naming_free:
+ * @naming: A #GDigicamNaming.
+ *
+ * Saves the exact counter, so no number is skipped, and frees
+ * @naming.
+ **/
+void
+_g_digicam_naming_free (GDigicamNaming *naming)
+{
+    GError *error = NULL;
+
+    if (NULL == naming) {
+        return;
+    }
+
+    if ((naming->next != naming->leased) &&
+        !_naming_save (naming, naming->next, &error)) {
+        G_DIGICAM_WARN ("GDigicamNaming: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_mutex_free (naming->lock);
+    g_free (naming->counter_file);
+    g_free (naming->suffix);
+    g_free (naming->prefix);
+    g_free (naming->pattern);
+    g_free (naming->directory);
+    g_free (naming);
+}
+
+
+/**
+ * _g_digicam_naming_flush:
+ * @naming: A #GDigicamNaming.
+ *
+ * Saves the exact counter, as _g_digicam_naming_free() does, so
+ * another #GDigicamNaming of the same directory and pattern goes on
+ * from it. Reserving another name takes a new lease.
+ **/
+void
+_g_digicam_naming_flush (GDigicamNaming *naming)
+{
+    GError *error = NULL;
+
+    g_return_if_fail (NULL != naming);
+
+    g_mutex_lock (naming->lock);
+    if ((naming->next != naming->leased) &&
+        !_naming_save (naming, naming->next, &error)) {
+        G_DIGICAM_WARN ("GDigicamNaming: %s", error->message);
+        g_error_free (error);
+    }
+    g_mutex_unlock (naming->lock);
+}
+
+
+/**
+ * _g_digicam_naming_get_directory:
+ * @naming: A #GDigicamNaming.
+ *
+ * Gets the directory of the names.
+ *
+ * Returns: the directory, owned by @naming.
+ **/
+const gchar *
+_g_digicam_naming_get_directory (GDigicamNaming *naming)
+{
+    g_return_val_if_fail (NULL != naming, NULL);
+
+    return naming->directory;
+}
+
+
+/**
+ * _g_digicam_naming_get_pattern:
+ * @naming: A #GDigicamNaming.
+ *
+ * Gets the pattern of the names.
+ *
+ * Returns: the pattern, owned by @naming.
+ **/
+const gchar *
+_g_digicam_naming_get_pattern (GDigicamNaming *naming)
+{
+    g_return_val_if_fail (NULL != naming, NULL);
+
+    return naming->pattern;
+}
+
+
+/**
+ * _g_digicam_naming_reserve:
+ * @naming: A #GDigicamNaming.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Reserves the next free name, creating an empty file for it. The
+ * names already taken are skipped. It can be called from any thread.
+ *
+ * Returns: the full path of the reserved file, or %NULL if there are
+ * no names left or the file can't be created.
+ **/
+gchar *
+_g_digicam_naming_reserve (GDigicamNaming  *naming,
+                           GError         **error)
+{
+    gchar *basename = NULL;
+    gchar *filename = NULL;
+    gint saved_errno;
+    gint fd;
+
+    g_return_val_if_fail (NULL != naming, NULL);
+
+    g_mutex_lock (naming->lock);
+
+    while (NULL == filename) {
+        if (naming->max < naming->next) {
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_EXIST,
+                         "No names left in %s", naming->directory);
+            break;
+        }
+
+        /* Out of leased numbers, take some more */
+        if ((naming->next == naming->leased) &&
+            !_naming_save (naming,
+                           MIN (naming->next + G_DIGICAM_NAMING_LEASE,
+                                naming->max + 1),
+                           error)) {
+            break;
+        }
+
+        basename = g_strdup_printf ("%s%0*u%s", naming->prefix,
+                                    naming->digits, naming->next,
+                                    naming->suffix);
+        filename = g_build_filename (naming->directory, basename, NULL);
+        g_free (basename);
+        naming->next++;
+
+        fd = g_open (filename, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (0 <= fd) {
+            close (fd);
+            break;
+        }
+
+        saved_errno = errno;
+        if (EEXIST != saved_errno) {
+            g_set_error (error, G_FILE_ERROR,
+                         g_file_error_from_errno (saved_errno),
+                         "Unable to create %s: %s",
+                         filename, g_strerror (saved_errno));
+        }
+        g_free (filename);
+        filename = NULL;
+
+        if (EEXIST != saved_errno) {
+            break;
+        }
+    }
+
+    g_mutex_unlock (naming->lock);
+
+    return filename;
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static gboolean
+_naming_parse_pattern (GDigicamNaming  *naming,
+                       const gchar     *pattern,
+                       GError         **error)
+{
+    const gchar *start = NULL;
+    const gchar *end = NULL;
+    guint i;
+
+    start = strchr (pattern, '#');
+    if (NULL != start) {
+        end = start + strspn (start, "#");
+    }
+
+    if ((NULL == start) || (NULL != strchr (end, '#')) ||
+        (NULL != strchr (pattern, G_DIR_SEPARATOR)) ||
+        (NAMING_MAX_DIGITS < (guint) (end - start))) {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "Invalid pattern %s, it must be a file name with "
+                     "a single run of up to %u '#'", pattern,
+                     NAMING_MAX_DIGITS);
+        return FALSE;
+    }
+
+    naming->prefix = g_strndup (pattern, start - pattern);
+    naming->suffix = g_strdup (end);
+    naming->digits = end - start;
+    naming->max = 9;
+    for (i = 1; i < naming->digits; i++) {
+        naming->max = naming->max * 10 + 9;
+    }
+
+    return TRUE;
+}
+
+
+static guint32
+_naming_scan (GDigicamNaming *naming)
+{
+    GDir *dir = NULL;
+    const gchar *name = NULL;
+    gsize prefix_len, suffix_len, len;
+    guint32 number, last = 0;
+    guint i;
+
+    dir = g_dir_open (naming->directory, 0, NULL);
+    if (NULL == dir) {
+        return 1;
+    }
+
+    prefix_len = strlen (naming->prefix);
+    suffix_len = strlen (naming->suffix);
+
+    while (NULL != (name = g_dir_read_name (dir))) {
+        len = strlen (name);
+        if ((prefix_len + naming->digits + suffix_len != len) ||
+            (0 != strncmp (name, naming->prefix, prefix_len)) ||
+            (0 != strcmp (name + len - suffix_len, naming->suffix))) {
+            continue;
+        }
+
+        number = 0;
+        for (i = 0; i < naming->digits; i++) {
+            if (!g_ascii_isdigit (name[prefix_len + i])) {
+                break;
+            }
+            number = number * 10 + g_ascii_digit_value (name[prefix_len + i]);
+        }
+        if (i == naming->digits) {
+            last = MAX (last, number);
+        }
+    }
+    g_dir_close (dir);
+
+    return last + 1;
+}
+
+
+static gboolean
+_naming_save (GDigicamNaming  *naming,
+              guint32          counter,
+              GError         **error)
+{
+    gchar *contents = NULL;
+    gboolean result;
+
+    /* Written to a temporary file and renamed, it is always whole */
+    contents = g_strdup_printf ("%u\n", counter);
+    result = g_file_set_contents (naming->counter_file, contents, -1, error);
+    g_free (contents);
+
+    if (result) {
+        naming->leased = counter;
+    }
+
+    return result;
+}
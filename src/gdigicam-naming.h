@@ -0,0 +1,63 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+
+#ifndef __G_DIGICAM_NAMING_H__
+#define __G_DIGICAM_NAMING_H__
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    G_BEGIN_DECLS
+
+    /**
+     * G_DIGICAM_NAMING_LEASE:
+     *
+     * Numbers taken from the counter file at once. After a crash, at
+     * most these many numbers are skipped.
+     */
+#define G_DIGICAM_NAMING_LEASE 100
+
+    typedef struct _GDigicamNaming GDigicamNaming;
+
+    GDigicamNaming *_g_digicam_naming_new (const gchar  *directory,
+                                           const gchar  *pattern,
+                                           GError      **error);
+    void _g_digicam_naming_free (GDigicamNaming *naming);
+    void _g_digicam_naming_flush (GDigicamNaming *naming);
+    const gchar *_g_digicam_naming_get_directory (GDigicamNaming *naming);
+    const gchar *_g_digicam_naming_get_pattern (GDigicamNaming *naming);
+    gchar *_g_digicam_naming_reserve (GDigicamNaming  *naming,
+                                      GError         **error);
+
+    G_END_DECLS
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __G_DIGICAM_NAMING_H__ */
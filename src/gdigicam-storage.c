@@ -0,0 +1,538 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Free space tracking of the directory where the pictures and videos
+ * are saved.
+ *
+ * The free space comes from statvfs(), refreshed when a capture is
+ * about to start and periodically while recording. The size of the
+ * pictures and the bitrate of the videos are learned, per capture
+ * settings, from the saved pictures and from how fast the free space
+ * goes down while recording. Both are exponentially weighted moving
+ * averages, so they follow the scenes being shot without jumping on a
+ * single odd sample.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/statvfs.h>
+
+#include "gdigicam-storage.h"
+#include "gdigicam-debug.h"
+
+
+/*****************************************/
+/* Type definitions */
+/*****************************************/
+
+/* Weight of a new sample in the averages */
+#define STORAGE_ALPHA 0.25
+
+/* The size of the pictures depends a lot on the scene, so some
+ * headroom is kept over the average */
+#define STORAGE_SHOT_MARGIN 1.25
+
+struct _GDigicamStorage {
+    gchar *directory;
+    guint64 reserved;
+    GMutex *lock;
+
+    /* From the last statvfs(), without the reserved bytes */
+    guint64 available;
+
+    /* Learned sizes, indexed by capture settings */
+    GHashTable *shot_sizes;
+    GHashTable *rates;
+
+    /* Settings of the pictures captured but not saved yet */
+    GQueue *pending;
+
+    gboolean recording;
+    gboolean recording_sampled;
+    guint32 recording_key;
+    guint64 recording_available;
+    GTimeVal recording_time;
+};
+
+
+/*****************************************/
+/* Private functions */
+/*****************************************/
+
+static gboolean _storage_statvfs (GDigicamStorage  *storage,
+                                  GError          **error);
+static gdouble _storage_model_get (GHashTable *models,
+                                   guint32     key,
+                                   gdouble     initial);
+static void _storage_model_learn (GHashTable *models,
+                                  guint32     key,
+                                  gdouble     sample);
+static guint64 _storage_get_free (GDigicamStorage *storage);
+
+
+/*****************************************/
+/* Public functions */
+/*****************************************/
+
+/**
+ * _g_digicam_storage_new:
+ * @directory: Directory where the captures are saved.
+ * @reserved: Bytes of @directory that captures must never use.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Creates a free space tracker for @directory, with its free space
+ * already read.
+ *
+ * Returns: the new #GDigicamStorage, or %NULL if the free space of
+ * @directory can't be read.
+ **/
+GDigicamStorage *
+_g_digicam_storage_new (const gchar  *directory,
+                        guint64       reserved,
+                        GError      **error)
+{
+    GDigicamStorage *storage = NULL;
+
+    g_return_val_if_fail (NULL != directory, NULL);
+
+    storage = g_new0 (GDigicamStorage, 1);
+    storage->directory = g_strdup (directory);
+    storage->reserved = reserved;
+    storage->lock = g_mutex_new ();
+    storage->shot_sizes = g_hash_table_new_full (g_direct_hash,
+                                                 g_direct_equal,
+                                                 NULL, g_free);
+    storage->rates = g_hash_table_new_full (g_direct_hash,
+                                            g_direct_equal,
+                                            NULL, g_free);
+    storage->pending = g_queue_new ();
+
+    if (!_storage_statvfs (storage, error)) {
+        _g_digicam_storage_free (storage);
+        return NULL;
+    }
+
+    return storage;
+}
+
+
+/**
+ * _g_digicam_storage_free:
+ * @storage: A #GDigicamStorage.
+ *
+ * Frees @storage and everything it has learned.
+ **/
+void
+_g_digicam_storage_free (GDigicamStorage *storage)
+{
+    if (NULL == storage) {
+        return;
+    }
+
+    g_queue_free (storage->pending);
+    g_hash_table_destroy (storage->rates);
+    g_hash_table_destroy (storage->shot_sizes);
+    g_mutex_free (storage->lock);
+    g_free (storage->directory);
+    g_free (storage);
+}
+
+
+/**
+ * _g_digicam_storage_refresh:
+ * @storage: A #GDigicamStorage.
+ * @error: A #GError to store the result of the operation.
+ *
+ * Reads again the free space of the directory.
+ *
+ * Returns: %TRUE if success, %FALSE otherwise.
+ **/
+gboolean
+_g_digicam_storage_refresh (GDigicamStorage  *storage,
+                            GError          **error)
+{
+    gboolean result;
+
+    g_return_val_if_fail (NULL != storage, FALSE);
+
+    g_mutex_lock (storage->lock);
+    result = _storage_statvfs (storage, error);
+    g_mutex_unlock (storage->lock);
+
+    return result;
+}
+
+
+/**
+ * _g_digicam_storage_get_free:
+ * @storage: A #GDigicamStorage.
+ *
+ * Gets the bytes that new captures can use, that is, the free space
+ * read last time without the reserved bytes nor the expected size of
+ * the pictures still being saved.
+ *
+ * Returns: the free bytes.
+ **/
+guint64
+_g_digicam_storage_get_free (GDigicamStorage *storage)
+{
+    guint64 result;
+
+    g_return_val_if_fail (NULL != storage, 0);
+
+    g_mutex_lock (storage->lock);
+    result = _storage_get_free (storage);
+    g_mutex_unlock (storage->lock);
+
+    return result;
+}
+
+
+/**
+ * _g_digicam_storage_get_directory:
+ * @storage: A #GDigicamStorage.
+ *
+ * Gets the directory whose free space is tracked.
+ *
+ * Returns: the directory, owned by @storage.
+ **/
+const gchar *
+_g_digicam_storage_get_directory (GDigicamStorage *storage)
+{
+    g_return_val_if_fail (NULL != storage, NULL);
+
+    return storage->directory;
+}
+
+
+/**
+ * _g_digicam_storage_shot_started:
+ * @storage: A #GDigicamStorage.
+ * @key: The capture settings of the picture.
+ *
+ * Accounts a picture which is going to be saved, until
+ * _g_digicam_storage_shot_done() is called for it.
+ **/
+void
+_g_digicam_storage_shot_started (GDigicamStorage *storage,
+                                 guint32          key)
+{
+    g_return_if_fail (NULL != storage);
+
+    g_mutex_lock (storage->lock);
+    g_queue_push_tail (storage->pending, GUINT_TO_POINTER (key));
+    g_mutex_unlock (storage->lock);
+}
+
+
+/**
+ * _g_digicam_storage_shot_done:
+ * @storage: A #GDigicamStorage.
+ * @size: Size of the saved file, or 0 if it is unknown.
+ *
+ * Finishes the oldest picture accounted with
+ * _g_digicam_storage_shot_started(), learning its size.
+ **/
+void
+_g_digicam_storage_shot_done (GDigicamStorage *storage,
+                              guint64          size)
+{
+    guint32 key;
+
+    g_return_if_fail (NULL != storage);
+
+    g_mutex_lock (storage->lock);
+
+    if (!g_queue_is_empty (storage->pending)) {
+        key = GPOINTER_TO_UINT (g_queue_pop_head (storage->pending));
+
+        if (0 < size) {
+            _storage_model_learn (storage->shot_sizes, key, size);
+
+            /* It is on the disk now, until the next refresh */
+            storage->available -= MIN (storage->available, size);
+        }
+    }
+
+    g_mutex_unlock (storage->lock);
+}
+
+
+/**
+ * _g_digicam_storage_shot_cancelled:
+ * @storage: A #GDigicamStorage.
+ *
+ * Forgets the oldest picture accounted with
+ * _g_digicam_storage_shot_started(), which is never going to be
+ * saved.
+ **/
+void
+_g_digicam_storage_shot_cancelled (GDigicamStorage *storage)
+{
+    g_return_if_fail (NULL != storage);
+
+    g_mutex_lock (storage->lock);
+    if (!g_queue_is_empty (storage->pending)) {
+        g_queue_pop_head (storage->pending);
+    }
+    g_mutex_unlock (storage->lock);
+}
+
+
+/**
+ * _g_digicam_storage_get_remaining_shots:
+ * @storage: A #GDigicamStorage.
+ * @key: The capture settings of the pictures.
+ *
+ * Estimates how many pictures with the @key settings still fit in the
+ * free space.
+ *
+ * Returns: the remaining pictures.
+ **/
+guint
+_g_digicam_storage_get_remaining_shots (GDigicamStorage *storage,
+                                        guint32          key)
+{
+    gdouble size;
+    guint64 free_bytes;
+
+    g_return_val_if_fail (NULL != storage, 0);
+
+    g_mutex_lock (storage->lock);
+    size = _storage_model_get (storage->shot_sizes, key,
+                               G_DIGICAM_STORAGE_DEFAULT_SHOT_SIZE);
+    free_bytes = _storage_get_free (storage);
+    g_mutex_unlock (storage->lock);
+
+    return (guint) MIN (free_bytes / (size * STORAGE_SHOT_MARGIN), G_MAXUINT);
+}
+
+
+/**
+ * _g_digicam_storage_recording_started:
+ * @storage: A #GDigicamStorage.
+ * @key: The capture settings of the recording.
+ *
+ * Starts learning the bitrate of a recording with the @key
+ * settings. The recording is measured on every
+ * _g_digicam_storage_recording_update().
+ **/
+void
+_g_digicam_storage_recording_started (GDigicamStorage *storage,
+                                      guint32          key)
+{
+    g_return_if_fail (NULL != storage);
+
+    g_mutex_lock (storage->lock);
+    storage->recording = TRUE;
+    storage->recording_sampled = FALSE;
+    storage->recording_key = key;
+    storage->recording_available = storage->available;
+    g_get_current_time (&storage->recording_time);
+    g_mutex_unlock (storage->lock);
+}
+
+
+/**
+ * _g_digicam_storage_recording_update:
+ * @storage: A #GDigicamStorage.
+ *
+ * Reads again the free space and, if a recording is going on, learns
+ * its bitrate from how much the free space went down since the last
+ * update. The first time it goes down is not learned, as it includes
+ * the space preallocated for the whole recording window.
+ **/
+void
+_g_digicam_storage_recording_update (GDigicamStorage *storage)
+{
+    GTimeVal now;
+    gdouble elapsed;
+
+    g_return_if_fail (NULL != storage);
+
+    g_mutex_lock (storage->lock);
+
+    if (!_storage_statvfs (storage, NULL) || !storage->recording) {
+        goto done;
+    }
+
+    g_get_current_time (&now);
+    elapsed = (now.tv_sec - storage->recording_time.tv_sec) +
+        (now.tv_usec - storage->recording_time.tv_usec) / (gdouble) G_USEC_PER_SEC;
+
+    if (storage->available > storage->recording_available) {
+        /* Somebody else freed space, measure from here */
+        storage->recording_available = storage->available;
+        storage->recording_time = now;
+    } else if ((1.0 <= elapsed) &&
+               (storage->available < storage->recording_available)) {
+        /* When the muxer is still buffering nothing goes down, so the
+         * next sample just covers a longer time. The first drop also
+         * takes the space reserved ahead of the new file at once, and
+         * would be several times the bitrate: measure from there */
+        if (storage->recording_sampled) {
+            _storage_model_learn (storage->rates, storage->recording_key,
+                                  (storage->recording_available -
+                                   storage->available) / elapsed);
+        }
+        storage->recording_sampled = TRUE;
+        storage->recording_available = storage->available;
+        storage->recording_time = now;
+    }
+
+done:
+    g_mutex_unlock (storage->lock);
+}
+
+
+/**
+ * _g_digicam_storage_recording_stopped:
+ * @storage: A #GDigicamStorage.
+ *
+ * Stops learning the bitrate of the current recording.
+ **/
+void
+_g_digicam_storage_recording_stopped (GDigicamStorage *storage)
+{
+    g_return_if_fail (NULL != storage);
+
+    g_mutex_lock (storage->lock);
+    storage->recording = FALSE;
+    g_mutex_unlock (storage->lock);
+}
+
+
+/**
+ * _g_digicam_storage_get_remaining_seconds:
+ * @storage: A #GDigicamStorage.
+ * @key: The capture settings of the recording.
+ *
+ * Estimates how many seconds of video with the @key settings still fit
+ * in the free space.
+ *
+ * Returns: the remaining seconds.
+ **/
+guint
+_g_digicam_storage_get_remaining_seconds (GDigicamStorage *storage,
+                                          guint32          key)
+{
+    gdouble rate;
+    guint64 free_bytes;
+
+    g_return_val_if_fail (NULL != storage, 0);
+
+    g_mutex_lock (storage->lock);
+    rate = _storage_model_get (storage->rates, key,
+                               G_DIGICAM_STORAGE_DEFAULT_RATE);
+    free_bytes = _storage_get_free (storage);
+    g_mutex_unlock (storage->lock);
+
+    return (guint) MIN (free_bytes / rate, G_MAXUINT);
+}
+
+
+/*********************************/
+/* Private utility functions     */
+/*********************************/
+
+static gboolean
+_storage_statvfs (GDigicamStorage  *storage,
+                  GError          **error)
+{
+    struct statvfs buf;
+    guint64 available;
+    gint saved_errno;
+
+    if (0 != statvfs (storage->directory, &buf)) {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR,
+                     g_file_error_from_errno (saved_errno),
+                     "unable to get the free space of %s: %s",
+                     storage->directory, g_strerror (saved_errno));
+        return FALSE;
+    }
+
+    available = (guint64) buf.f_bavail * buf.f_frsize;
+    storage->available = available - MIN (available, storage->reserved);
+
+    G_DIGICAM_DEBUG ("GDigicamStorage: %" G_GUINT64_FORMAT
+                     " bytes available in %s",
+                     storage->available, storage->directory);
+
+    return TRUE;
+}
+
+
+static gdouble
+_storage_model_get (GHashTable *models,
+                    guint32     key,
+                    gdouble     initial)
+{
+    gdouble *value = NULL;
+
+    value = g_hash_table_lookup (models, GUINT_TO_POINTER (key));
+
+    return (NULL != value) ? *value : initial;
+}
+
+
+static void
+_storage_model_learn (GHashTable *models,
+                      guint32     key,
+                      gdouble     sample)
+{
+    gdouble *value = NULL;
+
+    value = g_hash_table_lookup (models, GUINT_TO_POINTER (key));
+
+    /* The first sample is better than any default */
+    if (NULL == value) {
+        value = g_new (gdouble, 1);
+        *value = sample;
+        g_hash_table_insert (models, GUINT_TO_POINTER (key), value);
+    } else {
+        *value += (sample - *value) * STORAGE_ALPHA;
+    }
+}
+
+
+static guint64
+_storage_get_free (GDigicamStorage *storage)
+{
+    GList *item = NULL;
+    guint64 result;
+    guint64 expected;
+
+    result = storage->available;
+
+    for (item = storage->pending->head; NULL != item; item = item->next) {
+        expected = _storage_model_get (storage->shot_sizes,
+                                       GPOINTER_TO_UINT (item->data),
+                                       G_DIGICAM_STORAGE_DEFAULT_SHOT_SIZE);
+        result -= MIN (result, expected);
+    }
+
+    return result;
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __G_DIGICAM_STORAGE_H__
+#define __G_DIGICAM_STORAGE_H__
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    G_BEGIN_DECLS
+
+    /**
+     * G_DIGICAM_STORAGE_DEFAULT_SHOT_SIZE:
+     *
+     * Bytes expected for a still picture until one with the same
+     * settings has been saved.
+     */
+#define G_DIGICAM_STORAGE_DEFAULT_SHOT_SIZE (4 * 1024 * 1024)
+
+    /**
+     * G_DIGICAM_STORAGE_DEFAULT_RATE:
+     *
+     * Bytes per second expected for a video recording until one with
+     * the same settings has been measured.
+     */
+#define G_DIGICAM_STORAGE_DEFAULT_RATE (2 * 1024 * 1024)
+
+    typedef struct _GDigicamStorage GDigicamStorage;
+
+    GDigicamStorage *_g_digicam_storage_new (const gchar  *directory,
+                                             guint64       reserved,
+                                             GError      **error);
+    void _g_digicam_storage_free (GDigicamStorage *storage);
+    gboolean _g_digicam_storage_refresh (GDigicamStorage  *storage,
+                                         GError          **error);
+    guint64 _g_digicam_storage_get_free (GDigicamStorage *storage);
+    const gchar *_g_digicam_storage_get_directory (GDigicamStorage *storage);
+    void _g_digicam_storage_shot_started (GDigicamStorage *storage,
+                                          guint32          key);
+    void _g_digicam_storage_shot_done (GDigicamStorage *storage,
+                                       guint64          size);
+    void _g_digicam_storage_shot_cancelled (GDigicamStorage *storage);
+    guint _g_digicam_storage_get_remaining_shots (GDigicamStorage *storage,
+                                                  guint32          key);
+    void _g_digicam_storage_recording_started (GDigicamStorage *storage,
+                                               guint32          key);
+    void _g_digicam_storage_recording_update (GDigicamStorage *storage);
+    void _g_digicam_storage_recording_stopped (GDigicamStorage *storage);
+    guint _g_digicam_storage_get_remaining_seconds (GDigicamStorage *storage,
+                                                    guint32          key);
+
+    G_END_DECLS
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __G_DIGICAM_STORAGE_H__ */
@@ -25,6 +25,7 @@
 #include <string.h>
 /* #include <unistd.h> */
 #include <check.h>
+#include <glib/gstdio.h>
 #include <gst/gst.h>
 #include <gst/gstbin.h>
 #include <gtk/gtk.h>
@@ -35,6 +36,7 @@
 #include "gdigicam-util.h"
 #include "gdigicam-error.h"
 #include "gdigicam-manager.h"
+#include "gdigicam-manager-private.h"
 
 #include <libintl.h>
 
@@ -6226,6 +6228,844 @@ END_TEST
 
 
 
+/* ----- Test case for set/get_window_geometry -----*/
+
+
+/**
+ * Purpose: test setting and getting the window geometry in a
+ * #GDigicamManager
+ * Cases considered:
+ *    - set/get window geometry from just created #GDigicamManager.
+ *    - get window geometry from a featured but not set #GDigicamManager.
+ */
+START_TEST (test_set_window_geometry_limit)
+{
+    guint width = 1;
+    guint height = 1;
+
+    /* Test 1 */
+    fail_if (g_digicam_manager_set_window_geometry (no_featured_manager,
+                                                    800, 480,
+                                                    &error,
+                                                    NULL),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    fail_if (!g_error_matches (error,
+                               G_DIGICAM_ERROR,
+                               G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET),
+             "gdigicam-manager: error is  \n\"%s\"\n instead of "
+             "\"bin not set\".",
+             error->message);
+    g_error_free (error);
+    error = NULL;
+
+    fail_if (g_digicam_manager_get_window_geometry (no_featured_manager,
+                                                    &width, &height,
+                                                    &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if ((0 != width) || (0 != height),
+             "gdigicam-manager: the window geometry was not the \"unset\" "
+             "value, it was \"%dx%d\".",
+             width, height);
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    g_error_free (error);
+    error = NULL;
+
+    /* Test 2 */
+    g_digicam_manager_set_gstreamer_bin (full_featured_manager,
+                                         full_featured_camera_bin,
+                                         full_featured_descriptor,
+                                         NULL);
+    width = height = 1;
+    fail_if (!g_digicam_manager_get_window_geometry (full_featured_manager,
+                                                     &width, &height,
+                                                     &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if ((0 != width) || (0 != height),
+             "gdigicam-manager: the window geometry was not the \"unset\" "
+             "value, it was \"%dx%d\".",
+             width, height);
+    fail_if (NULL != error,
+             "gdigicam-manager: error was set.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+}
+END_TEST
+
+
+/**
+ * Purpose: test setting and getting the window geometry in a
+ * #GDigicamManager
+ * Cases considered:
+ *    - set/get a window geometry in a featured #GDigicamManager.
+ *    - set/get a new window geometry after a resize.
+ */
+START_TEST (test_set_window_geometry_regular)
+{
+    guint width = 0;
+    guint height = 0;
+
+    /* Test 1 */
+    g_digicam_manager_set_gstreamer_bin (full_featured_manager,
+                                         full_featured_camera_bin,
+                                         full_featured_descriptor,
+                                         NULL);
+    fail_if (!g_digicam_manager_set_window_geometry (full_featured_manager,
+                                                     800, 480,
+                                                     &error,
+                                                     NULL),
+             "gdigicam-manager: an error has happened.");
+    fail_if (NULL != error,
+             "gdigicam-manager: error was set.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    fail_if (!g_digicam_manager_get_window_geometry (full_featured_manager,
+                                                     &width, &height,
+                                                     &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if ((800 != width) || (480 != height),
+             "gdigicam-manager: the window geometry was not the \"set\" "
+             "value, it was \"%dx%d\".",
+             width, height);
+    fail_if (NULL != error,
+             "gdigicam-manager: error was set.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    /* Test 2 */
+    fail_if (!g_digicam_manager_set_window_geometry (full_featured_manager,
+                                                     320, 240,
+                                                     &error,
+                                                     NULL),
+             "gdigicam-manager: an error has happened.");
+    fail_if (NULL != error,
+             "gdigicam-manager: error was set.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    fail_if (!g_digicam_manager_get_window_geometry (full_featured_manager,
+                                                     &width, &height,
+                                                     &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if ((320 != width) || (240 != height),
+             "gdigicam-manager: the window geometry was not the \"set\" "
+             "value, it was \"%dx%d\".",
+             width, height);
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+}
+END_TEST
+
+
+/**
+ * Purpose: test setting and getting the window geometry with invalid
+ * values in a #GDigicamManager
+ * Cases considered:
+ *    - set/get window geometry from a NULL #GDigicamManager.
+ *    - get window geometry with invalid pointers in which to store.
+ */
+START_TEST (test_set_window_geometry_invalid)
+{
+    guint width = 0;
+    guint height = 0;
+
+    /* Test 1 */
+    fail_if (g_digicam_manager_set_window_geometry (NULL,
+                                                    800, 480,
+                                                    &error,
+                                                    NULL),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (g_digicam_manager_get_window_geometry (NULL,
+                                                    &width, &height,
+                                                    &error),
+             "gdigicam-manager: an error has not happened.");
+
+    /* Test 2 */
+    g_digicam_manager_set_gstreamer_bin (full_featured_manager,
+                                         full_featured_camera_bin,
+                                         full_featured_descriptor,
+                                         NULL);
+    fail_if (g_digicam_manager_get_window_geometry (full_featured_manager,
+                                                    NULL, &height,
+                                                    &error),
+             "gdigicam-manager: window geometry got "
+             "with invalid pointer in which to set");
+    fail_if (g_digicam_manager_get_window_geometry (full_featured_manager,
+                                                    &width, NULL,
+                                                    &error),
+             "gdigicam-manager: window geometry got "
+             "with invalid pointer in which to set");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+}
+END_TEST
+
+
+
+/* ----- Test case for set/get_preview_sizes -----*/
+
+
+/**
+ * Purpose: test setting and getting the preview sizes in a
+ * #GDigicamManager
+ * Cases considered:
+ *    - set/get preview sizes from just created #GDigicamManager.
+ *    - set/get preview sizes to a minimum featured #GDigicamManager.
+ *    - get preview sizes from a featured but not set #GDigicamManager.
+ */
+START_TEST (test_set_preview_sizes_limit)
+{
+    GDigicamPreviewSize size = { 160, 120 };
+    GDigicamPreviewSize *gotten_sizes = NULL;
+    guint n_sizes = 1;
+
+    /* Test 1 */
+    fail_if (g_digicam_manager_set_preview_sizes (no_featured_manager,
+                                                  &size, 1,
+                                                  &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    fail_if (!g_error_matches (error,
+                               G_DIGICAM_ERROR,
+                               G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET),
+             "gdigicam-manager: error is  \n\"%s\"\n instead of "
+             "\"bin not set\".",
+             error->message);
+    g_error_free (error);
+    error = NULL;
+
+    fail_if (g_digicam_manager_get_preview_sizes (no_featured_manager,
+                                                  &gotten_sizes, &n_sizes,
+                                                  &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if ((NULL != gotten_sizes) || (0 != n_sizes),
+             "gdigicam-manager: preview sizes were gotten.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    g_error_free (error);
+    error = NULL;
+
+    /* Test 2 */
+    g_digicam_manager_set_gstreamer_bin (minimum_featured_manager,
+                                         minimum_featured_camera_bin,
+                                         minimum_featured_descriptor,
+                                         NULL);
+    fail_if (g_digicam_manager_set_preview_sizes (minimum_featured_manager,
+                                                  &size, 1,
+                                                  &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    fail_if (!g_error_matches (error,
+                               G_DIGICAM_ERROR,
+		               G_DIGICAM_ERROR_PREVIEW_NOT_SUPPORTED),
+             "gdigicam-manager: error is  \n\"%s\"\n instead of "
+             "\"preview not supported\".",
+             error->message);
+    g_error_free (error);
+    error = NULL;
+
+    /* Test 3 */
+    g_digicam_manager_set_gstreamer_bin (full_featured_manager,
+                                         full_featured_camera_bin,
+                                         full_featured_descriptor,
+                                         NULL);
+    n_sizes = 1;
+    fail_if (!g_digicam_manager_get_preview_sizes (full_featured_manager,
+                                                   &gotten_sizes, &n_sizes,
+                                                   &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if ((NULL != gotten_sizes) || (0 != n_sizes),
+             "gdigicam-manager: preview sizes were not the \"unset\" value.");
+    fail_if (NULL != error,
+             "gdigicam-manager: error was set.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+}
+END_TEST
+
+
+/**
+ * Purpose: test setting and getting the preview sizes in a
+ * #GDigicamManager
+ * Cases considered:
+ *    - set/get several preview sizes in a featured #GDigicamManager.
+ *    - unset the preview sizes.
+ *    - set an invalid preview size.
+ */
+START_TEST (test_set_preview_sizes_regular)
+{
+    GDigicamPreviewSize sizes[] = { { 800, 480 }, { 128, 128 } };
+    GDigicamPreviewSize invalid = { 0, 480 };
+    GDigicamPreviewSize *gotten_sizes = NULL;
+    guint n_sizes = 0;
+
+    g_digicam_manager_set_gstreamer_bin (full_featured_manager,
+                                         full_featured_camera_bin,
+                                         full_featured_descriptor,
+                                         NULL);
+
+    /* Test 1 */
+    fail_if (!g_digicam_manager_set_preview_sizes (full_featured_manager,
+                                                   sizes,
+                                                   G_N_ELEMENTS (sizes),
+                                                   &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (NULL != error,
+             "gdigicam-manager: error was set.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    fail_if (!g_digicam_manager_get_preview_sizes (full_featured_manager,
+                                                   &gotten_sizes, &n_sizes,
+                                                   &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if ((G_N_ELEMENTS (sizes) != n_sizes) ||
+             (0 != memcmp (sizes, gotten_sizes, sizeof (sizes))),
+             "gdigicam-manager: the preview sizes were not the \"set\" "
+             "value.");
+    g_free (gotten_sizes);
+    gotten_sizes = NULL;
+
+    /* Test 2 */
+    fail_if (!g_digicam_manager_set_preview_sizes (full_featured_manager,
+                                                   NULL, 0,
+                                                   &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (!g_digicam_manager_get_preview_sizes (full_featured_manager,
+                                                   &gotten_sizes, &n_sizes,
+                                                   &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if ((NULL != gotten_sizes) || (0 != n_sizes),
+             "gdigicam-manager: the preview sizes were not unset.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    /* Test 3 */
+    fail_if (g_digicam_manager_set_preview_sizes (full_featured_manager,
+                                                  &invalid, 1,
+                                                  &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+}
+END_TEST
+
+#if G_DIGICAM_HAVE_GDKPIXBUF
+/**
+ * Purpose: test the recycling of the preview surfaces of a
+ * #GDigicamManager
+ * Cases considered:
+ *    - the surface released by a shot is handed out to the next one.
+ *    - a surface still in use is not handed out.
+ *    - a released surface of another size keeps its pixels.
+ */
+START_TEST (test_preview_surfaces_regular)
+{
+    GdkPixbuf *first = NULL;
+    GdkPixbuf *second = NULL;
+    GdkPixbuf *third = NULL;
+    guchar *pixels = NULL;
+
+    /* Test 1 */
+    first = _g_digicam_manager_get_preview_surface (full_featured_manager,
+                                                    FALSE, 320, 240);
+    fail_if (NULL == first,
+             "gdigicam-manager: no preview surface.");
+    pixels = gdk_pixbuf_get_pixels (first);
+    g_object_unref (first);
+
+    second = _g_digicam_manager_get_preview_surface (full_featured_manager,
+                                                     FALSE, 320, 240);
+    fail_if (first != second,
+             "gdigicam-manager: the released surface was not reused.");
+
+    /* Test 2 */
+    third = _g_digicam_manager_get_preview_surface (full_featured_manager,
+                                                    FALSE, 320, 240);
+    fail_if ((NULL == third) || (second == third),
+             "gdigicam-manager: a surface in use was handed out.");
+    g_object_unref (third);
+    g_object_unref (second);
+
+    /* Test 3 */
+    third = _g_digicam_manager_get_preview_surface (full_featured_manager,
+                                                    FALSE, 160, 120);
+    fail_if ((160 != gdk_pixbuf_get_width (third)) ||
+             (120 != gdk_pixbuf_get_height (third)),
+             "gdigicam-manager: wrong preview surface size.");
+    fail_if (pixels != gdk_pixbuf_get_pixels (third),
+             "gdigicam-manager: the resized surface was reallocated.");
+    g_object_unref (third);
+}
+END_TEST
+#endif
+
+
+
+/* ----- Test case for set/get_thumbnail_mode -----*/
+
+
+/**
+ * Purpose: test setting and getting the thumbnail mode in a
+ * #GDigicamManager
+ * Cases considered:
+ *    - set/get thumbnail mode from just created #GDigicamManager.
+ *    - set thumbnail mode to a minimum featured #GDigicamManager.
+ *    - get thumbnail mode from a featured but not set #GDigicamManager.
+ */
+START_TEST (test_set_thumbnail_mode_limit)
+{
+    GDigicamThumbnail thumbnail_mode = G_DIGICAM_THUMBNAIL_LARGE;
+
+    /* Test 1 */
+    fail_if (g_digicam_manager_set_thumbnail_mode (no_featured_manager,
+                                                   G_DIGICAM_THUMBNAIL_NORMAL,
+                                                   &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    fail_if (!g_error_matches (error,
+                               G_DIGICAM_ERROR,
+                               G_DIGICAM_ERROR_GSTREAMER_BIN_NOT_SET),
+             "gdigicam-manager: error is  \n\"%s\"\n instead of "
+             "\"bin not set\".",
+             error->message);
+    g_error_free (error);
+    error = NULL;
+
+    fail_if (g_digicam_manager_get_thumbnail_mode (no_featured_manager,
+                                                   &thumbnail_mode,
+                                                   &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    g_error_free (error);
+    error = NULL;
+
+    /* Test 2 */
+    g_digicam_manager_set_gstreamer_bin (minimum_featured_manager,
+                                         minimum_featured_camera_bin,
+                                         minimum_featured_descriptor,
+                                         NULL);
+    fail_if (g_digicam_manager_set_thumbnail_mode (minimum_featured_manager,
+                                                   G_DIGICAM_THUMBNAIL_NORMAL,
+                                                   &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    fail_if (!g_error_matches (error,
+                               G_DIGICAM_ERROR,
+		               G_DIGICAM_ERROR_PREVIEW_NOT_SUPPORTED),
+             "gdigicam-manager: error is  \n\"%s\"\n instead of "
+             "\"preview not supported\".",
+             error->message);
+    g_error_free (error);
+    error = NULL;
+
+    /* Test 3 */
+    g_digicam_manager_set_gstreamer_bin (full_featured_manager,
+                                         full_featured_camera_bin,
+                                         full_featured_descriptor,
+                                         NULL);
+    fail_if (!g_digicam_manager_get_thumbnail_mode (full_featured_manager,
+                                                    &thumbnail_mode,
+                                                    &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (G_DIGICAM_THUMBNAIL_NONE != thumbnail_mode,
+             "gdigicam-manager: thumbnail mode was not the \"unset\" value.");
+    fail_if (NULL != error,
+             "gdigicam-manager: error was set.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+}
+END_TEST
+
+
+/**
+ * Purpose: test setting and getting the thumbnail mode in a
+ * #GDigicamManager
+ * Cases considered:
+ *    - set/get both thumbnail sizes in a featured #GDigicamManager.
+ *    - set an invalid thumbnail mode.
+ *    - keep the thumbnail mode when the preview sizes are set again.
+ */
+START_TEST (test_set_thumbnail_mode_regular)
+{
+    GDigicamThumbnail thumbnail_mode = G_DIGICAM_THUMBNAIL_NONE;
+    GDigicamPreviewSize sizes[] = { { 800, 480 } };
+
+    g_digicam_manager_set_gstreamer_bin (full_featured_manager,
+                                         full_featured_camera_bin,
+                                         full_featured_descriptor,
+                                         NULL);
+
+    /* Test 1 */
+    fail_if (!g_digicam_manager_set_thumbnail_mode (full_featured_manager,
+                                                    G_DIGICAM_THUMBNAIL_NORMAL |
+                                                    G_DIGICAM_THUMBNAIL_LARGE,
+                                                    &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (!g_digicam_manager_get_thumbnail_mode (full_featured_manager,
+                                                    &thumbnail_mode,
+                                                    &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if ((G_DIGICAM_THUMBNAIL_NORMAL | G_DIGICAM_THUMBNAIL_LARGE) !=
+             thumbnail_mode,
+             "gdigicam-manager: thumbnail mode was not the \"set\" value.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    /* Test 2 */
+    fail_if (g_digicam_manager_set_thumbnail_mode (full_featured_manager,
+                                                   G_DIGICAM_THUMBNAIL_N,
+                                                   &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    /* Test 3 */
+    g_digicam_manager_set_preview_sizes (full_featured_manager,
+                                         sizes, G_N_ELEMENTS (sizes),
+                                         NULL);
+    g_digicam_manager_set_preview_sizes (full_featured_manager,
+                                         sizes, G_N_ELEMENTS (sizes),
+                                         NULL);
+    fail_if (!g_digicam_manager_get_thumbnail_mode (full_featured_manager,
+                                                    &thumbnail_mode,
+                                                    &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if ((G_DIGICAM_THUMBNAIL_NORMAL | G_DIGICAM_THUMBNAIL_LARGE) !=
+             thumbnail_mode,
+             "gdigicam-manager: thumbnail mode changed with the previews.");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+}
+END_TEST
+
+
+
+/**
+ * Purpose: test the free space tracking of a #GDigicamManager
+ * Cases considered:
+ *    - get the remaining shots and seconds without storage.
+ *    - set a storage which doesn't exist.
+ *    - get the remaining shots and seconds of the temporary directory.
+ *    - capture a still picture when everything is reserved.
+ *    - fall back to a second storage when the first one is full, with
+ *      the names of the captures.
+ */
+START_TEST (test_set_storage_regular)
+{
+    guint shots = 0;
+    guint seconds = 0;
+    gchar *directory = NULL;
+    gchar *second = NULL;
+    gchar *filename = NULL;
+
+    g_digicam_manager_set_gstreamer_bin (full_featured_manager,
+                                         full_featured_camera_bin,
+                                         full_featured_descriptor,
+                                         NULL);
+    window = create_test_window ();
+    show_test_window (window);
+    g_digicam_manager_set_mode (full_featured_manager,
+				G_DIGICAM_MODE_STILL,
+				&error,
+				NULL);
+    if (error != NULL)
+        g_error_free (error);
+    error = NULL;
+
+    /* Test 1 */
+    fail_if (g_digicam_manager_get_remaining_shots (full_featured_manager,
+                                                    &shots,
+                                                    &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    g_error_free (error);
+    error = NULL;
+    fail_if (g_digicam_manager_get_remaining_seconds (full_featured_manager,
+                                                      &seconds,
+                                                      &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    g_error_free (error);
+    error = NULL;
+
+    /* Test 2 */
+    fail_if (g_digicam_manager_set_storage (full_featured_manager,
+                                            "/nonexistent/gdigicam",
+                                            0,
+                                            &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    g_error_free (error);
+    error = NULL;
+
+    /* Test 3 */
+    fail_if (!g_digicam_manager_set_storage (full_featured_manager,
+                                             g_get_tmp_dir (),
+                                             0,
+                                             &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (!g_digicam_manager_get_remaining_shots (full_featured_manager,
+                                                     &shots,
+                                                     &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (!g_digicam_manager_get_remaining_seconds (full_featured_manager,
+                                                       &seconds,
+                                                       &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (seconds < shots,
+             "gdigicam-manager: %u seconds of video estimated for "
+             "%u pictures.", seconds, shots);
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    /* Test 4 */
+    fail_if (!g_digicam_manager_set_storage (full_featured_manager,
+                                             g_get_tmp_dir (),
+                                             G_MAXUINT64,
+                                             &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (!g_digicam_manager_get_remaining_shots (full_featured_manager,
+                                                     &shots,
+                                                     &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (0 != shots,
+             "gdigicam-manager: %u shots remaining with no space.", shots);
+    fail_if (g_digicam_manager_capture_still_picture (full_featured_manager,
+                                                      "file.jpg",
+                                                      &error,
+                                                      NULL),
+             "gdigicam-manager: capture started with no space.");
+    fail_if (!g_error_matches (error,
+                               G_DIGICAM_ERROR,
+                               G_DIGICAM_ERROR_NO_SPACE),
+             "gdigicam-manager: error is  \n\"%s\"\n instead of "
+             "\"no space\".",
+             NULL != error ? error->message : "none");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    /* Test 5 */
+    fail_if (!g_digicam_manager_set_naming (full_featured_manager,
+                                            G_DIGICAM_MODE_STILL,
+                                            g_get_tmp_dir (),
+                                            "GDIGICAM_####.jpg",
+                                            &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (g_digicam_manager_select_storage (full_featured_manager,
+                                               &directory,
+                                               &error),
+             "gdigicam-manager: storage chosen with no space.");
+    fail_if (!g_error_matches (error,
+                               G_DIGICAM_ERROR,
+                               G_DIGICAM_ERROR_NO_SPACE),
+             "gdigicam-manager: error is  \n\"%s\"\n instead of "
+             "\"no space\".",
+             NULL != error ? error->message : "none");
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+    second = g_build_filename (g_get_tmp_dir (), "gdigicam-storage",
+                               NULL);
+    g_mkdir (second, 0700);
+    fail_if (!g_file_test (second, G_FILE_TEST_IS_DIR),
+             "gdigicam-manager: directory not created.");
+    fail_if (!g_digicam_manager_add_storage (full_featured_manager,
+                                             second,
+                                             0,
+                                             &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (!g_digicam_manager_select_storage (full_featured_manager,
+                                                &directory,
+                                                &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (0 != g_strcmp0 (directory, second),
+             "gdigicam-manager: storage is \"%s\" instead of \"%s\".",
+             directory, second);
+    g_free (directory);
+    fail_if (!g_digicam_manager_get_storage (full_featured_manager,
+                                             &directory,
+                                             &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (0 != g_strcmp0 (directory, second),
+             "gdigicam-manager: current storage is \"%s\" instead of "
+             "\"%s\".", directory, second);
+    g_free (directory);
+    fail_if (!g_digicam_manager_get_remaining_shots (full_featured_manager,
+                                                     &shots,
+                                                     &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (0 == shots,
+             "gdigicam-manager: no shots remaining with a free storage.");
+    fail_if (!g_digicam_manager_reserve_filename (full_featured_manager,
+                                                  G_DIGICAM_MODE_STILL,
+                                                  &filename,
+                                                  &error),
+             "gdigicam-manager: an error has happened.");
+    directory = g_path_get_dirname (filename);
+    fail_if (0 != g_strcmp0 (directory, second),
+             "gdigicam-manager: name reserved in \"%s\" instead of "
+             "\"%s\".", directory, second);
+    g_free (directory);
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    g_digicam_manager_set_naming (full_featured_manager,
+                                  G_DIGICAM_MODE_STILL,
+                                  NULL, NULL, NULL);
+    g_unlink (filename);
+    g_free (filename);
+    filename = g_build_filename (second, ".GDIGICAM_####.jpg.counter", NULL);
+    g_unlink (filename);
+    g_free (filename);
+    g_digicam_manager_set_storage (full_featured_manager, NULL, 0, NULL);
+    g_rmdir (second);
+    g_free (second);
+}
+END_TEST
+
+
+
+/**
+ * Purpose: test the file names generated by a #GDigicamManager
+ * Cases considered:
+ *    - reserve a name without naming.
+ *    - set a naming with an invalid pattern.
+ *    - reserve names after the ones already used, skipping the ones
+ *      taken meanwhile.
+ *    - go on with the saved counter with a new naming.
+ */
+START_TEST (test_set_naming_regular)
+{
+    const gchar *names[] = { "IMG_0007.jpg", "IMG_0008.jpg",
+                             "IMG_0009.jpg", "IMG_0010.jpg",
+                             "IMG_0011.jpg", ".IMG_####.jpg.counter" };
+    gchar *directory = NULL;
+    gchar *filename = NULL;
+    gchar *expected = NULL;
+    guint i;
+
+    directory = g_build_filename (g_get_tmp_dir (), "gdigicam-naming",
+                                  NULL);
+    g_mkdir (directory, 0700);
+    for (i = 0; i < G_N_ELEMENTS (names); i++) {
+        filename = g_build_filename (directory, names[i], NULL);
+        g_unlink (filename);
+        g_free (filename);
+    }
+    filename = g_build_filename (directory, names[0], NULL);
+    g_file_set_contents (filename, "", 0, NULL);
+    g_free (filename);
+    filename = NULL;
+
+    /* Test 1 */
+    fail_if (g_digicam_manager_reserve_filename (full_featured_manager,
+                                                 G_DIGICAM_MODE_STILL,
+                                                 &filename,
+                                                 &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    g_error_free (error);
+    error = NULL;
+
+    /* Test 2 */
+    fail_if (g_digicam_manager_set_naming (full_featured_manager,
+                                           G_DIGICAM_MODE_STILL,
+                                           directory,
+                                           "IMG_##_##.jpg",
+                                           &error),
+             "gdigicam-manager: an error has not happened.");
+    fail_if (NULL == error,
+             "gdigicam-manager: error was not set.");
+    g_error_free (error);
+    error = NULL;
+
+    /* Test 3 */
+    fail_if (!g_digicam_manager_set_naming (full_featured_manager,
+                                            G_DIGICAM_MODE_STILL,
+                                            directory,
+                                            "IMG_####.jpg",
+                                            &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (!g_digicam_manager_reserve_filename (full_featured_manager,
+                                                  G_DIGICAM_MODE_STILL,
+                                                  &filename,
+                                                  &error),
+             "gdigicam-manager: an error has happened.");
+    expected = g_build_filename (directory, names[1], NULL);
+    fail_if ((NULL == filename) || (0 != strcmp (filename, expected)) ||
+             !g_file_test (filename, G_FILE_TEST_EXISTS),
+             "gdigicam-manager: reserved \"%s\" instead of \"%s\".",
+             filename, expected);
+    g_free (expected);
+    g_free (filename);
+
+    expected = g_build_filename (directory, names[2], NULL);
+    g_file_set_contents (expected, "", 0, NULL);
+    g_free (expected);
+    fail_if (!g_digicam_manager_reserve_filename (full_featured_manager,
+                                                  G_DIGICAM_MODE_STILL,
+                                                  &filename,
+                                                  &error),
+             "gdigicam-manager: an error has happened.");
+    expected = g_build_filename (directory, names[3], NULL);
+    fail_if ((NULL == filename) || (0 != strcmp (filename, expected)),
+             "gdigicam-manager: reserved \"%s\" instead of \"%s\".",
+             filename, expected);
+    g_free (expected);
+    g_free (filename);
+
+    /* Test 4 */
+    fail_if (!g_digicam_manager_set_naming (full_featured_manager,
+                                            G_DIGICAM_MODE_STILL,
+                                            directory,
+                                            "IMG_####.jpg",
+                                            &error),
+             "gdigicam-manager: an error has happened.");
+    fail_if (!g_digicam_manager_reserve_filename (full_featured_manager,
+                                                  G_DIGICAM_MODE_STILL,
+                                                  &filename,
+                                                  &error),
+             "gdigicam-manager: an error has happened.");
+    expected = g_build_filename (directory, names[4], NULL);
+    fail_if ((NULL == filename) || (0 != strcmp (filename, expected)),
+             "gdigicam-manager: reserved \"%s\" instead of \"%s\".",
+             filename, expected);
+    g_free (expected);
+    g_free (filename);
+    if (error != NULL) g_error_free (error);
+    error = NULL;
+
+    g_digicam_manager_set_naming (full_featured_manager,
+                                  G_DIGICAM_MODE_STILL,
+                                  NULL, NULL, NULL);
+    for (i = 0; i < G_N_ELEMENTS (names); i++) {
+        filename = g_build_filename (directory, names[i], NULL);
+        g_unlink (filename);
+        g_free (filename);
+    }
+    g_rmdir (directory);
+    g_free (directory);
+}
+END_TEST
+
+
+
 /* ---------- Suite creation ---------- */
 
 Suite *create_g_digicam_manager_suite (void)
@@ -6258,6 +7098,11 @@ Suite *create_g_digicam_manager_suite (void)
     TCase *tc25 = tcase_create ("test_set_aspect_ratio_resolution");
     TCase *tc26 = tcase_create ("test_set_preview_mode");
     TCase *tc27 = tcase_create ("test_preview_enabled");
+    TCase *tc28 = tcase_create ("test_set_get_window_geometry");
+    TCase *tc29 = tcase_create ("test_set_get_preview_sizes");
+    TCase *tc30 = tcase_create ("test_set_get_thumbnail_mode");
+    TCase *tc31 = tcase_create ("test_set_storage");
+    TCase *tc32 = tcase_create ("test_set_naming");
 
     /* Create test case for new and add it to the suite */
     tcase_add_checked_fixture (tc1, fx_setup_g_digicam, NULL);
@@ -6456,6 +7301,48 @@ Suite *create_g_digicam_manager_suite (void)
     tcase_add_test (tc27, test_preview_enabled_invalid);
     suite_add_tcase (s, tc27);
 
+    /* Create test case for test_set_window_geometry and add it to the suite */
+    tcase_add_checked_fixture (tc28,
+                               fx_setup_default_managers,
+                               fx_teardown_default_managers);
+    tcase_add_test (tc28, test_set_window_geometry_limit);
+    tcase_add_test (tc28, test_set_window_geometry_regular);
+    tcase_add_test (tc28, test_set_window_geometry_invalid);
+    suite_add_tcase (s, tc28);
+
+    /* Create test case for test_set_preview_sizes and add it to the suite */
+    tcase_add_checked_fixture (tc29,
+                               fx_setup_default_managers,
+                               fx_teardown_default_managers);
+    tcase_add_test (tc29, test_set_preview_sizes_limit);
+    tcase_add_test (tc29, test_set_preview_sizes_regular);
+#if G_DIGICAM_HAVE_GDKPIXBUF
+    tcase_add_test (tc29, test_preview_surfaces_regular);
+#endif
+    suite_add_tcase (s, tc29);
+
+    /* Create test case for test_set_thumbnail_mode and add it to the suite */
+    tcase_add_checked_fixture (tc30,
+                               fx_setup_default_managers,
+                               fx_teardown_default_managers);
+    tcase_add_test (tc30, test_set_thumbnail_mode_limit);
+    tcase_add_test (tc30, test_set_thumbnail_mode_regular);
+    suite_add_tcase (s, tc30);
+
+    /* Create test case for test_set_storage and add it to the suite */
+    tcase_add_checked_fixture (tc31,
+                               fx_setup_default_managers,
+                               fx_teardown_default_managers);
+    tcase_add_test (tc31, test_set_storage_regular);
+    suite_add_tcase (s, tc31);
+
+    /* Create test case for test_set_naming and add it to the suite */
+    tcase_add_checked_fixture (tc32,
+                               fx_setup_default_managers,
+                               fx_teardown_default_managers);
+    tcase_add_test (tc32, test_set_naming_regular);
+    suite_add_tcase (s, tc32);
+
     /* Return created suite */
     return s;
 }
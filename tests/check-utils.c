@@ -370,6 +370,10 @@ create_full_featured_descriptor (GstElement *gst_element)
             (GDigicamManagerFunc) _dummy_manager_func;
         descriptor->handle_sync_bus_message_func =
             (GDigicamManagerFunc) _dummy_manager_func;
+        descriptor->set_window_geometry_func =
+            (GDigicamManagerFunc) _dummy_manager_func;
+        descriptor->handle_picture_done_func =
+            (GDigicamManagerFunc) _dummy_manager_func;
         descriptor->set_exposure_comp_func =
             (GDigicamManagerFunc) _dummy_manager_func;
 	descriptor->supported_qualities = descriptor->supported_qualities |
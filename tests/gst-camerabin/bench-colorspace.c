@@ -0,0 +1,222 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Microbenchmark of the preview colorspace conversion.
+ *
+ * Converts the same frames with every GDigicam kernel available in the
+ * running CPU and with ffmpegcolorspace, which is what camerabin uses
+ * when RGB previews are requested.
+ *
+ * Usage: bench-colorspace [WIDTH HEIGHT [FRAMES]]
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include "gdigicam-camerabin-colorspace.h"
+
+#define DEFAULT_WIDTH  640
+#define DEFAULT_HEIGHT 480
+#define DEFAULT_FRAMES 200
+
+
+static gdouble
+_run_pipeline (const gchar *description)
+{
+    GstElement *pipeline = NULL;
+    GstBus *bus = NULL;
+    GstMessage *message = NULL;
+    GError *error = NULL;
+    GTimer *timer = NULL;
+    gdouble elapsed = -1;
+
+    pipeline = gst_parse_launch (description, &error);
+    if (NULL == pipeline) {
+        g_printerr ("Unable to build \"%s\": %s\n",
+                    description, error->message);
+        g_error_free (error);
+        return elapsed;
+    }
+
+    /* Preroll first, so only the streaming is measured */
+    gst_element_set_state (pipeline, GST_STATE_PAUSED);
+    gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+
+    timer = g_timer_new ();
+    gst_element_set_state (pipeline, GST_STATE_PLAYING);
+    bus = gst_element_get_bus (pipeline);
+    message = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+                                          GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    if (GST_MESSAGE_EOS == GST_MESSAGE_TYPE (message)) {
+        elapsed = g_timer_elapsed (timer, NULL);
+    }
+
+    gst_message_unref (message);
+    gst_object_unref (bus);
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    gst_object_unref (pipeline);
+    g_timer_destroy (timer);
+
+    return elapsed;
+}
+
+
+static void
+_bench_ffmpegcolorspace (GstVideoFormat format,
+                         gint width, gint height, gint frames)
+{
+    gchar *caps = NULL;
+    gchar *description = NULL;
+    gdouble source, total;
+    guint32 fourcc;
+
+    fourcc = gst_video_format_to_fourcc (format);
+    caps = g_strdup_printf ("video/x-raw-yuv,format=(fourcc)%" GST_FOURCC_FORMAT
+                            ",width=%d,height=%d",
+                            GST_FOURCC_ARGS (fourcc), width, height);
+
+    /* The source alone, to substract it from the conversion */
+    description = g_strdup_printf ("videotestsrc num-buffers=%d pattern=snow ! "
+                                   "%s ! fakesink",
+                                   frames, caps);
+    source = _run_pipeline (description);
+    g_free (description);
+
+    description = g_strdup_printf ("videotestsrc num-buffers=%d pattern=snow ! "
+                                   "%s ! ffmpegcolorspace ! "
+                                   "video/x-raw-rgb,bpp=24,depth=24 ! fakesink",
+                                   frames, caps);
+    total = _run_pipeline (description);
+    g_free (description);
+    g_free (caps);
+
+    if ((0 > source) || (0 > total)) {
+        return;
+    }
+
+    g_print ("%" GST_FOURCC_FORMAT "  %-16s %8.3f ms/frame\n",
+             GST_FOURCC_ARGS (fourcc), "ffmpegcolorspace",
+             MAX (0, total - source) * 1000 / frames);
+}
+
+
+static void
+_bench_kernel (GstVideoFormat format, guint simd, const gchar *name,
+               const guchar *src, guchar *dst,
+               gint width, gint height, gint frames)
+{
+    GTimer *timer = NULL;
+    guint32 fourcc;
+    gint i;
+
+    _g_digicam_camerabin_colorspace_set_simd (simd);
+
+    /* Warm up caches and the kernel selection */
+    _g_digicam_camerabin_colorspace_convert (format, src, width, height,
+                                             dst, width * 3, FALSE);
+
+    timer = g_timer_new ();
+    for (i = 0; i < frames; i++) {
+        _g_digicam_camerabin_colorspace_convert (format, src, width, height,
+                                                 dst, width * 3, FALSE);
+    }
+
+    fourcc = gst_video_format_to_fourcc (format);
+    g_print ("%" GST_FOURCC_FORMAT "  %-16s %8.3f ms/frame\n",
+             GST_FOURCC_ARGS (fourcc), name,
+             g_timer_elapsed (timer, NULL) * 1000 / frames);
+
+    g_timer_destroy (timer);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    const GstVideoFormat formats[] = { GST_VIDEO_FORMAT_I420,
+                                       GST_VIDEO_FORMAT_NV12,
+                                       GST_VIDEO_FORMAT_UYVY };
+    const struct {
+        guint simd;
+        const gchar *name;
+    } kernels[] = {
+        { G_DIGICAM_CAMERABIN_SIMD_NONE, "gdigicam C" },
+        { G_DIGICAM_CAMERABIN_SIMD_SSE2, "gdigicam SSE2" },
+        { G_DIGICAM_CAMERABIN_SIMD_AVX2, "gdigicam AVX2" },
+        { G_DIGICAM_CAMERABIN_SIMD_NEON, "gdigicam NEON" },
+    };
+    guchar *src = NULL;
+    guchar *dst = NULL;
+    guint available;
+    gint width = DEFAULT_WIDTH;
+    gint height = DEFAULT_HEIGHT;
+    gint frames = DEFAULT_FRAMES;
+    gint size;
+    guint f, k;
+    gint i;
+
+    gst_init (&argc, &argv);
+
+    if (3 <= argc) {
+        width = atoi (argv[1]);
+        height = atoi (argv[2]);
+    }
+    if (4 <= argc) {
+        frames = atoi (argv[3]);
+    }
+    if ((0 >= width) || (0 >= height) || (0 >= frames)) {
+        g_printerr ("Usage: %s [WIDTH HEIGHT [FRAMES]]\n", argv[0]);
+        return 1;
+    }
+
+    available = _g_digicam_camerabin_colorspace_get_simd ();
+    g_print ("%dx%d, %d frames\n", width, height, frames);
+
+    for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+        size = gst_video_format_get_size (formats[f], width, height);
+        src = g_malloc (size);
+        dst = g_malloc (width * height * 3);
+        for (i = 0; i < size; i++) {
+            src[i] = g_random_int_range (0, 256);
+        }
+
+        for (k = 0; k < G_N_ELEMENTS (kernels); k++) {
+            if ((G_DIGICAM_CAMERABIN_SIMD_NONE != kernels[k].simd) &&
+                !(available & kernels[k].simd)) {
+                continue;
+            }
+            _bench_kernel (formats[f], kernels[k].simd, kernels[k].name,
+                           src, dst, width, height, frames);
+        }
+        _g_digicam_camerabin_colorspace_set_simd (~0U);
+
+        _bench_ffmpegcolorspace (formats[f], width, height, frames);
+
+        g_free (src);
+        g_free (dst);
+    }
+
+    return 0;
+}
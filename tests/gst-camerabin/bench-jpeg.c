@@ -0,0 +1,221 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Microbenchmark of the still picture JPEG encoding.
+ *
+ * Encodes the same frames with the GDigicam encoder, whole and split
+ * in an increasing number of parallel strips, and with jpegenc, which
+ * is the stock CameraBin image encoder.
+ *
+ * Usage: bench-jpeg [WIDTH HEIGHT [FRAMES]]
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gst/gst.h>
+
+#include "gdigicam-camerabin-jpeg.h"
+
+#define DEFAULT_WIDTH  2576
+#define DEFAULT_HEIGHT 1936
+#define DEFAULT_FRAMES 10
+#define DEFAULT_QUALITY 85
+
+
+static gdouble
+_run_pipeline (const gchar *description)
+{
+    GstElement *pipeline = NULL;
+    GstBus *bus = NULL;
+    GstMessage *message = NULL;
+    GError *error = NULL;
+    GTimer *timer = NULL;
+    gdouble elapsed = -1;
+
+    pipeline = gst_parse_launch (description, &error);
+    if (NULL == pipeline) {
+        g_printerr ("Unable to build \"%s\": %s\n",
+                    description, error->message);
+        g_error_free (error);
+        return elapsed;
+    }
+
+    /* Preroll first, so only the streaming is measured */
+    gst_element_set_state (pipeline, GST_STATE_PAUSED);
+    gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+
+    timer = g_timer_new ();
+    gst_element_set_state (pipeline, GST_STATE_PLAYING);
+    bus = gst_element_get_bus (pipeline);
+    message = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+                                          GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    if (GST_MESSAGE_EOS == GST_MESSAGE_TYPE (message)) {
+        elapsed = g_timer_elapsed (timer, NULL);
+    }
+
+    gst_message_unref (message);
+    gst_object_unref (bus);
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    gst_object_unref (pipeline);
+    g_timer_destroy (timer);
+
+    return elapsed;
+}
+
+
+static void
+_bench_jpegenc (GstVideoFormat format,
+                gint width, gint height, gint frames)
+{
+    gchar *caps = NULL;
+    gchar *description = NULL;
+    gdouble source, total;
+    guint32 fourcc;
+
+    fourcc = gst_video_format_to_fourcc (format);
+    caps = g_strdup_printf ("video/x-raw-yuv,format=(fourcc)%" GST_FOURCC_FORMAT
+                            ",width=%d,height=%d",
+                            GST_FOURCC_ARGS (fourcc), width, height);
+
+    /* The source alone, to substract it from the encoding */
+    description = g_strdup_printf ("videotestsrc num-buffers=%d pattern=snow ! "
+                                   "%s ! fakesink",
+                                   frames, caps);
+    source = _run_pipeline (description);
+    g_free (description);
+
+    description = g_strdup_printf ("videotestsrc num-buffers=%d pattern=snow ! "
+                                   "%s ! jpegenc quality=%d ! fakesink",
+                                   frames, caps, DEFAULT_QUALITY);
+    total = _run_pipeline (description);
+    g_free (description);
+    g_free (caps);
+
+    if ((0 > source) || (0 > total)) {
+        return;
+    }
+
+    g_print ("%" GST_FOURCC_FORMAT "  %-16s %8.3f ms/frame\n",
+             GST_FOURCC_ARGS (fourcc), "jpegenc",
+             MAX (0, total - source) * 1000 / frames);
+}
+
+
+static void
+_bench_strips (GstVideoFormat format, guint strips,
+               const guchar *src,
+               gint width, gint height, gint frames)
+{
+    GTimer *timer = NULL;
+    guchar *data = NULL;
+    gsize size = 0;
+    gchar *name = NULL;
+    guint32 fourcc;
+    gint i;
+
+    timer = g_timer_new ();
+    for (i = 0; i < frames; i++) {
+        _g_digicam_camerabin_jpeg_encode_strips (format, src, width, height,
+                                                 DEFAULT_QUALITY, strips,
+                                                 &data, &size);
+        g_free (data);
+    }
+
+    fourcc = gst_video_format_to_fourcc (format);
+    name = g_strdup_printf ("gdigicam %u strip%s", strips,
+                            (1 == strips) ? "" : "s");
+    g_print ("%" GST_FOURCC_FORMAT "  %-16s %8.3f ms/frame, %" G_GSIZE_FORMAT
+             " bytes\n",
+             GST_FOURCC_ARGS (fourcc), name,
+             g_timer_elapsed (timer, NULL) * 1000 / frames, size);
+
+    g_free (name);
+    g_timer_destroy (timer);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    const GstVideoFormat formats[] = { GST_VIDEO_FORMAT_I420,
+                                       GST_VIDEO_FORMAT_NV12,
+                                       GST_VIDEO_FORMAT_UYVY };
+    guchar *src = NULL;
+    guchar *data = NULL;
+    gint width = DEFAULT_WIDTH;
+    gint height = DEFAULT_HEIGHT;
+    gint frames = DEFAULT_FRAMES;
+    gint cores = 1;
+    gsize encoded;
+    gint size;
+    guint f, strips;
+    gint i;
+
+    gst_init (&argc, &argv);
+
+    if (3 <= argc) {
+        width = atoi (argv[1]);
+        height = atoi (argv[2]);
+    }
+    if (4 <= argc) {
+        frames = atoi (argv[3]);
+    }
+    if ((0 >= width) || (0 >= height) || (0 >= frames)) {
+        g_printerr ("Usage: %s [WIDTH HEIGHT [FRAMES]]\n", argv[0]);
+        return 1;
+    }
+
+#ifdef _SC_NPROCESSORS_ONLN
+    cores = MAX (1, sysconf (_SC_NPROCESSORS_ONLN));
+#endif
+    g_print ("%dx%d, %d frames, %d cores\n", width, height, frames, cores);
+
+    for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+        size = gst_video_format_get_size (formats[f], width, height);
+        src = g_malloc (size);
+        for (i = 0; i < size; i++) {
+            src[i] = g_random_int_range (0, 256);
+        }
+
+        /* Warm up caches and the strip threads */
+        _g_digicam_camerabin_jpeg_encode_strips (formats[f], src, width, height,
+                                                 DEFAULT_QUALITY, cores,
+                                                 &data, &encoded);
+        g_free (data);
+
+        for (strips = 1; strips <= (guint) cores; strips *= 2) {
+            _bench_strips (formats[f], strips, src, width, height, frames);
+        }
+        if (strips / 2 != (guint) cores) {
+            _bench_strips (formats[f], cores, src, width, height, frames);
+        }
+
+        _bench_jpegenc (formats[f], width, height, frames);
+
+        g_free (src);
+    }
+
+    return 0;
+}
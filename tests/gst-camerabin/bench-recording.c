@@ -0,0 +1,242 @@
+/*
+ * This file is part of GDigicam
+ *
+ * Copyright (C) 2008-2009 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Contact: Alexander Bokovoy <alexander.bokovoy@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/*
+ * Microbenchmark of the handling of the recording files.
+ *
+ * Writes a file the way a muxer does, in small appends, as it is,
+ * with space reserved ahead, flushed as it grows, and both. Prints the
+ * percentiles of the write latency, and the most dirty memory seen by
+ * the system while writing. The writes are not paced, so the data of
+ * a long recording is written in a few seconds.
+ *
+ * Usage: bench-recording [DIRECTORY [SECONDS [BITRATE]]]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "gdigicam-camerabin-prealloc.h"
+#include "gdigicam-camerabin-writeback.h"
+
+#define DEFAULT_SECONDS 60
+#define DEFAULT_BITRATE 8000000
+#define CHUNK_SIZE (16 * 1024)
+#define PREALLOC_SECONDS 10
+#define WRITEBACK_WINDOW (2 * 1024 * 1024)
+
+enum {
+    USE_PREALLOC = 1 << 0,
+    USE_WRITEBACK = 1 << 1
+};
+
+
+static gint
+_compare_doubles (gconstpointer a,
+                  gconstpointer b)
+{
+    gdouble x = *(const gdouble *) a;
+    gdouble y = *(const gdouble *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/* Dirty memory of the whole system, in KiB, or 0 if unknown */
+static guint64
+_get_dirty (void)
+{
+    gchar *contents = NULL;
+    gchar *line = NULL;
+    guint64 dirty = 0;
+
+    if (g_file_get_contents ("/proc/meminfo", &contents, NULL, NULL)) {
+        line = strstr (contents, "\nDirty:");
+        if (NULL != line) {
+            dirty = g_ascii_strtoull (line + strlen ("\nDirty:"), NULL, 10);
+        }
+        g_free (contents);
+    }
+
+    return dirty;
+}
+
+
+static gboolean
+_bench_recording (const gchar *directory, gint seconds, gint bitrate,
+                  guint flags)
+{
+    GDigicamCamerabinPrealloc *prealloc = NULL;
+    GDigicamCamerabinWriteback *writeback = NULL;
+    GError *error = NULL;
+    GTimer *timer = NULL;
+    GTimer *total = NULL;
+    gchar *filename = NULL;
+    gchar *chunk = NULL;
+    gdouble *latencies = NULL;
+    guint64 dirty = 0;
+    gsize per_second, done;
+    gint n_chunks, i, fd;
+
+    filename = g_build_filename (directory, "bench-recording.mp4", NULL);
+    fd = g_open (filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (0 > fd) {
+        g_printerr ("Unable to create %s: %s\n",
+                    filename, g_strerror (errno));
+        g_free (filename);
+        return FALSE;
+    }
+
+    if (flags & USE_PREALLOC) {
+        prealloc = _g_digicam_camerabin_prealloc_new (filename, bitrate,
+                                                      PREALLOC_SECONDS,
+                                                      &error);
+    }
+    if ((NULL == error) && (flags & USE_WRITEBACK)) {
+        writeback = _g_digicam_camerabin_writeback_new (filename,
+                                                        WRITEBACK_WINDOW,
+                                                        &error);
+    }
+    if (NULL != error) {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        if (NULL != prealloc) {
+            _g_digicam_camerabin_prealloc_finish (prealloc, NULL);
+        }
+        close (fd);
+        g_unlink (filename);
+        g_free (filename);
+        return FALSE;
+    }
+
+    /* Start from a clean page cache, as far as this file goes */
+    sync ();
+
+    per_second = bitrate / 8;
+    n_chunks = (gint) (per_second * seconds / CHUNK_SIZE);
+    chunk = g_malloc (CHUNK_SIZE);
+    memset (chunk, 0x5a, CHUNK_SIZE);
+    latencies = g_new (gdouble, n_chunks);
+    timer = g_timer_new ();
+    total = g_timer_new ();
+
+    for (i = 0, done = 0; i < n_chunks; i++) {
+        g_timer_start (timer);
+        if (NULL != prealloc) {
+            _g_digicam_camerabin_prealloc_written (prealloc, CHUNK_SIZE);
+        }
+        if (NULL != writeback) {
+            _g_digicam_camerabin_writeback_written (writeback, CHUNK_SIZE);
+        }
+        if (CHUNK_SIZE != write (fd, chunk, CHUNK_SIZE)) {
+            g_printerr ("Unable to write %s: %s\n",
+                        filename, g_strerror (errno));
+            break;
+        }
+        latencies[i] = g_timer_elapsed (timer, NULL) * 1000;
+
+        done += CHUNK_SIZE;
+        if (done >= per_second) {
+            dirty = MAX (dirty, _get_dirty ());
+            done = 0;
+        }
+    }
+    n_chunks = i;
+
+    close (fd);
+    if (NULL != prealloc) {
+        _g_digicam_camerabin_prealloc_finish (prealloc, NULL);
+    }
+    if (NULL != writeback) {
+        _g_digicam_camerabin_writeback_finish (writeback);
+    }
+
+    qsort (latencies, n_chunks, sizeof (gdouble), _compare_doubles);
+    if (0 < n_chunks) {
+        g_print ("%-11s p50 %6.3f  p90 %6.3f  p99 %6.3f  p99.9 %7.3f  "
+                 "max %8.3f ms  %6.1f MB/s  dirty %6" G_GUINT64_FORMAT
+                 " KiB\n",
+                 (USE_PREALLOC | USE_WRITEBACK) == flags ? "both" :
+                 (USE_PREALLOC == flags) ? "prealloc" :
+                 (USE_WRITEBACK == flags) ? "writeback" : "plain",
+                 latencies[n_chunks / 2],
+                 latencies[n_chunks * 90 / 100],
+                 latencies[n_chunks * 99 / 100],
+                 latencies[n_chunks * 999 / 1000],
+                 latencies[n_chunks - 1],
+                 (gdouble) n_chunks * CHUNK_SIZE /
+                 g_timer_elapsed (total, NULL) / 1000000,
+                 dirty);
+    }
+
+    g_unlink (filename);
+
+    g_timer_destroy (total);
+    g_timer_destroy (timer);
+    g_free (latencies);
+    g_free (chunk);
+    g_free (filename);
+
+    return TRUE;
+}
+
+
+int
+main (int argc, char **argv)
+{
+    const gchar *directory = NULL;
+    gint seconds = DEFAULT_SECONDS;
+    gint bitrate = DEFAULT_BITRATE;
+    guint flags;
+
+    directory = g_get_tmp_dir ();
+    if (2 <= argc) {
+        directory = argv[1];
+    }
+    if (3 <= argc) {
+        seconds = atoi (argv[2]);
+    }
+    if (4 <= argc) {
+        bitrate = atoi (argv[3]);
+    }
+    if ((0 >= seconds) || (CHUNK_SIZE * 8 > bitrate)) {
+        g_printerr ("Usage: %s [DIRECTORY [SECONDS [BITRATE]]]\n", argv[0]);
+        return 1;
+    }
+
+    g_print ("%s, %d s at %d bit/s, %d bytes per write\n",
+             directory, seconds, bitrate, CHUNK_SIZE);
+
+    for (flags = 0; flags <= (USE_PREALLOC | USE_WRITEBACK); flags++) {
+        _bench_recording (directory, seconds, bitrate, flags);
+    }
+
+    return 0;
+}
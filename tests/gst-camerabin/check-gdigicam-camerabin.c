@@ -21,13 +21,34 @@
  *
  */
 
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
 #include <check.h>
+#include <glib/gstdio.h>
+
+#include <config.h>
 
 #include "check-utils.h"
 
 #include "test_suites.h"
 #include "gdigicam-util.h"
 #include "gdigicam-camerabin.h"
+#include "gdigicam-camerabin-colorspace.h"
+#ifdef HAVE_JPEG
+#include "gdigicam-camerabin-encoder.h"
+#include "gdigicam-camerabin-jpeg.h"
+#endif
+#include "gdigicam-camerabin-metadata.h"
+#include "gdigicam-camerabin-output.h"
+#include "gdigicam-camerabin-prealloc.h"
+#include "gdigicam-camerabin-prerecord.h"
+#include "gdigicam-camerabin-segmenter.h"
+#include "gdigicam-camerabin-writeback.h"
+#include "gdigicam-camerabin-writer.h"
+#include "gdigicam-camerabin-xmp.h"
 
 static GstElement *minimum_camera_bin = NULL;
 static GstElement *simple_camerabin = NULL;
@@ -154,6 +175,228 @@ START_TEST (test_g_digicam_camerabin_element_new_regular)
 }
 END_TEST
 
+/* ----- Test case for element_new_async -----*/
+
+static void
+_element_ready_cb (GDigicamManager *manager,
+                   GstElement *gst_camera_bin,
+                   gint colorkey,
+                   const GError *error,
+                   gpointer user_data)
+{
+    GMainLoop *loop = (GMainLoop *) user_data;
+
+    if (NULL != gst_camera_bin) {
+        simple_camerabin = GST_ELEMENT (gst_object_ref (GST_OBJECT (gst_camera_bin)));
+    }
+
+    g_main_loop_quit (loop);
+}
+
+/**
+ * Purpose: test the asynchronous creation of a #GstElement CameraBin
+ * in the regular cases.
+ * Cases considered:
+ *    - Request a #GstElement CameraBin with regular elements.
+ *    - Recycle it and request it again, so it is taken from the pool.
+ */
+START_TEST (test_g_digicam_camerabin_element_new_async_regular)
+{
+    GMainLoop *loop = NULL;
+    GstElement *first_camerabin = NULL;
+    gboolean result;
+
+    loop = g_main_loop_new (NULL, FALSE);
+
+    /* Case 1 */
+    result = g_digicam_camerabin_element_new_async (NULL,
+                                                    "videotestsrc",
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    VIDEO_SINK,
+                                                    _element_ready_cb,
+                                                    loop);
+    fail_if (!result,
+             "g-digicam-camerabin: the asynchronous creation "
+             "couldn't be started.");
+
+    g_main_loop_run (loop);
+
+    /* Check that the GstElement object has been created properly */
+    fail_if (!GST_IS_ELEMENT (simple_camerabin),
+             "g-digicam-camerabin: the returned camerabin"
+             "is not a valid GstElement.");
+
+    /* Case 2 */
+    first_camerabin = simple_camerabin;
+    simple_camerabin = NULL;
+    g_digicam_camerabin_element_recycle (first_camerabin);
+
+    result = g_digicam_camerabin_element_new_async (NULL,
+                                                    "videotestsrc",
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    VIDEO_SINK,
+                                                    _element_ready_cb,
+                                                    loop);
+    fail_if (!result,
+             "g-digicam-camerabin: the asynchronous creation "
+             "couldn't be started.");
+
+    g_main_loop_run (loop);
+
+    /* Check that the pooled GstElement has been reused */
+    fail_if (first_camerabin != simple_camerabin,
+             "g-digicam-camerabin: the recycled camerabin"
+             "has not been reused.");
+
+    gst_object_unref (GST_OBJECT (simple_camerabin));
+    simple_camerabin = NULL;
+
+    g_main_loop_unref (loop);
+}
+END_TEST
+
+static gboolean
+_recycled_picture_done_cb (GstElement *gst_camera_bin,
+                           const gchar *filename,
+                           gpointer user_data)
+{
+    return TRUE;
+}
+
+/**
+ * Purpose: test that a #GstElement CameraBin used by a
+ * #GDigicamManager comes back clean from the pool.
+ * Cases considered:
+ *    - Set up the CameraBin in a manager, free the manager and
+ *      recycle it, checking that no handler is left behind.
+ *    - Check that the capture settings have been reset.
+ */
+START_TEST (test_g_digicam_camerabin_element_recycle_manager)
+{
+    GDigicamDescriptor *recycle_descriptor = NULL;
+    GDigicamManager *manager = NULL;
+    GstElement *first_camerabin = NULL;
+    GstCaps *caps = NULL;
+    GMainLoop *loop = NULL;
+    gchar *filename = NULL;
+    guint signal_id;
+    gint mode;
+    gboolean result;
+
+    loop = g_main_loop_new (NULL, FALSE);
+
+    result = g_digicam_camerabin_element_new_async (NULL,
+                                                    "videotestsrc",
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    VIDEO_SINK,
+                                                    _element_ready_cb,
+                                                    loop);
+    fail_if (!result,
+             "g-digicam-camerabin: the asynchronous creation "
+             "couldn't be started.");
+    g_main_loop_run (loop);
+    fail_if (!GST_IS_ELEMENT (simple_camerabin),
+             "g-digicam-camerabin: the returned camerabin"
+             "is not a valid GstElement.");
+
+    recycle_descriptor = g_digicam_camerabin_descriptor_new (simple_camerabin);
+    manager = g_digicam_manager_new ();
+    fail_if (!g_digicam_manager_set_gstreamer_bin (manager, simple_camerabin,
+                                                   recycle_descriptor,
+                                                   NULL),
+             "g-digicam-camerabin: camerabin not set in the manager.");
+    g_signal_connect (simple_camerabin, "img-done",
+                      G_CALLBACK (_recycled_picture_done_cb), NULL);
+    caps = gst_caps_new_simple ("video/x-raw-yuv",
+                                "width", G_TYPE_INT, 160,
+                                "height", G_TYPE_INT, 120,
+                                NULL);
+    g_object_set (simple_camerabin,
+                  "filename", "/tmp/gdigicam-recycle.jpg",
+                  "preview-caps", caps,
+                  "mode", 1,
+                  NULL);
+    gst_caps_unref (caps);
+    caps = NULL;
+
+    /* Test 1 */
+    g_object_unref (manager);
+    g_digicam_manager_descriptor_free (recycle_descriptor);
+    first_camerabin = simple_camerabin;
+    simple_camerabin = NULL;
+    g_digicam_camerabin_element_recycle (first_camerabin);
+
+    result = g_digicam_camerabin_element_new_async (NULL,
+                                                    "videotestsrc",
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    VIDEO_SINK,
+                                                    _element_ready_cb,
+                                                    loop);
+    fail_if (!result,
+             "g-digicam-camerabin: the asynchronous creation "
+             "couldn't be started.");
+    g_main_loop_run (loop);
+    fail_if (first_camerabin != simple_camerabin,
+             "g-digicam-camerabin: the recycled camerabin"
+             "has not been reused.");
+
+    signal_id = g_signal_lookup ("img-done", G_OBJECT_TYPE (simple_camerabin));
+    fail_if (0 != g_signal_handler_find (simple_camerabin,
+                                         G_SIGNAL_MATCH_ID |
+                                         G_SIGNAL_MATCH_DATA,
+                                         signal_id, 0, NULL, NULL,
+                                         manager),
+             "g-digicam-camerabin: the manager handler is still "
+             "connected.");
+    fail_if (0 != g_signal_handler_find (simple_camerabin,
+                                         G_SIGNAL_MATCH_FUNC,
+                                         0, 0, NULL,
+                                         _recycled_picture_done_cb,
+                                         NULL),
+             "g-digicam-camerabin: the user handler is still "
+             "connected.");
+
+    /* Test 2 */
+    g_object_get (simple_camerabin,
+                  "filename", &filename,
+                  "preview-caps", &caps,
+                  "mode", &mode,
+                  NULL);
+    fail_if ((NULL != filename) && ('\0' != filename[0]),
+             "g-digicam-camerabin: the filename has not been reset.");
+    fail_if (NULL != caps,
+             "g-digicam-camerabin: the preview caps have not been reset.");
+    fail_if (0 != mode,
+             "g-digicam-camerabin: the mode has not been reset.");
+    g_free (filename);
+
+    gst_object_unref (GST_OBJECT (simple_camerabin));
+    simple_camerabin = NULL;
+
+    g_main_loop_unref (loop);
+}
+END_TEST
+
 /* ----- Test case for descriptor_new -----*/
 
 /**
@@ -273,6 +516,1572 @@ START_TEST (test_g_digicam_camerabin_descriptor_new_regular)
 }
 END_TEST
 
+/**
+ * Purpose: test the YUV to RGB conversion of previews.
+ * Cases considered:
+ *    - unsupported formats are rejected.
+ *    - black and white are converted exactly in every format.
+ *    - every available SIMD kernel gives the same result as the C one.
+ */
+START_TEST (test_g_digicam_camerabin_colorspace_regular)
+{
+    const GstVideoFormat formats[] = { GST_VIDEO_FORMAT_I420,
+                                       GST_VIDEO_FORMAT_NV12,
+                                       GST_VIDEO_FORMAT_UYVY };
+    const gint sizes[][2] = { { 640, 480 }, { 97, 5 }, { 33, 3 }, { 1, 1 } };
+    guchar *src = NULL;
+    guchar *plain = NULL;
+    guchar *simd = NULL;
+    guint available;
+    gint size, stride;
+    gint f, i, j, k, alpha;
+
+    available = _g_digicam_camerabin_colorspace_get_simd ();
+    src = g_malloc (640 * 480 * 2);
+    plain = g_malloc (640 * 480 * 4);
+    simd = g_malloc (640 * 480 * 4);
+
+    /* Test 1 */
+    fail_if (_g_digicam_camerabin_colorspace_convert (GST_VIDEO_FORMAT_RGB,
+                                                      src, 16, 16,
+                                                      plain, 16 * 3,
+                                                      FALSE),
+             "g-digicam-camerabin: RGB previews were converted.");
+
+    for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+        /* Test 2 */
+        size = gst_video_format_get_size (formats[f], 64, 2);
+        for (k = 0; k < 2; k++) {
+            memset (src, 128, size);
+            for (i = 0; i < 2; i++) {
+                for (j = 0; j < 64; j++) {
+                    src[gst_video_format_get_component_offset (formats[f], 0, 64, 2) +
+                        i * gst_video_format_get_row_stride (formats[f], 0, 64) +
+                        j * gst_video_format_get_pixel_stride (formats[f], 0)] =
+                        (0 == k) ? 16 : 235;
+                }
+            }
+            fail_if (!_g_digicam_camerabin_colorspace_convert (formats[f],
+                                                               src, 64, 2,
+                                                               plain, 64 * 3,
+                                                               FALSE),
+                     "g-digicam-camerabin: format %d not converted.",
+                     formats[f]);
+            for (i = 0; i < 64 * 2 * 3; i++) {
+                fail_if (plain[i] != ((0 == k) ? 0 : 255),
+                         "g-digicam-camerabin: format %d gives %d at %d.",
+                         formats[f], plain[i], i);
+            }
+        }
+
+        /* Test 3 */
+        for (i = 0; i < 640 * 480 * 2; i++) {
+            src[i] = g_random_int_range (0, 256);
+        }
+        for (k = 0; k < G_N_ELEMENTS (sizes); k++) {
+            for (alpha = 0; alpha < 2; alpha++) {
+                stride = sizes[k][0] * (alpha ? 4 : 3);
+                size = stride * sizes[k][1];
+
+                _g_digicam_camerabin_colorspace_set_simd (G_DIGICAM_CAMERABIN_SIMD_NONE);
+                _g_digicam_camerabin_colorspace_convert (formats[f], src,
+                                                         sizes[k][0], sizes[k][1],
+                                                         plain, stride, alpha);
+
+                for (j = 1; j <= G_DIGICAM_CAMERABIN_SIMD_NEON; j <<= 1) {
+                    if (!(available & j)) {
+                        continue;
+                    }
+                    _g_digicam_camerabin_colorspace_set_simd (j);
+                    _g_digicam_camerabin_colorspace_convert (formats[f], src,
+                                                             sizes[k][0], sizes[k][1],
+                                                             simd, stride, alpha);
+                    fail_if (0 != memcmp (plain, simd, size),
+                             "g-digicam-camerabin: kernel 0x%x differs from "
+                             "the C one for format %d at %dx%d.",
+                             j, formats[f], sizes[k][0], sizes[k][1]);
+                }
+            }
+        }
+    }
+
+    _g_digicam_camerabin_colorspace_set_simd (~0U);
+    g_free (src);
+    g_free (plain);
+    g_free (simd);
+}
+END_TEST
+
+/**
+ * Purpose: test the metadata tags reused between captures.
+ * Cases considered:
+ *    - the same metadata gives back the same tag lists.
+ *    - a different orientation doesn't rebuild the tag lists.
+ *    - different metadata rebuilds the tag lists.
+ *    - the location names are joined in the video tags.
+ *    - the date has no fraction of second.
+ */
+START_TEST (test_g_digicam_camerabin_metadata_regular)
+{
+    GDigicamCamerabinMetadataSession *session = NULL;
+    GDigicamCamerabinMetadata metadata = { "model", "make", "author", "id",
+                                           "country", "city", "suburb",
+                                           G_MAXDOUBLE, G_MAXDOUBLE,
+                                           G_MAXDOUBLE, 1 };
+    const GstTagList *picture_tags = NULL;
+    const GstTagList *video_tags = NULL;
+    const gchar *date = NULL;
+    gchar *city = NULL;
+    gchar *geo_name = NULL;
+    gdouble latitude = 0;
+
+    session = _g_digicam_camerabin_metadata_session_new ();
+
+    /* Test 1 */
+    picture_tags = _g_digicam_camerabin_metadata_session_get_picture_tags (session,
+                                                                           &metadata);
+    video_tags = _g_digicam_camerabin_metadata_session_get_video_tags (session,
+                                                                       &metadata);
+    fail_if (NULL == picture_tags || NULL == video_tags,
+             "g-digicam-camerabin: no tags were built.");
+    city = g_strdup (metadata.city_name);
+    metadata.city_name = city;
+    fail_if (picture_tags !=
+             _g_digicam_camerabin_metadata_session_get_picture_tags (session,
+                                                                     &metadata),
+             "g-digicam-camerabin: picture tags were rebuilt.");
+
+    /* Test 2 */
+    metadata.orientation = 3;
+    fail_if (video_tags !=
+             _g_digicam_camerabin_metadata_session_get_video_tags (session,
+                                                                   &metadata),
+             "g-digicam-camerabin: video tags were rebuilt.");
+
+    /* Test 3 */
+    metadata.latitude = 60.17;
+    metadata.longitude = 24.94;
+    picture_tags = _g_digicam_camerabin_metadata_session_get_picture_tags (session,
+                                                                           &metadata);
+    fail_if (!gst_tag_list_get_double (picture_tags,
+                                       GST_TAG_GEO_LOCATION_LATITUDE,
+                                       &latitude) ||
+             60.17 != latitude,
+             "g-digicam-camerabin: picture tags were not rebuilt.");
+
+    /* Test 4 */
+    video_tags = _g_digicam_camerabin_metadata_session_get_video_tags (session,
+                                                                       &metadata);
+    fail_if (!gst_tag_list_get_string (video_tags,
+                                       GST_TAG_GEO_LOCATION_NAME,
+                                       &geo_name) ||
+             0 != strcmp ("country,city,suburb", geo_name),
+             "g-digicam-camerabin: wrong location name.");
+
+    /* Test 5 */
+    date = _g_digicam_camerabin_metadata_session_get_date (session);
+    fail_if (NULL == date || NULL != strchr (date, '.'),
+             "g-digicam-camerabin: wrong date \"%s\".", date);
+
+    _g_digicam_camerabin_metadata_session_free (session);
+    g_free (geo_name);
+    g_free (city);
+}
+END_TEST
+
+/**
+ * Purpose: test the XMP packets written after saving the pictures.
+ * Cases considered:
+ *    - files which are not JPEG are rejected.
+ *    - the metadata is escaped in the packet.
+ *    - the packet is put after the JFIF segment.
+ *    - a second packet replaces the first one, and the file gets a
+ *      new modification time, the one its thumbnails are made for.
+ */
+START_TEST (test_g_digicam_camerabin_xmp_regular)
+{
+    const guchar jpeg[] = { 0xff, 0xd8,
+                            0xff, 0xe0, 0x00, 0x06, 'J', 'F', 'I', 'F',
+                            0xff, 0xda, 0x00, 0x02, 0x12, 0x34,
+                            0xff, 0xd9 };
+    GDigicamCamerabinMetadata metadata = { "N900", "Nokia", "Tom & Jerry",
+                                           NULL, NULL, NULL, NULL,
+                                           24.94, 60.17, -1.5, 1 };
+    gchar *filename = NULL;
+    gchar *packet = NULL;
+    gchar *contents = NULL;
+    struct utimbuf times = { 1000000000, 1000000000 };
+    struct stat buf;
+    gsize length, first_length;
+    gint fd;
+
+    fd = g_file_open_tmp ("gdigicam-xmp-XXXXXX", &filename, NULL);
+    fail_if (0 > fd, "g-digicam-camerabin: unable to create a file.");
+    close (fd);
+
+    packet = _g_digicam_camerabin_xmp_packet_new (&metadata,
+                                                  "2009-06-01T12:00:00Z");
+
+    /* Test 1 */
+    g_file_set_contents (filename, "not a jpeg", -1, NULL);
+    fail_if (_g_digicam_camerabin_xmp_embed (filename, packet, NULL),
+             "g-digicam-camerabin: XMP written in a non JPEG file.");
+
+    /* Test 2 */
+    fail_if (NULL == strstr (packet, "<rdf:li>Tom &amp; Jerry</rdf:li>") ||
+             NULL == strstr (packet, "exif:GPSLatitude=\"60,10.2000N\"") ||
+             NULL == strstr (packet, "exif:GPSAltitude=\"150/100\""),
+             "g-digicam-camerabin: wrong XMP packet:\n%s", packet);
+
+    /* Test 3 */
+    g_file_set_contents (filename, (const gchar *) jpeg, sizeof (jpeg), NULL);
+    fail_if (!_g_digicam_camerabin_xmp_embed (filename, packet, NULL),
+             "g-digicam-camerabin: XMP not written.");
+    g_file_get_contents (filename, &contents, &first_length, NULL);
+    fail_if (first_length != sizeof (jpeg) + 4 + 29 + strlen (packet) ||
+             0 != memcmp (contents, jpeg, 10) ||
+             0xe1 != (guchar) contents[11] ||
+             0 != memcmp (contents + 14, "http://ns.adobe.com/xap/1.0/", 29) ||
+             0 != memcmp (contents + first_length - 8, jpeg + 10, 8),
+             "g-digicam-camerabin: XMP badly placed.");
+    g_free (contents);
+
+    /* Test 4 */
+    utime (filename, &times);
+    fail_if (!_g_digicam_camerabin_xmp_embed (filename, packet, NULL),
+             "g-digicam-camerabin: XMP not written again.");
+    g_file_get_contents (filename, &contents, &length, NULL);
+    fail_if (length != first_length,
+             "g-digicam-camerabin: XMP packet not replaced.");
+    g_free (contents);
+    fail_if ((0 != g_stat (filename, &buf)) ||
+             (times.modtime == buf.st_mtime),
+             "g-digicam-camerabin: modification time not updated.");
+
+    g_unlink (filename);
+    g_free (filename);
+    g_free (packet);
+}
+END_TEST
+
+/**
+ * Purpose: test the pre-record ring of video frames.
+ * Cases considered:
+ *    - the frames older than the duration are dropped.
+ *    - the frames not fitting in the maximum size are dropped.
+ *    - a frame older than the last one empties the ring.
+ *    - the frames are given back in order, with their duration.
+ */
+START_TEST (test_g_digicam_camerabin_prerecord_regular)
+{
+    GDigicamCamerabinPrerecord *prerecord = NULL;
+    GstBuffer *buffer = NULL;
+    GList *frames = NULL;
+    GstClockTime duration;
+    gint i;
+
+    /* Test 1 */
+    prerecord = _g_digicam_camerabin_prerecord_new (100 * GST_MSECOND, 10000);
+    for (i = 0; i < 10; i++) {
+        buffer = gst_buffer_new_and_alloc (1000);
+        GST_BUFFER_TIMESTAMP (buffer) = i * 40 * GST_MSECOND;
+        GST_BUFFER_DURATION (buffer) = 40 * GST_MSECOND;
+        _g_digicam_camerabin_prerecord_push (prerecord, buffer);
+    }
+    frames = _g_digicam_camerabin_prerecord_take (prerecord, &duration);
+    fail_if (3 != g_list_length (frames) ||
+             280 * GST_MSECOND != GST_BUFFER_TIMESTAMP (frames->data) ||
+             120 * GST_MSECOND != duration,
+             "g-digicam-camerabin: wrong frames kept by duration.");
+    g_list_foreach (frames, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (frames);
+    _g_digicam_camerabin_prerecord_free (prerecord);
+
+    /* Test 2 */
+    prerecord = _g_digicam_camerabin_prerecord_new (GST_SECOND, 2500);
+    for (i = 0; i < 10; i++) {
+        buffer = gst_buffer_new_and_alloc (1000);
+        GST_BUFFER_TIMESTAMP (buffer) = i * 40 * GST_MSECOND;
+        _g_digicam_camerabin_prerecord_push (prerecord, buffer);
+    }
+    frames = _g_digicam_camerabin_prerecord_take (prerecord, &duration);
+    fail_if (2 != g_list_length (frames) ||
+             80 * GST_MSECOND != duration,
+             "g-digicam-camerabin: wrong frames kept by size.");
+    g_list_foreach (frames, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (frames);
+
+    /* Test 3 */
+    for (i = 5; i >= 4; i--) {
+        buffer = gst_buffer_new_and_alloc (1000);
+        GST_BUFFER_TIMESTAMP (buffer) = i * 40 * GST_MSECOND;
+        _g_digicam_camerabin_prerecord_push (prerecord, buffer);
+    }
+    frames = _g_digicam_camerabin_prerecord_take (prerecord, &duration);
+    fail_if (1 != g_list_length (frames) ||
+             160 * GST_MSECOND != GST_BUFFER_TIMESTAMP (frames->data) ||
+             0 != duration,
+             "g-digicam-camerabin: ring not emptied by an older frame.");
+    g_list_foreach (frames, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (frames);
+
+    /* Test 4 */
+    frames = _g_digicam_camerabin_prerecord_take (prerecord, &duration);
+    fail_if (NULL != frames || 0 != duration,
+             "g-digicam-camerabin: frames given back twice.");
+    _g_digicam_camerabin_prerecord_free (prerecord);
+}
+END_TEST
+
+/**
+ * Purpose: test the lookup of the zero shutter lag frame.
+ * Cases considered:
+ *    - an empty ring has no frame.
+ *    - the frame closest to the timestamp is picked, before or after.
+ *    - the picked frame stays in the ring.
+ */
+START_TEST (test_g_digicam_camerabin_prerecord_pick)
+{
+    GDigicamCamerabinPrerecord *prerecord = NULL;
+    GstBuffer *buffer = NULL;
+    GList *frames = NULL;
+    gint i;
+
+    /* Test 1 */
+    prerecord = _g_digicam_camerabin_prerecord_new (GST_SECOND, 10000);
+    fail_if (NULL != _g_digicam_camerabin_prerecord_pick (prerecord, 0),
+             "g-digicam-camerabin: frame picked from an empty ring.");
+
+    /* Test 2 */
+    for (i = 0; i < 5; i++) {
+        buffer = gst_buffer_new_and_alloc (1000);
+        GST_BUFFER_TIMESTAMP (buffer) = i * 40 * GST_MSECOND;
+        _g_digicam_camerabin_prerecord_push (prerecord, buffer);
+    }
+    buffer = _g_digicam_camerabin_prerecord_pick (prerecord, 90 * GST_MSECOND);
+    fail_if (NULL == buffer ||
+             80 * GST_MSECOND != GST_BUFFER_TIMESTAMP (buffer),
+             "g-digicam-camerabin: wrong frame picked before.");
+    gst_buffer_unref (buffer);
+    buffer = _g_digicam_camerabin_prerecord_pick (prerecord, 110 * GST_MSECOND);
+    fail_if (NULL == buffer ||
+             120 * GST_MSECOND != GST_BUFFER_TIMESTAMP (buffer),
+             "g-digicam-camerabin: wrong frame picked after.");
+    gst_buffer_unref (buffer);
+    buffer = _g_digicam_camerabin_prerecord_pick (prerecord, GST_SECOND);
+    fail_if (NULL == buffer ||
+             160 * GST_MSECOND != GST_BUFFER_TIMESTAMP (buffer),
+             "g-digicam-camerabin: last frame not picked.");
+    gst_buffer_unref (buffer);
+
+    /* Test 3 */
+    frames = _g_digicam_camerabin_prerecord_take (prerecord, NULL);
+    fail_if (5 != g_list_length (frames),
+             "g-digicam-camerabin: picked frames removed from the ring.");
+    g_list_foreach (frames, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (frames);
+    _g_digicam_camerabin_prerecord_free (prerecord);
+}
+END_TEST
+
+#ifdef HAVE_JPEG
+/**
+ * Purpose: test the JPEG encoding of the zero shutter lag frames.
+ * Cases considered:
+ *    - an unsupported format is refused.
+ *    - every supported format gives a whole JPEG file, for sizes
+ *      which are not a multiple of the blocks too.
+ */
+START_TEST (test_g_digicam_camerabin_jpeg_regular)
+{
+    const GstVideoFormat formats[] = { GST_VIDEO_FORMAT_I420,
+                                       GST_VIDEO_FORMAT_NV12,
+                                       GST_VIDEO_FORMAT_UYVY };
+    const gint sizes[][2] = { { 64, 48 }, { 33, 17 }, { 2, 2 } };
+    guchar *src = NULL;
+    guchar *data = NULL;
+    gsize size;
+    guint f, s;
+
+    /* Test 1 */
+    src = g_malloc0 (64 * 48 * 4);
+    fail_if (_g_digicam_camerabin_jpeg_encode (GST_VIDEO_FORMAT_RGB, src,
+                                               64, 48, 85, &data, &size),
+             "g-digicam-camerabin: RGB frame encoded.");
+
+    /* Test 2 */
+    for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+        for (s = 0; s < G_N_ELEMENTS (sizes); s++) {
+            data = NULL;
+            size = 0;
+            fail_if (!_g_digicam_camerabin_jpeg_encode (formats[f], src,
+                                                        sizes[s][0], sizes[s][1],
+                                                        85, &data, &size),
+                     "g-digicam-camerabin: frame not encoded.");
+            fail_if (4 > size ||
+                     0xff != data[0] || 0xd8 != data[1] ||
+                     0xff != data[size - 2] || 0xd9 != data[size - 1],
+                     "g-digicam-camerabin: encoded frame is not a JPEG file.");
+            g_free (data);
+        }
+    }
+    g_free (src);
+}
+END_TEST
+
+/**
+ * Purpose: test the JPEG encoding in parallel strips.
+ * Cases considered:
+ *    - the strips are joined in a single file with the whole height.
+ *    - the file has a restart interval and a restart marker between
+ *      the strips.
+ *    - a single strip gives the same file as the whole encoding.
+ */
+START_TEST (test_g_digicam_camerabin_jpeg_strips)
+{
+    guchar *src = NULL;
+    guchar *data = NULL;
+    guchar *whole = NULL;
+    gsize size, whole_size, i;
+    gint sof_height = 0;
+    gboolean restart_interval = FALSE;
+    gint restarts = 0;
+
+    src = g_malloc (gst_video_format_get_size (GST_VIDEO_FORMAT_I420, 64, 200));
+    for (i = 0; i < gst_video_format_get_size (GST_VIDEO_FORMAT_I420, 64, 200); i++) {
+        src[i] = i % 251;
+    }
+
+    /* Test 1 */
+    fail_if (!_g_digicam_camerabin_jpeg_encode_strips (GST_VIDEO_FORMAT_I420, src,
+                                                       64, 200, 85, 4,
+                                                       &data, &size),
+             "g-digicam-camerabin: strips not encoded.");
+    fail_if (4 > size ||
+             0xff != data[0] || 0xd8 != data[1] ||
+             0xff != data[size - 2] || 0xd9 != data[size - 1],
+             "g-digicam-camerabin: joined strips are not a JPEG file.");
+
+    /* Test 2 */
+    for (i = 2; i + 6 < size; i++) {
+        if (0xff != data[i]) {
+            continue;
+        }
+        if ((0xc0 == data[i + 1]) && (0 == sof_height)) {
+            sof_height = (data[i + 5] << 8) | data[i + 6];
+        } else if (0xdd == data[i + 1]) {
+            restart_interval = TRUE;
+        } else if ((0xd0 <= data[i + 1]) && (0xd7 >= data[i + 1])) {
+            restarts++;
+        }
+    }
+    fail_if (200 != sof_height,
+             "g-digicam-camerabin: wrong height of the joined strips.");
+    fail_if (!restart_interval || 3 != restarts,
+             "g-digicam-camerabin: strips not joined with restart markers.");
+    g_free (data);
+
+    /* Test 3 */
+    _g_digicam_camerabin_jpeg_encode (GST_VIDEO_FORMAT_I420, src, 64, 200, 85,
+                                      &whole, &whole_size);
+    _g_digicam_camerabin_jpeg_encode_strips (GST_VIDEO_FORMAT_I420, src,
+                                             64, 200, 85, 1, &data, &size);
+    fail_if (whole_size != size || 0 != memcmp (whole, data, size),
+             "g-digicam-camerabin: single strip differs from the whole image.");
+    g_free (whole);
+    g_free (data);
+    g_free (src);
+}
+END_TEST
+
+static void
+_encoder_done (const gchar *filename,
+               const GError *error,
+               gpointer user_data)
+{
+    GPtrArray *saved = (GPtrArray *) user_data;
+
+    g_ptr_array_add (saved, g_strdup ((NULL == error) ? filename : ""));
+}
+
+/**
+ * Purpose: test the parallel encoding of the zero shutter lag frames.
+ * Cases considered:
+ *    - the pictures are saved in the order they were given, even if
+ *      later ones are encoded faster.
+ *    - freeing the encoders waits for all the pictures.
+ *    - a full queue refuses the frames instead of waiting.
+ */
+START_TEST (test_g_digicam_camerabin_encoder_regular)
+{
+    GDigicamCamerabinEncoder *encoder = NULL;
+    GPtrArray *saved = NULL;
+    GstBuffer *frame = NULL;
+    gchar *filenames[6];
+    gint width;
+    guint i;
+
+    saved = g_ptr_array_new ();
+    encoder = _g_digicam_camerabin_encoder_new (4, 2, 1, NULL, NULL);
+    fail_if (NULL == encoder,
+             "g-digicam-camerabin: encoders not created.");
+
+    /* Test 1 */
+    for (i = 0; i < G_N_ELEMENTS (filenames); i++) {
+        width = (0 == i) ? 1280 : 16;
+        frame = gst_buffer_new_and_alloc (gst_video_format_get_size (GST_VIDEO_FORMAT_I420,
+                                                                     width, width));
+        memset (GST_BUFFER_DATA (frame), 0x80, GST_BUFFER_SIZE (frame));
+        filenames[i] = g_strdup_printf ("%s/gdigicam-encoder-%d-%u.jpg",
+                                        g_get_tmp_dir (), getpid (), i);
+        /* A full queue refuses the frame, it is given again later */
+        while (!_g_digicam_camerabin_encoder_push (encoder, frame,
+                                                   GST_VIDEO_FORMAT_I420,
+                                                   width, width, 85,
+                                                   filenames[i],
+                                                   _encoder_done, saved,
+                                                   NULL)) {
+            g_usleep (1000);
+        }
+        fail_if (2 < _g_digicam_camerabin_encoder_get_pending (encoder),
+                 "g-digicam-camerabin: encoder queue overflown.");
+    }
+
+    /* Test 2 */
+    _g_digicam_camerabin_encoder_free (encoder);
+    fail_if (G_N_ELEMENTS (filenames) != saved->len,
+             "g-digicam-camerabin: not all the pictures were saved.");
+    for (i = 0; i < saved->len; i++) {
+        fail_if (0 != g_strcmp0 (filenames[i], g_ptr_array_index (saved, i)),
+                 "g-digicam-camerabin: pictures saved out of order.");
+        fail_if (!g_file_test (filenames[i], G_FILE_TEST_IS_REGULAR),
+                 "g-digicam-camerabin: picture not written.");
+        g_unlink (filenames[i]);
+        g_free (filenames[i]);
+        g_free (g_ptr_array_index (saved, i));
+    }
+    g_ptr_array_free (saved, TRUE);
+}
+END_TEST
+
+static gboolean
+_parallel_picture_done_cb (GDigicamManager *manager,
+                           const gchar *filename,
+                           gpointer user_data)
+{
+    g_main_loop_quit ((GMainLoop *) user_data);
+
+    return FALSE;
+}
+
+static gboolean
+_parallel_capture_timeout (gpointer user_data)
+{
+    g_main_loop_quit ((GMainLoop *) user_data);
+
+    return FALSE;
+}
+
+/**
+ * Purpose: test the pictures CameraBin captures encoded in parallel.
+ * Cases considered:
+ *    - the picture is saved by the shared encoders, as a whole JPEG
+ *      file, before "pict-done".
+ *    - disabling it gives the pictures back to the image encoder.
+ */
+START_TEST (test_g_digicam_camerabin_parallel_encoding_regular)
+{
+    GDigicamCamerabinModeHelper mode_helper;
+    GDigicamCamerabinPictureHelper picture_helper;
+    GDigicamDescriptor *parallel_descriptor = NULL;
+    GDigicamManager *manager = NULL;
+    GstElement *camerabin = NULL;
+    GMainLoop *loop = NULL;
+    GError *error = NULL;
+    gchar *filename = NULL;
+    gchar *contents = NULL;
+    gsize length = 0;
+    guint timeout;
+
+    loop = g_main_loop_new (NULL, FALSE);
+    filename = g_strdup_printf ("%s/gdigicam-parallel-%d.jpg",
+                                g_get_tmp_dir (), getpid ());
+
+    camerabin = g_digicam_camerabin_element_new ("videotestsrc",
+                                                 NULL, NULL, NULL, NULL,
+                                                 "jpegenc",
+                                                 NULL,
+                                                 "fakesink",
+                                                 NULL);
+    fail_if (!GST_IS_ELEMENT (camerabin),
+             "g-digicam-camerabin: camerabin not created.");
+    parallel_descriptor = g_digicam_camerabin_descriptor_new (camerabin);
+
+    manager = g_digicam_manager_new ();
+    fail_if (!g_digicam_manager_set_gstreamer_bin (manager, camerabin,
+                                                   parallel_descriptor,
+                                                   NULL),
+             "g-digicam-camerabin: camerabin not set in the manager.");
+    fail_if (!g_digicam_camerabin_set_parallel_encoding (camerabin, TRUE),
+             "g-digicam-camerabin: parallel encoding not enabled.");
+    mode_helper.mode = G_DIGICAM_MODE_STILL;
+    g_digicam_manager_set_mode (manager, G_DIGICAM_MODE_STILL, NULL,
+                                &mode_helper);
+    g_signal_connect (manager, "pict-done",
+                      G_CALLBACK (_parallel_picture_done_cb), loop);
+
+    gst_element_set_state (camerabin, GST_STATE_PLAYING);
+    gst_element_get_state (camerabin, NULL, NULL, GST_CLOCK_TIME_NONE);
+
+    /* Test 1 */
+    picture_helper.file_path = filename;
+    picture_helper.metadata = NULL;
+    fail_if (!g_digicam_manager_capture_still_picture (manager, filename,
+                                                       &error,
+                                                       &picture_helper),
+             "g-digicam-camerabin: capture not started.");
+    fail_if (NULL != error,
+             "g-digicam-camerabin: error was set.");
+
+    timeout = g_timeout_add_seconds (10, _parallel_capture_timeout, loop);
+    g_main_loop_run (loop);
+    g_source_remove (timeout);
+
+    fail_if (!g_file_get_contents (filename, &contents, &length, NULL),
+             "g-digicam-camerabin: picture not saved.");
+    fail_if ((4 > length) ||
+             (0xff != (guchar) contents[0]) ||
+             (0xd8 != (guchar) contents[1]) ||
+             (0xff != (guchar) contents[length - 2]) ||
+             (0xd9 != (guchar) contents[length - 1]),
+             "g-digicam-camerabin: picture not a whole JPEG file.");
+    g_free (contents);
+    g_unlink (filename);
+
+    /* Test 2 */
+    fail_if (!g_digicam_camerabin_set_parallel_encoding (camerabin, FALSE),
+             "g-digicam-camerabin: parallel encoding not disabled.");
+    fail_if (g_digicam_camerabin_get_parallel_encoding (camerabin),
+             "g-digicam-camerabin: parallel encoding still enabled.");
+
+    gst_element_set_state (camerabin, GST_STATE_NULL);
+    g_object_unref (manager);
+    g_digicam_manager_descriptor_free (parallel_descriptor);
+    gst_object_unref (GST_OBJECT (camerabin));
+    g_main_loop_unref (loop);
+    g_free (filename);
+}
+END_TEST
+#endif
+
+static void
+_writer_done (const gchar *filename,
+              const GError *error,
+              gpointer user_data)
+{
+    GPtrArray *saved = (GPtrArray *) user_data;
+
+    g_ptr_array_add (saved, g_strdup ((NULL == error) ? filename : ""));
+}
+
+/**
+ * Purpose: test the asynchronous saving of the pictures.
+ * Cases considered:
+ *    - freeing the writer waits for all the files.
+ *    - the files are saved in the order they were given, in batches,
+ *      replacing the existing ones.
+ *    - a file which can't be created is reported, and nothing is left
+ *      behind.
+ */
+START_TEST (test_g_digicam_camerabin_writer_regular)
+{
+    GDigicamCamerabinWriter *writer = NULL;
+    GPtrArray *saved = NULL;
+    GstBuffer *buffer = NULL;
+    GList *buffers = NULL;
+    GDir *dir = NULL;
+    gchar *dirname = NULL;
+    gchar *filenames[6];
+    gchar *contents = NULL;
+    gsize length;
+    guint i;
+
+    dirname = g_strdup_printf ("%s/gdigicam-writer-%d",
+                               g_get_tmp_dir (), getpid ());
+    g_mkdir (dirname, 0700);
+
+    saved = g_ptr_array_new ();
+    writer = _g_digicam_camerabin_writer_new (2, NULL);
+    fail_if (NULL == writer,
+             "g-digicam-camerabin: writer not created.");
+
+    for (i = 0; i < G_N_ELEMENTS (filenames); i++) {
+        filenames[i] = g_strdup_printf ("%s/%s%u.jpg", dirname,
+                                        (5 == i) ? "missing/" : "", i);
+        if (0 == i) {
+            g_file_set_contents (filenames[i], "previous", -1, NULL);
+        }
+
+        buffers = NULL;
+        buffer = gst_buffer_new_and_alloc (3);
+        memcpy (GST_BUFFER_DATA (buffer), "abc", 3);
+        buffers = g_list_append (buffers, buffer);
+        buffer = gst_buffer_new_and_alloc (1);
+        GST_BUFFER_DATA (buffer)[0] = '0' + i;
+        buffers = g_list_append (buffers, buffer);
+
+        _g_digicam_camerabin_writer_push (writer, filenames[i], buffers,
+                                          _writer_done, saved, NULL);
+    }
+
+    /* Test 1 */
+    _g_digicam_camerabin_writer_free (writer);
+    fail_if (G_N_ELEMENTS (filenames) != saved->len,
+             "g-digicam-camerabin: not all the files were reported.");
+
+    /* Test 2 */
+    for (i = 0; i < 5; i++) {
+        fail_if (0 != g_strcmp0 (filenames[i], g_ptr_array_index (saved, i)),
+                 "g-digicam-camerabin: files saved out of order.");
+        fail_if (!g_file_get_contents (filenames[i], &contents, &length, NULL) ||
+                 (4 != length) || (0 != memcmp (contents, "abc", 3)) ||
+                 ('0' + i != contents[3]),
+                 "g-digicam-camerabin: wrong file contents.");
+        g_free (contents);
+    }
+
+    /* Test 3 */
+    fail_if (0 != g_strcmp0 ("", g_ptr_array_index (saved, 5)),
+             "g-digicam-camerabin: failure not reported.");
+
+    dir = g_dir_open (dirname, 0, NULL);
+    length = 0;
+    while (NULL != g_dir_read_name (dir)) {
+        length++;
+    }
+    g_dir_close (dir);
+    fail_if (5 != length,
+             "g-digicam-camerabin: temporary files left behind.");
+
+    for (i = 0; i < G_N_ELEMENTS (filenames); i++) {
+        g_unlink (filenames[i]);
+        g_free (filenames[i]);
+        g_free (g_ptr_array_index (saved, i));
+    }
+    g_ptr_array_free (saved, TRUE);
+    g_rmdir (dirname);
+    g_free (dirname);
+}
+END_TEST
+
+typedef struct {
+    GMainLoop *loop;
+    guint buffers;
+    gboolean jpeg;
+    gboolean buffer_named;
+    gboolean done;
+    gboolean done_named;
+    gboolean ordered;
+    guint written;
+} MemoryCapture;
+
+static gint
+_compare_file_sink (GstElement *element,
+                    gpointer user_data)
+{
+    GstElementFactory *factory = NULL;
+    gint result;
+
+    factory = gst_element_get_factory (element);
+    result = ((NULL != factory) &&
+              (0 == g_strcmp0 (GST_PLUGIN_FEATURE_NAME (factory),
+                               "filesink"))) ? 0 : 1;
+    if (0 != result) {
+        gst_object_unref (element);
+    }
+
+    return result;
+}
+
+static gboolean
+_file_sink_data_cb (GstPad *pad,
+                    GstMiniObject *data,
+                    gpointer user_data)
+{
+    MemoryCapture *capture = (MemoryCapture *) user_data;
+
+    if (GST_IS_BUFFER (data)) {
+        capture->written++;
+    }
+
+    return TRUE;
+}
+
+static void
+_picture_buffer_cb (GDigicamManager *manager,
+                    GstBuffer *buffer,
+                    const gchar *filename,
+                    gpointer user_data)
+{
+    MemoryCapture *capture = (MemoryCapture *) user_data;
+
+    capture->buffers++;
+    capture->jpeg = (2 <= GST_BUFFER_SIZE (buffer)) &&
+        (0xff == GST_BUFFER_DATA (buffer)[0]) &&
+        (0xd8 == GST_BUFFER_DATA (buffer)[1]);
+    capture->buffer_named = (NULL != filename);
+}
+
+static gboolean
+_memory_picture_done_cb (GDigicamManager *manager,
+                         const gchar *filename,
+                         gpointer user_data)
+{
+    MemoryCapture *capture = (MemoryCapture *) user_data;
+
+    capture->done = TRUE;
+    capture->done_named = (NULL != filename);
+    capture->ordered = (0 < capture->buffers);
+    g_main_loop_quit (capture->loop);
+
+    return FALSE;
+}
+
+static gboolean
+_memory_capture_timeout (gpointer user_data)
+{
+    g_main_loop_quit ((GMainLoop *) user_data);
+
+    return FALSE;
+}
+
+/**
+ * Purpose: test the pictures only captured to memory.
+ * Cases considered:
+ *    - a capture without a file hands the encoded picture in
+ *      "picture-buffer", before "pict-done".
+ *    - both come without a filename and no buffer reaches the file
+ *      sink.
+ */
+START_TEST (test_g_digicam_camerabin_picture_buffers_regular)
+{
+    GDigicamCamerabinModeHelper mode_helper;
+    GDigicamCamerabinPictureHelper picture_helper;
+    GDigicamDescriptor *memory_descriptor = NULL;
+    GDigicamManager *manager = NULL;
+    GstElement *camerabin = NULL;
+    MemoryCapture capture;
+    GstElement *sink = NULL;
+    GstPad *sink_pad = NULL;
+    GstIterator *iterator = NULL;
+    GError *error = NULL;
+    guint timeout;
+
+    memset (&capture, 0, sizeof (capture));
+    capture.loop = g_main_loop_new (NULL, FALSE);
+
+    camerabin = g_digicam_camerabin_element_new ("videotestsrc",
+                                                 NULL, NULL, NULL, NULL,
+                                                 "jpegenc",
+                                                 NULL,
+                                                 "fakesink",
+                                                 NULL);
+    fail_if (!GST_IS_ELEMENT (camerabin),
+             "g-digicam-camerabin: camerabin not created.");
+    memory_descriptor = g_digicam_camerabin_descriptor_new (camerabin);
+
+    manager = g_digicam_manager_new ();
+    fail_if (!g_digicam_manager_set_gstreamer_bin (manager, camerabin,
+                                                   memory_descriptor, NULL),
+             "g-digicam-camerabin: camerabin not set in the manager.");
+    fail_if (!g_digicam_camerabin_set_picture_buffers (camerabin, TRUE),
+             "g-digicam-camerabin: pictures can't be captured to memory.");
+    mode_helper.mode = G_DIGICAM_MODE_STILL;
+    g_digicam_manager_set_mode (manager, G_DIGICAM_MODE_STILL, NULL,
+                                &mode_helper);
+
+    g_signal_connect (manager, "picture-buffer",
+                      G_CALLBACK (_picture_buffer_cb), &capture);
+    g_signal_connect (manager, "pict-done",
+                      G_CALLBACK (_memory_picture_done_cb), &capture);
+
+    gst_element_set_state (camerabin, GST_STATE_PLAYING);
+    gst_element_get_state (camerabin, NULL, NULL, GST_CLOCK_TIME_NONE);
+
+    /* Only sees what gets through the probes of GDigicam */
+    iterator = gst_bin_iterate_recurse (GST_BIN (camerabin));
+    sink = gst_iterator_find_custom (iterator,
+                                     (GCompareFunc) _compare_file_sink,
+                                     NULL);
+    gst_iterator_free (iterator);
+    fail_if (NULL == sink,
+             "g-digicam-camerabin: image file sink not found.");
+    sink_pad = gst_element_get_static_pad (sink, "sink");
+    g_signal_connect_after (sink_pad, "have-data",
+                            G_CALLBACK (_file_sink_data_cb), &capture);
+
+    /* Test 1 */
+    picture_helper.file_path = NULL;
+    picture_helper.metadata = NULL;
+    fail_if (!g_digicam_manager_capture_still_picture (manager, NULL,
+                                                       &error,
+                                                       &picture_helper),
+             "g-digicam-camerabin: capture to memory not started.");
+    fail_if (NULL != error,
+             "g-digicam-camerabin: error was set.");
+
+    timeout = g_timeout_add_seconds (10, _memory_capture_timeout,
+                                     capture.loop);
+    g_main_loop_run (capture.loop);
+    g_source_remove (timeout);
+
+    fail_if (!capture.done,
+             "g-digicam-camerabin: \"pict-done\" not emitted.");
+    fail_if ((1 != capture.buffers) || !capture.jpeg,
+             "g-digicam-camerabin: encoded picture not handed.");
+    fail_if (!capture.ordered,
+             "g-digicam-camerabin: picture handed after \"pict-done\".");
+
+    /* Test 2 */
+    fail_if (capture.buffer_named || capture.done_named,
+             "g-digicam-camerabin: filename given without a file.");
+    fail_if (0 != capture.written,
+             "g-digicam-camerabin: picture written to the file sink.");
+
+    gst_element_set_state (camerabin, GST_STATE_NULL);
+    gst_object_unref (sink_pad);
+    gst_object_unref (sink);
+    g_object_unref (manager);
+    g_digicam_manager_descriptor_free (memory_descriptor);
+    gst_object_unref (GST_OBJECT (camerabin));
+    g_main_loop_unref (capture.loop);
+}
+END_TEST
+
+/**
+ * Purpose: test the handling of the recording files.
+ * Cases considered:
+ *    - the file can be written while it is preallocated and flushed,
+ *      and its blocks cover the space reserved ahead.
+ *    - finishing leaves the file with the size and contents written,
+ *      giving back the blocks reserved ahead.
+ *    - without preallocation support only the flushing is tested.
+ */
+START_TEST (test_g_digicam_camerabin_recording_regular)
+{
+    GDigicamCamerabinPrealloc *prealloc = NULL;
+    GDigicamCamerabinWriteback *writeback = NULL;
+    GError *error = NULL;
+    struct stat buf;
+    gchar *filename = NULL;
+    gchar *contents = NULL;
+    gchar chunk[4096];
+    gsize length;
+    guint64 allocated = 0;
+    gboolean result;
+    gint fd;
+    guint i;
+
+    filename = g_strdup_printf ("%s/gdigicam-recording-%d.mp4",
+                                g_get_tmp_dir (), getpid ());
+    fd = g_open (filename, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    fail_if (0 > fd,
+             "g-digicam-camerabin: recording file not created.");
+
+    prealloc = _g_digicam_camerabin_prealloc_new (filename, 8000000, 10,
+                                                  &error);
+    if ((NULL == prealloc) && (NULL != error) &&
+        g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOSYS)) {
+        /* Built without preallocation support */
+        g_error_free (error);
+        error = NULL;
+    }
+    fail_if ((NULL == prealloc) && (NULL != error),
+             "g-digicam-camerabin: preallocation not started.");
+    writeback = _g_digicam_camerabin_writeback_new (filename, 64 * 1024,
+                                                    &error);
+    fail_if ((NULL == writeback) || (NULL != error),
+             "g-digicam-camerabin: writeback not started.");
+
+    /* Test 1 */
+    for (i = 0; i < 256; i++) {
+        memset (chunk, i, sizeof (chunk));
+        if (NULL != prealloc) {
+            _g_digicam_camerabin_prealloc_written (prealloc, sizeof (chunk));
+        }
+        _g_digicam_camerabin_writeback_written (writeback, sizeof (chunk));
+        fail_if ((gssize) sizeof (chunk) != write (fd, chunk, sizeof (chunk)),
+                 "g-digicam-camerabin: recording file not written.");
+    }
+    close (fd);
+
+    /* The size doesn't include the reserved space, the blocks do */
+    if (NULL != prealloc) {
+        allocated = _g_digicam_camerabin_prealloc_get_allocated (prealloc);
+        fail_if ((0 != g_stat (filename, &buf)) ||
+                 ((guint64) buf.st_blocks * 512 < allocated),
+                 "g-digicam-camerabin: space not reserved ahead.");
+    }
+
+    /* Test 2 */
+    if (NULL != prealloc) {
+        result = _g_digicam_camerabin_prealloc_finish (prealloc, &error);
+        fail_if (!result || (NULL != error),
+                 "g-digicam-camerabin: preallocation not finished.");
+    }
+    _g_digicam_camerabin_writeback_finish (writeback);
+
+    fail_if (!g_file_get_contents (filename, &contents, &length, NULL) ||
+             (256 * sizeof (chunk) != length),
+             "g-digicam-camerabin: wrong recording file size.");
+    for (i = 0; i < 256; i++) {
+        fail_if ((guchar) i != (guchar) contents[i * sizeof (chunk)] ||
+                 (guchar) i != (guchar) contents[(i + 1) * sizeof (chunk) - 1],
+                 "g-digicam-camerabin: wrong recording file contents.");
+    }
+
+    /* 10 seconds were reserved ahead, allow for the file system
+     * keeping some blocks past the end anyway */
+    fail_if ((0 != g_stat (filename, &buf)) ||
+             ((guint64) buf.st_blocks * 512 > length + 1024 * 1024),
+             "g-digicam-camerabin: reserved space not given back.");
+
+    g_free (contents);
+    g_unlink (filename);
+    g_free (filename);
+}
+END_TEST
+
+static guint
+_append_box (guint8 *stream,
+             const gchar *type,
+             guint size,
+             guint8 fill)
+{
+    GST_WRITE_UINT32_BE (stream, size);
+    memcpy (stream + 4, type, 4);
+    memset (stream + 8, fill, size - 8);
+
+    return size;
+}
+
+/* A moof box with the flags of its first sample, and the mdat box of
+ * its samples */
+#define FRAGMENT_SIZE (68 + 600)
+
+static guint
+_append_fragment (guint8 *stream,
+                  gboolean keyframe,
+                  guint8 fill)
+{
+    guint size;
+
+    GST_WRITE_UINT32_BE (stream, 68);
+    memcpy (stream + 4, "moof", 4);
+    size = 8;
+    size += _append_box (stream + size, "mfhd", 16, 0);
+    GST_WRITE_UINT32_BE (stream + size, 44);
+    memcpy (stream + size + 4, "traf", 4);
+    size += 8;
+    GST_WRITE_UINT32_BE (stream + size, 16);
+    memcpy (stream + size + 4, "tfhd", 4);
+    GST_WRITE_UINT32_BE (stream + size + 8, 0);
+    GST_WRITE_UINT32_BE (stream + size + 12, 1);
+    size += 16;
+    GST_WRITE_UINT32_BE (stream + size, 20);
+    memcpy (stream + size + 4, "trun", 4);
+    GST_WRITE_UINT32_BE (stream + size + 8, 0x000004);
+    GST_WRITE_UINT32_BE (stream + size + 12, 1);
+    GST_WRITE_UINT32_BE (stream + size + 16, keyframe ? 0 : 0x00010000);
+    size += 20;
+    size += _append_box (stream + size, "mdat", 600, fill);
+
+    return size;
+}
+
+/**
+ * Purpose: test the splitting of the recordings in segments.
+ * Cases considered:
+ *    - a new segment starts at the first fragment starting at a
+ *      keyframe after the current one is full, whatever the buffers
+ *      the stream comes in.
+ *    - every segment starts with the initialization part.
+ *    - the index of the whole stream at its end is not written.
+ */
+START_TEST (test_g_digicam_camerabin_segmenter_regular)
+{
+    GDigicamCamerabinSegmenter *segmenter = NULL;
+    GstBuffer *buffer = NULL;
+    GError *error = NULL;
+    gchar *filenames[3];
+    gchar *contents = NULL;
+    guint8 stream[8192];
+    gsize length;
+    guint size, offset, init, fragments, i;
+    gboolean result;
+
+    size = _append_box (stream, "ftyp", 16, 1);
+    size += _append_box (stream + size, "moov", 24, 2);
+    init = size;
+    for (i = 0; i < 6; i++) {
+        size += _append_fragment (stream + size, 3 != i, 20 + i);
+    }
+    size += _append_box (stream + size, "mfra", 16, 3);
+
+    filenames[0] = g_strdup_printf ("%s/gdigicam-segments-%d.mp4",
+                                    g_get_tmp_dir (), getpid ());
+    filenames[1] = g_strdup_printf ("%s/gdigicam-segments-%d-002.mp4",
+                                    g_get_tmp_dir (), getpid ());
+    filenames[2] = g_strdup_printf ("%s/gdigicam-segments-%d-003.mp4",
+                                    g_get_tmp_dir (), getpid ());
+
+    /* Full after three fragments, the fourth one doesn't start at a
+     * keyframe */
+    segmenter = _g_digicam_camerabin_segmenter_new (filenames[0], 0,
+                                                    init + 2 * FRAGMENT_SIZE + 1,
+                                                    0, 0, &error);
+    fail_if ((NULL == segmenter) || (NULL != error),
+             "g-digicam-camerabin: segmenter not created.");
+
+    /* Test 1 */
+    for (offset = 0; offset < size; offset += 7) {
+        buffer = gst_buffer_new_and_alloc (MIN (7, size - offset));
+        memcpy (GST_BUFFER_DATA (buffer), stream + offset,
+                GST_BUFFER_SIZE (buffer));
+        result = _g_digicam_camerabin_segmenter_push (segmenter, buffer,
+                                                      &error);
+        gst_buffer_unref (buffer);
+        fail_if (!result || (NULL != error),
+                 "g-digicam-camerabin: segment not written.");
+    }
+    fail_if (2 != _g_digicam_camerabin_segmenter_get_count (segmenter),
+             "g-digicam-camerabin: wrong number of segments.");
+    _g_digicam_camerabin_segmenter_finish (segmenter);
+
+    fail_if (g_file_test (filenames[2], G_FILE_TEST_EXISTS),
+             "g-digicam-camerabin: too many segments.");
+
+    /* Test 2 */
+    for (i = 0; i < 2; i++) {
+        fragments = (0 == i) ? 4 : 2;
+        fail_if (!g_file_get_contents (filenames[i], &contents, &length,
+                                       NULL) ||
+                 (init + fragments * FRAGMENT_SIZE != length) ||
+                 (0 != memcmp (contents, stream, init)) ||
+                 (0 != memcmp (contents + init,
+                               stream + init + i * 4 * FRAGMENT_SIZE,
+                               fragments * FRAGMENT_SIZE)),
+                 "g-digicam-camerabin: wrong segment contents.");
+        g_free (contents);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (filenames); i++) {
+        g_unlink (filenames[i]);
+        g_free (filenames[i]);
+    }
+}
+END_TEST
+
+/**
+ * Purpose: test moving a segmented recording to another directory.
+ * Cases considered:
+ *    - the current segment is cut at the next fragment starting at a
+ *      keyframe, even if it is not full.
+ *    - the next segment is created in the new directory, with the name
+ *      it would have had.
+ */
+START_TEST (test_g_digicam_camerabin_segmenter_directory)
+{
+    GDigicamCamerabinSegmenter *segmenter = NULL;
+    GstBuffer *buffer = NULL;
+    GError *error = NULL;
+    gchar *directory = NULL;
+    gchar *filenames[2];
+    gchar *contents = NULL;
+    guint8 stream[8192];
+    gsize length;
+    guint size, moved, cut, init, i;
+    gboolean result;
+
+    size = _append_box (stream, "ftyp", 16, 1);
+    size += _append_box (stream + size, "moov", 24, 2);
+    init = size;
+    moved = 0;
+    cut = 0;
+    for (i = 0; i < 4; i++) {
+        size += _append_fragment (stream + size, 2 != i, 20 + i);
+        if (1 == i) {
+            moved = size;
+        } else if (2 == i) {
+            cut = size;
+        }
+    }
+
+    directory = g_strdup_printf ("%s/gdigicam-storage-%d",
+                                 g_get_tmp_dir (), getpid ());
+    fail_if (0 != g_mkdir (directory, 0700),
+             "g-digicam-camerabin: directory not created.");
+    filenames[0] = g_strdup_printf ("%s/gdigicam-moved-%d.mp4",
+                                    g_get_tmp_dir (), getpid ());
+    filenames[1] = g_strdup_printf ("%s/gdigicam-moved-%d-002.mp4",
+                                    directory, getpid ());
+
+    /* Segments which are never full */
+    segmenter = _g_digicam_camerabin_segmenter_new (filenames[0], 0, 0,
+                                                    0, 0, &error);
+    fail_if ((NULL == segmenter) || (NULL != error),
+             "g-digicam-camerabin: segmenter not created.");
+
+    /* Test 1 */
+    for (i = 0; i < 2; i++) {
+        buffer = gst_buffer_new_and_alloc (0 == i ? moved : size - moved);
+        memcpy (GST_BUFFER_DATA (buffer), stream + (0 == i ? 0 : moved),
+                GST_BUFFER_SIZE (buffer));
+        result = _g_digicam_camerabin_segmenter_push (segmenter, buffer,
+                                                      &error);
+        gst_buffer_unref (buffer);
+        fail_if (!result || (NULL != error),
+                 "g-digicam-camerabin: segment not written.");
+        if (0 == i) {
+            _g_digicam_camerabin_segmenter_set_directory (segmenter,
+                                                          directory);
+        }
+    }
+    fail_if (2 != _g_digicam_camerabin_segmenter_get_count (segmenter),
+             "g-digicam-camerabin: the segment was not cut.");
+    _g_digicam_camerabin_segmenter_finish (segmenter);
+
+    /* Test 2 */
+    fail_if (!g_file_get_contents (filenames[0], &contents, &length,
+                                   NULL) ||
+             (cut != length) ||
+             (0 != memcmp (contents, stream, cut)),
+             "g-digicam-camerabin: wrong first segment contents.");
+    g_free (contents);
+    fail_if (!g_file_get_contents (filenames[1], &contents, &length,
+                                   NULL) ||
+             (init + size - cut != length) ||
+             (0 != memcmp (contents, stream, init)) ||
+             (0 != memcmp (contents + init, stream + cut, size - cut)),
+             "g-digicam-camerabin: the next segment is not in the new "
+             "directory.");
+    g_free (contents);
+
+    for (i = 0; i < G_N_ELEMENTS (filenames); i++) {
+        g_unlink (filenames[i]);
+        g_free (filenames[i]);
+    }
+    g_rmdir (directory);
+    g_free (directory);
+}
+END_TEST
+
+static gboolean
+_output_write (GDigicamCamerabinOutput *output,
+               const gchar *data)
+{
+    GstBuffer *buffer = NULL;
+    gboolean result;
+
+    buffer = gst_buffer_new_and_alloc (strlen (data));
+    memcpy (GST_BUFFER_DATA (buffer), data, GST_BUFFER_SIZE (buffer));
+    result = _g_digicam_camerabin_output_write (output, buffer, NULL);
+    gst_buffer_unref (buffer);
+
+    return result;
+}
+
+/**
+ * Purpose: test the writing to descriptors of the application.
+ * Cases considered:
+ *    - the data goes after what is already in a file, and the muxer
+ *      can go back to update it.
+ *    - the muxer going back on a pipe is ignored, but for the data
+ *      past what was written, and going forward leaves zeros.
+ *    - a file opened for appending is written as a pipe.
+ *    - a descriptor not open for writing is refused.
+ */
+START_TEST (test_g_digicam_camerabin_output_regular)
+{
+    GDigicamCamerabinOutput *output = NULL;
+    gchar *filename = NULL;
+    gchar *contents = NULL;
+    gchar data[16];
+    gsize length;
+    gint fds[2];
+    gint fd;
+
+    filename = g_strdup_printf ("%s/gdigicam-output-%d.jpg",
+                                g_get_tmp_dir (), getpid ());
+    fd = g_open (filename, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    fail_if ((0 > fd) || (4 != write (fd, "head", 4)),
+             "g-digicam-camerabin: output file not created.");
+
+    /* Test 1 */
+    output = _g_digicam_camerabin_output_new (fd, NULL);
+    fail_if (NULL == output,
+             "g-digicam-camerabin: output not created.");
+    fail_if (!_output_write (output, "abc") ||
+             !_output_write (output, "def"),
+             "g-digicam-camerabin: output not written.");
+    _g_digicam_camerabin_output_seek (output, 0);
+    fail_if (!_output_write (output, "X"),
+             "g-digicam-camerabin: output not updated.");
+    _g_digicam_camerabin_output_free (output);
+
+    fail_if (10 != lseek (fd, 0, SEEK_CUR),
+             "g-digicam-camerabin: output file left at the wrong offset.");
+    close (fd);
+    fail_if (!g_file_get_contents (filename, &contents, &length, NULL) ||
+             (10 != length) || (0 != memcmp (contents, "headXbcdef", 10)),
+             "g-digicam-camerabin: wrong output file contents.");
+    g_free (contents);
+
+    /* Test 2 */
+    fail_if (0 != pipe (fds),
+             "g-digicam-camerabin: pipe not created.");
+    output = _g_digicam_camerabin_output_new (fds[1], NULL);
+    close (fds[1]);
+    fail_if (NULL == output,
+             "g-digicam-camerabin: output not created.");
+    fail_if (!_output_write (output, "abc"),
+             "g-digicam-camerabin: output not written.");
+    _g_digicam_camerabin_output_seek (output, 0);
+    fail_if (!_output_write (output, "X"),
+             "g-digicam-camerabin: going back not ignored.");
+    _g_digicam_camerabin_output_seek (output, 3);
+    fail_if (!_output_write (output, "de"),
+             "g-digicam-camerabin: output not written.");
+    _g_digicam_camerabin_output_seek (output, 1);
+    fail_if (!_output_write (output, "XXXXv"),
+             "g-digicam-camerabin: output not written.");
+    _g_digicam_camerabin_output_seek (output, 8);
+    fail_if (!_output_write (output, "f"),
+             "g-digicam-camerabin: output not written.");
+    _g_digicam_camerabin_output_free (output);
+
+    length = read (fds[0], data, sizeof (data));
+    close (fds[0]);
+    fail_if ((9 != length) || (0 != memcmp (data, "abcdev\0\0f", 9)),
+             "g-digicam-camerabin: wrong output pipe contents.");
+
+    /* Test 3 */
+    fd = g_open (filename, O_WRONLY | O_APPEND, 0600);
+    fail_if (0 > fd,
+             "g-digicam-camerabin: output file not opened.");
+    output = _g_digicam_camerabin_output_new (fd, NULL);
+    close (fd);
+    fail_if (NULL == output,
+             "g-digicam-camerabin: output not created.");
+    fail_if (!_output_write (output, "gh"),
+             "g-digicam-camerabin: output not written.");
+    _g_digicam_camerabin_output_seek (output, 0);
+    fail_if (!_output_write (output, "X"),
+             "g-digicam-camerabin: going back not ignored.");
+    _g_digicam_camerabin_output_free (output);
+    fail_if (!g_file_get_contents (filename, &contents, &length, NULL) ||
+             (12 != length) || (0 != memcmp (contents, "headXbcdefgh", 12)),
+             "g-digicam-camerabin: wrong appended file contents.");
+    g_free (contents);
+
+    /* Test 4 */
+    fd = g_open (filename, O_RDONLY, 0);
+    fail_if (0 > fd,
+             "g-digicam-camerabin: output file not opened.");
+    fail_if (NULL != _g_digicam_camerabin_output_new (fd, NULL),
+             "g-digicam-camerabin: read only descriptor accepted.");
+    close (fd);
+
+    g_unlink (filename);
+    g_free (filename);
+}
+END_TEST
+
+/**
+ * Purpose: test the recordings written in fragments.
+ * Cases considered:
+ *    - a muxer with a "fragment-duration" property gets it set.
+ *    - a muxer without it is still used.
+ */
+START_TEST (test_g_digicam_camerabin_recording_fragments)
+{
+    GstElement *camerabin = NULL;
+    GstElement *vmux = NULL;
+    GstElementFactory *factory = NULL;
+    guint duration = 0;
+
+    /* Test 1 */
+    factory = gst_element_factory_find ("mp4mux");
+    if (NULL != factory) {
+        gst_object_unref (GST_OBJECT (factory));
+
+        camerabin = g_digicam_camerabin_element_new ("videotestsrc",
+                                                     NULL, "mp4mux",
+                                                     NULL, NULL,
+                                                     "jpegenc",
+                                                     NULL,
+                                                     "fakesink",
+                                                     NULL);
+        fail_if (!GST_IS_ELEMENT (camerabin),
+                 "g-digicam-camerabin: camerabin not created.");
+        g_object_get (camerabin, "videomux", &vmux, NULL);
+        fail_if (NULL == vmux,
+                 "g-digicam-camerabin: video muxer not set.");
+        fail_if (NULL == g_object_class_find_property (G_OBJECT_GET_CLASS (vmux),
+                                                       "fragment-duration"),
+                 "g-digicam-camerabin: mp4mux can't write fragments.");
+        g_object_get (vmux, "fragment-duration", &duration, NULL);
+        fail_if (0 == duration,
+                 "g-digicam-camerabin: fragment duration not set.");
+        gst_object_unref (GST_OBJECT (vmux));
+        gst_object_unref (GST_OBJECT (camerabin));
+    }
+
+    /* Test 2 */
+    factory = gst_element_factory_find ("avimux");
+    if (NULL != factory) {
+        gst_object_unref (GST_OBJECT (factory));
+
+        camerabin = g_digicam_camerabin_element_new ("videotestsrc",
+                                                     NULL, "avimux",
+                                                     NULL, NULL,
+                                                     "jpegenc",
+                                                     NULL,
+                                                     "fakesink",
+                                                     NULL);
+        fail_if (!GST_IS_ELEMENT (camerabin),
+                 "g-digicam-camerabin: camerabin not created.");
+        vmux = NULL;
+        g_object_get (camerabin, "videomux", &vmux, NULL);
+        fail_if (NULL == vmux,
+                 "g-digicam-camerabin: unfragmented muxer not used.");
+        gst_object_unref (GST_OBJECT (vmux));
+        gst_object_unref (GST_OBJECT (camerabin));
+    }
+}
+END_TEST
+
+typedef struct {
+    GMainLoop *loop;
+    GstBuffer *buffer;
+    guint buffers;
+    guint32 fourcc;
+    gint width;
+    gint height;
+    gint stride;
+    gboolean ordered;
+} PreviewCapture;
+
+static void
+_preview_buffer_cb (GDigicamManager *manager,
+                    GstBuffer *buffer,
+                    guint32 fourcc,
+                    gint width,
+                    gint height,
+                    gint stride,
+                    gpointer user_data)
+{
+    PreviewCapture *capture = (PreviewCapture *) user_data;
+
+    capture->buffers++;
+    capture->ordered = (buffer == capture->buffer);
+    capture->fourcc = fourcc;
+    capture->width = width;
+    capture->height = height;
+    capture->stride = stride;
+    g_main_loop_quit (capture->loop);
+}
+
+/**
+ * Purpose: test the raw previews handed by camerabin.
+ * Cases considered:
+ *    - a camerabin preview is handed in "preview-buffer" as is,
+ *      with its format, size and stride.
+ */
+START_TEST (test_g_digicam_camerabin_preview_buffer_regular)
+{
+    GDigicamCamerabinModeHelper mode_helper;
+    GDigicamDescriptor *preview_descriptor = NULL;
+    GDigicamManager *manager = NULL;
+    GstElement *camerabin = NULL;
+    PreviewCapture capture;
+    GstStructure *structure = NULL;
+    GstCaps *caps = NULL;
+    guint timeout;
+
+    memset (&capture, 0, sizeof (capture));
+    capture.loop = g_main_loop_new (NULL, FALSE);
+
+    camerabin = g_digicam_camerabin_element_new ("videotestsrc",
+                                                 NULL, NULL, NULL, NULL,
+                                                 "jpegenc",
+                                                 NULL,
+                                                 "fakesink",
+                                                 NULL);
+    fail_if (!GST_IS_ELEMENT (camerabin),
+             "g-digicam-camerabin: camerabin not created.");
+    preview_descriptor = g_digicam_camerabin_descriptor_new (camerabin);
+
+    manager = g_digicam_manager_new ();
+    fail_if (!g_digicam_manager_set_gstreamer_bin (manager, camerabin,
+                                                   preview_descriptor, NULL),
+             "g-digicam-camerabin: camerabin not set in the manager.");
+    mode_helper.mode = G_DIGICAM_MODE_STILL;
+    g_digicam_manager_set_mode (manager, G_DIGICAM_MODE_STILL, NULL,
+                                &mode_helper);
+
+    g_signal_connect (manager, "preview-buffer",
+                      G_CALLBACK (_preview_buffer_cb), &capture);
+
+    /* Test 1 */
+    /* Room for a 64x48 preview in any of the preview formats */
+    capture.buffer = gst_buffer_new_and_alloc (64 * 48 * 3);
+    memset (GST_BUFFER_DATA (capture.buffer), 0x80,
+            GST_BUFFER_SIZE (capture.buffer));
+    caps = gst_caps_new_simple ("video/x-raw-yuv",
+                                "width", G_TYPE_INT, 64,
+                                "height", G_TYPE_INT, 48,
+                                NULL);
+    gst_buffer_set_caps (capture.buffer, caps);
+    gst_caps_unref (caps);
+
+    structure = gst_structure_new ("preview-image",
+                                   "buffer", GST_TYPE_BUFFER, capture.buffer,
+                                   NULL);
+    gst_element_post_message (camerabin,
+                              gst_message_new_element (GST_OBJECT (camerabin),
+                                                       structure));
+
+    timeout = g_timeout_add_seconds (10, _memory_capture_timeout,
+                                     capture.loop);
+    g_main_loop_run (capture.loop);
+    g_source_remove (timeout);
+
+    fail_if (1 != capture.buffers,
+             "g-digicam-camerabin: \"preview-buffer\" not emitted.");
+    fail_if (!capture.ordered,
+             "g-digicam-camerabin: preview buffer copied.");
+    fail_if ((64 != capture.width) || (48 != capture.height),
+             "g-digicam-camerabin: wrong preview size.");
+    fail_if ((GST_MAKE_FOURCC ('U', 'Y', 'V', 'Y') == capture.fourcc) &&
+             (128 != capture.stride),
+             "g-digicam-camerabin: wrong UYVY preview stride.");
+    fail_if ((GST_MAKE_FOURCC ('R', 'G', 'B', ' ') == capture.fourcc) &&
+             (192 != capture.stride),
+             "g-digicam-camerabin: wrong RGB preview stride.");
+    fail_if (((GST_MAKE_FOURCC ('I', '4', '2', '0') == capture.fourcc) ||
+              (GST_MAKE_FOURCC ('N', 'V', '1', '2') == capture.fourcc)) &&
+             (64 != capture.stride),
+             "g-digicam-camerabin: wrong planar preview stride.");
+
+    gst_buffer_unref (capture.buffer);
+    g_object_unref (manager);
+    g_digicam_manager_descriptor_free (preview_descriptor);
+    gst_object_unref (GST_OBJECT (camerabin));
+    g_main_loop_unref (capture.loop);
+}
+END_TEST
+
 /* ---------- Suite creation ---------- */
 
 Suite *create_g_digicam_camerabin_suite (void)
@@ -283,6 +2092,17 @@ Suite *create_g_digicam_camerabin_suite (void)
     /* Create test cases */
     TCase *tc1 = tcase_create ("new");
     TCase *tc2 = tcase_create ("new");
+    TCase *tc3 = tcase_create ("new_async");
+    TCase *tc4 = tcase_create ("colorspace");
+    TCase *tc5 = tcase_create ("metadata");
+    TCase *tc6 = tcase_create ("xmp");
+    TCase *tc7 = tcase_create ("prerecord");
+#ifdef HAVE_JPEG
+    TCase *tc8 = tcase_create ("jpeg");
+#endif
+    TCase *tc9 = tcase_create ("writer");
+    TCase *tc10 = tcase_create ("recording");
+    TCase *tc11 = tcase_create ("preview");
 
     /* Create test case for element_new and add it to the suite */
     tcase_add_checked_fixture (tc1, fx_setup_g_digicam_camerabin, NULL);
@@ -299,6 +2119,68 @@ Suite *create_g_digicam_camerabin_suite (void)
     tcase_add_test (tc2, test_g_digicam_camerabin_descriptor_new_regular);
     suite_add_tcase (s, tc2);
 
+    /* Create test case for element_new_async and add it to the suite */
+    tcase_add_checked_fixture (tc3, fx_setup_g_digicam_camerabin, NULL);
+    tcase_add_test (tc3, test_g_digicam_camerabin_element_new_async_regular);
+    tcase_add_test (tc3, test_g_digicam_camerabin_element_recycle_manager);
+    suite_add_tcase (s, tc3);
+
+    /* Create test case for the preview colorspace conversion and add
+     * it to the suite */
+    tcase_add_test (tc4, test_g_digicam_camerabin_colorspace_regular);
+    suite_add_tcase (s, tc4);
+
+    /* Create test case for the metadata session and add it to the
+     * suite */
+    tcase_add_checked_fixture (tc5, fx_setup_g_digicam_camerabin, NULL);
+    tcase_add_test (tc5, test_g_digicam_camerabin_metadata_regular);
+    suite_add_tcase (s, tc5);
+
+    /* Create test case for the deferred metadata and add it to the
+     * suite */
+    tcase_add_test (tc6, test_g_digicam_camerabin_xmp_regular);
+    suite_add_tcase (s, tc6);
+
+    /* Create test case for the pre-record ring and add it to the
+     * suite */
+    tcase_add_checked_fixture (tc7, fx_setup_g_digicam_camerabin, NULL);
+    tcase_add_test (tc7, test_g_digicam_camerabin_prerecord_regular);
+    tcase_add_test (tc7, test_g_digicam_camerabin_prerecord_pick);
+    suite_add_tcase (s, tc7);
+
+#ifdef HAVE_JPEG
+    /* Create test case for the zero shutter lag encoders and add it
+     * to the suite */
+    tcase_add_checked_fixture (tc8, fx_setup_g_digicam_camerabin, NULL);
+    tcase_add_test (tc8, test_g_digicam_camerabin_jpeg_regular);
+    tcase_add_test (tc8, test_g_digicam_camerabin_jpeg_strips);
+    tcase_add_test (tc8, test_g_digicam_camerabin_encoder_regular);
+    tcase_add_test (tc8, test_g_digicam_camerabin_parallel_encoding_regular);
+    suite_add_tcase (s, tc8);
+#endif
+
+    /* Create test case for the picture writer and add it to the
+     * suite */
+    tcase_add_checked_fixture (tc9, fx_setup_g_digicam_camerabin, NULL);
+    tcase_add_test (tc9, test_g_digicam_camerabin_writer_regular);
+    tcase_add_test (tc9, test_g_digicam_camerabin_picture_buffers_regular);
+    suite_add_tcase (s, tc9);
+
+    /* Create test case for the recording files and add it to the
+     * suite */
+    tcase_add_checked_fixture (tc10, fx_setup_g_digicam_camerabin, NULL);
+    tcase_add_test (tc10, test_g_digicam_camerabin_recording_regular);
+    tcase_add_test (tc10, test_g_digicam_camerabin_recording_fragments);
+    tcase_add_test (tc10, test_g_digicam_camerabin_segmenter_regular);
+    tcase_add_test (tc10, test_g_digicam_camerabin_segmenter_directory);
+    tcase_add_test (tc10, test_g_digicam_camerabin_output_regular);
+    suite_add_tcase (s, tc10);
+
+    /* Create test case for the raw previews and add it to the suite */
+    tcase_add_checked_fixture (tc11, fx_setup_g_digicam_camerabin, NULL);
+    tcase_add_test (tc11, test_g_digicam_camerabin_preview_buffer_regular);
+    suite_add_tcase (s, tc11);
+
     /* Return created suite */
     return s;
 }